@@ -2,6 +2,7 @@
 
 #include "plugin_logsmanagement.h"
 #include "../../logsmanagement/file_info.h"
+#include "../../logsmanagement/circular_buffer.h"
 
 #define NETDATA_CHART_PRIO_LOGS_BASE            132200
 #define NETDATA_CHART_PRIO_LINES                NETDATA_CHART_PRIO_LOGS_BASE + 0
@@ -19,6 +20,13 @@
 #define NETDATA_CHART_PRIO_IP_VER               NETDATA_CHART_PRIO_LOGS_BASE + 12
 #define NETDATA_CHART_PRIO_REQ_CLIENT_CURRENT   NETDATA_CHART_PRIO_LOGS_BASE + 13
 #define NETDATA_CHART_PRIO_REQ_CLIENT_ALL_TIME  NETDATA_CHART_PRIO_LOGS_BASE + 14
+#define NETDATA_CHART_PRIO_CIRC_BUFF_ITEMS      NETDATA_CHART_PRIO_LOGS_BASE + 15
+#define NETDATA_CHART_PRIO_CIRC_BUFF_MEM        NETDATA_CHART_PRIO_LOGS_BASE + 16
+#define NETDATA_CHART_PRIO_CIRC_BUFF_FULL       NETDATA_CHART_PRIO_LOGS_BASE + 17
+#define NETDATA_CHART_PRIO_DB_WRITES            NETDATA_CHART_PRIO_LOGS_BASE + 18
+#define NETDATA_CHART_PRIO_DB_WRITE_BATCHES     NETDATA_CHART_PRIO_LOGS_BASE + 19
+#define NETDATA_CHART_PRIO_DB_COMMIT_LATENCY    NETDATA_CHART_PRIO_LOGS_BASE + 20
+#define NETDATA_CHART_PRIO_UPS_RESP_TIME        NETDATA_CHART_PRIO_LOGS_BASE + 21
 
 struct Chart_data{
     char *rrd_type;
@@ -29,18 +37,29 @@ struct Chart_data{
     RRDDIM *dim_lines_rate;
     collected_number num_lines_total, num_lines_rate;
 
+    /* Circular buffer */
+    RRDSET *st_circ_buff_items, *st_circ_buff_mem, *st_circ_buff_full;
+    RRDDIM *dim_circ_buff_items, *dim_circ_buff_items_max;
+    RRDDIM *dim_circ_buff_mem, *dim_circ_buff_mem_max;
+    RRDDIM *dim_circ_buff_writes_deferred, *dim_circ_buff_msgs_dropped;
+    RRDSET *st_db_writes, *st_db_write_batches, *st_db_commit_latency;
+    RRDDIM *dim_db_writes_text, *dim_db_writes_blob, *dim_db_writes_metadata;
+    RRDDIM *dim_db_write_batches, *dim_db_write_msgs;
+    RRDDIM *dim_db_commit_latency_max;
+
     /* Vhosts */
     RRDSET *st_vhost;
     RRDDIM **dim_vhosts;
     collected_number *num_vhosts;
     int vhost_size, vhost_size_max; /**< Actual size and maximum allocated size of dim_vhosts, num_vhosts arrays **/ 
+    struct log_parser_metrics_vhosts_array vhost_index; /**< Hash indexed names of dim_vhosts, in the same order **/
 
     /* Ports */
     RRDSET *st_port;
     RRDDIM **dim_ports;
     collected_number *num_ports;
-    int *ports;                      /**< Array of port numbers  **/
-    int port_size, port_size_max;    /**< Actual size and maximum allocated size of dim_ports, num_ports and ports arrays **/ 
+    int port_size, port_size_max;    /**< Actual size and maximum allocated size of dim_ports, num_ports arrays **/ 
+    struct log_parser_metrics_ports_array port_index; /**< Hash indexed port numbers of dim_ports, in the same order **/
 
     /* IP Version */
     RRDSET *st_ip_ver;
@@ -88,7 +107,14 @@ struct Chart_data{
     /* Request processing time */
     RRDSET *st_req_proc_time;
     RRDDIM *dim_req_proc_time_min, *dim_req_proc_time_max, *dim_req_proc_time_avg;
+    RRDDIM *dim_req_proc_time_p50, *dim_req_proc_time_p95, *dim_req_proc_time_p99;
     collected_number num_req_proc_time_min, num_req_proc_time_max, num_req_proc_time_avg;
+    collected_number num_req_proc_time_p50, num_req_proc_time_p95, num_req_proc_time_p99;
+
+    /* Upstream response time */
+    RRDSET *st_ups_resp_time;
+    RRDDIM *dim_ups_resp_time_p50, *dim_ups_resp_time_p95, *dim_ups_resp_time_p99;
+    collected_number num_ups_resp_time_p50, num_ups_resp_time_p95, num_ups_resp_time_p99;
 
     /* Response code family */
     RRDSET *st_resp_code_family;
@@ -115,6 +141,7 @@ struct Chart_data{
     RRDDIM **dim_ssl_ciphers;
     collected_number *num_ssl_ciphers;
     int ssl_cipher_size, ssl_cipher_size_max; /**< Actual size and maximum allocated size of dim_ssl_ciphers, num_ssl_ciphers arrays **/ 
+    struct log_parser_metrics_ssl_cipher_array ssl_cipher_index; /**< Hash indexed strings of dim_ssl_ciphers, in the same order **/
 };
 
 static struct Chart_data **chart_data_arr;
@@ -169,6 +196,110 @@ void *logsmanagement_plugin_main(void *ptr){
         chart_data_arr[i]->dim_lines_total = rrddim_add(chart_data_arr[i]->st_lines, "Total lines", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
         chart_data_arr[i]->dim_lines_rate = rrddim_add(chart_data_arr[i]->st_lines, "New lines", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
 
+        /* Circular buffer - initialise */
+        chart_data_arr[i]->st_circ_buff_items = rrdset_create_localhost(
+                chart_data_arr[i]->rrd_type
+                , "circular_buffer_items"
+                , NULL
+                , "circular buffer"
+                , NULL
+                , "Circular buffer occupancy"
+                , "items"
+                , "logsmanagement.plugin"
+                , NULL
+                , NETDATA_CHART_PRIO_CIRC_BUFF_ITEMS
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_LINE
+        );
+        chart_data_arr[i]->dim_circ_buff_items = rrddim_add(chart_data_arr[i]->st_circ_buff_items, "used", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+        chart_data_arr[i]->dim_circ_buff_items_max = rrddim_add(chart_data_arr[i]->st_circ_buff_items, "max", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+
+        chart_data_arr[i]->st_circ_buff_mem = rrdset_create_localhost(
+                chart_data_arr[i]->rrd_type
+                , "circular_buffer_memory"
+                , NULL
+                , "circular buffer"
+                , NULL
+                , "Circular buffer memory usage"
+                , "KiB"
+                , "logsmanagement.plugin"
+                , NULL
+                , NETDATA_CHART_PRIO_CIRC_BUFF_MEM
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_LINE
+        );
+        chart_data_arr[i]->dim_circ_buff_mem = rrddim_add(chart_data_arr[i]->st_circ_buff_mem, "used", NULL, 1, 1024, RRD_ALGORITHM_ABSOLUTE);
+        chart_data_arr[i]->dim_circ_buff_mem_max = rrddim_add(chart_data_arr[i]->st_circ_buff_mem, "max", NULL, 1, 1024, RRD_ALGORITHM_ABSOLUTE);
+
+        chart_data_arr[i]->st_circ_buff_full = rrdset_create_localhost(
+                chart_data_arr[i]->rrd_type
+                , "circular_buffer_full"
+                , NULL
+                , "circular buffer"
+                , NULL
+                , "Circular buffer full events"
+                , "events/s"
+                , "logsmanagement.plugin"
+                , NULL
+                , NETDATA_CHART_PRIO_CIRC_BUFF_FULL
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_LINE
+        );
+        chart_data_arr[i]->dim_circ_buff_writes_deferred = rrddim_add(chart_data_arr[i]->st_circ_buff_full, "deferred_reads", "deferred reads", 1, 1, RRD_ALGORITHM_INCREMENTAL);
+        chart_data_arr[i]->dim_circ_buff_msgs_dropped = rrddim_add(chart_data_arr[i]->st_circ_buff_full, "dropped_messages", "dropped messages", 1, 1, RRD_ALGORITHM_INCREMENTAL);
+
+        /* DB writer - initialise */
+        chart_data_arr[i]->st_db_writes = rrdset_create_localhost(
+                chart_data_arr[i]->rrd_type
+                , "db_writes"
+                , NULL
+                , "db writer"
+                , NULL
+                , "DB write amplification (log text vs bytes written to disk)"
+                , "KiB/s"
+                , "logsmanagement.plugin"
+                , NULL
+                , NETDATA_CHART_PRIO_DB_WRITES
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_LINE
+        );
+        chart_data_arr[i]->dim_db_writes_text = rrddim_add(chart_data_arr[i]->st_db_writes, "log_text", "log text", 1, 1024, RRD_ALGORITHM_INCREMENTAL);
+        chart_data_arr[i]->dim_db_writes_blob = rrddim_add(chart_data_arr[i]->st_db_writes, "blob", NULL, 1, 1024, RRD_ALGORITHM_INCREMENTAL);
+        chart_data_arr[i]->dim_db_writes_metadata = rrddim_add(chart_data_arr[i]->st_db_writes, "metadata", NULL, 1, 1024, RRD_ALGORITHM_INCREMENTAL);
+
+        chart_data_arr[i]->st_db_write_batches = rrdset_create_localhost(
+                chart_data_arr[i]->rrd_type
+                , "db_write_batches"
+                , NULL
+                , "db writer"
+                , NULL
+                , "DB write batches and messages"
+                , "writes/s"
+                , "logsmanagement.plugin"
+                , NULL
+                , NETDATA_CHART_PRIO_DB_WRITE_BATCHES
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_LINE
+        );
+        chart_data_arr[i]->dim_db_write_batches = rrddim_add(chart_data_arr[i]->st_db_write_batches, "batches", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+        chart_data_arr[i]->dim_db_write_msgs = rrddim_add(chart_data_arr[i]->st_db_write_batches, "messages", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+
+        chart_data_arr[i]->st_db_commit_latency = rrdset_create_localhost(
+                chart_data_arr[i]->rrd_type
+                , "db_commit_latency"
+                , NULL
+                , "db writer"
+                , NULL
+                , "DB flush commit latency"
+                , "milliseconds"
+                , "logsmanagement.plugin"
+                , NULL
+                , NETDATA_CHART_PRIO_DB_COMMIT_LATENCY
+                , localhost->rrd_update_every
+                , RRDSET_TYPE_LINE
+        );
+        chart_data_arr[i]->dim_db_commit_latency_max = rrddim_add(chart_data_arr[i]->st_db_commit_latency, "max", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+
         /* Vhost - initialise */
         if(p_file_info->parser_config->chart_config & CHART_VHOST){
             chart_data_arr[i]->st_vhost = rrdset_create_localhost(
@@ -383,6 +514,30 @@ void *logsmanagement_plugin_main(void *ptr){
             chart_data_arr[i]->dim_req_proc_time_min = rrddim_add(chart_data_arr[i]->st_req_proc_time, "min", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
             chart_data_arr[i]->dim_req_proc_time_max = rrddim_add(chart_data_arr[i]->st_req_proc_time, "max", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
             chart_data_arr[i]->dim_req_proc_time_avg = rrddim_add(chart_data_arr[i]->st_req_proc_time, "avg", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+            chart_data_arr[i]->dim_req_proc_time_p50 = rrddim_add(chart_data_arr[i]->st_req_proc_time, "p50", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+            chart_data_arr[i]->dim_req_proc_time_p95 = rrddim_add(chart_data_arr[i]->st_req_proc_time, "p95", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+            chart_data_arr[i]->dim_req_proc_time_p99 = rrddim_add(chart_data_arr[i]->st_req_proc_time, "p99", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+        }
+
+        /* Upstream response time - initialise */
+        if(p_file_info->parser_config->chart_config & CHART_UPS_RESP_TIME){
+            chart_data_arr[i]->st_ups_resp_time = rrdset_create_localhost(
+                    chart_data_arr[i]->rrd_type
+                    , "upstream_timings"
+                    , NULL
+                    , "timings"
+                    , NULL
+                    , "Upstream Response Time"
+                    , "milliseconds"
+                    , "logsmanagement.plugin"
+                    , NULL
+                    , NETDATA_CHART_PRIO_UPS_RESP_TIME
+                    , localhost->rrd_update_every
+                    , RRDSET_TYPE_LINE
+            );
+            chart_data_arr[i]->dim_ups_resp_time_p50 = rrddim_add(chart_data_arr[i]->st_ups_resp_time, "p50", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+            chart_data_arr[i]->dim_ups_resp_time_p95 = rrddim_add(chart_data_arr[i]->st_ups_resp_time, "p95", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
+            chart_data_arr[i]->dim_ups_resp_time_p99 = rrddim_add(chart_data_arr[i]->st_ups_resp_time, "p99", NULL, 1, 1000, RRD_ALGORITHM_ABSOLUTE);
         }
 
         /* Response code family - initialise */
@@ -510,13 +665,10 @@ void *logsmanagement_plugin_main(void *ptr){
         /* Vhost - collect first time */
         if(p_file_info->parser_config->chart_config & CHART_VHOST){
             for(int j = 0; j < p_file_info->parser_metrics->vhost_arr.size; j++){
-                int k;
-                for(k = 0; k < chart_data_arr[i]->vhost_size; k++){
-                    if(!strcmp(p_file_info->parser_metrics->vhost_arr.vhosts[j].name, chart_data_arr[i]->dim_vhosts[k]->name)){
-                        chart_data_arr[i]->num_vhosts[k] = p_file_info->parser_metrics->vhost_arr.vhosts[j].count;
-                        p_file_info->parser_metrics->vhost_arr.vhosts[j].count = 0;
-                        break;
-                    }
+                const int k = parser_metrics_vhost_get(&chart_data_arr[i]->vhost_index, p_file_info->parser_metrics->vhost_arr.vhosts[j].name);
+                if(k < chart_data_arr[i]->vhost_size){
+                    chart_data_arr[i]->num_vhosts[k] = p_file_info->parser_metrics->vhost_arr.vhosts[j].count;
+                    p_file_info->parser_metrics->vhost_arr.vhosts[j].count = 0;
                 }
                 if(chart_data_arr[i]->vhost_size == k){ // New vhost not in existing dimensions
                     chart_data_arr[i]->vhost_size++;
@@ -540,13 +692,10 @@ void *logsmanagement_plugin_main(void *ptr){
         /* Port - collect first time */
         if(p_file_info->parser_config->chart_config & CHART_PORT){
             for(int j = 0; j < p_file_info->parser_metrics->port_arr.size; j++){
-                int k;
-                for(k = 0; k < chart_data_arr[i]->port_size; k++){
-                    if(p_file_info->parser_metrics->port_arr.ports[j].port == chart_data_arr[i]->ports[k]){
-                        chart_data_arr[i]->num_ports[k] = p_file_info->parser_metrics->port_arr.ports[j].count;
-                        p_file_info->parser_metrics->port_arr.ports[j].count = 0;
-                        break;
-                    }
+                const int k = parser_metrics_port_get(&chart_data_arr[i]->port_index, p_file_info->parser_metrics->port_arr.ports[j].port);
+                if(k < chart_data_arr[i]->port_size){
+                    chart_data_arr[i]->num_ports[k] = p_file_info->parser_metrics->port_arr.ports[j].count;
+                    p_file_info->parser_metrics->port_arr.ports[j].count = 0;
                 }
                 if(chart_data_arr[i]->port_size == k){ // New port not in existing dimensions
                     chart_data_arr[i]->port_size++;
@@ -554,19 +703,16 @@ void *logsmanagement_plugin_main(void *ptr){
                     if(chart_data_arr[i]->port_size >= chart_data_arr[i]->port_size_max){
                         chart_data_arr[i]->port_size_max = chart_data_arr[i]->port_size * LOG_PARSER_METRICS_PORT_BUFFS_SCALE_FACTOR + 1;
 
-                        chart_data_arr[i]->ports = reallocz(chart_data_arr[i]->ports, chart_data_arr[i]->port_size_max * sizeof(int));
                         chart_data_arr[i]->dim_ports = reallocz(chart_data_arr[i]->dim_ports, chart_data_arr[i]->port_size_max * sizeof(RRDDIM));
                         chart_data_arr[i]->num_ports = reallocz(chart_data_arr[i]->num_ports, chart_data_arr[i]->port_size_max * sizeof(collected_number));
                     }
 
-                    chart_data_arr[i]->ports[chart_data_arr[i]->port_size - 1] = p_file_info->parser_metrics->port_arr.ports[j].port;
-
-                    if(unlikely(chart_data_arr[i]->ports[chart_data_arr[i]->port_size - 1] == INVALID_PORT)){
+                    if(unlikely(chart_data_arr[i]->port_index.ports[k].port == INVALID_PORT)){
                         chart_data_arr[i]->dim_ports[chart_data_arr[i]->port_size - 1] = rrddim_add(chart_data_arr[i]->st_port, 
                             "invalid", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
                     } else {
                         char port_name[6] = "";
-                        snprintf(port_name, 6, "%d", chart_data_arr[i]->ports[chart_data_arr[i]->port_size - 1]);
+                        snprintf(port_name, 6, "%d", chart_data_arr[i]->port_index.ports[k].port);
                         chart_data_arr[i]->dim_ports[chart_data_arr[i]->port_size - 1] = rrddim_add(chart_data_arr[i]->st_port, 
                             port_name, NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
                     }
@@ -589,16 +735,15 @@ void *logsmanagement_plugin_main(void *ptr){
 
         /* Request client current poll - collect first time */
         if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_CURRENT){
-            chart_data_arr[i]->num_req_client_current_ipv4 = p_file_info->parser_metrics->req_clients_current_arr.ipv4_size;
-            p_file_info->parser_metrics->req_clients_current_arr.ipv4_size = 0;  
-            chart_data_arr[i]->num_req_client_current_ipv6 = p_file_info->parser_metrics->req_clients_current_arr.ipv6_size;
-            p_file_info->parser_metrics->req_clients_current_arr.ipv6_size = 0;
+            chart_data_arr[i]->num_req_client_current_ipv4 = parser_metrics_req_clients_ipv4_count(&p_file_info->parser_metrics->req_clients_current_arr);
+            chart_data_arr[i]->num_req_client_current_ipv6 = parser_metrics_req_clients_ipv6_count(&p_file_info->parser_metrics->req_clients_current_arr);
+            parser_metrics_req_clients_reset(&p_file_info->parser_metrics->req_clients_current_arr);
         }
 
         /* Request client all-time - collect first time */
         if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_ALL_TIME){
-            chart_data_arr[i]->num_req_client_all_time_ipv4 = p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size;  
-            chart_data_arr[i]->num_req_client_all_time_ipv6 = p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size;
+            chart_data_arr[i]->num_req_client_all_time_ipv4 = parser_metrics_req_clients_ipv4_count(&p_file_info->parser_metrics->req_clients_alltime_arr);  
+            chart_data_arr[i]->num_req_client_all_time_ipv6 = parser_metrics_req_clients_ipv6_count(&p_file_info->parser_metrics->req_clients_alltime_arr);
         }
 
         /* Request methods - collect first time */
@@ -711,6 +856,18 @@ void *logsmanagement_plugin_main(void *ptr){
                     p_file_info->parser_metrics->req_proc_time.sum / p_file_info->parser_metrics->req_proc_time.count : 0;
             p_file_info->parser_metrics->req_proc_time.sum = 0;
             p_file_info->parser_metrics->req_proc_time.count = 0;
+            chart_data_arr[i]->num_req_proc_time_p50 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->req_proc_time.hist, 0.50);
+            chart_data_arr[i]->num_req_proc_time_p95 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->req_proc_time.hist, 0.95);
+            chart_data_arr[i]->num_req_proc_time_p99 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->req_proc_time.hist, 0.99);
+            parser_metrics_latency_hist_reset(&p_file_info->parser_metrics->req_proc_time.hist);
+        }
+
+        /* Upstream response time - collect */
+        if(p_file_info->parser_config->chart_config & CHART_UPS_RESP_TIME){
+            chart_data_arr[i]->num_ups_resp_time_p50 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->ups_resp_time_hist, 0.50);
+            chart_data_arr[i]->num_ups_resp_time_p95 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->ups_resp_time_hist, 0.95);
+            chart_data_arr[i]->num_ups_resp_time_p99 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->ups_resp_time_hist, 0.99);
+            parser_metrics_latency_hist_reset(&p_file_info->parser_metrics->ups_resp_time_hist);
         }
 
         /* Response code family - collect first time */
@@ -772,13 +929,10 @@ void *logsmanagement_plugin_main(void *ptr){
         /* SSL cipher suite - collect first time */
         if(p_file_info->parser_config->chart_config & CHART_SSL_CIPHER){
             for(int j = 0; j < p_file_info->parser_metrics->ssl_cipher_arr.size; j++){
-                int k;
-                for(k = 0; k < chart_data_arr[i]->ssl_cipher_size; k++){
-                    if(!strcmp(p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].string, chart_data_arr[i]->dim_ssl_ciphers[k]->name)){
-                        chart_data_arr[i]->num_ssl_ciphers[k] = p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count;
-                        p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count = 0;
-                        break;
-                    }
+                const int k = parser_metrics_ssl_cipher_get(&chart_data_arr[i]->ssl_cipher_index, p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].string);
+                if(k < chart_data_arr[i]->ssl_cipher_size){
+                    chart_data_arr[i]->num_ssl_ciphers[k] = p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count;
+                    p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count = 0;
                 }
                 if(chart_data_arr[i]->ssl_cipher_size == k){ // New SSL cipher suite not in existing dimensions
                     chart_data_arr[i]->ssl_cipher_size++;
@@ -809,6 +963,36 @@ void *logsmanagement_plugin_main(void *ptr){
         rrddim_set_by_pointer(chart_data_arr[i]->st_lines, chart_data_arr[i]->dim_lines_rate, chart_data_arr[i]->num_lines_rate);
     	rrdset_done(chart_data_arr[i]->st_lines);
 
+        /* Circular buffer - collect and update charts first time */
+        Circ_buff_stats_t circ_buff_stats;
+        circ_buff_get_stats(p_file_info->msg_buff, &circ_buff_stats);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_items, chart_data_arr[i]->dim_circ_buff_items, circ_buff_stats.num_of_items);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_items, chart_data_arr[i]->dim_circ_buff_items_max, circ_buff_stats.num_of_items_max);
+        rrdset_done(chart_data_arr[i]->st_circ_buff_items);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_mem, chart_data_arr[i]->dim_circ_buff_mem, circ_buff_stats.text_size_total);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_mem, chart_data_arr[i]->dim_circ_buff_mem_max, circ_buff_stats.text_size_total_max);
+        rrdset_done(chart_data_arr[i]->st_circ_buff_mem);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_full, chart_data_arr[i]->dim_circ_buff_writes_deferred, circ_buff_stats.num_of_writes_deferred);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_full, chart_data_arr[i]->dim_circ_buff_msgs_dropped, circ_buff_stats.num_of_msgs_dropped);
+        rrdset_done(chart_data_arr[i]->st_circ_buff_full);
+
+        /* DB writer - update charts first time */
+        rrddim_set_by_pointer(chart_data_arr[i]->st_db_writes, chart_data_arr[i]->dim_db_writes_text, 
+            __atomic_load_n(&p_file_info->db_writer_stats.text_bytes, __ATOMIC_SEQ_CST));
+        rrddim_set_by_pointer(chart_data_arr[i]->st_db_writes, chart_data_arr[i]->dim_db_writes_blob, 
+            __atomic_load_n(&p_file_info->db_writer_stats.blob_bytes, __ATOMIC_SEQ_CST));
+        rrddim_set_by_pointer(chart_data_arr[i]->st_db_writes, chart_data_arr[i]->dim_db_writes_metadata, 
+            __atomic_load_n(&p_file_info->db_writer_stats.metadata_bytes, __ATOMIC_SEQ_CST));
+        rrdset_done(chart_data_arr[i]->st_db_writes);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_db_write_batches, chart_data_arr[i]->dim_db_write_batches, 
+            __atomic_load_n(&p_file_info->db_writer_stats.num_of_batches, __ATOMIC_SEQ_CST));
+        rrddim_set_by_pointer(chart_data_arr[i]->st_db_write_batches, chart_data_arr[i]->dim_db_write_msgs, 
+            __atomic_load_n(&p_file_info->db_writer_stats.num_of_msgs, __ATOMIC_SEQ_CST));
+        rrdset_done(chart_data_arr[i]->st_db_write_batches);
+        rrddim_set_by_pointer(chart_data_arr[i]->st_db_commit_latency, chart_data_arr[i]->dim_db_commit_latency_max, 
+            __atomic_exchange_n(&p_file_info->db_writer_stats.commit_latency_usec_max, 0, __ATOMIC_SEQ_CST));
+        rrdset_done(chart_data_arr[i]->st_db_commit_latency);
+
         /* Vhost - update chart first time */
         if(p_file_info->parser_config->chart_config & CHART_VHOST){
             for(int j = 0; j < chart_data_arr[i]->vhost_size; j++){
@@ -911,9 +1095,20 @@ void *logsmanagement_plugin_main(void *ptr){
             rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_min, chart_data_arr[i]->num_req_proc_time_min);
             rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_max, chart_data_arr[i]->num_req_proc_time_max);
             rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_avg, chart_data_arr[i]->num_req_proc_time_avg);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_p50, chart_data_arr[i]->num_req_proc_time_p50);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_p95, chart_data_arr[i]->num_req_proc_time_p95);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_p99, chart_data_arr[i]->num_req_proc_time_p99);
             rrdset_done(chart_data_arr[i]->st_req_proc_time);
         }
 
+        /* Upstream response time - update chart first time */
+        if(p_file_info->parser_config->chart_config & CHART_UPS_RESP_TIME){
+            rrddim_set_by_pointer(chart_data_arr[i]->st_ups_resp_time, chart_data_arr[i]->dim_ups_resp_time_p50, chart_data_arr[i]->num_ups_resp_time_p50);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_ups_resp_time, chart_data_arr[i]->dim_ups_resp_time_p95, chart_data_arr[i]->num_ups_resp_time_p95);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_ups_resp_time, chart_data_arr[i]->dim_ups_resp_time_p99, chart_data_arr[i]->num_ups_resp_time_p99);
+            rrdset_done(chart_data_arr[i]->st_ups_resp_time);
+        }
+
         /* Response code family - update chart first time */
         if(p_file_info->parser_config->chart_config & CHART_RESP_CODE_FAMILY){
             rrddim_set_by_pointer(chart_data_arr[i]->st_resp_code_family, chart_data_arr[i]->dim_resp_code_family_1xx, chart_data_arr[i]->num_resp_code_family_1xx);
@@ -988,13 +1183,10 @@ void *logsmanagement_plugin_main(void *ptr){
             /* Vhost - collect */
             if(p_file_info->parser_config->chart_config & CHART_VHOST){
                 for(int j = 0; j < p_file_info->parser_metrics->vhost_arr.size; j++){
-                    int k;
-                    for(k = 0; k < chart_data_arr[i]->vhost_size; k++){
-                        if(!strcmp(p_file_info->parser_metrics->vhost_arr.vhosts[j].name, chart_data_arr[i]->dim_vhosts[k]->name)){
-                            chart_data_arr[i]->num_vhosts[k] += p_file_info->parser_metrics->vhost_arr.vhosts[j].count;
-                            p_file_info->parser_metrics->vhost_arr.vhosts[j].count = 0;
-                            break;
-                        }
+                    const int k = parser_metrics_vhost_get(&chart_data_arr[i]->vhost_index, p_file_info->parser_metrics->vhost_arr.vhosts[j].name);
+                    if(k < chart_data_arr[i]->vhost_size){
+                        chart_data_arr[i]->num_vhosts[k] += p_file_info->parser_metrics->vhost_arr.vhosts[j].count;
+                        p_file_info->parser_metrics->vhost_arr.vhosts[j].count = 0;
                     }
                     if(chart_data_arr[i]->vhost_size == k){ // New vhost not in existing dimensions
                         chart_data_arr[i]->vhost_size++;
@@ -1010,6 +1202,7 @@ void *logsmanagement_plugin_main(void *ptr){
                             p_file_info->parser_metrics->vhost_arr.vhosts[j].name, NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
                         
                         chart_data_arr[i]->num_vhosts[chart_data_arr[i]->vhost_size - 1] = p_file_info->parser_metrics->vhost_arr.vhosts[j].count;
+                        p_file_info->parser_metrics->vhost_arr.vhosts[j].count = 0;
                     }
                 }
             }
@@ -1017,13 +1210,10 @@ void *logsmanagement_plugin_main(void *ptr){
             /* Port - collect */
             if(p_file_info->parser_config->chart_config & CHART_PORT){
                 for(int j = 0; j < p_file_info->parser_metrics->port_arr.size; j++){
-                    int k;
-                    for(k = 0; k < chart_data_arr[i]->port_size; k++){
-                        if(p_file_info->parser_metrics->port_arr.ports[j].port == chart_data_arr[i]->ports[k]){
-                            chart_data_arr[i]->num_ports[k] += p_file_info->parser_metrics->port_arr.ports[j].count;
-                            p_file_info->parser_metrics->port_arr.ports[j].count = 0;
-                            break;
-                        }
+                    const int k = parser_metrics_port_get(&chart_data_arr[i]->port_index, p_file_info->parser_metrics->port_arr.ports[j].port);
+                    if(k < chart_data_arr[i]->port_size){
+                        chart_data_arr[i]->num_ports[k] += p_file_info->parser_metrics->port_arr.ports[j].count;
+                        p_file_info->parser_metrics->port_arr.ports[j].count = 0;
                     }
                     if(chart_data_arr[i]->port_size == k){ // New port not in existing dimensions
                         chart_data_arr[i]->port_size++;
@@ -1031,19 +1221,16 @@ void *logsmanagement_plugin_main(void *ptr){
                         if(chart_data_arr[i]->port_size >= chart_data_arr[i]->port_size_max){
                             chart_data_arr[i]->port_size_max = chart_data_arr[i]->port_size * LOG_PARSER_METRICS_PORT_BUFFS_SCALE_FACTOR + 1;
 
-                            chart_data_arr[i]->ports = reallocz(chart_data_arr[i]->ports, chart_data_arr[i]->port_size_max * sizeof(int));
                             chart_data_arr[i]->dim_ports = reallocz(chart_data_arr[i]->dim_ports, chart_data_arr[i]->port_size_max * sizeof(RRDDIM));
                             chart_data_arr[i]->num_ports = reallocz(chart_data_arr[i]->num_ports, chart_data_arr[i]->port_size_max * sizeof(collected_number));
                         }
 
-                        chart_data_arr[i]->ports[chart_data_arr[i]->port_size - 1] = p_file_info->parser_metrics->port_arr.ports[j].port;
-
-                        if(unlikely(chart_data_arr[i]->ports[chart_data_arr[i]->port_size - 1] == INVALID_PORT)){
+                        if(unlikely(chart_data_arr[i]->port_index.ports[k].port == INVALID_PORT)){
                         chart_data_arr[i]->dim_ports[chart_data_arr[i]->port_size - 1] = rrddim_add(chart_data_arr[i]->st_port, 
                             "invalid", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
                         } else {
                             char port_name[6] = "";
-                            snprintf(port_name, 6, "%d", chart_data_arr[i]->ports[chart_data_arr[i]->port_size - 1]);
+                            snprintf(port_name, 6, "%d", chart_data_arr[i]->port_index.ports[k].port);
                             chart_data_arr[i]->dim_ports[chart_data_arr[i]->port_size - 1] = rrddim_add(chart_data_arr[i]->st_port, 
                                 port_name, NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
                         }
@@ -1065,16 +1252,15 @@ void *logsmanagement_plugin_main(void *ptr){
 
             /* Request client current poll - collect */
             if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_CURRENT){
-                chart_data_arr[i]->num_req_client_current_ipv4 += p_file_info->parser_metrics->req_clients_current_arr.ipv4_size;
-                p_file_info->parser_metrics->req_clients_current_arr.ipv4_size = 0;  
-                chart_data_arr[i]->num_req_client_current_ipv6 += p_file_info->parser_metrics->req_clients_current_arr.ipv6_size;
-                p_file_info->parser_metrics->req_clients_current_arr.ipv6_size = 0;
+                chart_data_arr[i]->num_req_client_current_ipv4 += parser_metrics_req_clients_ipv4_count(&p_file_info->parser_metrics->req_clients_current_arr);
+                chart_data_arr[i]->num_req_client_current_ipv6 += parser_metrics_req_clients_ipv6_count(&p_file_info->parser_metrics->req_clients_current_arr);
+                parser_metrics_req_clients_reset(&p_file_info->parser_metrics->req_clients_current_arr);
             }
 
             /* Request client all-time - collect */
             if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_ALL_TIME){
-                chart_data_arr[i]->num_req_client_all_time_ipv4 = p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size;  
-                chart_data_arr[i]->num_req_client_all_time_ipv6 = p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size;
+                chart_data_arr[i]->num_req_client_all_time_ipv4 = parser_metrics_req_clients_ipv4_count(&p_file_info->parser_metrics->req_clients_alltime_arr);  
+                chart_data_arr[i]->num_req_client_all_time_ipv6 = parser_metrics_req_clients_ipv6_count(&p_file_info->parser_metrics->req_clients_alltime_arr);
             }
 
             /* Request methods - collect */
@@ -1187,6 +1373,18 @@ void *logsmanagement_plugin_main(void *ptr){
                     p_file_info->parser_metrics->req_proc_time.sum / p_file_info->parser_metrics->req_proc_time.count : 0;
                 p_file_info->parser_metrics->req_proc_time.sum = 0;
                 p_file_info->parser_metrics->req_proc_time.count = 0;
+                chart_data_arr[i]->num_req_proc_time_p50 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->req_proc_time.hist, 0.50);
+                chart_data_arr[i]->num_req_proc_time_p95 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->req_proc_time.hist, 0.95);
+                chart_data_arr[i]->num_req_proc_time_p99 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->req_proc_time.hist, 0.99);
+                parser_metrics_latency_hist_reset(&p_file_info->parser_metrics->req_proc_time.hist);
+            }
+
+            /* Upstream response time - collect */
+            if(p_file_info->parser_config->chart_config & CHART_UPS_RESP_TIME){
+                chart_data_arr[i]->num_ups_resp_time_p50 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->ups_resp_time_hist, 0.50);
+                chart_data_arr[i]->num_ups_resp_time_p95 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->ups_resp_time_hist, 0.95);
+                chart_data_arr[i]->num_ups_resp_time_p99 = parser_metrics_latency_hist_percentile(&p_file_info->parser_metrics->ups_resp_time_hist, 0.99);
+                parser_metrics_latency_hist_reset(&p_file_info->parser_metrics->ups_resp_time_hist);
             }
 
             /* Response code family - collect */
@@ -1248,13 +1446,10 @@ void *logsmanagement_plugin_main(void *ptr){
             /* SSL cipher suite - collect */
             if(p_file_info->parser_config->chart_config & CHART_SSL_CIPHER){
                 for(int j = 0; j < p_file_info->parser_metrics->ssl_cipher_arr.size; j++){
-                    int k;
-                    for(k = 0; k < chart_data_arr[i]->ssl_cipher_size; k++){
-                        if(!strcmp(p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].string, chart_data_arr[i]->dim_ssl_ciphers[k]->name)){
-                            chart_data_arr[i]->num_ssl_ciphers[k] += p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count;
-                            p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count = 0;
-                            break;
-                        }
+                    const int k = parser_metrics_ssl_cipher_get(&chart_data_arr[i]->ssl_cipher_index, p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].string);
+                    if(k < chart_data_arr[i]->ssl_cipher_size){
+                        chart_data_arr[i]->num_ssl_ciphers[k] += p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count;
+                        p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count = 0;
                     }
                     if(chart_data_arr[i]->ssl_cipher_size == k){ // New SSL cipher suite not in existing dimensions
                         chart_data_arr[i]->ssl_cipher_size++;
@@ -1285,6 +1480,42 @@ void *logsmanagement_plugin_main(void *ptr){
             rrddim_set_by_pointer(chart_data_arr[i]->st_lines, chart_data_arr[i]->dim_lines_rate, chart_data_arr[i]->num_lines_rate);
             rrdset_done(chart_data_arr[i]->st_lines);
 
+            /* Circular buffer - collect and update charts */
+            Circ_buff_stats_t circ_buff_stats;
+            circ_buff_get_stats(p_file_info->msg_buff, &circ_buff_stats);
+            rrdset_next(chart_data_arr[i]->st_circ_buff_items);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_items, chart_data_arr[i]->dim_circ_buff_items, circ_buff_stats.num_of_items);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_items, chart_data_arr[i]->dim_circ_buff_items_max, circ_buff_stats.num_of_items_max);
+            rrdset_done(chart_data_arr[i]->st_circ_buff_items);
+            rrdset_next(chart_data_arr[i]->st_circ_buff_mem);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_mem, chart_data_arr[i]->dim_circ_buff_mem, circ_buff_stats.text_size_total);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_mem, chart_data_arr[i]->dim_circ_buff_mem_max, circ_buff_stats.text_size_total_max);
+            rrdset_done(chart_data_arr[i]->st_circ_buff_mem);
+            rrdset_next(chart_data_arr[i]->st_circ_buff_full);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_full, chart_data_arr[i]->dim_circ_buff_writes_deferred, circ_buff_stats.num_of_writes_deferred);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_circ_buff_full, chart_data_arr[i]->dim_circ_buff_msgs_dropped, circ_buff_stats.num_of_msgs_dropped);
+            rrdset_done(chart_data_arr[i]->st_circ_buff_full);
+
+            /* DB writer - update charts */
+            rrdset_next(chart_data_arr[i]->st_db_writes);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_db_writes, chart_data_arr[i]->dim_db_writes_text, 
+                __atomic_load_n(&p_file_info->db_writer_stats.text_bytes, __ATOMIC_SEQ_CST));
+            rrddim_set_by_pointer(chart_data_arr[i]->st_db_writes, chart_data_arr[i]->dim_db_writes_blob, 
+                __atomic_load_n(&p_file_info->db_writer_stats.blob_bytes, __ATOMIC_SEQ_CST));
+            rrddim_set_by_pointer(chart_data_arr[i]->st_db_writes, chart_data_arr[i]->dim_db_writes_metadata, 
+                __atomic_load_n(&p_file_info->db_writer_stats.metadata_bytes, __ATOMIC_SEQ_CST));
+            rrdset_done(chart_data_arr[i]->st_db_writes);
+            rrdset_next(chart_data_arr[i]->st_db_write_batches);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_db_write_batches, chart_data_arr[i]->dim_db_write_batches, 
+                __atomic_load_n(&p_file_info->db_writer_stats.num_of_batches, __ATOMIC_SEQ_CST));
+            rrddim_set_by_pointer(chart_data_arr[i]->st_db_write_batches, chart_data_arr[i]->dim_db_write_msgs, 
+                __atomic_load_n(&p_file_info->db_writer_stats.num_of_msgs, __ATOMIC_SEQ_CST));
+            rrdset_done(chart_data_arr[i]->st_db_write_batches);
+            rrdset_next(chart_data_arr[i]->st_db_commit_latency);
+            rrddim_set_by_pointer(chart_data_arr[i]->st_db_commit_latency, chart_data_arr[i]->dim_db_commit_latency_max, 
+                __atomic_exchange_n(&p_file_info->db_writer_stats.commit_latency_usec_max, 0, __ATOMIC_SEQ_CST));
+            rrdset_done(chart_data_arr[i]->st_db_commit_latency);
+
             /* Vhost - update chart */
             if(p_file_info->parser_config->chart_config & CHART_VHOST){
                 rrdset_next(chart_data_arr[i]->st_vhost);
@@ -1396,9 +1627,21 @@ void *logsmanagement_plugin_main(void *ptr){
                 rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_min, chart_data_arr[i]->num_req_proc_time_min);
                 rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_max, chart_data_arr[i]->num_req_proc_time_max);
                 rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_avg, chart_data_arr[i]->num_req_proc_time_avg);
+                rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_p50, chart_data_arr[i]->num_req_proc_time_p50);
+                rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_p95, chart_data_arr[i]->num_req_proc_time_p95);
+                rrddim_set_by_pointer(chart_data_arr[i]->st_req_proc_time, chart_data_arr[i]->dim_req_proc_time_p99, chart_data_arr[i]->num_req_proc_time_p99);
                 rrdset_done(chart_data_arr[i]->st_req_proc_time);
             }
 
+            /* Upstream response time - update chart */
+            if(p_file_info->parser_config->chart_config & CHART_UPS_RESP_TIME){
+                rrdset_next(chart_data_arr[i]->st_ups_resp_time);
+                rrddim_set_by_pointer(chart_data_arr[i]->st_ups_resp_time, chart_data_arr[i]->dim_ups_resp_time_p50, chart_data_arr[i]->num_ups_resp_time_p50);
+                rrddim_set_by_pointer(chart_data_arr[i]->st_ups_resp_time, chart_data_arr[i]->dim_ups_resp_time_p95, chart_data_arr[i]->num_ups_resp_time_p95);
+                rrddim_set_by_pointer(chart_data_arr[i]->st_ups_resp_time, chart_data_arr[i]->dim_ups_resp_time_p99, chart_data_arr[i]->num_ups_resp_time_p99);
+                rrdset_done(chart_data_arr[i]->st_ups_resp_time);
+            }
+
             /* Response code family - update chart */
             if(p_file_info->parser_config->chart_config & CHART_RESP_CODE_FAMILY){
                 rrdset_next(chart_data_arr[i]->st_resp_code_family);
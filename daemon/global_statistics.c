@@ -537,6 +537,9 @@ void global_statistics_charts(void) {
     RRDHOST *host;
     unsigned long long stats_array[RRDENG_NR_STATS] = {0};
     unsigned long long local_stats_array[RRDENG_NR_STATS];
+    unsigned long long cmd_queued[RRDENG_MAX_OPCODE] = {0};
+    unsigned long long cmd_dispatched[RRDENG_MAX_OPCODE] = {0};
+    unsigned long long cmd_latency_usec[RRDENG_MAX_OPCODE] = {0};
     unsigned dbengine_contexts = 0, counted_multihost_db = 0, i;
 
     rrd_rdlock();
@@ -549,11 +552,12 @@ void global_statistics_charts(void) {
             }
             ++dbengine_contexts;
             /* get localhost's DB engine's statistics */
-            rrdeng_get_37_statistics(host->rrdeng_ctx, local_stats_array);
+            rrdeng_get_40_statistics(host->rrdeng_ctx, local_stats_array);
             for (i = 0 ; i < RRDENG_NR_STATS ; ++i) {
                 /* aggregate statistics across hosts */
                 stats_array[i] += local_stats_array[i];
             }
+            rrdeng_get_cmd_queue_statistics(host->rrdeng_ctx, cmd_queued, cmd_dispatched, cmd_latency_usec);
         }
     }
     rrd_unlock();
@@ -944,6 +948,122 @@ void global_statistics_charts(void) {
             rrddim_set_by_pointer(st_ram_usage, rd_metadata, metadata);
             rrdset_done(st_ram_usage);
         }
+
+        // ----------------------------------------------------------------
+
+        {
+            static const struct {
+                enum rrdeng_opcode opcode;
+                const char *name;
+            } queues[] = {
+                { RRDENG_READ_PAGE,                     "read_page"       },
+                { RRDENG_READ_EXTENT,                   "read_extent"     },
+                { RRDENG_COMMIT_PAGE,                   "commit_page"     },
+                { RRDENG_FLUSH_PAGES,                   "flush_pages"     },
+                { RRDENG_INVALIDATE_OLDEST_MEMORY_PAGE, "invalidate_page" },
+            };
+            #define DBENGINE_CMD_QUEUES (sizeof(queues) / sizeof(queues[0]))
+
+            static RRDSET *st_queue_depth = NULL, *st_queue_latency = NULL;
+            static RRDDIM *rd_queue_depth[DBENGINE_CMD_QUEUES], *rd_queue_latency[DBENGINE_CMD_QUEUES];
+            static unsigned long long last_dispatched[RRDENG_MAX_OPCODE], last_latency_usec[RRDENG_MAX_OPCODE];
+
+            if (unlikely(!st_queue_depth)) {
+                st_queue_depth = rrdset_create_localhost(
+                        "netdata"
+                        , "dbengine_queue_depth"
+                        , NULL
+                        , "dbengine"
+                        , NULL
+                        , "NetData DB engine command queue depth"
+                        , "commands"
+                        , "netdata"
+                        , "stats"
+                        , 130511
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_LINE
+                );
+
+                st_queue_latency = rrdset_create_localhost(
+                        "netdata"
+                        , "dbengine_queue_latency"
+                        , NULL
+                        , "dbengine"
+                        , NULL
+                        , "NetData DB engine command queueing latency"
+                        , "microseconds"
+                        , "netdata"
+                        , "stats"
+                        , 130512
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_LINE
+                );
+
+                for (i = 0 ; i < DBENGINE_CMD_QUEUES ; ++i) {
+                    rd_queue_depth[i] = rrddim_add(st_queue_depth, queues[i].name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+                    rd_queue_latency[i] = rrddim_add(st_queue_latency, queues[i].name, NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+                }
+            }
+            else {
+                rrdset_next(st_queue_depth);
+                rrdset_next(st_queue_latency);
+            }
+
+            for (i = 0 ; i < DBENGINE_CMD_QUEUES ; ++i) {
+                enum rrdeng_opcode opcode = queues[i].opcode;
+                unsigned long long dispatched = 0, latency_usec = 0;
+
+                /* the average latency of the commands dequeued since the last iteration */
+                if (cmd_dispatched[opcode] > last_dispatched[opcode] && cmd_latency_usec[opcode] >= last_latency_usec[opcode]) {
+                    dispatched = cmd_dispatched[opcode] - last_dispatched[opcode];
+                    latency_usec = cmd_latency_usec[opcode] - last_latency_usec[opcode];
+                }
+                last_dispatched[opcode] = cmd_dispatched[opcode];
+                last_latency_usec[opcode] = cmd_latency_usec[opcode];
+
+                rrddim_set_by_pointer(st_queue_depth, rd_queue_depth[i], (collected_number)cmd_queued[opcode]);
+                rrddim_set_by_pointer(st_queue_latency, rd_queue_latency[i], (collected_number)(dispatched ? latency_usec / dispatched : 0));
+            }
+            rrdset_done(st_queue_depth);
+            rrdset_done(st_queue_latency);
+        }
+
+        // ----------------------------------------------------------------
+
+        {
+            static RRDSET *st_xt_cache = NULL;
+            static RRDDIM *rd_hits = NULL;
+            static RRDDIM *rd_misses = NULL;
+            static RRDDIM *rd_evictions = NULL;
+
+            if (unlikely(!st_xt_cache)) {
+                st_xt_cache = rrdset_create_localhost(
+                        "netdata"
+                        , "dbengine_extent_cache_stats"
+                        , NULL
+                        , "dbengine"
+                        , NULL
+                        , "NetData DB engine extent cache statistics"
+                        , "extents/s"
+                        , "netdata"
+                        , "stats"
+                        , 130513
+                        , localhost->rrd_update_every
+                        , RRDSET_TYPE_LINE
+                );
+
+                rd_hits = rrddim_add(st_xt_cache, "hits", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+                rd_misses = rrddim_add(st_xt_cache, "misses", NULL, 1, 1, RRD_ALGORITHM_INCREMENTAL);
+                rd_evictions = rrddim_add(st_xt_cache, "evictions", NULL, -1, 1, RRD_ALGORITHM_INCREMENTAL);
+            }
+            else
+                rrdset_next(st_xt_cache);
+
+            rrddim_set_by_pointer(st_xt_cache, rd_hits, (collected_number)stats_array[37]);
+            rrddim_set_by_pointer(st_xt_cache, rd_misses, (collected_number)stats_array[38]);
+            rrddim_set_by_pointer(st_xt_cache, rd_evictions, (collected_number)stats_array[39]);
+            rrdset_done(st_xt_cache);
+        }
     }
 #endif
 
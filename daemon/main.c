@@ -9,6 +9,7 @@ int netdata_anonymous_statistics_enabled;
 //should go in common.h or libnetdata.h when ready
 #ifdef ENABLE_LOGSMANAGEMENT
 extern void logsmanagement_main();
+extern int logs_management_unittest(void);
 static uv_thread_t *logsmanagement_main_thread;
 #endif
 
@@ -358,6 +359,9 @@ int help(int exitcode) {
             "  -W stacksize=N           Set the stacksize (in bytes).\n\n"
             "  -W debug_flags=N         Set runtime tracing to debug.log.\n\n"
             "  -W unittest              Run internal unittests and exit.\n\n"
+#ifdef ENABLE_LOGSMANAGEMENT
+            "  -W logsmanagementtest    Run the logs management unittests and exit.\n\n"
+#endif
 #ifdef ENABLE_DBENGINE
             "  -W createdataset=N       Create a DB engine dataset of N seconds and exit.\n\n"
             "  -W stresstest=A,B,C,D,E,F\n"
@@ -366,6 +370,11 @@ int help(int exitcode) {
             "                           time of D seconds for writers, a page cache\n"
             "                           size of E MiB, an optional disk space limit"
             "                           of F MiB and exit.\n\n"
+            "  -W cachebenchmark=A,B,C  Run a DB engine page cache benchmark of A rounds\n"
+            "                           of long scans followed by hot reads, with a page\n"
+            "                           cache size of B MiB, with the LRU and the 2Q\n"
+            "                           replacement policies, and exit. It fails if the\n"
+            "                           2Q hot reads hit ratio is below C%% (default 90).\n\n"
 #endif
             "  -W set section option value\n"
             "                           set netdata.conf option from the command line.\n\n"
@@ -592,6 +601,70 @@ static void get_netdata_configured_variables() {
         default_multidb_disk_quota_mb = default_rrdeng_disk_quota_mb;
     }
 
+    // the libuv thread pool is shared by all dbengine instances, it has to be sized before it is first used
+    default_rrdeng_worker_threads = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine worker threads", MAX(4, get_system_cpus()));
+    if(default_rrdeng_worker_threads < 1 || default_rrdeng_worker_threads > 128) {
+        error("Invalid dbengine worker threads %d given. Defaulting to 4.", default_rrdeng_worker_threads);
+        default_rrdeng_worker_threads = 4;
+    }
+    if(getenv("UV_THREADPOOL_SIZE"))
+        info("UV_THREADPOOL_SIZE is set in the environment, ignoring dbengine worker threads.");
+    else {
+        char buf[20 + 1];
+        snprintfz(buf, 20, "%d", default_rrdeng_worker_threads);
+        setenv("UV_THREADPOOL_SIZE", buf, 1);
+    }
+
+    default_rrdeng_extent_cache_mb = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine extent cache size", default_rrdeng_extent_cache_mb);
+    if(default_rrdeng_extent_cache_mb < 0) {
+        error("Invalid dbengine extent cache size %d given. Defaulting to %d.", default_rrdeng_extent_cache_mb, RRDENG_DEFAULT_EXTENT_CACHE_SIZE_MB);
+        default_rrdeng_extent_cache_mb = RRDENG_DEFAULT_EXTENT_CACHE_SIZE_MB;
+    }
+
+    {
+        const char *compression = config_get(CONFIG_SECTION_GLOBAL, "dbengine page compression", "lz4");
+        if(!strcmp(compression, "gorilla"))
+            default_rrdeng_compression_algorithm = RRD_GORILLA;
+        else if(!strcmp(compression, "none"))
+            default_rrdeng_compression_algorithm = RRD_NO_COMPRESSION;
+        else {
+            if(strcmp(compression, "lz4"))
+                error("Invalid dbengine page compression '%s' given. Defaulting to lz4.", compression);
+            default_rrdeng_compression_algorithm = RRD_LZ4;
+        }
+    }
+
+    default_rrdeng_storage_tiers = (int) config_get_number(CONFIG_SECTION_GLOBAL, "dbengine storage tiers", default_rrdeng_storage_tiers);
+    if(default_rrdeng_storage_tiers < 1 || default_rrdeng_storage_tiers > RRD_STORAGE_TIERS) {
+        error("Invalid dbengine storage tiers %d given. Defaulting to %d.", default_rrdeng_storage_tiers, RRD_STORAGE_TIERS);
+        default_rrdeng_storage_tiers = RRD_STORAGE_TIERS;
+    }
+
+    for(int tier = 1; tier < default_rrdeng_storage_tiers ; tier++) {
+        char key[CONFIG_MAX_NAME + 1];
+
+        snprintfz(key, CONFIG_MAX_NAME, "dbengine tier %d update every iterations", tier);
+        default_rrdeng_tier_grouping[tier] = (int) config_get_number(CONFIG_SECTION_GLOBAL, key, default_rrdeng_tier_grouping[tier]);
+        if(default_rrdeng_tier_grouping[tier] < 2) {
+            error("Invalid %s %d given. Defaulting to 2.", key, default_rrdeng_tier_grouping[tier]);
+            default_rrdeng_tier_grouping[tier] = 2;
+        }
+
+        snprintfz(key, CONFIG_MAX_NAME, "dbengine tier %d multihost disk space", tier);
+        default_multidb_tier_disk_quota_mb[tier] = (int) config_get_number(CONFIG_SECTION_GLOBAL, key, default_multidb_tier_disk_quota_mb[tier]);
+        if(default_multidb_tier_disk_quota_mb[tier] < RRDENG_MIN_DISK_SPACE_MB) {
+            error("Invalid %s %d given. Defaulting to %d.", key, default_multidb_tier_disk_quota_mb[tier], RRDENG_MIN_DISK_SPACE_MB);
+            default_multidb_tier_disk_quota_mb[tier] = RRDENG_MIN_DISK_SPACE_MB;
+        }
+
+        snprintfz(key, CONFIG_MAX_NAME, "dbengine tier %d page cache size", tier);
+        default_rrdeng_tier_page_cache_mb[tier] = (int) config_get_number(CONFIG_SECTION_GLOBAL, key, default_rrdeng_tier_page_cache_mb[tier]);
+        if(default_rrdeng_tier_page_cache_mb[tier] < RRDENG_MIN_PAGE_CACHE_SIZE_MB) {
+            error("Invalid %s %d given. Defaulting to %d.", key, default_rrdeng_tier_page_cache_mb[tier], RRDENG_MIN_PAGE_CACHE_SIZE_MB);
+            default_rrdeng_tier_page_cache_mb[tier] = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
+        }
+    }
+
 #endif
     // ------------------------------------------------------------------------
 
@@ -1031,6 +1104,7 @@ int main(int argc, char **argv) {
 #ifdef ENABLE_DBENGINE
                         char* createdataset_string = "createdataset=";
                         char* stresstest_string = "stresstest=";
+                        char* cachebenchmark_string = "cachebenchmark=";
 #endif
 
                         if(strcmp(optarg, "unittest") == 0) {
@@ -1052,10 +1126,18 @@ int main(int argc, char **argv) {
                             if(unit_test_storage()) return 1;
 #ifdef ENABLE_DBENGINE
                             if(test_dbengine()) return 1;
+#endif
+#ifdef ENABLE_LOGSMANAGEMENT
+                            if(logs_management_unittest()) return 1;
 #endif
                             fprintf(stderr, "\n\nALL TESTS PASSED\n\n");
                             return 0;
                         }
+#ifdef ENABLE_LOGSMANAGEMENT
+                        else if(strcmp(optarg, "logsmanagementtest") == 0) {
+                            return logs_management_unittest() ? 1 : 0;
+                        }
+#endif
 #ifdef ENABLE_DBENGINE
                         else if(strncmp(optarg, createdataset_string, strlen(createdataset_string)) == 0) {
                             optarg += strlen(createdataset_string);
@@ -1085,6 +1167,19 @@ int main(int argc, char **argv) {
                                                  page_cache_mb, disk_space_mb);
                             return 0;
                         }
+                        else if(strncmp(optarg, cachebenchmark_string, strlen(cachebenchmark_string)) == 0) {
+                            char *endptr;
+                            unsigned rounds = 0, page_cache_mb = 0, min_hit_ratio = 0;
+
+                            optarg += strlen(cachebenchmark_string);
+                            rounds = (unsigned)strtoul(optarg, &endptr, 0);
+                            if (',' == *endptr)
+                                page_cache_mb = (unsigned)strtoul(endptr + 1, &endptr, 0);
+                            if (',' == *endptr)
+                                min_hit_ratio = (unsigned)strtoul(endptr + 1, &endptr, 0);
+
+                            return dbengine_page_cache_benchmark(rounds, page_cache_mb, min_hit_ratio) ? 1 : 0;
+                        }
 #endif
                         else if(strcmp(optarg, "simple-pattern") == 0) {
                             if(optind + 2 > argc) {
@@ -1713,7 +1713,251 @@ static int test_dbengine_check_rrdr(RRDSET *st[CHARTS], RRDDIM *rd[CHARTS][DIMS]
     return errors;
 }
 
-int test_dbengine(void)
+/*
+ * Round-trips pages of constant, slowly changing and random values, and a PAGE_TIER page of rollups, through the
+ * RRD_GORILLA codec
+ */
+static int test_dbengine_gorilla_compression(void)
+{
+    const unsigned PAGES = 4, POINTS = RRDENG_BLOCK_SIZE / sizeof(storage_number);
+    const unsigned TIER_POINTS = RRDENG_BLOCK_SIZE / sizeof(struct rrdeng_tier_point);
+    struct rrdeng_df_extent_header *header;
+    struct rrdeng_tier_point *tier_points;
+    storage_number *pages, *decompressed;
+    void *compressed;
+    // a PAGE_TIER page is filled with whole points only, like rrdeng_store_tier_point() does
+    uint32_t payload_length = (PAGES - 1) * RRDENG_BLOCK_SIZE + TIER_POINTS * sizeof(*tier_points), compressed_length;
+    unsigned i, j;
+    int errors = 0;
+
+    fprintf(stderr, "\nRunning DB-engine gorilla compression test\n");
+
+    header = callocz(1, sizeof(*header) + PAGES * sizeof(header->descr[0]));
+    pages = mallocz(payload_length);
+    decompressed = mallocz(payload_length);
+    compressed = mallocz(RRDENG_GORILLA_COMPRESS_BOUND(payload_length, PAGES));
+
+    header->compression_algorithm = RRD_GORILLA;
+    header->number_of_pages = PAGES;
+    for (i = 0 ; i < PAGES ; ++i) {
+        header->descr[i].type = PAGE_METRICS;
+        header->descr[i].page_length = RRDENG_BLOCK_SIZE;
+    }
+    header->descr[PAGES - 1].type = PAGE_TIER;
+    header->descr[PAGES - 1].page_length = TIER_POINTS * sizeof(*tier_points);
+    for (j = 0 ; j < POINTS ; ++j) {
+        pages[j] = pack_storage_number(42, SN_EXISTS);
+        pages[POINTS + j] = pack_storage_number((calculated_number)(j / 16), SN_EXISTS);
+        pages[2 * POINTS + j] = (storage_number)random();
+    }
+    // rollups of 60 points of a slowly rising metric, with a gap of points that do not exist
+    tier_points = (struct rrdeng_tier_point *)&pages[(PAGES - 1) * POINTS];
+    for (j = 0 ; j < TIER_POINTS ; ++j) {
+        if (j % 64 < 8) {
+            tier_points[j].sum = 0;
+            tier_points[j].min = tier_points[j].max = NAN;
+            tier_points[j].count = 0;
+            continue;
+        }
+        tier_points[j].min = (float)(j / 4);
+        tier_points[j].max = (float)(j / 4 + j % 3);
+        tier_points[j].sum = 60 * (tier_points[j].min + tier_points[j].max) / 2;
+        tier_points[j].count = 60;
+    }
+
+    compressed_length = rrdeng_gorilla_compress(header, pages, compressed);
+    if (compressed_length > RRDENG_GORILLA_COMPRESS_BOUND(payload_length, PAGES)) {
+        fprintf(stderr, "    DB-engine gorilla compressed %u bytes to %u bytes, over its bound ### E R R O R ###\n",
+                payload_length, compressed_length);
+        ++errors;
+    }
+    if (rrdeng_gorilla_decompress(header, compressed, compressed_length, decompressed, payload_length) ||
+        memcmp(pages, decompressed, payload_length)) {
+        fprintf(stderr, "    DB-engine gorilla decompressed pages differ ### E R R O R ###\n");
+        ++errors;
+    }
+    if (!rrdeng_gorilla_decompress(header, compressed, compressed_length / 2, decompressed, payload_length)) {
+        fprintf(stderr, "    DB-engine gorilla decompressed a truncated payload ### E R R O R ###\n");
+        ++errors;
+    }
+    fprintf(stderr, "    DB-engine gorilla compressed %u bytes to %u bytes\n", payload_length, compressed_length);
+
+    freez(compressed);
+    freez(decompressed);
+    freez(pages);
+    freez(header);
+    return errors;
+}
+
+// the number of complete tier 1 points test_dbengine_tiers() collects
+static const int TIER_POINTS = 4;
+
+/*
+ * Collects 1, 2, 3, ... every second in a child of the multihost database and checks the sum, min, max and count of
+ * the tier 1 points, and that rrd2rrdr() queries tier 1 only when the points requested are as coarse as its points.
+ */
+static int test_dbengine_tiers(void)
+{
+    RRDHOST *host;
+    RRDSET *st;
+    RRDDIM *rd;
+    RRDR *r;
+    struct rrddim_query_handle handle;
+    uuid_t uuid;
+    char machine_guid[GUID_LEN + 1];
+    time_t time_start = 2 * API_RELATIVE_TIME_MAX, time_now, time_retrieved, grouping;
+    calculated_number value, expected;
+    int k, c, errors = 0, checked = 0;
+    static const struct {
+        TIER_QUERY_FETCH fetch;
+        const char *name;
+    } fetches[] = {
+        { TIER_QUERY_FETCH_SUM, "sum" },
+        { TIER_QUERY_FETCH_MIN, "min" },
+        { TIER_QUERY_FETCH_MAX, "max" },
+        { TIER_QUERY_FETCH_AVERAGE, "sum / count" },
+    };
+
+    fprintf(stderr, "\nRunning DB-engine storage tiers test\n");
+
+    if (NULL == multidb_ctx.tier_ctx[1]) {
+        fprintf(stderr, "    DB-engine storage tiers are disabled, skipping the test\n");
+        return 0;
+    }
+    grouping = multidb_ctx.tier_ctx[1]->tier_grouping;
+
+    uuid_generate(uuid);
+    uuid_unparse_lower(uuid, machine_guid);
+    host = rrdhost_find_or_create(
+            "unittest-dbengine-tiers"
+            , "unittest-dbengine-tiers"
+            , machine_guid
+            , os_type
+            , netdata_configured_timezone
+            , config_get(CONFIG_SECTION_BACKEND, "host tags", "")
+            , program_name
+            , program_version
+            , 1
+            , default_rrd_history_entries
+            , RRD_MEMORY_MODE_DBENGINE
+            , default_health_enabled
+            , default_rrdpush_enabled
+            , default_rrdpush_destination
+            , default_rrdpush_api_key
+            , default_rrdpush_send_charts_matching
+            , NULL
+    );
+    if (NULL == host || host->rrdeng_ctx != &multidb_ctx) {
+        fprintf(stderr, "    DB-engine unittest: cannot create a multihost database child ### E R R O R ###\n");
+        return 1;
+    }
+
+    st = rrdset_create(host, "netdata", "dbengine-tiers", "dbengine-tiers", "netdata", NULL, "Unit Testing",
+                       "a value", "unittest", NULL, 1, 1, RRDSET_TYPE_LINE);
+    rrdset_flag_set(st, RRDSET_FLAG_DEBUG);
+    rrdset_flag_set(st, RRDSET_FLAG_STORE_FIRST);
+    rd = rrddim_add(st, "dim", NULL, 1, 1, RRD_ALGORITHM_ABSOLUTE);
+
+    // the first point is 0 at time_start, which is aligned to the points of every tier
+    rd->last_collected_time.tv_sec = st->last_collected_time.tv_sec = st->last_updated.tv_sec = time_start - 1;
+    rd->last_collected_time.tv_usec = st->last_collected_time.tv_usec = st->last_updated.tv_usec = 0;
+    st->usec_since_last_update = USEC_PER_SEC;
+    rrddim_set_by_pointer_fake_time(rd, 0, time_start);
+    rrdset_done(st);
+
+    // tier 1 point k rolls up the collected points at time_start + (k - 1) * grouping + 1 ... time_start + k * grouping
+    // and it is stored when the first point of point k + 1 is collected
+    for (c = 1, time_now = time_start + 1 ; c <= TIER_POINTS * grouping + 1 ; ++c, ++time_now) {
+        st->usec_since_last_update = USEC_PER_SEC;
+        rrddim_set_by_pointer_fake_time(rd, c, time_now);
+        rrdset_done(st);
+    }
+
+    for (size_t f = 0 ; f < sizeof(fetches) / sizeof(fetches[0]) ; ++f) {
+        rrdeng_load_metric_init_tier(rd, &handle, time_start + grouping, time_start + TIER_POINTS * grouping, 1,
+                                     fetches[f].fetch);
+        if (1 != handle.tier) {
+            fprintf(stderr, "    DB-engine unittest %s/%s: queried tier %d instead of tier 1 ### E R R O R ###\n",
+                    st->name, rd->name, handle.tier);
+            errors++;
+        }
+        for (k = 1 ; k <= TIER_POINTS ; ++k) {
+            calculated_number first = (k - 1) * grouping + 1, last = k * grouping;
+
+            switch (fetches[f].fetch) {
+                case TIER_QUERY_FETCH_SUM: expected = (first + last) * grouping / 2; break;
+                case TIER_QUERY_FETCH_MIN: expected = first; break;
+                case TIER_QUERY_FETCH_MAX: expected = last; break;
+                default:                   expected = (first + last) / 2; break;
+            }
+            expected = unpack_storage_number(pack_storage_number(expected, SN_EXISTS));
+            value = unpack_storage_number(rrdeng_load_metric_next(&handle, &time_retrieved));
+            if (calculated_number_round(value) != calculated_number_round(expected)) {
+                fprintf(stderr, "    DB-engine unittest %s/%s: tier 1 point %d, expecting %s "
+                                CALCULATED_NUMBER_FORMAT ", found " CALCULATED_NUMBER_FORMAT " ### E R R O R ###\n",
+                        st->name, rd->name, k, fetches[f].name, expected, value);
+                errors++;
+            }
+            if (time_retrieved != time_start + k * grouping) {
+                fprintf(stderr, "    DB-engine unittest %s/%s: tier 1 point %d, found timestamp %lu ### E R R O R ###\n",
+                        st->name, rd->name, k, (unsigned long)time_retrieved);
+                errors++;
+            }
+        }
+        rrdeng_load_metric_finalize(&handle);
+    }
+
+    // as many points as collected points read the collected points
+    r = rrd2rrdr(st, TIER_POINTS * grouping, time_start + 1, time_start + TIER_POINTS * grouping,
+                 RRDR_GROUPING_AVERAGE, 0, 0, NULL, NULL);
+    if (!r || r->internal.tier != 0) {
+        fprintf(stderr, "    DB-engine unittest %s: RRDR of every collected point did not query tier 0 ### E R R O R ###\n",
+                st->name);
+        errors++;
+    }
+    if (r)
+        rrdr_free(r);
+
+    // 1 point per grouping collected points reads tier 1
+    r = rrd2rrdr(st, TIER_POINTS, time_start, time_start + TIER_POINTS * grouping, RRDR_GROUPING_MAX, 0, 0,
+                 NULL, NULL);
+    if (!r || r->internal.tier != 1) {
+        fprintf(stderr, "    DB-engine unittest %s: RRDR of 1 point per %ld collected points did not query tier 1 "
+                        "### E R R O R ###\n", st->name, (long)grouping);
+        errors++;
+    } else {
+        for (c = 0 ; c != rrdr_rows(r) ; ++c) {
+            k = (int)((r->t[c] - time_start) / grouping);
+            if (r->t[c] != time_start + k * grouping || k < 1 || k > TIER_POINTS)
+                continue;
+            expected = unpack_storage_number(pack_storage_number((calculated_number)k * grouping, SN_EXISTS));
+            value = r->v[c * r->d];
+            if (calculated_number_round(value) != calculated_number_round(expected)) {
+                fprintf(stderr, "    DB-engine unittest %s: at %lu secs, expecting max " CALCULATED_NUMBER_FORMAT
+                                ", RRDR found " CALCULATED_NUMBER_FORMAT " ### E R R O R ###\n",
+                        st->name, (unsigned long)r->t[c], expected, value);
+                errors++;
+            }
+            checked++;
+        }
+        if (!checked) {
+            fprintf(stderr, "    DB-engine unittest %s: RRDR of tier 1 has no tier 1 points ### E R R O R ###\n",
+                    st->name);
+            errors++;
+        }
+    }
+    if (r)
+        rrdr_free(r);
+
+    rrd_wrlock();
+    rrdhost_delete_charts(host);
+    rrd_unlock();
+
+    return errors;
+}
+
+// Stores and checks the regions of test data in a legacy dbengine host, returns number of errors
+static int test_dbengine_regions(char *hostname)
 {
     int i, j, errors, update_every, current_region;
     RRDHOST *host = NULL;
@@ -1721,13 +1965,12 @@ int test_dbengine(void)
     RRDDIM *rd[CHARTS][DIMS];
     time_t time_start[REGIONS], time_end[REGIONS];
 
-    error_log_limit_unlimited();
     fprintf(stderr, "\nRunning DB-engine test\n");
 
     default_rrd_memory_mode = RRD_MEMORY_MODE_DBENGINE;
 
-    fprintf(stderr, "Initializing localhost with hostname 'unittest-dbengine'");
-    host = dbengine_rrdhost_find_or_create("unittest-dbengine");
+    fprintf(stderr, "Initializing localhost with hostname '%s'", hostname);
+    host = dbengine_rrdhost_find_or_create(hostname);
     if (NULL == host)
         return 1;
 
@@ -1842,6 +2085,29 @@ int test_dbengine(void)
     return errors;
 }
 
+int test_dbengine(void)
+{
+    uint8_t compression_algorithm = default_rrdeng_compression_algorithm;
+    int errors;
+
+    error_log_limit_unlimited();
+    if (test_dbengine_gorilla_compression())
+        return 1;
+    if (test_dbengine_tiers())
+        return 1;
+
+    errors = test_dbengine_regions("unittest-dbengine");
+    if (errors)
+        return errors;
+
+    // once more with the extents of the datafiles compressed with RRD_GORILLA, the page cache is smaller than a region
+    default_rrdeng_compression_algorithm = RRD_GORILLA;
+    errors = test_dbengine_regions("unittest-dbengine-gorilla");
+    default_rrdeng_compression_algorithm = compression_algorithm;
+
+    return errors;
+}
+
 struct dbengine_chart_thread {
     uv_thread_t thread;
     RRDHOST *host;
@@ -2232,4 +2498,191 @@ void dbengine_stress_test(unsigned TEST_DURATION_SEC, unsigned DSET_CHARTS, unsi
     rrd_unlock();
 }
 
+/* Queries a dimension and returns the number of points read */
+static unsigned long benchmark_query_dbengine_dim(RRDDIM *rd, time_t time_after, time_t time_before)
+{
+    struct rrddim_query_handle handle;
+    unsigned long points = 0;
+    time_t time_retrieved;
+
+    rd->state->query_ops.init(rd, &handle, time_after, time_before);
+    while (!rd->state->query_ops.is_finished(&handle)) {
+        (void)rd->state->query_ops.next_metric(&handle, &time_retrieved);
+        ++points;
+    }
+    rd->state->query_ops.finalize(&handle);
+
+    return points;
+}
+
+/* Reads the latest page of every dimension of the first hot_charts charts, like dashboards refreshing do */
+static void benchmark_dbengine_hot_reads(struct dbengine_chart_thread **chart_threads, unsigned hot_charts,
+                                         unsigned dset_dims, time_t time_after, time_t time_before)
+{
+    unsigned i, j;
+
+    for (i = 0 ; i < hot_charts ; ++i) {
+        for (j = 0 ; j < dset_dims ; ++j) {
+            (void)benchmark_query_dbengine_dim(chart_threads[i]->rd[j], time_after, time_before);
+        }
+    }
+}
+
+/*
+ * Runs the rounds of the page cache benchmark, every round scans the whole history of a chart and then reads the
+ * latest page of every dimension of the hot charts.
+ * Returns the page cache hit ratio of the hot reads as a percentage.
+ */
+static unsigned long long benchmark_dbengine_page_cache_rounds(RRDHOST *host,
+                                                               struct dbengine_chart_thread **chart_threads,
+                                                               unsigned rounds, unsigned dset_charts,
+                                                               unsigned dset_dims, unsigned hot_charts,
+                                                               time_t time_present, unsigned history_seconds)
+{
+    const unsigned POINTS_PER_PAGE = RRDENG_BLOCK_SIZE / sizeof(storage_number);
+    unsigned long long stats_array[RRDENG_NR_STATS];
+    unsigned long long hits, misses, total_hits = 0, total_misses = 0;
+    unsigned long points;
+    unsigned i, j, round;
+    usec_t scan_usec;
+
+    /* warm up, the hot pages are read twice before they are expected to be cached */
+    for (i = 0 ; i < 2 ; ++i) {
+        benchmark_dbengine_hot_reads(chart_threads, hot_charts, dset_dims,
+                                     time_present - POINTS_PER_PAGE, time_present - 1);
+    }
+
+    for (round = 0 ; round < rounds ; ++round) {
+        i = hot_charts + round % (dset_charts - hot_charts);
+        scan_usec = now_monotonic_usec();
+        for (j = 0, points = 0 ; j < dset_dims ; ++j) {
+            points += benchmark_query_dbengine_dim(chart_threads[i]->rd[j], time_present - history_seconds,
+                                                   time_present - 1);
+        }
+        scan_usec = now_monotonic_usec() - scan_usec;
+
+        rrdeng_get_40_statistics(host->rrdeng_ctx, stats_array);
+        hits = stats_array[7];
+        misses = stats_array[8];
+        benchmark_dbengine_hot_reads(chart_threads, hot_charts, dset_dims,
+                                     time_present - POINTS_PER_PAGE, time_present - 1);
+        rrdeng_get_40_statistics(host->rrdeng_ctx, stats_array);
+        hits = stats_array[7] - hits;
+        misses = stats_array[8] - misses;
+        total_hits += hits;
+        total_misses += misses;
+
+        fprintf(stderr, "    round %u: scanned %lu points of %s in %llu ms, hot reads hit ratio %llu%% "
+                        "(%llu hits, %llu misses)\n",
+                round + 1, points, chart_threads[i]->st->name, scan_usec / USEC_PER_MS,
+                (hits + misses) ? hits * 100 / (hits + misses) : 0, hits, misses);
+    }
+    return (total_hits + total_misses) ? total_hits * 100 / (total_hits + total_misses) : 0;
+}
+
+/*
+ * Measures how well the page cache keeps the pages that are read repeatedly while long queries scan the database.
+ * Every round scans the whole history of a chart, which is twice the size of the page cache, and then reads the
+ * latest page of every dimension of a few hot charts. The rounds run with the legacy LRU replacement policy and
+ * then with the 2Q one, and the page cache hit ratio of the hot reads of both is reported.
+ * Returns 1 if the 2Q hit ratio is below MIN_HIT_RATIO percent, 0 otherwise.
+ */
+int dbengine_page_cache_benchmark(unsigned ROUNDS, unsigned PAGE_CACHE_MB, unsigned MIN_HIT_RATIO)
+{
+    const unsigned DSET_CHARTS = 16;
+    const unsigned DSET_DIMS = 128;
+    const unsigned HOT_CHARTS = 2;
+    const unsigned POINTS_PER_PAGE = RRDENG_BLOCK_SIZE / sizeof(storage_number);
+    RRDHOST *host = NULL;
+    struct dbengine_chart_thread **chart_threads;
+    unsigned long long lru_hit_ratio, twoq_hit_ratio;
+    unsigned i, history_seconds;
+    time_t time_present;
+
+    error_log_limit_unlimited();
+
+    if (!ROUNDS)
+        ROUNDS = 8;
+    if (PAGE_CACHE_MB < RRDENG_MIN_PAGE_CACHE_SIZE_MB)
+        PAGE_CACHE_MB = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
+    if (!MIN_HIT_RATIO || MIN_HIT_RATIO > 100)
+        MIN_HIT_RATIO = 90;
+
+    /* the history of every chart is twice the size of the page cache */
+    history_seconds = (2ULL * PAGE_CACHE_MB * 1024 * 1024) / (DSET_DIMS * sizeof(storage_number));
+    history_seconds += POINTS_PER_PAGE - history_seconds % POINTS_PER_PAGE;
+
+    default_rrd_memory_mode = RRD_MEMORY_MODE_DBENGINE;
+    default_rrdeng_page_cache_mb = PAGE_CACHE_MB;
+    /* the dataset must not be deleted, leave room for uncompressible data */
+    default_rrdeng_disk_quota_mb = (((uint64_t)DSET_DIMS * DSET_CHARTS) * sizeof(storage_number) * history_seconds) /
+                                   (1024 * 1024) * 2;
+    if (default_rrdeng_disk_quota_mb < RRDENG_MIN_DISK_SPACE_MB)
+        default_rrdeng_disk_quota_mb = RRDENG_MIN_DISK_SPACE_MB;
+
+    fprintf(stderr, "Initializing localhost with hostname 'dbengine-page-cache-benchmark'\n");
+
+    host = dbengine_rrdhost_find_or_create("dbengine-page-cache-benchmark");
+    if (NULL == host)
+        return 1;
+
+    chart_threads = mallocz(sizeof(*chart_threads) * DSET_CHARTS);
+    for (i = 0 ; i < DSET_CHARTS ; ++i) {
+        chart_threads[i] = mallocz(sizeof(*chart_threads[i]) + sizeof(RRDDIM *) * DSET_DIMS);
+    }
+    fprintf(stderr, "\nRunning DB-engine page cache benchmark, %u rounds, %u MiB of page cache,\n"
+                    "%u charts of %u dimensions with %u seconds of history each, %u hot charts.\n",
+                    ROUNDS, PAGE_CACHE_MB, DSET_CHARTS, DSET_DIMS, history_seconds, HOT_CHARTS);
+
+    time_present = now_realtime_sec();
+    for (i = 0 ; i < DSET_CHARTS ; ++i) {
+        chart_threads[i]->host = host;
+        chart_threads[i]->chartname = "random";
+        chart_threads[i]->dset_charts = DSET_CHARTS;
+        chart_threads[i]->chart_i = i;
+        chart_threads[i]->dset_dims = DSET_DIMS;
+        chart_threads[i]->history_seconds = history_seconds;
+        chart_threads[i]->time_present = time_present;
+        chart_threads[i]->time_max = 0;
+        chart_threads[i]->done = 0;
+        chart_threads[i]->errors = chart_threads[i]->stored_metrics_nr = 0;
+        init_completion(&chart_threads[i]->charts_initialized);
+        assert(0 == uv_thread_create(&chart_threads[i]->thread, generate_dbengine_chart, chart_threads[i]));
+        wait_for_completion(&chart_threads[i]->charts_initialized);
+        destroy_completion(&chart_threads[i]->charts_initialized);
+    }
+    for (i = 0 ; i < DSET_CHARTS ; ++i) {
+        assert(0 == uv_thread_join(&chart_threads[i]->thread));
+    }
+
+    /*
+     * The LRU rounds run first: they leave every page in probation and unreferenced, so the 2Q rounds start from a
+     * page cache that is in the same state as a fresh one that got filled.
+     */
+    fprintf(stderr, "\nLegacy LRU replacement policy:\n");
+    host->rrdeng_ctx->pg_cache.replaceQ.lru = 1;
+    lru_hit_ratio = benchmark_dbengine_page_cache_rounds(host, chart_threads, ROUNDS, DSET_CHARTS, DSET_DIMS,
+                                                         HOT_CHARTS, time_present, history_seconds);
+    fprintf(stderr, "\n2Q replacement policy:\n");
+    host->rrdeng_ctx->pg_cache.replaceQ.lru = 0;
+    twoq_hit_ratio = benchmark_dbengine_page_cache_rounds(host, chart_threads, ROUNDS, DSET_CHARTS, DSET_DIMS,
+                                                          HOT_CHARTS, time_present, history_seconds);
+
+    fprintf(stderr, "\nDB-engine page cache benchmark finished, hot reads hit ratio after long scans: "
+                    "LRU %llu%%, 2Q %llu%% (minimum %u%%) %s\n",
+            lru_hit_ratio, twoq_hit_ratio, MIN_HIT_RATIO, twoq_hit_ratio < MIN_HIT_RATIO ? "FAILED" : "OK");
+
+    for (i = 0 ; i < DSET_CHARTS ; ++i) {
+        freez(chart_threads[i]);
+    }
+    freez(chart_threads);
+    rrd_wrlock();
+    rrdeng_prepare_exit(host->rrdeng_ctx);
+    rrdhost_delete_charts(host);
+    rrdeng_exit(host->rrdeng_ctx);
+    rrd_unlock();
+
+    return twoq_hit_ratio < MIN_HIT_RATIO ? 1 : 0;
+}
+
 #endif
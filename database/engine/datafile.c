@@ -38,7 +38,7 @@ void datafile_list_delete(struct rrdengine_instance *ctx, struct rrdengine_dataf
 static void datafile_init(struct rrdengine_datafile *datafile, struct rrdengine_instance *ctx,
                           unsigned tier, unsigned fileno)
 {
-    fatal_assert(tier == 1);
+    fatal_assert(tier == RRDENG_DATAFILE_TIER(ctx));
     datafile->tier = tier;
     datafile->fileno = fileno;
     datafile->file = (uv_file)0;
@@ -161,7 +161,7 @@ int create_data_file(struct rrdengine_datafile *datafile)
     }
     (void) strncpy(superblock->magic_number, RRDENG_DF_MAGIC, RRDENG_MAGIC_SZ);
     (void) strncpy(superblock->version, RRDENG_DF_VER, RRDENG_VER_SZ);
-    superblock->tier = 1;
+    superblock->tier = RRDENG_DATAFILE_TIER(ctx);
 
     iov = uv_buf_init((void *)superblock, sizeof(*superblock));
 
@@ -186,7 +186,7 @@ int create_data_file(struct rrdengine_datafile *datafile)
     return 0;
 }
 
-static int check_data_file_superblock(uv_file file)
+static int check_data_file_superblock(struct rrdengine_instance *ctx, uv_file file)
 {
     int ret;
     struct rrdeng_df_sb *superblock;
@@ -210,7 +210,7 @@ static int check_data_file_superblock(uv_file file)
 
     if (strncmp(superblock->magic_number, RRDENG_DF_MAGIC, RRDENG_MAGIC_SZ) ||
         strncmp(superblock->version, RRDENG_DF_VER, RRDENG_VER_SZ) ||
-        superblock->tier != 1) {
+        superblock->tier != RRDENG_DATAFILE_TIER(ctx)) {
         error("File has invalid superblock.");
         ret = UV_EINVAL;
     } else {
@@ -244,7 +244,7 @@ static int load_data_file(struct rrdengine_datafile *datafile)
         goto error;
     file_size = ALIGN_BYTES_CEILING(file_size);
 
-    ret = check_data_file_superblock(file);
+    ret = check_data_file_superblock(ctx, file);
     if (ret)
         goto error;
     ctx->stats.io_read_bytes += sizeof(struct rrdeng_df_sb);
@@ -305,6 +305,11 @@ static int scan_data_files(struct rrdengine_instance *ctx)
     for (matched_files = 0 ; UV_EOF != uv_fs_scandir_next(&req, &dent) && matched_files < MAX_DATAFILES ; ) {
         info("Scanning file \"%s/%s\"", ctx->dbfiles_path, dent.name);
         ret = sscanf(dent.name, DATAFILE_PREFIX RRDENG_FILE_NUMBER_SCAN_TMPL DATAFILE_EXTENSION, &tier, &no);
+        if (2 == ret && tier != RRDENG_DATAFILE_TIER(ctx)) {
+            info("Ignoring file \"%s/%s\" of tier %u, this instance is of tier %u.", ctx->dbfiles_path, dent.name,
+                 tier, RRDENG_DATAFILE_TIER(ctx));
+            continue;
+        }
         if (2 == ret) {
             info("Matched file \"%s/%s\"", ctx->dbfiles_path, dent.name);
             datafile = mallocz(sizeof(*datafile));
@@ -426,7 +431,7 @@ int init_data_files(struct rrdengine_instance *ctx)
         return ret;
     } else if (0 == ret) {
         info("Data files not found, creating in path \"%s\".", ctx->dbfiles_path);
-        ret = create_new_datafile_pair(ctx, 1, 1);
+        ret = create_new_datafile_pair(ctx, RRDENG_DATAFILE_TIER(ctx), 1);
         if (ret) {
             error("Failed to create data and journal files in path \"%s\".", ctx->dbfiles_path);
             return ret;
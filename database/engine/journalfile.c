@@ -300,7 +300,7 @@ static void restore_extent_metadata(struct rrdengine_instance *ctx, struct rrden
         Pvoid_t *PValue;
         struct pg_cache_page_index *page_index = NULL;
 
-        if (PAGE_METRICS != jf_metric_data->descr[i].type) {
+        if (ctx->page_type != jf_metric_data->descr[i].type) {
             error("Unknown page type encountered.");
             continue;
         }
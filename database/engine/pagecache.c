@@ -8,26 +8,29 @@ static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx);
 
 /* always inserts into tail */
 static inline void pg_cache_replaceQ_insert_unsafe(struct rrdengine_instance *ctx,
-                                                   struct rrdeng_page_descr *descr)
+                                                   struct rrdeng_page_descr *descr,
+                                                   pg_cache_replaceQ_queue_t queue)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct pg_cache_replaceQ_queue *replaceQ = &ctx->pg_cache.replaceQ.queues[queue];
     struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr;
 
-    if (likely(NULL != pg_cache->replaceQ.tail)) {
-        pg_cache_descr->prev = pg_cache->replaceQ.tail;
-        pg_cache->replaceQ.tail->next = pg_cache_descr;
+    pg_cache_descr->replaceQ_queue = queue;
+    if (likely(NULL != replaceQ->tail)) {
+        pg_cache_descr->prev = replaceQ->tail;
+        replaceQ->tail->next = pg_cache_descr;
     }
-    if (unlikely(NULL == pg_cache->replaceQ.head)) {
-        pg_cache->replaceQ.head = pg_cache_descr;
+    if (unlikely(NULL == replaceQ->head)) {
+        replaceQ->head = pg_cache_descr;
     }
-    pg_cache->replaceQ.tail = pg_cache_descr;
+    replaceQ->tail = pg_cache_descr;
+    ++replaceQ->count;
 }
 
 static inline void pg_cache_replaceQ_delete_unsafe(struct rrdengine_instance *ctx,
                                                    struct rrdeng_page_descr *descr)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
     struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr, *prev, *next;
+    struct pg_cache_replaceQ_queue *replaceQ = &ctx->pg_cache.replaceQ.queues[pg_cache_descr->replaceQ_queue];
 
     prev = pg_cache_descr->prev;
     next = pg_cache_descr->next;
@@ -38,22 +41,25 @@ static inline void pg_cache_replaceQ_delete_unsafe(struct rrdengine_instance *ct
     if (likely(NULL != next)) {
         next->prev = prev;
     }
-    if (unlikely(pg_cache_descr == pg_cache->replaceQ.head)) {
-        pg_cache->replaceQ.head = next;
+    if (unlikely(pg_cache_descr == replaceQ->head)) {
+        replaceQ->head = next;
     }
-    if (unlikely(pg_cache_descr == pg_cache->replaceQ.tail)) {
-        pg_cache->replaceQ.tail = prev;
+    if (unlikely(pg_cache_descr == replaceQ->tail)) {
+        replaceQ->tail = prev;
     }
     pg_cache_descr->prev = pg_cache_descr->next = NULL;
+    --replaceQ->count;
 }
 
+/* New pages are inserted in probation and have to be accessed again to be protected */
 void pg_cache_replaceQ_insert(struct rrdengine_instance *ctx,
                               struct rrdeng_page_descr *descr)
 {
     struct page_cache *pg_cache = &ctx->pg_cache;
 
     uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
-    pg_cache_replaceQ_insert_unsafe(ctx, descr);
+    descr->pg_cache_descr->referenced = 0;
+    pg_cache_replaceQ_insert_unsafe(ctx, descr, PG_CACHE_REPLACEQ_PROBATION);
     uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
 }
 
@@ -66,15 +72,30 @@ void pg_cache_replaceQ_delete(struct rrdengine_instance *ctx,
     pg_cache_replaceQ_delete_unsafe(ctx, descr);
     uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
 }
+
+/*
+ * Marks the page as accessed without taking the replaceQ lock, the caller must hold a page reference.
+ * The page is moved to the protected queue lazily, when it is next met by pg_cache_try_evict_one_page_unsafe().
+ * With the legacy LRU policy the page is moved to the tail of the replaceQ instead.
+ */
 void pg_cache_replaceQ_set_hot(struct rrdengine_instance *ctx,
                                struct rrdeng_page_descr *descr)
 {
     struct page_cache *pg_cache = &ctx->pg_cache;
+    struct page_cache_descr *pg_cache_descr = descr->pg_cache_descr;
 
-    uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
-    pg_cache_replaceQ_delete_unsafe(ctx, descr);
-    pg_cache_replaceQ_insert_unsafe(ctx, descr);
-    uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
+    if (unlikely(pg_cache->replaceQ.lru)) {
+        uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
+        pg_cache_replaceQ_delete_unsafe(ctx, descr);
+        pg_cache_replaceQ_insert_unsafe(ctx, descr, PG_CACHE_REPLACEQ_PROBATION);
+        uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
+        return;
+    }
+    if (unlikely(__atomic_exchange_n(&pg_cache_descr->prefetched, 0, __ATOMIC_RELAXED))) {
+        /* the page was read for locality, this is its first access */
+        return;
+    }
+    __atomic_store_n(&pg_cache_descr->referenced, 1, __ATOMIC_RELAXED);
 }
 
 struct rrdeng_page_descr *pg_cache_create_descr(void)
@@ -359,25 +380,33 @@ static void pg_cache_evict_unsafe(struct rrdengine_instance *ctx, struct rrdeng_
 }
 
 /*
- * The caller must hold the page cache lock.
- * Lock order: page cache -> replaceQ -> page descriptor
- * This function iterates all pages and tries to evict one.
- * If it fails it sets in_flight_descr to the oldest descriptor that has write-back in progress,
- * or it sets it to NULL if no write-back is in progress.
+ * The caller must hold the page cache lock and the replaceQ lock.
+ * Scans a replaceQ queue from its oldest page and evicts the first page that is neither referenced nor in use.
+ * Referenced pages get a second chance by moving to the tail of the protected queue, the scan visits at most as
+ * many pages as the queue held when it started so that it terminates even when every page is referenced.
  *
- * Returns 1 on success and 0 on failure.
+ * Returns the descriptor of the evicted page or NULL.
  */
-static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx)
+static struct rrdeng_page_descr *pg_cache_try_evict_from_replaceQ_unsafe(struct rrdengine_instance *ctx,
+                                                                         pg_cache_replaceQ_queue_t queue)
 {
-    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct pg_cache_replaceQ_queue *replaceQ = &ctx->pg_cache.replaceQ.queues[queue];
     unsigned long old_flags;
+    unsigned scanned, to_scan = replaceQ->count;
     struct rrdeng_page_descr *descr;
-    struct page_cache_descr *pg_cache_descr = NULL;
+    struct page_cache_descr *pg_cache_descr, *next;
 
-    uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
-    for (pg_cache_descr = pg_cache->replaceQ.head ; NULL != pg_cache_descr ; pg_cache_descr = pg_cache_descr->next) {
+    for (pg_cache_descr = replaceQ->head, scanned = 0 ;
+         NULL != pg_cache_descr && scanned < to_scan ;
+         pg_cache_descr = next, ++scanned) {
+        next = pg_cache_descr->next;
         descr = pg_cache_descr->descr;
 
+        if (__atomic_exchange_n(&pg_cache_descr->referenced, 0, __ATOMIC_RELAXED)) {
+            pg_cache_replaceQ_delete_unsafe(ctx, descr);
+            pg_cache_replaceQ_insert_unsafe(ctx, descr, PG_CACHE_REPLACEQ_PROTECTED);
+            continue;
+        }
         rrdeng_page_descr_mutex_lock(ctx, descr);
         old_flags = pg_cache_descr->flags;
         if ((old_flags & RRD_PAGE_POPULATED) && !(old_flags & RRD_PAGE_DIRTY) && pg_cache_try_get_unsafe(descr, 1)) {
@@ -387,18 +416,48 @@ static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx)
             pg_cache_replaceQ_delete_unsafe(ctx, descr);
 
             rrdeng_page_descr_mutex_unlock(ctx, descr);
-            uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
-
-            rrdeng_try_deallocate_pg_cache_descr(ctx, descr);
-
-            return 1;
+            return descr;
         }
         rrdeng_page_descr_mutex_unlock(ctx, descr);
     }
+    return NULL;
+}
+
+/*
+ * The caller must hold the page cache lock.
+ * Lock order: page cache -> replaceQ -> page descriptor
+ * This function iterates the replaceQ and tries to evict one page, following the 2Q policy: the pages in probation
+ * are evicted first, unless they are too few in which case the protected pages are evicted in CLOCK order.
+ *
+ * Returns 1 on success and 0 on failure.
+ */
+static int pg_cache_try_evict_one_page_unsafe(struct rrdengine_instance *ctx)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct pg_cache_replaceQ_queue *probation, *protected;
+    struct rrdeng_page_descr *descr;
+
+    uv_rwlock_wrlock(&pg_cache->replaceQ.lock);
+    probation = &pg_cache->replaceQ.queues[PG_CACHE_REPLACEQ_PROBATION];
+    protected = &pg_cache->replaceQ.queues[PG_CACHE_REPLACEQ_PROTECTED];
+    if (0 == protected->count || (uint64_t)probation->count * 100 >
+        (uint64_t)(probation->count + protected->count) * PG_CACHE_REPLACEQ_PROBATION_PERCENT) {
+        descr = pg_cache_try_evict_from_replaceQ_unsafe(ctx, PG_CACHE_REPLACEQ_PROBATION);
+        if (NULL == descr)
+            descr = pg_cache_try_evict_from_replaceQ_unsafe(ctx, PG_CACHE_REPLACEQ_PROTECTED);
+    } else {
+        descr = pg_cache_try_evict_from_replaceQ_unsafe(ctx, PG_CACHE_REPLACEQ_PROTECTED);
+        if (NULL == descr)
+            descr = pg_cache_try_evict_from_replaceQ_unsafe(ctx, PG_CACHE_REPLACEQ_PROBATION);
+    }
     uv_rwlock_wrunlock(&pg_cache->replaceQ.lock);
 
-    /* failed to evict */
-    return 0;
+    if (NULL == descr) {
+        /* failed to evict */
+        return 0;
+    }
+    rrdeng_try_deallocate_pg_cache_descr(ctx, descr);
+    return 1;
 }
 
 /**
@@ -1157,8 +1216,8 @@ static void init_replaceQ(struct rrdengine_instance *ctx)
 {
     struct page_cache *pg_cache = &ctx->pg_cache;
 
-    pg_cache->replaceQ.head = NULL;
-    pg_cache->replaceQ.tail = NULL;
+    memset(pg_cache->replaceQ.queues, 0, sizeof(pg_cache->replaceQ.queues));
+    pg_cache->replaceQ.lru = rrdeng_page_cache_lru;
     fatal_assert(0 == uv_rwlock_init(&pg_cache->replaceQ.lock));
 }
 
@@ -27,6 +27,9 @@ struct page_cache_descr {
     struct page_cache_descr *next; /* LRU */
 
     unsigned refcnt;
+    uint8_t replaceQ_queue; /* the replaceQ queue that holds the page */
+    volatile uint8_t referenced; /* set without locking when the page is accessed, cleared by the eviction scan */
+    volatile uint8_t prefetched; /* read along with a requested page, its first access does not count as a reference */
     uv_mutex_t mutex; /* always take it after the page cache lock or after the commit lock */
     uv_cond_t cond;
     unsigned waiters;
@@ -127,15 +130,33 @@ struct pg_cache_committed_page_index {
     unsigned nr_committed_pages;
 };
 
+/* The queues of the 2Q replacement policy of the page cache */
+typedef enum {
+    PG_CACHE_REPLACEQ_PROBATION = 0, /* FIFO of pages that have not been accessed again since they were inserted */
+    PG_CACHE_REPLACEQ_PROTECTED,     /* CLOCK of pages that have been accessed again */
+    PG_CACHE_REPLACEQ_QUEUES
+} pg_cache_replaceQ_queue_t;
+
+/* percentage of the evictable pages above which the pages in probation are evicted first */
+#define PG_CACHE_REPLACEQ_PROBATION_PERCENT (25)
+
+struct pg_cache_replaceQ_queue {
+    struct page_cache_descr *head; /* oldest */
+    struct page_cache_descr *tail; /* newest */
+    unsigned count;
+};
+
 /*
  * Gathers populated pages to be evicted.
  * Relies on page cache descriptors being there as it uses their memory.
+ * Accessing a page only sets its referenced flag, pages are moved between the queues when looking for one to evict,
+ * so that a long scan of pages that are accessed once cannot evict the ones that are accessed repeatedly.
  */
 struct pg_cache_replaceQ {
-    uv_rwlock_t lock; /* LRU lock */
+    uv_rwlock_t lock; /* replaceQ lock */
 
-    struct page_cache_descr *head; /* LRU */
-    struct page_cache_descr *tail; /* MRU */
+    struct pg_cache_replaceQ_queue queues[PG_CACHE_REPLACEQ_QUEUES];
+    uint8_t lru; /* use the legacy LRU policy: accessing a page moves it to the tail of probation, nothing is protected */
 };
 
 struct page_cache { /* TODO: add statistics */
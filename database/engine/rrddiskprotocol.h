@@ -19,6 +19,7 @@
 
 #define RRD_NO_COMPRESSION (0)
 #define RRD_LZ4 (1)
+#define RRD_GORILLA (2) /* see rrdengcompression.h */
 
 #define RRDENG_DF_SB_PADDING_SZ (RRDENG_BLOCK_SIZE - (RRDENG_MAGIC_SZ + RRDENG_VER_SZ + sizeof(uint8_t)))
 /*
@@ -36,6 +37,19 @@ struct rrdeng_df_sb {
  */
 #define PAGE_METRICS    (0)
 #define PAGE_LOGS       (1) /* reserved */
+#define PAGE_TIER       (2) /* rollups of the pages of the tier below, see struct rrdeng_tier_point */
+
+/*
+ * Point of a PAGE_TIER page: the rollups of the points of a metric in an interval.
+ * The minimum and maximum are NAN when none of the points exist (count is 0). The sum is a double, since a float
+ * loses the precision of the sums of many points (e.g. counters in the millions) and the average is derived from it.
+ */
+struct rrdeng_tier_point {
+    double sum;
+    float min;
+    float max;
+    uint32_t count;
+} __attribute__ ((packed));
 
 /*
  * Data file page descriptor
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+#include "rrdengine.h"
+
+#define GORILLA_MAX_WORDS_PER_POINT (sizeof(struct rrdeng_tier_point) / sizeof(uint32_t))
+
+struct gorilla_bit_writer {
+    uint8_t *buf;
+    uint32_t size; /* bytes written */
+    uint32_t capacity; /* bytes */
+    uint64_t acc;
+    unsigned acc_bits;
+};
+
+struct gorilla_bit_reader {
+    uint8_t *buf;
+    uint32_t pos; /* bytes read */
+    uint32_t length; /* bytes */
+    uint64_t acc;
+    unsigned acc_bits;
+};
+
+/* Returns 0 on success, 1 when the buffer is full */
+static inline int gorilla_write_bits(struct gorilla_bit_writer *writer, uint32_t value, unsigned bits)
+{
+    writer->acc = (writer->acc << bits) | (value & ((1ULL << bits) - 1));
+    writer->acc_bits += bits;
+    while (writer->acc_bits >= 8) {
+        if (unlikely(writer->size == writer->capacity))
+            return 1;
+        writer->acc_bits -= 8;
+        writer->buf[writer->size++] = (uint8_t)(writer->acc >> writer->acc_bits);
+    }
+    return 0;
+}
+
+/* Returns 0 on success, 1 when the buffer is full */
+static inline int gorilla_flush_bits(struct gorilla_bit_writer *writer)
+{
+    if (writer->acc_bits)
+        return gorilla_write_bits(writer, 0, 8 - writer->acc_bits);
+    return 0;
+}
+
+/* Returns 0 on success, 1 when the buffer is exhausted */
+static inline int gorilla_read_bits(struct gorilla_bit_reader *reader, unsigned bits, uint32_t *value)
+{
+    while (reader->acc_bits < bits) {
+        if (unlikely(reader->pos == reader->length))
+            return 1;
+        reader->acc = (reader->acc << 8) | reader->buf[reader->pos++];
+        reader->acc_bits += 8;
+    }
+    reader->acc_bits -= bits;
+    *value = (uint32_t)((reader->acc >> reader->acc_bits) & ((1ULL << bits) - 1));
+    return 0;
+}
+
+static inline unsigned gorilla_words_per_point(uint8_t page_type)
+{
+    if (PAGE_TIER == page_type)
+        return sizeof(struct rrdeng_tier_point) / sizeof(uint32_t);
+    return sizeof(storage_number) / sizeof(uint32_t);
+}
+
+/*
+ * Encodes a page into dst, which has room for page_length - 1 bytes.
+ * Returns the size of the encoded page, or 0 if it would not be smaller than the page.
+ */
+static uint32_t gorilla_encode_page(uint8_t *dst, uint8_t *page, uint32_t page_length, unsigned words_per_point)
+{
+    struct gorilla_bit_writer writer = { .buf = dst, .size = 0, .capacity = page_length - 1, .acc = 0, .acc_bits = 0 };
+    uint32_t prev[GORILLA_MAX_WORDS_PER_POINT], word, xor;
+    unsigned leading[GORILLA_MAX_WORDS_PER_POINT], trailing[GORILLA_MAX_WORDS_PER_POINT];
+    unsigned i, field, words, lz, tz, meaningful;
+
+    if (0 == page_length || page_length % (words_per_point * sizeof(uint32_t)))
+        return 0;
+    words = page_length / sizeof(uint32_t);
+
+    for (i = 0 ; i < words ; ++i) {
+        field = i % words_per_point;
+        memcpy(&word, page + i * sizeof(uint32_t), sizeof(word));
+        if (i < words_per_point) {
+            prev[field] = word;
+            leading[field] = trailing[field] = 32; /* no window yet */
+            if (gorilla_write_bits(&writer, word, 32))
+                return 0;
+            continue;
+        }
+        xor = word ^ prev[field];
+        prev[field] = word;
+        if (0 == xor) {
+            if (gorilla_write_bits(&writer, 0, 1))
+                return 0;
+            continue;
+        }
+        lz = __builtin_clz(xor);
+        tz = __builtin_ctz(xor);
+        if (leading[field] + trailing[field] < 32 && lz >= leading[field] && tz >= trailing[field]) {
+            meaningful = 32 - leading[field] - trailing[field];
+            if (gorilla_write_bits(&writer, 2, 2) ||
+                gorilla_write_bits(&writer, xor >> trailing[field], meaningful))
+                return 0;
+            continue;
+        }
+        meaningful = 32 - lz - tz;
+        leading[field] = lz;
+        trailing[field] = tz;
+        if (gorilla_write_bits(&writer, 3, 2) ||
+            gorilla_write_bits(&writer, lz, 5) ||
+            gorilla_write_bits(&writer, meaningful - 1, 5) ||
+            gorilla_write_bits(&writer, xor >> tz, meaningful))
+            return 0;
+    }
+    if (gorilla_flush_bits(&writer))
+        return 0;
+    return writer.size;
+}
+
+/* Returns 0 on success, 1 if the encoded page is corrupted */
+static int gorilla_decode_page(uint8_t *page, uint32_t page_length, uint8_t *src, uint32_t src_length,
+                               unsigned words_per_point)
+{
+    struct gorilla_bit_reader reader = { .buf = src, .pos = 0, .length = src_length, .acc = 0, .acc_bits = 0 };
+    uint32_t prev[GORILLA_MAX_WORDS_PER_POINT], word, xor, control;
+    unsigned leading[GORILLA_MAX_WORDS_PER_POINT], trailing[GORILLA_MAX_WORDS_PER_POINT];
+    unsigned i, field, words, meaningful;
+
+    if (page_length % (words_per_point * sizeof(uint32_t)))
+        return 1;
+    words = page_length / sizeof(uint32_t);
+
+    for (i = 0 ; i < words ; ++i) {
+        field = i % words_per_point;
+        if (i < words_per_point) {
+            if (gorilla_read_bits(&reader, 32, &word))
+                return 1;
+            leading[field] = trailing[field] = 32;
+        } else {
+            if (gorilla_read_bits(&reader, 1, &control))
+                return 1;
+            if (0 == control) {
+                word = prev[field];
+            } else {
+                if (gorilla_read_bits(&reader, 1, &control))
+                    return 1;
+                if (1 == control) {
+                    uint32_t lz, len;
+
+                    if (gorilla_read_bits(&reader, 5, &lz) || gorilla_read_bits(&reader, 5, &len))
+                        return 1;
+                    if (lz + len + 1 > 32)
+                        return 1;
+                    leading[field] = lz;
+                    trailing[field] = 32 - lz - (len + 1);
+                } else if (leading[field] + trailing[field] >= 32) {
+                    return 1;
+                }
+                meaningful = 32 - leading[field] - trailing[field];
+                if (gorilla_read_bits(&reader, meaningful, &xor))
+                    return 1;
+                word = prev[field] ^ (xor << trailing[field]);
+            }
+        }
+        prev[field] = word;
+        memcpy(page + i * sizeof(uint32_t), &word, sizeof(word));
+    }
+    return 0;
+}
+
+/*
+ * Compresses the payload of an extent, the concatenation of the pages described by the header.
+ * dst must have room for RRDENG_GORILLA_COMPRESS_BOUND() bytes.
+ * Returns the compressed payload length.
+ */
+uint32_t rrdeng_gorilla_compress(struct rrdeng_df_extent_header *header, void *payload, void *dst)
+{
+    uint8_t *src = payload, *out = dst;
+    uint32_t page_length, length, pos = 0;
+    unsigned i;
+
+    for (i = 0 ; i < header->number_of_pages ; ++i) {
+        page_length = header->descr[i].page_length;
+        length = gorilla_encode_page(out + pos + sizeof(length), src, page_length,
+                                     gorilla_words_per_point(header->descr[i].type));
+        if (0 == length) {
+            /* not worth it, store the page as is */
+            length = page_length;
+            (void) memcpy(out + pos + sizeof(length), src, page_length);
+        }
+        (void) memcpy(out + pos, &length, sizeof(length));
+        pos += sizeof(length) + length;
+        src += page_length;
+    }
+    return pos;
+}
+
+/*
+ * Decompresses the payload of an extent into dst, which must have room for the pages described by the header.
+ * Returns 0 on success, 1 if the payload is corrupted.
+ */
+int rrdeng_gorilla_decompress(struct rrdeng_df_extent_header *header, void *src, uint32_t src_length,
+                              void *dst, uint32_t dst_length)
+{
+    uint8_t *in = src, *out = dst;
+    uint32_t page_length, length, pos = 0, out_pos = 0;
+    unsigned i;
+
+    for (i = 0 ; i < header->number_of_pages ; ++i) {
+        page_length = header->descr[i].page_length;
+        if (src_length - pos < sizeof(length) || dst_length - out_pos < page_length)
+            return 1;
+        (void) memcpy(&length, in + pos, sizeof(length));
+        pos += sizeof(length);
+        if (length > page_length || src_length - pos < length)
+            return 1;
+        if (length == page_length) {
+            (void) memcpy(out + out_pos, in + pos, page_length);
+        } else if (gorilla_decode_page(out + out_pos, page_length, in + pos, length,
+                                       gorilla_words_per_point(header->descr[i].type))) {
+            return 1;
+        }
+        pos += length;
+        out_pos += page_length;
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef NETDATA_RRDENGCOMPRESSION_H
+#define NETDATA_RRDENGCOMPRESSION_H
+
+#include "rrdengine.h"
+
+/*
+ * RRD_GORILLA extent payload: for every page of the extent, in the order of the page descriptors of the extent header,
+ * a 32-bit length followed by that many bytes. A length equal to the page length means the page is stored as is,
+ * a smaller one means the page is encoded as follows.
+ *
+ * Pages are arrays of points made of 32-bit words, 1 word for PAGE_METRICS and 4 for PAGE_TIER. The words of the first
+ * point are stored as is, every other word is XORed with the same word of the previous point and stored as:
+ *   '0'                                          when the XOR is 0, i.e. the word did not change
+ *   '10' + meaningful bits                       when the meaningful bits fit the window of the previous XOR
+ *   '11' + 5 bits leading zeros + 5 bits (meaningful bits - 1) + meaningful bits
+ * The bits are packed most significant first.
+ */
+
+/* the maximum size of the RRD_GORILLA payload of an extent */
+#define RRDENG_GORILLA_COMPRESS_BOUND(uncompressed_payload_length, number_of_pages) \
+    ((uncompressed_payload_length) + (number_of_pages) * sizeof(uint32_t))
+
+extern uint32_t rrdeng_gorilla_compress(struct rrdeng_df_extent_header *header, void *payload, void *dst);
+extern int rrdeng_gorilla_decompress(struct rrdeng_df_extent_header *header, void *src, uint32_t src_length,
+                                     void *dst, uint32_t dst_length);
+
+#endif /* NETDATA_RRDENGCOMPRESSION_H */
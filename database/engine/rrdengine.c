@@ -29,36 +29,81 @@ static void sanity_check(void)
     /* page count must fit in 8 bits */
     BUILD_BUG_ON(MAX_PAGES_PER_EXTENT > 255);
 
-    /* extent cache count must fit in 32 bits */
-    BUILD_BUG_ON(MAX_CACHED_EXTENTS > 32);
-
     /* page info scratch space must be able to hold 2 32-bit integers */
     BUILD_BUG_ON(sizeof(((struct rrdeng_page_info *)0)->scratch) < 2 * sizeof(uint32_t));
 }
 
-/* always inserts into tail */
-static inline void xt_cache_replaceQ_insert(struct rrdengine_worker_config* wc,
-                                            struct extent_cache_element *xt_cache_elem)
+static struct extent_cache xt_cache;
+static uv_once_t xt_cache_once = UV_ONCE_INIT;
+
+static void xt_cache_init_once(void)
+{
+    unsigned i;
+    size_t max_bytes = 0;
+
+    if (default_rrdeng_extent_cache_mb > 0)
+        max_bytes = (size_t)default_rrdeng_extent_cache_mb * 1024 * 1024 / XT_CACHE_SHARDS;
+
+    for (i = 0 ; i < XT_CACHE_SHARDS ; ++i) {
+        fatal_assert(0 == uv_mutex_init(&xt_cache.shards[i].lock));
+        xt_cache.shards[i].JudyHS_array = (Pvoid_t) NULL;
+        memset(xt_cache.shards[i].queues, 0, sizeof(xt_cache.shards[i].queues));
+        xt_cache.shards[i].max_bytes = max_bytes;
+    }
+    info("DBENGINE: extent cache size is %d MiB in %d shards.", default_rrdeng_extent_cache_mb, XT_CACHE_SHARDS);
+}
+
+/* The extent cache is shared by all instances and it is initialized by the first one */
+void init_xt_cache(void)
+{
+    uv_once(&xt_cache_once, xt_cache_init_once);
+}
+
+static inline void xt_cache_key_init(struct extent_cache_key *key, struct rrdengine_instance *ctx,
+                                     struct extent_info *extent)
+{
+    /* the key is hashed as raw bytes, the padding must be zeroed */
+    memset(key, 0, sizeof(*key));
+    key->ctx = ctx;
+    key->extent = extent;
+    key->fileno = extent->datafile->fileno;
+}
+
+static inline struct extent_cache_shard *xt_cache_get_shard(struct extent_cache_key *key)
 {
-    struct extent_cache *xt_cache = &wc->xt_cache;
+    uintptr_t hash;
+
+    hash = ((uintptr_t)key->extent / sizeof(struct extent_info)) ^ ((uintptr_t)key->ctx >> 6) ^ key->fileno;
+    return &xt_cache.shards[hash % XT_CACHE_SHARDS];
+}
 
+/* always inserts into tail, the shard lock must be held */
+static inline void xt_cache_queue_insert(struct extent_cache_shard *shard, struct extent_cache_element *xt_cache_elem,
+                                         xt_cache_queue_t queue)
+{
+    struct extent_cache_queue *q = &shard->queues[queue];
+
+    xt_cache_elem->queue = queue;
     xt_cache_elem->prev = NULL;
     xt_cache_elem->next = NULL;
 
-    if (likely(NULL != xt_cache->replaceQ_tail)) {
-        xt_cache_elem->prev = xt_cache->replaceQ_tail;
-        xt_cache->replaceQ_tail->next = xt_cache_elem;
+    if (likely(NULL != q->tail)) {
+        xt_cache_elem->prev = q->tail;
+        q->tail->next = xt_cache_elem;
     }
-    if (unlikely(NULL == xt_cache->replaceQ_head)) {
-        xt_cache->replaceQ_head = xt_cache_elem;
+    if (unlikely(NULL == q->head)) {
+        q->head = xt_cache_elem;
     }
-    xt_cache->replaceQ_tail = xt_cache_elem;
+    q->tail = xt_cache_elem;
+    ++q->count;
+    if (XT_CACHE_A1OUT != queue)
+        q->bytes += xt_cache_elem->size;
 }
 
-static inline void xt_cache_replaceQ_delete(struct rrdengine_worker_config* wc,
-                                            struct extent_cache_element *xt_cache_elem)
+/* the shard lock must be held */
+static inline void xt_cache_queue_delete(struct extent_cache_shard *shard, struct extent_cache_element *xt_cache_elem)
 {
-    struct extent_cache *xt_cache = &wc->xt_cache;
+    struct extent_cache_queue *q = &shard->queues[xt_cache_elem->queue];
     struct extent_cache_element *prev, *next;
 
     prev = xt_cache_elem->prev;
@@ -70,103 +115,251 @@ static inline void xt_cache_replaceQ_delete(struct rrdengine_worker_config* wc,
     if (likely(NULL != next)) {
         next->prev = prev;
     }
-    if (unlikely(xt_cache_elem == xt_cache->replaceQ_head)) {
-        xt_cache->replaceQ_head = next;
+    if (unlikely(xt_cache_elem == q->head)) {
+        q->head = next;
     }
-    if (unlikely(xt_cache_elem == xt_cache->replaceQ_tail)) {
-        xt_cache->replaceQ_tail = prev;
+    if (unlikely(xt_cache_elem == q->tail)) {
+        q->tail = prev;
     }
     xt_cache_elem->prev = xt_cache_elem->next = NULL;
+    --q->count;
+    if (XT_CACHE_A1OUT != xt_cache_elem->queue)
+        q->bytes -= xt_cache_elem->size;
 }
 
-static inline void xt_cache_replaceQ_set_hot(struct rrdengine_worker_config* wc,
-                                             struct extent_cache_element *xt_cache_elem)
+/* Removes an element from its queue and from the index and frees it, the shard lock must be held */
+static void xt_cache_delete_elem(struct extent_cache_shard *shard, struct extent_cache_element *xt_cache_elem)
 {
-    xt_cache_replaceQ_delete(wc, xt_cache_elem);
-    xt_cache_replaceQ_insert(wc, xt_cache_elem);
+    int ret;
+
+    xt_cache_queue_delete(shard, xt_cache_elem);
+    ret = JudyHSDel(&shard->JudyHS_array, &xt_cache_elem->key, sizeof(xt_cache_elem->key), PJE0);
+    fatal_assert(1 == ret);
+    freez(xt_cache_elem->pages);
+    freez(xt_cache_elem);
 }
 
-/* Returns the index of the cached extent if it was successfully inserted in the extent cache, otherwise -1 */
-static int try_insert_into_xt_cache(struct rrdengine_worker_config* wc, struct extent_info *extent)
+/*
+ * Evicts the oldest evictable extent of the queue, the shard lock must be held.
+ * Extents leaving A1in are remembered in A1out without their pages.
+ * Returns 1 if an extent was evicted, 0 otherwise.
+ */
+static int xt_cache_evict_from_queue(struct extent_cache_shard *shard, xt_cache_queue_t queue)
 {
-    struct extent_cache *xt_cache = &wc->xt_cache;
     struct extent_cache_element *xt_cache_elem;
-    unsigned idx;
-    int ret;
+    struct rrdengine_instance *ctx;
 
-    ret = find_first_zero(xt_cache->allocation_bitmap);
-    if (-1 == ret || ret >= MAX_CACHED_EXTENTS) {
-        for (xt_cache_elem = xt_cache->replaceQ_head ; NULL != xt_cache_elem ; xt_cache_elem = xt_cache_elem->next) {
-            idx = xt_cache_elem - xt_cache->extent_array;
-            if (!check_bit(xt_cache->inflight_bitmap, idx)) {
-                xt_cache_replaceQ_delete(wc, xt_cache_elem);
-                break;
-            }
-        }
-        if (NULL == xt_cache_elem)
-            return -1;
-    } else {
-        idx = (unsigned)ret;
-        xt_cache_elem = &xt_cache->extent_array[idx];
+    for (xt_cache_elem = shard->queues[queue].head ; NULL != xt_cache_elem ; xt_cache_elem = xt_cache_elem->next) {
+        if (!xt_cache_elem->inflight && 0 == xt_cache_elem->refcnt)
+            break;
     }
-    xt_cache_elem->extent = extent;
-    xt_cache_elem->fileno = extent->datafile->fileno;
-    xt_cache_elem->inflight_io_descr = NULL;
-    xt_cache_replaceQ_insert(wc, xt_cache_elem);
-    modify_bit(&xt_cache->allocation_bitmap, idx, 1);
+    if (NULL == xt_cache_elem)
+        return 0;
 
-    return (int)idx;
+    ctx = xt_cache_elem->key.ctx;
+    rrd_stat_atomic_add(&ctx->stats.xt_cache_evictions, 1);
+    if (XT_CACHE_AM == queue) {
+        xt_cache_delete_elem(shard, xt_cache_elem);
+        return 1;
+    }
+    xt_cache_queue_delete(shard, xt_cache_elem);
+    freez(xt_cache_elem->pages);
+    xt_cache_elem->pages = NULL;
+    xt_cache_queue_insert(shard, xt_cache_elem, XT_CACHE_A1OUT);
+    if (shard->queues[XT_CACHE_A1OUT].count > XT_CACHE_A1OUT_MAX)
+        xt_cache_delete_elem(shard, shard->queues[XT_CACHE_A1OUT].head);
+    return 1;
 }
 
-/**
- * Returns 0 if the cached extent was found in the extent cache, 1 otherwise.
- * Sets *idx to point to the position of the extent inside the cache.
- **/
-static uint8_t lookup_in_xt_cache(struct rrdengine_worker_config* wc, struct extent_info *extent, unsigned *idx)
+/*
+ * Makes room for size bytes in the shard following the 2Q policy, the shard lock must be held.
+ * Returns 0 on success, 1 if not enough extents could be evicted.
+ */
+static int xt_cache_make_room(struct extent_cache_shard *shard, uint32_t size)
 {
-    struct extent_cache *xt_cache = &wc->xt_cache;
-    struct extent_cache_element *xt_cache_elem;
-    unsigned i;
+    struct extent_cache_queue *a1in = &shard->queues[XT_CACHE_A1IN], *am = &shard->queues[XT_CACHE_AM];
+    size_t a1in_max_bytes = shard->max_bytes * XT_CACHE_A1IN_PERCENT / 100;
+    int evicted;
 
-    for (i = 0 ; i < MAX_CACHED_EXTENTS ; ++i) {
-        xt_cache_elem = &xt_cache->extent_array[i];
-        if (check_bit(xt_cache->allocation_bitmap, i) && xt_cache_elem->extent == extent &&
-            xt_cache_elem->fileno == extent->datafile->fileno) {
-            *idx = i;
-            return 0;
+    if (size > shard->max_bytes)
+        return 1;
+    while (a1in->bytes + am->bytes + size > shard->max_bytes) {
+        /* extents that were read once make way first so that scans cannot flush the frequently read ones */
+        if (a1in->bytes > a1in_max_bytes || 0 == am->count) {
+            evicted = xt_cache_evict_from_queue(shard, XT_CACHE_A1IN) ||
+                      xt_cache_evict_from_queue(shard, XT_CACHE_AM);
+        } else {
+            evicted = xt_cache_evict_from_queue(shard, XT_CACHE_AM) ||
+                      xt_cache_evict_from_queue(shard, XT_CACHE_A1IN);
         }
+        if (!evicted)
+            return 1;
     }
-    return 1;
+    return 0;
 }
 
-#if 0 /* disabled code */
-static void delete_from_xt_cache(struct rrdengine_worker_config* wc, unsigned idx)
+typedef enum {
+    XT_CACHE_HIT = 0,       /* the extent is cached and referenced, release it with xt_cache_release() */
+    XT_CACHE_INFLIGHT,      /* the extent is being read, the I/O descriptor will be served when it is populated */
+    XT_CACHE_RESERVED,      /* the extent was not cached, it will be populated by the I/O descriptor that reads it */
+    XT_CACHE_MISS           /* the extent was not cached and there was no room for it */
+} xt_cache_lookup_t;
+
+/*
+ * Looks up the extent of the I/O descriptor in the extent cache and reserves room for it when it is not cached.
+ * Sets *xt_cache_elemp to the element of the extent unless it returns XT_CACHE_MISS.
+ */
+static xt_cache_lookup_t xt_cache_get_or_reserve(struct rrdengine_instance *ctx, struct extent_info *extent,
+                                                 struct extent_io_descriptor *xt_io_descr,
+                                                 struct extent_cache_element **xt_cache_elemp)
 {
-    struct extent_cache *xt_cache = &wc->xt_cache;
-    struct extent_cache_element *xt_cache_elem;
+    struct extent_cache_key key;
+    struct extent_cache_shard *shard;
+    struct extent_cache_element *xt_cache_elem = NULL;
+    Pvoid_t *PValue;
+    xt_cache_queue_t queue = XT_CACHE_A1IN;
+    xt_cache_lookup_t ret;
+    uint32_t size;
+    unsigned j;
+
+    xt_cache_key_init(&key, ctx, extent);
+    shard = xt_cache_get_shard(&key);
+
+    uv_mutex_lock(&shard->lock);
+    PValue = JudyHSGet(shard->JudyHS_array, &key, sizeof(key));
+    if (PValue)
+        xt_cache_elem = *PValue;
+    if (xt_cache_elem && XT_CACHE_A1OUT != xt_cache_elem->queue) {
+        rrd_stat_atomic_add(&ctx->stats.xt_cache_hits, 1);
+        if (xt_cache_elem->inflight) {
+            struct extent_io_descriptor *old_next = xt_cache_elem->inflight_io_descr->next;
+
+            xt_cache_elem->inflight_io_descr->next = xt_io_descr;
+            xt_io_descr->next = old_next;
+            ret = XT_CACHE_INFLIGHT;
+        } else {
+            /* extents in A1in stay in place, only the ones in Am are promoted */
+            if (XT_CACHE_AM == xt_cache_elem->queue) {
+                xt_cache_queue_delete(shard, xt_cache_elem);
+                xt_cache_queue_insert(shard, xt_cache_elem, XT_CACHE_AM);
+            }
+            ++xt_cache_elem->refcnt;
+            ret = XT_CACHE_HIT;
+        }
+        uv_mutex_unlock(&shard->lock);
+        *xt_cache_elemp = xt_cache_elem;
+        return ret;
+    }
+    rrd_stat_atomic_add(&ctx->stats.xt_cache_misses, 1);
 
-    xt_cache_elem = &xt_cache->extent_array[idx];
-    xt_cache_replaceQ_delete(wc, xt_cache_elem);
-    xt_cache_elem->extent = NULL;
-    modify_bit(&wc->xt_cache.allocation_bitmap, idx, 0); /* invalidate it */
-    modify_bit(&wc->xt_cache.inflight_bitmap, idx, 0); /* not in-flight anymore */
+    if (xt_cache_elem) {
+        /* the extent was evicted from A1in recently, it is read again so it goes to Am */
+        xt_cache_delete_elem(shard, xt_cache_elem);
+        xt_cache_elem = NULL;
+        queue = XT_CACHE_AM;
+    }
+    for (j = 0, size = 0 ; j < extent->number_of_pages ; ++j)
+        size += extent->pages[j]->page_length;
+    if (xt_cache_make_room(shard, size)) {
+        uv_mutex_unlock(&shard->lock);
+        return XT_CACHE_MISS;
+    }
+
+    xt_cache_elem = callocz(1, sizeof(*xt_cache_elem));
+    xt_cache_elem->key = key;
+    xt_cache_elem->size = size;
+    xt_cache_elem->inflight = 1;
+    xt_cache_elem->inflight_io_descr = xt_io_descr;
+    xt_cache_queue_insert(shard, xt_cache_elem, queue);
+    PValue = JudyHSIns(&shard->JudyHS_array, &xt_cache_elem->key, sizeof(xt_cache_elem->key), PJE0);
+    fatal_assert(NULL == *PValue);
+    *PValue = xt_cache_elem;
+    uv_mutex_unlock(&shard->lock);
+
+    *xt_cache_elemp = xt_cache_elem;
+    return XT_CACHE_RESERVED;
 }
-#endif
 
-void enqueue_inflight_read_to_xt_cache(struct rrdengine_worker_config* wc, unsigned idx,
-                                       struct extent_io_descriptor *xt_io_descr)
+/* Releases a reference to a cached extent taken by xt_cache_get_or_reserve() */
+static void xt_cache_release(struct extent_cache_element *xt_cache_elem)
 {
-    struct extent_cache *xt_cache = &wc->xt_cache;
-    struct extent_cache_element *xt_cache_elem;
-    struct extent_io_descriptor *old_next;
+    struct extent_cache_shard *shard = xt_cache_get_shard(&xt_cache_elem->key);
 
-    xt_cache_elem = &xt_cache->extent_array[idx];
-    old_next = xt_cache_elem->inflight_io_descr->next;
-    xt_cache_elem->inflight_io_descr->next = xt_io_descr;
-    xt_io_descr->next = old_next;
+    uv_mutex_lock(&shard->lock);
+    fatal_assert(xt_cache_elem->refcnt > 0);
+    --xt_cache_elem->refcnt;
+    uv_mutex_unlock(&shard->lock);
 }
 
-void read_cached_extent_cb(struct rrdengine_worker_config* wc, unsigned idx, struct extent_io_descriptor *xt_io_descr)
+/* Deletes all the extents of an instance from the extent cache so that its address can be reused */
+void xt_cache_delete_instance(struct rrdengine_instance *ctx)
+{
+    struct extent_cache_shard *shard;
+    struct extent_cache_element *xt_cache_elem, *next;
+    unsigned i, queue;
+
+    for (i = 0 ; i < XT_CACHE_SHARDS ; ++i) {
+        shard = &xt_cache.shards[i];
+        uv_mutex_lock(&shard->lock);
+        for (queue = 0 ; queue < XT_CACHE_QUEUES ; ++queue) {
+            for (xt_cache_elem = shard->queues[queue].head ; NULL != xt_cache_elem ; xt_cache_elem = next) {
+                next = xt_cache_elem->next;
+                if (xt_cache_elem->key.ctx != ctx)
+                    continue;
+                fatal_assert(!xt_cache_elem->inflight && 0 == xt_cache_elem->refcnt);
+                xt_cache_delete_elem(shard, xt_cache_elem);
+            }
+        }
+        uv_mutex_unlock(&shard->lock);
+    }
+}
+
+void read_cached_extent_cb(struct rrdengine_worker_config* wc, struct extent_cache_element *xt_cache_elem,
+                           struct extent_io_descriptor *xt_io_descr);
+
+/*
+ * Populates the pages of a reserved extent and serves the in-flight read requests that are waiting for it.
+ * pages must be an allocation of xt_cache_elem->size bytes whose ownership passes to the extent cache, and the
+ * extent stays referenced by the caller who must release it with xt_cache_release(). When pages is NULL the extent
+ * could not be read, the waiting requests get empty pages and the extent leaves the cache.
+ */
+static void xt_cache_populate(struct rrdengine_worker_config* wc, struct extent_cache_element *xt_cache_elem,
+                              void *pages)
+{
+    struct extent_cache_shard *shard = xt_cache_get_shard(&xt_cache_elem->key);
+    struct extent_io_descriptor *curr, *next;
+    int ret;
+
+    uv_mutex_lock(&shard->lock);
+    /* no new requests can be chained from now on */
+    curr = xt_cache_elem->inflight_io_descr->next;
+    xt_cache_elem->inflight_io_descr = NULL;
+    xt_cache_elem->inflight = 0;
+    if (likely(NULL != pages)) {
+        xt_cache_elem->pages = pages;
+        ++xt_cache_elem->refcnt;
+    } else {
+        xt_cache_queue_delete(shard, xt_cache_elem);
+        ret = JudyHSDel(&shard->JudyHS_array, &xt_cache_elem->key, sizeof(xt_cache_elem->key), PJE0);
+        fatal_assert(1 == ret);
+        xt_cache_elem->pages = callocz(1, xt_cache_elem->size);
+    }
+    uv_mutex_unlock(&shard->lock);
+
+    /* complete all connected in-flight read requests */
+    for ( ; curr ; curr = next) {
+        next = curr->next;
+        read_cached_extent_cb(wc, xt_cache_elem, curr);
+    }
+
+    if (unlikely(NULL == pages)) {
+        freez(xt_cache_elem->pages);
+        freez(xt_cache_elem);
+    }
+}
+
+void read_cached_extent_cb(struct rrdengine_worker_config* wc, struct extent_cache_element *xt_cache_elem,
+                           struct extent_io_descriptor *xt_io_descr)
 {
     unsigned i, j, page_offset;
     struct rrdengine_instance *ctx = wc->ctx;
@@ -190,12 +383,13 @@ void read_cached_extent_cb(struct rrdengine_worker_config* wc, unsigned idx, str
 
         }
         /* care, we don't hold the descriptor mutex */
-       (void) memcpy(page, wc->xt_cache.extent_array[idx].pages + page_offset, descr->page_length);
+       (void) memcpy(page, xt_cache_elem->pages + page_offset, descr->page_length);
 
         rrdeng_page_descr_mutex_lock(ctx, descr);
         pg_cache_descr = descr->pg_cache_descr;
         pg_cache_descr->page = page;
         pg_cache_descr->flags |= RRD_PAGE_POPULATED;
+        pg_cache_descr->prefetched = 0;
         pg_cache_descr->flags &= ~RRD_PAGE_READ_PENDING;
         rrdeng_page_descr_mutex_unlock(ctx, descr);
         pg_cache_replaceQ_insert(ctx, descr);
@@ -211,40 +405,48 @@ void read_cached_extent_cb(struct rrdengine_worker_config* wc, unsigned idx, str
     freez(xt_io_descr);
 }
 
-void read_extent_cb(uv_fs_t* req)
+/*
+ * Runs in the libuv thread pool: reads an extent, verifies its checksum and decompresses it.
+ * It must not touch the extent cache or anything else owned by the event loop.
+ */
+static void read_extent_work_cb(uv_work_t *req)
 {
-    struct rrdengine_worker_config* wc = req->loop->data;
+    struct extent_io_descriptor *xt_io_descr = req->data;
+    struct rrdengine_worker_config* wc = xt_io_descr->wc;
     struct rrdengine_instance *ctx = wc->ctx;
-    struct extent_io_descriptor *xt_io_descr;
-    struct rrdeng_page_descr *descr;
-    struct page_cache_descr *pg_cache_descr;
     int ret;
-    unsigned i, j, count;
-    void *page, *uncompressed_buf = NULL;
-    uint32_t payload_length, payload_offset, page_offset, uncompressed_payload_length = 0;
-    uint8_t have_read_error = 0;
+    ssize_t bytes_read;
+    unsigned i, count;
+    uint32_t payload_length, payload_offset;
     /* persistent structures */
     struct rrdeng_df_extent_header *header;
     struct rrdeng_df_extent_trailer *trailer;
     uLong crc;
 
-    xt_io_descr = req->data;
+    xt_io_descr->have_read_error = 0;
+    xt_io_descr->uncompressed_buf = NULL;
+
+    /* synchronous read, the uv_fs_*() calls are not safe to use outside the thread of the event loop */
+    do {
+        bytes_read = pread(xt_io_descr->file, xt_io_descr->buf, xt_io_descr->iov.len, (off_t)xt_io_descr->pos);
+    } while (bytes_read < 0 && EINTR == errno);
+    if (bytes_read < 0) {
+        struct rrdengine_datafile *datafile = xt_io_descr->descr_array[0]->extent->datafile;
+
+        rrd_stat_atomic_add(&ctx->stats.io_errors, 1);
+        rrd_stat_atomic_add(&global_io_errors, 1);
+        xt_io_descr->have_read_error = 1;
+        error("%s: pread - %s - extent at offset %"PRIu64"(%u) in datafile %u-%u.", __func__,
+              strerror(errno), xt_io_descr->pos, xt_io_descr->bytes, datafile->tier, datafile->fileno);
+        return;
+    }
+
     header = xt_io_descr->buf;
     payload_length = header->payload_length;
     count = header->number_of_pages;
     payload_offset = sizeof(*header) + sizeof(header->descr[0]) * count;
     trailer = xt_io_descr->buf + xt_io_descr->bytes - sizeof(*trailer);
 
-    if (req->result < 0) {
-        struct rrdengine_datafile *datafile = xt_io_descr->descr_array[0]->extent->datafile;
-
-        ++ctx->stats.io_errors;
-        rrd_stat_atomic_add(&global_io_errors, 1);
-        have_read_error = 1;
-        error("%s: uv_fs_read - %s - extent at offset %"PRIu64"(%u) in datafile %u-%u.", __func__,
-              uv_strerror((int)req->result), xt_io_descr->pos, xt_io_descr->bytes, datafile->tier, datafile->fileno);
-        goto after_crc_check;
-    }
     crc = crc32(0L, Z_NULL, 0);
     crc = crc32(crc, xt_io_descr->buf, xt_io_descr->bytes - sizeof(*trailer));
     ret = crc32cmp(trailer->checksum, crc);
@@ -258,53 +460,91 @@ void read_extent_cb(uv_fs_t* req)
     if (unlikely(ret)) {
         struct rrdengine_datafile *datafile = xt_io_descr->descr_array[0]->extent->datafile;
 
-        ++ctx->stats.io_errors;
+        rrd_stat_atomic_add(&ctx->stats.io_errors, 1);
         rrd_stat_atomic_add(&global_io_errors, 1);
-        have_read_error = 1;
+        xt_io_descr->have_read_error = 1;
         error("%s: Extent at offset %"PRIu64"(%u) was read from datafile %u-%u. CRC32 check: FAILED", __func__,
               xt_io_descr->pos, xt_io_descr->bytes, datafile->tier, datafile->fileno);
+        return;
     }
 
-after_crc_check:
-    if (!have_read_error && RRD_NO_COMPRESSION != header->compression_algorithm) {
-        uncompressed_payload_length = 0;
+    if (RRD_NO_COMPRESSION != header->compression_algorithm) {
+        uint32_t uncompressed_payload_length = 0;
+
         for (i = 0 ; i < count ; ++i) {
             uncompressed_payload_length += header->descr[i].page_length;
         }
-        uncompressed_buf = mallocz(uncompressed_payload_length);
-        ret = LZ4_decompress_safe(xt_io_descr->buf + payload_offset, uncompressed_buf,
-                                  payload_length, uncompressed_payload_length);
-        ctx->stats.before_decompress_bytes += payload_length;
-        ctx->stats.after_decompress_bytes += ret;
-        debug(D_RRDENGINE, "LZ4 decompressed %u bytes to %d bytes.", payload_length, ret);
+        xt_io_descr->uncompressed_buf = mallocz(uncompressed_payload_length);
+        xt_io_descr->uncompressed_payload_length = uncompressed_payload_length;
+        if (RRD_GORILLA == header->compression_algorithm) {
+            if (unlikely(rrdeng_gorilla_decompress(header, xt_io_descr->buf + payload_offset, payload_length,
+                                                   xt_io_descr->uncompressed_buf, uncompressed_payload_length))) {
+                struct rrdengine_datafile *datafile = xt_io_descr->descr_array[0]->extent->datafile;
+
+                rrd_stat_atomic_add(&ctx->stats.io_errors, 1);
+                rrd_stat_atomic_add(&global_io_errors, 1);
+                xt_io_descr->have_read_error = 1;
+                freez(xt_io_descr->uncompressed_buf);
+                xt_io_descr->uncompressed_buf = NULL;
+                error("%s: Extent at offset %"PRIu64"(%u) was read from datafile %u-%u. Corrupted payload.", __func__,
+                      xt_io_descr->pos, xt_io_descr->bytes, datafile->tier, datafile->fileno);
+                return;
+            }
+            ret = (int)uncompressed_payload_length;
+            debug(D_RRDENGINE, "Gorilla decompressed %u bytes to %d bytes.", payload_length, ret);
+        } else {
+            ret = LZ4_decompress_safe(xt_io_descr->buf + payload_offset, xt_io_descr->uncompressed_buf,
+                                      payload_length, uncompressed_payload_length);
+            debug(D_RRDENGINE, "LZ4 decompressed %u bytes to %d bytes.", payload_length, ret);
+        }
+        rrd_stat_atomic_add(&ctx->stats.before_decompress_bytes, payload_length);
+        rrd_stat_atomic_add(&ctx->stats.after_decompress_bytes, ret);
         /* care, we don't hold the descriptor mutex */
     }
-    {
-        uint8_t xt_is_cached = 0;
-        unsigned xt_idx;
-        struct extent_info *extent = xt_io_descr->descr_array[0]->extent;
-
-        xt_is_cached = !lookup_in_xt_cache(wc, extent, &xt_idx);
-        if (xt_is_cached && check_bit(wc->xt_cache.inflight_bitmap, xt_idx)) {
-            struct extent_cache *xt_cache = &wc->xt_cache;
-            struct extent_cache_element *xt_cache_elem = &xt_cache->extent_array[xt_idx];
-            struct extent_io_descriptor *curr, *next;
-
-            if (have_read_error) {
-                memset(xt_cache_elem->pages, 0, sizeof(xt_cache_elem->pages));
-            } else if (RRD_NO_COMPRESSION == header->compression_algorithm) {
-                (void)memcpy(xt_cache_elem->pages, xt_io_descr->buf + payload_offset, payload_length);
-            } else {
-                (void)memcpy(xt_cache_elem->pages, uncompressed_buf, uncompressed_payload_length);
-            }
-            /* complete all connected in-flight read requests */
-            for (curr = xt_cache_elem->inflight_io_descr->next ; curr ; curr = next) {
-                next = curr->next;
-                read_cached_extent_cb(wc, xt_idx, curr);
+}
+
+/* Runs in the event loop after read_extent_work_cb(), populates the pages of the extent */
+static void read_extent_after_work_cb(uv_work_t *req, int status)
+{
+    struct extent_io_descriptor *xt_io_descr = req->data;
+    struct rrdengine_worker_config* wc = xt_io_descr->wc;
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct rrdeng_page_descr *descr;
+    struct page_cache_descr *pg_cache_descr;
+    unsigned i, j, count;
+    void *page, *uncompressed_buf = xt_io_descr->uncompressed_buf;
+    uint32_t payload_length, payload_offset, page_offset, uncompressed_payload_length;
+    uint8_t have_read_error = xt_io_descr->have_read_error;
+    /* persistent structures */
+    struct rrdeng_df_extent_header *header;
+
+    fatal_assert(0 == status);
+    header = xt_io_descr->buf;
+    payload_length = header->payload_length;
+    count = header->number_of_pages;
+    payload_offset = sizeof(*header) + sizeof(header->descr[0]) * count;
+    uncompressed_payload_length = xt_io_descr->uncompressed_payload_length;
+    if (unlikely(have_read_error)) {
+        /* the header cannot be trusted, only populate the requested pages */
+        count = 0;
+    }
+    if (xt_io_descr->xt_cache_elem) {
+        void *pages = NULL;
+
+        if (have_read_error) {
+            ;
+        } else if (RRD_NO_COMPRESSION == header->compression_algorithm) {
+            if (likely(payload_length == xt_io_descr->xt_cache_elem->size)) {
+                pages = mallocz(payload_length);
+                (void)memcpy(pages, xt_io_descr->buf + payload_offset, payload_length);
             }
-            xt_cache_elem->inflight_io_descr = NULL;
-            modify_bit(&xt_cache->inflight_bitmap, xt_idx, 0); /* not in-flight anymore */
+        } else if (likely(uncompressed_payload_length == xt_io_descr->xt_cache_elem->size)) {
+            /* the extent cache takes ownership of the decompressed payload */
+            pages = uncompressed_buf;
         }
+        xt_cache_populate(wc, xt_io_descr->xt_cache_elem, pages);
+        if (NULL == pages)
+            xt_io_descr->xt_cache_elem = NULL;
     }
 
     for (i = 0, page_offset = 0; i < count; page_offset += header->descr[i++].page_length) {
@@ -346,6 +586,7 @@ void read_extent_cb(uv_fs_t* req)
         pg_cache_descr = descr->pg_cache_descr;
         pg_cache_descr->page = page;
         pg_cache_descr->flags |= RRD_PAGE_POPULATED;
+        pg_cache_descr->prefetched = is_prefetched_page;
         pg_cache_descr->flags &= ~RRD_PAGE_READ_PENDING;
         rrdeng_page_descr_mutex_unlock(ctx, descr);
         pg_cache_replaceQ_insert(ctx, descr);
@@ -356,12 +597,36 @@ void read_extent_cb(uv_fs_t* req)
             pg_cache_wake_up_waiters(ctx, descr);
         }
     }
-    if (!have_read_error && RRD_NO_COMPRESSION != header->compression_algorithm) {
-        freez(uncompressed_buf);
+    if (unlikely(have_read_error)) {
+        /* Applications should make sure NULL values match 0 as does SN_EMPTY_SLOT */
+        for (i = 0 ; i < xt_io_descr->descr_count ; ++i) {
+            descr = xt_io_descr->descr_array[i];
+            page = callocz(1, RRDENG_BLOCK_SIZE);
+
+            rrdeng_page_descr_mutex_lock(ctx, descr);
+            pg_cache_descr = descr->pg_cache_descr;
+            pg_cache_descr->page = page;
+            pg_cache_descr->flags |= RRD_PAGE_POPULATED;
+            pg_cache_descr->prefetched = 0;
+            pg_cache_descr->flags &= ~RRD_PAGE_READ_PENDING;
+            rrdeng_page_descr_mutex_unlock(ctx, descr);
+            pg_cache_replaceQ_insert(ctx, descr);
+            if (xt_io_descr->release_descr) {
+                pg_cache_put(ctx, descr);
+            } else {
+                debug(D_RRDENGINE, "%s: Waking up waiters.", __func__);
+                pg_cache_wake_up_waiters(ctx, descr);
+            }
+        }
     }
+    if (xt_io_descr->xt_cache_elem) {
+        if (uncompressed_buf == xt_io_descr->xt_cache_elem->pages)
+            uncompressed_buf = NULL; /* owned by the extent cache */
+        xt_cache_release(xt_io_descr->xt_cache_elem);
+    }
+    freez(uncompressed_buf);
     if (xt_io_descr->completion)
         complete(xt_io_descr->completion);
-    uv_fs_req_cleanup(req);
     free(xt_io_descr->buf);
     freez(xt_io_descr);
 }
@@ -380,8 +645,7 @@ static void do_read_extent(struct rrdengine_worker_config* wc,
     struct extent_io_descriptor *xt_io_descr;
     struct rrdengine_datafile *datafile;
     struct extent_info *extent = descr[0]->extent;
-    uint8_t xt_is_cached = 0, xt_is_inflight = 0;
-    unsigned xt_idx;
+    struct extent_cache_element *xt_cache_elem;
 
     datafile = extent->datafile;
     pos = extent->offset;
@@ -405,22 +669,19 @@ static void do_read_extent(struct rrdengine_worker_config* wc,
     /* xt_io_descr->descr_commit_idx_array[0] */
     xt_io_descr->release_descr = release_descr;
 
-    xt_is_cached = !lookup_in_xt_cache(wc, extent, &xt_idx);
-    if (xt_is_cached) {
-        xt_cache_replaceQ_set_hot(wc, &wc->xt_cache.extent_array[xt_idx]);
-        xt_is_inflight = check_bit(wc->xt_cache.inflight_bitmap, xt_idx);
-        if (xt_is_inflight) {
-            enqueue_inflight_read_to_xt_cache(wc, xt_idx, xt_io_descr);
-            return;
-        }
-        return read_cached_extent_cb(wc, xt_idx, xt_io_descr);
-    } else {
-        ret = try_insert_into_xt_cache(wc, extent);
-        if (-1 != ret) {
-            xt_idx = (unsigned)ret;
-            modify_bit(&wc->xt_cache.inflight_bitmap, xt_idx, 1);
-            wc->xt_cache.extent_array[xt_idx].inflight_io_descr = xt_io_descr;
-        }
+    switch (xt_cache_get_or_reserve(ctx, extent, xt_io_descr, &xt_cache_elem)) {
+    case XT_CACHE_HIT:
+        read_cached_extent_cb(wc, xt_cache_elem, xt_io_descr);
+        xt_cache_release(xt_cache_elem);
+        return;
+    case XT_CACHE_INFLIGHT:
+        return;
+    case XT_CACHE_RESERVED:
+        xt_io_descr->xt_cache_elem = xt_cache_elem;
+        break;
+    case XT_CACHE_MISS:
+    default:
+        break;
     }
 
     ret = posix_memalign((void *)&xt_io_descr->buf, RRDFILE_ALIGNMENT, ALIGN_BYTES_CEILING(size_bytes));
@@ -431,7 +692,10 @@ static void do_read_extent(struct rrdengine_worker_config* wc,
     }
     real_io_size = ALIGN_BYTES_CEILING(size_bytes);
     xt_io_descr->iov = uv_buf_init((void *)xt_io_descr->buf, real_io_size);
-    ret = uv_fs_read(wc->loop, &xt_io_descr->req, datafile->file, &xt_io_descr->iov, 1, pos, read_extent_cb);
+    xt_io_descr->wc = wc;
+    xt_io_descr->file = datafile->file;
+    xt_io_descr->work_req.data = xt_io_descr;
+    ret = uv_queue_work(wc->loop, &xt_io_descr->work_req, read_extent_work_cb, read_extent_after_work_cb);
     fatal_assert(-1 != ret);
     ctx->stats.io_read_bytes += real_io_size;
     ++ctx->stats.io_read_requests;
@@ -646,83 +910,37 @@ void flush_pages_cb(uv_fs_t* req)
 }
 
 /*
- * completion must be NULL or valid.
- * Returns 0 when no flushing can take place.
- * Returns datafile bytes to be written on successful flushing initiation.
+ * Runs in the libuv thread pool: builds and compresses the extent of the pages being flushed.
+ * It must not touch the datafiles or anything else owned by the event loop.
  */
-static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct completion *completion)
+static void flush_pages_work_cb(uv_work_t *req)
 {
-    struct rrdengine_instance *ctx = wc->ctx;
-    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct extent_io_descriptor *xt_io_descr = req->data;
+    struct rrdengine_instance *ctx = xt_io_descr->wc->ctx;
     int ret;
     int compressed_size, max_compressed_size = 0;
-    unsigned i, count, size_bytes, pos, real_io_size;
+    unsigned i, count, size_bytes, pos;
     uint32_t uncompressed_payload_length, payload_offset;
-    struct rrdeng_page_descr *descr, *eligible_pages[MAX_PAGES_PER_EXTENT];
-    struct page_cache_descr *pg_cache_descr;
-    struct extent_io_descriptor *xt_io_descr;
+    struct rrdeng_page_descr *descr;
     void *compressed_buf = NULL;
-    Word_t descr_commit_idx_array[MAX_PAGES_PER_EXTENT];
-    Pvoid_t *PValue;
-    Word_t Index;
     uint8_t compression_algorithm = ctx->global_compress_alg;
-    struct extent_info *extent;
-    struct rrdengine_datafile *datafile;
     /* persistent structures */
     struct rrdeng_df_extent_header *header;
     struct rrdeng_df_extent_trailer *trailer;
     uLong crc;
 
-    if (force) {
-        debug(D_RRDENGINE, "Asynchronous flushing of extent has been forced by page pressure.");
-    }
-    uv_rwlock_wrlock(&pg_cache->committed_page_index.lock);
-    for (Index = 0, count = 0, uncompressed_payload_length = 0,
-         PValue = JudyLFirst(pg_cache->committed_page_index.JudyL_array, &Index, PJE0),
-         descr = unlikely(NULL == PValue) ? NULL : *PValue ;
-
-         descr != NULL && count != pages_per_extent ;
-
-         PValue = JudyLNext(pg_cache->committed_page_index.JudyL_array, &Index, PJE0),
-         descr = unlikely(NULL == PValue) ? NULL : *PValue) {
-        uint8_t page_write_pending;
-
-        fatal_assert(0 != descr->page_length);
-        page_write_pending = 0;
-
-        rrdeng_page_descr_mutex_lock(ctx, descr);
-        pg_cache_descr = descr->pg_cache_descr;
-        if (!(pg_cache_descr->flags & RRD_PAGE_WRITE_PENDING)) {
-            page_write_pending = 1;
-            /* care, no reference being held */
-            pg_cache_descr->flags |= RRD_PAGE_WRITE_PENDING;
-            uncompressed_payload_length += descr->page_length;
-            descr_commit_idx_array[count] = Index;
-            eligible_pages[count++] = descr;
-        }
-        rrdeng_page_descr_mutex_unlock(ctx, descr);
-
-        if (page_write_pending) {
-            ret = JudyLDel(&pg_cache->committed_page_index.JudyL_array, Index, PJE0);
-            fatal_assert(1 == ret);
-        }
-    }
-    uv_rwlock_wrunlock(&pg_cache->committed_page_index.lock);
-
-    if (!count) {
-        debug(D_RRDENGINE, "%s: no pages eligible for flushing.", __func__);
-        if (completion)
-            complete(completion);
-        return 0;
-    }
-    wc->inflight_dirty_pages += count;
-
-    xt_io_descr = mallocz(sizeof(*xt_io_descr));
+    count = xt_io_descr->descr_count;
+    uncompressed_payload_length = xt_io_descr->uncompressed_payload_length;
     payload_offset = sizeof(*header) + count * sizeof(header->descr[0]);
     switch (compression_algorithm) {
     case RRD_NO_COMPRESSION:
         size_bytes = payload_offset + uncompressed_payload_length + sizeof(*trailer);
         break;
+    case RRD_GORILLA:
+        max_compressed_size = RRDENG_GORILLA_COMPRESS_BOUND(uncompressed_payload_length, count);
+        compressed_buf = mallocz(max_compressed_size);
+        size_bytes = payload_offset + max_compressed_size + sizeof(*trailer);
+        break;
     default: /* Compress */
         fatal_assert(uncompressed_payload_length < LZ4_MAX_INPUT_SIZE);
         max_compressed_size = LZ4_compressBound(uncompressed_payload_length);
@@ -735,8 +953,6 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
         fatal("posix_memalign:%s", strerror(ret));
         /* freez(xt_io_descr);*/
     }
-    (void) memcpy(xt_io_descr->descr_array, eligible_pages, sizeof(struct rrdeng_page_descr *) * count);
-    xt_io_descr->descr_count = count;
 
     pos = 0;
     header = xt_io_descr->buf;
@@ -744,19 +960,9 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
     header->number_of_pages = count;
     pos += sizeof(*header);
 
-    extent = mallocz(sizeof(*extent) + count * sizeof(extent->pages[0]));
-    datafile = ctx->datafiles.last;  /* TODO: check for exceeded size quota */
-    extent->offset = datafile->pos;
-    extent->number_of_pages = count;
-    extent->datafile = datafile;
-    extent->next = NULL;
-
     for (i = 0 ; i < count ; ++i) {
-        /* This is here for performance reasons */
-        xt_io_descr->descr_commit_idx_array[i] = descr_commit_idx_array[i];
-
         descr = xt_io_descr->descr_array[i];
-        header->descr[i].type = PAGE_METRICS;
+        header->descr[i].type = ctx->page_type;
         uuid_copy(*(uuid_t *)header->descr[i].uuid, *descr->id);
         header->descr[i].page_length = descr->page_length;
         header->descr[i].start_time = descr->start_time;
@@ -767,22 +973,28 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
         descr = xt_io_descr->descr_array[i];
         /* care, we don't hold the descriptor mutex */
         (void) memcpy(xt_io_descr->buf + pos, descr->pg_cache_descr->page, descr->page_length);
-        descr->extent = extent;
-        extent->pages[i] = descr;
-
         pos += descr->page_length;
     }
-    df_extent_insert(extent);
 
     switch (compression_algorithm) {
     case RRD_NO_COMPRESSION:
         header->payload_length = uncompressed_payload_length;
         break;
+    case RRD_GORILLA:
+        compressed_size = (int)rrdeng_gorilla_compress(header, xt_io_descr->buf + payload_offset, compressed_buf);
+        rrd_stat_atomic_add(&ctx->stats.before_compress_bytes, uncompressed_payload_length);
+        rrd_stat_atomic_add(&ctx->stats.after_compress_bytes, compressed_size);
+        debug(D_RRDENGINE, "Gorilla compressed %"PRIu32" bytes to %d bytes.", uncompressed_payload_length, compressed_size);
+        (void) memcpy(xt_io_descr->buf + payload_offset, compressed_buf, compressed_size);
+        freez(compressed_buf);
+        size_bytes = payload_offset + compressed_size + sizeof(*trailer);
+        header->payload_length = compressed_size;
+        break;
     default: /* Compress */
         compressed_size = LZ4_compress_default(xt_io_descr->buf + payload_offset, compressed_buf,
                                                uncompressed_payload_length, max_compressed_size);
-        ctx->stats.before_compress_bytes += uncompressed_payload_length;
-        ctx->stats.after_compress_bytes += compressed_size;
+        rrd_stat_atomic_add(&ctx->stats.before_compress_bytes, uncompressed_payload_length);
+        rrd_stat_atomic_add(&ctx->stats.after_compress_bytes, compressed_size);
         debug(D_RRDENGINE, "LZ4 compressed %"PRIu32" bytes to %d bytes.", uncompressed_payload_length, compressed_size);
         (void) memcpy(xt_io_descr->buf + payload_offset, compressed_buf, compressed_size);
         freez(compressed_buf);
@@ -790,16 +1002,44 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
         header->payload_length = compressed_size;
         break;
     }
-    extent->size = size_bytes;
     xt_io_descr->bytes = size_bytes;
-    xt_io_descr->pos = datafile->pos;
-    xt_io_descr->req.data = xt_io_descr;
-    xt_io_descr->completion = completion;
 
     trailer = xt_io_descr->buf + size_bytes - sizeof(*trailer);
     crc = crc32(0L, Z_NULL, 0);
     crc = crc32(crc, xt_io_descr->buf, size_bytes - sizeof(*trailer));
     crc32set(trailer->checksum, crc);
+}
+
+/* Runs in the event loop after flush_pages_work_cb(), appends the extent to the last datafile */
+static void flush_pages_after_work_cb(uv_work_t *req, int status)
+{
+    struct extent_io_descriptor *xt_io_descr = req->data;
+    struct rrdengine_worker_config* wc = xt_io_descr->wc;
+    struct rrdengine_instance *ctx = wc->ctx;
+    int ret;
+    unsigned i, count, size_bytes, real_io_size;
+    struct extent_info *extent;
+    struct rrdengine_datafile *datafile;
+
+    fatal_assert(0 == status);
+    count = xt_io_descr->descr_count;
+    size_bytes = xt_io_descr->bytes;
+
+    extent = mallocz(sizeof(*extent) + count * sizeof(extent->pages[0]));
+    datafile = ctx->datafiles.last;  /* TODO: check for exceeded size quota */
+    extent->offset = datafile->pos;
+    extent->number_of_pages = count;
+    extent->datafile = datafile;
+    extent->next = NULL;
+    extent->size = size_bytes;
+    for (i = 0 ; i < count ; ++i) {
+        xt_io_descr->descr_array[i]->extent = extent;
+        extent->pages[i] = xt_io_descr->descr_array[i];
+    }
+    df_extent_insert(extent);
+
+    xt_io_descr->pos = datafile->pos;
+    xt_io_descr->req.data = xt_io_descr;
 
     real_io_size = ALIGN_BYTES_CEILING(size_bytes);
     xt_io_descr->iov = uv_buf_init((void *)xt_io_descr->buf, real_io_size);
@@ -814,7 +1054,93 @@ static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct
     ctx->disk_space += ALIGN_BYTES_CEILING(size_bytes);
     rrdeng_test_quota(wc);
 
-    return ALIGN_BYTES_CEILING(size_bytes);
+    if (!--wc->inflight_flush_work && unlikely(ctx->quiesce != NO_QUIESCE)) {
+        /* let rrdeng_cleanup_finished_threads() finish quiescing */
+        uv_stop(wc->loop);
+    }
+}
+
+/*
+ * completion must be NULL or valid.
+ * Returns 0 when no flushing can take place.
+ * Returns an upper bound of the datafile bytes to be written on successful flushing initiation, the extent is
+ * compressed and written asynchronously.
+ */
+static int do_flush_pages(struct rrdengine_worker_config* wc, int force, struct completion *completion)
+{
+    struct rrdengine_instance *ctx = wc->ctx;
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    int ret;
+    unsigned count;
+    uint32_t uncompressed_payload_length;
+    struct rrdeng_page_descr *descr, *eligible_pages[MAX_PAGES_PER_EXTENT];
+    struct page_cache_descr *pg_cache_descr;
+    struct extent_io_descriptor *xt_io_descr;
+    Word_t descr_commit_idx_array[MAX_PAGES_PER_EXTENT];
+    Pvoid_t *PValue;
+    Word_t Index;
+
+    if (force) {
+        debug(D_RRDENGINE, "Asynchronous flushing of extent has been forced by page pressure.");
+    }
+    uv_rwlock_wrlock(&pg_cache->committed_page_index.lock);
+    for (Index = 0, count = 0, uncompressed_payload_length = 0,
+         PValue = JudyLFirst(pg_cache->committed_page_index.JudyL_array, &Index, PJE0),
+         descr = unlikely(NULL == PValue) ? NULL : *PValue ;
+
+         descr != NULL && count != pages_per_extent ;
+
+         PValue = JudyLNext(pg_cache->committed_page_index.JudyL_array, &Index, PJE0),
+         descr = unlikely(NULL == PValue) ? NULL : *PValue) {
+        uint8_t page_write_pending;
+
+        fatal_assert(0 != descr->page_length);
+        page_write_pending = 0;
+
+        rrdeng_page_descr_mutex_lock(ctx, descr);
+        pg_cache_descr = descr->pg_cache_descr;
+        if (!(pg_cache_descr->flags & RRD_PAGE_WRITE_PENDING)) {
+            page_write_pending = 1;
+            /* care, no reference being held */
+            pg_cache_descr->flags |= RRD_PAGE_WRITE_PENDING;
+            uncompressed_payload_length += descr->page_length;
+            descr_commit_idx_array[count] = Index;
+            eligible_pages[count++] = descr;
+        }
+        rrdeng_page_descr_mutex_unlock(ctx, descr);
+
+        if (page_write_pending) {
+            ret = JudyLDel(&pg_cache->committed_page_index.JudyL_array, Index, PJE0);
+            fatal_assert(1 == ret);
+        }
+    }
+    uv_rwlock_wrunlock(&pg_cache->committed_page_index.lock);
+
+    if (!count) {
+        debug(D_RRDENGINE, "%s: no pages eligible for flushing.", __func__);
+        if (completion)
+            complete(completion);
+        return 0;
+    }
+    wc->inflight_dirty_pages += count;
+
+    xt_io_descr = callocz(1, sizeof(*xt_io_descr));
+    (void) memcpy(xt_io_descr->descr_array, eligible_pages, sizeof(struct rrdeng_page_descr *) * count);
+    (void) memcpy(xt_io_descr->descr_commit_idx_array, descr_commit_idx_array, sizeof(Word_t) * count);
+    xt_io_descr->descr_count = count;
+    xt_io_descr->uncompressed_payload_length = uncompressed_payload_length;
+    xt_io_descr->completion = completion;
+    xt_io_descr->wc = wc;
+    xt_io_descr->work_req.data = xt_io_descr;
+
+    ++wc->inflight_flush_work;
+    ret = uv_queue_work(wc->loop, &xt_io_descr->work_req, flush_pages_work_cb, flush_pages_after_work_cb);
+    fatal_assert(-1 != ret);
+
+    /* the extent has not been compressed yet, this is an upper bound of its size */
+    return ALIGN_BYTES_CEILING(sizeof(struct rrdeng_df_extent_header) +
+                               count * sizeof(struct rrdeng_extent_page_descr) +
+                               uncompressed_payload_length + sizeof(struct rrdeng_df_extent_trailer));
 }
 
 static void after_delete_old_data(struct rrdengine_worker_config* wc)
@@ -885,10 +1211,11 @@ static void delete_old_data(void *arg)
         for (i = 0 ; i < count ; ++i) {
             descr = extent->pages[i];
             can_delete_metric = pg_cache_punch_hole(ctx, descr, 0, 0, &metric_id);
-            if (unlikely(can_delete_metric && ctx->metalog_ctx->initialized)) {
+            if (unlikely(can_delete_metric && ctx->metalog_ctx->initialized &&
+                         !rrdeng_metric_in_other_tiers(ctx, &metric_id))) {
                 /*
-                 * If the metric is empty, has no active writers and if the metadata log has been initialized then
-                 * attempt to delete the corresponding netdata dimension.
+                 * If the metric is empty in all storage tiers, has no active writers and if the metadata log has been
+                 * initialized then attempt to delete the corresponding netdata dimension.
                  */
                 metalog_delete_dimension_by_uuid(ctx->metalog_ctx, &metric_id);
             }
@@ -923,7 +1250,7 @@ void rrdeng_test_quota(struct rrdengine_worker_config* wc)
     if (unlikely(current_size >= target_size || (out_of_space && only_one_datafile))) {
         /* Finalize data and journal file and create a new pair */
         wal_flush_transaction_buffer(wc);
-        ret = create_new_datafile_pair(ctx, 1, ctx->last_fileno + 1);
+        ret = create_new_datafile_pair(ctx, RRDENG_DATAFILE_TIER(ctx), ctx->last_fileno + 1);
         if (likely(!ret)) {
             ++ctx->last_fileno;
         }
@@ -956,7 +1283,7 @@ void rrdeng_test_quota(struct rrdengine_worker_config* wc)
 
 static inline int rrdeng_threads_alive(struct rrdengine_worker_config* wc)
 {
-    if (wc->now_invalidating_dirty_pages || wc->now_deleting_files) {
+    if (wc->now_invalidating_dirty_pages || wc->now_deleting_files || wc->inflight_flush_work) {
         return 1;
     }
     return 0;
@@ -973,6 +1300,8 @@ static void rrdeng_cleanup_finished_threads(struct rrdengine_worker_config* wc)
         after_delete_old_data(wc);
     }
     if (unlikely(SET_QUIESCE == ctx->quiesce && !rrdeng_threads_alive(wc))) {
+        /* the extents compressed after the quiesce command have committed transactions */
+        wal_flush_transaction_buffer(wc);
         ctx->quiesce = QUIESCED;
         complete(&ctx->rrdengine_completion);
     }
@@ -989,29 +1318,72 @@ void finalize_rrd_files(struct rrdengine_instance *ctx)
     return finalize_data_files(ctx);
 }
 
+/*
+ * The order in which the command queues are served. Reads are served first so that queries do not wait behind
+ * flushing, shutting down is served last so that it happens after every queued command.
+ */
+static const enum rrdeng_opcode cmd_queue_priority[] = {
+    RRDENG_READ_PAGE,
+    RRDENG_READ_EXTENT,
+    RRDENG_INVALIDATE_OLDEST_MEMORY_PAGE,
+    RRDENG_FLUSH_PAGES,
+    RRDENG_COMMIT_PAGE,
+    RRDENG_QUIESCE,
+    RRDENG_SHUTDOWN
+};
+#define CMD_QUEUE_PRIORITIES (sizeof(cmd_queue_priority) / sizeof(cmd_queue_priority[0]))
+/* the first entry of cmd_queue_priority[] that is not a read */
+#define CMD_QUEUE_PRIORITY_FIRST_NON_READ (2)
+
+static inline int is_read_opcode(enum rrdeng_opcode opcode)
+{
+    return RRDENG_READ_PAGE == opcode || RRDENG_READ_EXTENT == opcode;
+}
+
 void rrdeng_init_cmd_queue(struct rrdengine_worker_config* wc)
 {
-    wc->cmd_queue.head = wc->cmd_queue.tail = 0;
+    unsigned i;
+
+    for (i = 0 ; i < RRDENG_MAX_OPCODE ; ++i) {
+        struct rrdeng_cmdqueue *cmd_queue = &wc->cmd_queues[i];
+
+        cmd_queue->head = cmd_queue->tail = cmd_queue->size = 0;
+        cmd_queue->max_size = is_read_opcode(i) ? RRDENG_CMD_Q_MAX_SIZE : RRDENG_CTRL_CMD_Q_MAX_SIZE;
+        cmd_queue->cmd_array = mallocz(sizeof(*cmd_queue->cmd_array) * cmd_queue->max_size);
+    }
+    memset(wc->cmd_stats, 0, sizeof(wc->cmd_stats));
+    wc->consecutive_read_cmds = 0;
     wc->queue_size = 0;
     fatal_assert(0 == uv_cond_init(&wc->cmd_cond));
     fatal_assert(0 == uv_mutex_init(&wc->cmd_mutex));
 }
 
+static void rrdeng_free_cmd_queue(struct rrdengine_worker_config* wc)
+{
+    unsigned i;
+
+    for (i = 0 ; i < RRDENG_MAX_OPCODE ; ++i)
+        freez(wc->cmd_queues[i].cmd_array);
+}
+
 void rrdeng_enq_cmd(struct rrdengine_worker_config* wc, struct rrdeng_cmd *cmd)
 {
-    unsigned queue_size;
+    struct rrdeng_cmdqueue *cmd_queue;
+
+    fatal_assert(cmd->opcode < RRDENG_MAX_OPCODE);
+    cmd_queue = &wc->cmd_queues[cmd->opcode];
+    cmd->enqueue_time = now_monotonic_usec();
 
     /* wait for free space in queue */
     uv_mutex_lock(&wc->cmd_mutex);
-    while ((queue_size = wc->queue_size) == RRDENG_CMD_Q_MAX_SIZE) {
+    while (cmd_queue->size == cmd_queue->max_size) {
         uv_cond_wait(&wc->cmd_cond, &wc->cmd_mutex);
     }
-    fatal_assert(queue_size < RRDENG_CMD_Q_MAX_SIZE);
     /* enqueue command */
-    wc->cmd_queue.cmd_array[wc->cmd_queue.tail] = *cmd;
-    wc->cmd_queue.tail = wc->cmd_queue.tail != RRDENG_CMD_Q_MAX_SIZE - 1 ?
-                         wc->cmd_queue.tail + 1 : 0;
-    wc->queue_size = queue_size + 1;
+    cmd_queue->cmd_array[cmd_queue->tail] = *cmd;
+    cmd_queue->tail = cmd_queue->tail != cmd_queue->max_size - 1 ? cmd_queue->tail + 1 : 0;
+    ++cmd_queue->size;
+    ++wc->queue_size;
     uv_mutex_unlock(&wc->cmd_mutex);
 
     /* wake up event loop */
@@ -1021,28 +1393,55 @@ void rrdeng_enq_cmd(struct rrdengine_worker_config* wc, struct rrdeng_cmd *cmd)
 struct rrdeng_cmd rrdeng_deq_cmd(struct rrdengine_worker_config* wc)
 {
     struct rrdeng_cmd ret;
-    unsigned queue_size;
+    struct rrdeng_cmdqueue *cmd_queue = NULL;
+    unsigned i, first;
 
     uv_mutex_lock(&wc->cmd_mutex);
-    queue_size = wc->queue_size;
-    if (queue_size == 0) {
+    if (wc->queue_size == 0) {
         ret.opcode = RRDENG_NOOP;
     } else {
+        /* do not let a burst of reads starve flushing forever */
+        first = 0;
+        if (wc->consecutive_read_cmds >= RRDENG_MAX_CONSECUTIVE_READ_CMDS) {
+            wc->consecutive_read_cmds = 0;
+            for (i = CMD_QUEUE_PRIORITY_FIRST_NON_READ ; i < CMD_QUEUE_PRIORITIES ; ++i) {
+                if (wc->cmd_queues[cmd_queue_priority[i]].size) {
+                    first = CMD_QUEUE_PRIORITY_FIRST_NON_READ;
+                    break;
+                }
+            }
+        }
+        for (i = first ; i < CMD_QUEUE_PRIORITIES ; ++i) {
+            cmd_queue = &wc->cmd_queues[cmd_queue_priority[i]];
+            if (cmd_queue->size)
+                break;
+        }
+        fatal_assert(i < CMD_QUEUE_PRIORITIES);
+
         /* dequeue command */
-        ret = wc->cmd_queue.cmd_array[wc->cmd_queue.head];
-        if (queue_size == 1) {
-            wc->cmd_queue.head = wc->cmd_queue.tail = 0;
+        ret = cmd_queue->cmd_array[cmd_queue->head];
+        if (cmd_queue->size == 1) {
+            cmd_queue->head = cmd_queue->tail = 0;
         } else {
-            wc->cmd_queue.head = wc->cmd_queue.head != RRDENG_CMD_Q_MAX_SIZE - 1 ?
-                                 wc->cmd_queue.head + 1 : 0;
+            cmd_queue->head = cmd_queue->head != cmd_queue->max_size - 1 ? cmd_queue->head + 1 : 0;
         }
-        wc->queue_size = queue_size - 1;
-
-        /* wake up producers */
-        uv_cond_signal(&wc->cmd_cond);
+        --cmd_queue->size;
+        --wc->queue_size;
+        if (is_read_opcode(ret.opcode))
+            ++wc->consecutive_read_cmds;
+        else
+            wc->consecutive_read_cmds = 0;
+
+        /* wake up producers, they may be waiting for any of the queues */
+        uv_cond_broadcast(&wc->cmd_cond);
     }
     uv_mutex_unlock(&wc->cmd_mutex);
 
+    if (RRDENG_NOOP != ret.opcode) {
+        wc->cmd_stats[ret.opcode].dispatched++;
+        wc->cmd_stats[ret.opcode].latency_usec += now_monotonic_usec() - ret.enqueue_time;
+    }
+
     return ret;
 }
 
@@ -1159,6 +1558,7 @@ void rrdeng_worker(void* arg)
     wc->now_invalidating_dirty_pages = NULL;
     wc->cleanup_thread_invalidating_dirty_pages = 0;
     wc->inflight_dirty_pages = 0;
+    wc->inflight_flush_work = 0;
 
     /* dirty page flushing timer */
     ret = uv_timer_init(loop, &timer_req);
@@ -1254,6 +1654,8 @@ void rrdeng_worker(void* arg)
     while (do_flush_pages(wc, 1, NULL)) {
         ; /* Force flushing of all committed pages. */
     }
+    /* wait for the extents to be compressed and written, then write their transactions */
+    uv_run(loop, UV_RUN_DEFAULT);
     wal_flush_transaction_buffer(wc);
     uv_run(loop, UV_RUN_DEFAULT);
 
@@ -1261,6 +1663,7 @@ void rrdeng_worker(void* arg)
     /* TODO: don't let the API block by waiting to enqueue commands */
     uv_cond_destroy(&wc->cmd_cond);
 /*  uv_mutex_destroy(&wc->cmd_mutex); */
+    rrdeng_free_cmd_queue(wc);
     fatal_assert(0 == uv_loop_close(loop));
     freez(loop);
 
@@ -1272,6 +1675,7 @@ void rrdeng_worker(void* arg)
     fatal_assert(0 == uv_loop_close(loop));
 error_after_loop_init:
     freez(loop);
+    rrdeng_free_cmd_queue(wc);
 
     wc->error = UV_EAGAIN;
     /* wake up initialization thread */
@@ -21,6 +21,7 @@
 #include "rrdengineapi.h"
 #include "pagecache.h"
 #include "rrdenglocking.h"
+#include "rrdengcompression.h"
 
 #ifdef NETDATA_RRD_INTERNALS
 
@@ -67,6 +68,7 @@ struct rrdeng_read_extent {
 
 struct rrdeng_cmd {
     enum rrdeng_opcode opcode;
+    usec_t enqueue_time; /* monotonic time the command was enqueued, to measure queueing latency */
     union {
         struct rrdeng_read_page read_page;
         struct rrdeng_read_extent read_extent;
@@ -74,15 +76,36 @@ struct rrdeng_cmd {
     };
 };
 
-#define RRDENG_CMD_Q_MAX_SIZE (2048)
+/* maximum number of queued commands of each read opcode */
+#define RRDENG_CMD_Q_MAX_SIZE (1024)
+/* maximum number of queued commands of each other opcode */
+#define RRDENG_CTRL_CMD_Q_MAX_SIZE (128)
+/* number of read commands served in a row before serving a pending command of another opcode */
+#define RRDENG_MAX_CONSECUTIVE_READ_CMDS (16)
 
+/* FIFO of the commands of an opcode */
 struct rrdeng_cmdqueue {
     unsigned head, tail;
-    struct rrdeng_cmd cmd_array[RRDENG_CMD_Q_MAX_SIZE];
+    unsigned size, max_size;
+    struct rrdeng_cmd *cmd_array;
 };
 
+/* Command queueing statistics of an opcode */
+struct rrdeng_cmd_statistics {
+    rrdeng_stats_t dispatched; /* number of dequeued commands */
+    rrdeng_stats_t latency_usec; /* total time dequeued commands spent queued */
+};
+
+struct extent_cache_element;
+
 struct extent_io_descriptor {
     uv_fs_t req;
+    uv_work_t work_req; /* checksums and (de)compression run in the libuv thread pool */
+    struct rrdengine_worker_config *wc;
+    uv_file file;
+    int have_read_error;
+    void *uncompressed_buf; /* decompressed payload of a read extent, NULL if not compressed */
+    uint32_t uncompressed_payload_length;
     uv_buf_t iov;
     void *buf;
     uint64_t pos;
@@ -93,6 +116,7 @@ struct extent_io_descriptor {
     struct rrdeng_page_descr *descr_array[MAX_PAGES_PER_EXTENT];
     Word_t descr_commit_idx_array[MAX_PAGES_PER_EXTENT];
     struct extent_io_descriptor *next; /* multiple requests to be served by the same cached extent */
+    struct extent_cache_element *xt_cache_elem; /* extent cache element reserved for the extent being read */
 };
 
 struct generic_io_descriptor {
@@ -104,25 +128,55 @@ struct generic_io_descriptor {
     struct completion *completion;
 };
 
-struct extent_cache_element {
+/* The extent cache is shared by all instances, an extent is identified by its instance, address and datafile */
+struct extent_cache_key {
+    struct rrdengine_instance *ctx;
     struct extent_info *extent; /* The ABA problem is avoided with the help of fileno below */
     unsigned fileno;
-    struct extent_cache_element *prev; /* LRU */
-    struct extent_cache_element *next; /* LRU */
+};
+
+/* the replacement queues of the 2Q policy */
+typedef enum {
+    XT_CACHE_A1IN = 0,  /* FIFO of extents read once */
+    XT_CACHE_AM,        /* LRU of extents read again while cached or soon after leaving A1in */
+    XT_CACHE_A1OUT,     /* FIFO of the keys of the extents that recently left A1in, they hold no pages */
+    XT_CACHE_QUEUES
+} xt_cache_queue_t;
+
+struct extent_cache_element {
+    struct extent_cache_key key;
+    xt_cache_queue_t queue;
+    uint8_t inflight; /* the extent is being read, its pages are not populated yet */
+    unsigned refcnt; /* readers copying pages out of it, it cannot be evicted while referenced */
+    struct extent_cache_element *prev;
+    struct extent_cache_element *next;
     struct extent_io_descriptor *inflight_io_descr; /* I/O descriptor for in-flight extent */
-    uint8_t pages[MAX_PAGES_PER_EXTENT * RRDENG_BLOCK_SIZE];
+    uint32_t size; /* uncompressed size of the pages of the extent */
+    void *pages;
 };
 
-#define MAX_CACHED_EXTENTS 16 /* cannot be over 32 to fit in 32-bit architectures */
+struct extent_cache_queue {
+    struct extent_cache_element *head; /* oldest or LRU */
+    struct extent_cache_element *tail; /* newest or MRU */
+    size_t bytes;
+    unsigned count;
+};
 
-/* Initialize by setting the structure to zero */
-struct extent_cache {
-    struct extent_cache_element extent_array[MAX_CACHED_EXTENTS];
-    unsigned allocation_bitmap; /* 1 if the corresponding position in the extent_array is allocated */
-    unsigned inflight_bitmap; /* 1 if the corresponding position in the extent_array is waiting for I/O */
+struct extent_cache_shard {
+    uv_mutex_t lock;
+    Pvoid_t JudyHS_array; /* extent_cache_key to extent_cache_element */
+    struct extent_cache_queue queues[XT_CACHE_QUEUES];
+    size_t max_bytes;
+};
+
+#define XT_CACHE_SHARDS (16)
+/* percentage of the bytes of a shard that extents read once can take */
+#define XT_CACHE_A1IN_PERCENT (25)
+/* maximum number of keys of evicted extents remembered by each shard */
+#define XT_CACHE_A1OUT_MAX (256)
 
-    struct extent_cache_element *replaceQ_head; /* LRU */
-    struct extent_cache_element *replaceQ_tail; /* MRU */
+struct extent_cache {
+    struct extent_cache_shard shards[XT_CACHE_SHARDS];
 };
 
 struct rrdengine_worker_config {
@@ -141,14 +195,16 @@ struct rrdengine_worker_config {
     /* set to 0 when now_invalidating_dirty_pages is still running */
     unsigned long cleanup_thread_invalidating_dirty_pages;
     unsigned inflight_dirty_pages;
+    /* extents being compressed in the thread pool, only accessed by the event loop */
+    unsigned inflight_flush_work;
 
-    /* FIFO command queue */
+    /* FIFO command queues, one per opcode */
     uv_mutex_t cmd_mutex;
     uv_cond_t cmd_cond;
     volatile unsigned queue_size;
-    struct rrdeng_cmdqueue cmd_queue;
-
-    struct extent_cache xt_cache;
+    struct rrdeng_cmdqueue cmd_queues[RRDENG_MAX_OPCODE];
+    unsigned consecutive_read_cmds;
+    struct rrdeng_cmd_statistics cmd_stats[RRDENG_MAX_OPCODE];
 
     int error;
 };
@@ -187,6 +243,9 @@ struct rrdengine_statistics {
     rrdeng_stats_t fs_errors;
     rrdeng_stats_t pg_cache_over_half_dirty_events;
     rrdeng_stats_t flushing_pressure_page_deletions;
+    rrdeng_stats_t xt_cache_hits;
+    rrdeng_stats_t xt_cache_misses;
+    rrdeng_stats_t xt_cache_evictions;
 };
 
 /* I/O errors global counter */
@@ -224,9 +283,21 @@ struct rrdengine_instance {
 
     uint8_t quiesce; /* set to SET_QUIESCE before shutdown of the engine */
 
+    uint8_t tier; /* 0 for the collected points, > 0 for rollups of the tier below */
+    uint8_t page_type; /* PAGE_METRICS for tier 0, PAGE_TIER otherwise */
+    unsigned tier_grouping; /* number of tier 0 points rolled up in each point of this tier */
+    struct rrdengine_instance *tier_ctx[RRD_STORAGE_TIERS]; /* all tiers of this instance, NULL if disabled */
+
     struct rrdengine_statistics stats;
 };
 
+/* size of each point of the pages of an instance */
+#define RRDENG_PAGE_POINT_SIZE(ctx) ((ctx)->tier ? sizeof(struct rrdeng_tier_point) : sizeof(storage_number))
+/* the value of the superblock tier and of the tier of the file names of the data files of an instance */
+#define RRDENG_DATAFILE_TIER(ctx) ((unsigned)(ctx)->tier + 1)
+
+extern void init_xt_cache(void);
+extern void xt_cache_delete_instance(struct rrdengine_instance *ctx);
 extern int init_rrd_files(struct rrdengine_instance *ctx);
 extern void finalize_rrd_files(struct rrdengine_instance *ctx);
 extern void rrdeng_test_quota(struct rrdengine_worker_config* wc);
@@ -7,14 +7,92 @@ struct rrdengine_instance multidb_ctx;
 int default_rrdeng_page_cache_mb = 32;
 int default_rrdeng_disk_quota_mb = 256;
 int default_multidb_disk_quota_mb = 256;
+/* Size of the libuv thread pool that reads, compresses and decompresses extents, 0 to keep the libuv default */
+int default_rrdeng_worker_threads = 0;
+int default_rrdeng_extent_cache_mb = RRDENG_DEFAULT_EXTENT_CACHE_SIZE_MB;
+uint8_t default_rrdeng_compression_algorithm = RRD_LZ4;
+/* Number of storage tiers of the multihost database, tier 0 keeps the collected points */
+int default_rrdeng_storage_tiers = RRD_STORAGE_TIERS;
+/* Number of points of the tier below that are rolled up in each point of a tier, tier 0 is always 1 */
+int default_rrdeng_tier_grouping[RRD_STORAGE_TIERS] = { 1, 60, 60 };
+/* Disk quota of the tiers above 0 of the multihost database, tier 0 uses default_multidb_disk_quota_mb */
+int default_multidb_tier_disk_quota_mb[RRD_STORAGE_TIERS] = { 256, 256, 256 };
+/* Page cache size of the tiers above 0 of the multihost database, tier 0 uses default_rrdeng_page_cache_mb */
+int default_rrdeng_tier_page_cache_mb[RRD_STORAGE_TIERS] = { 32, RRDENG_MIN_PAGE_CACHE_SIZE_MB, RRDENG_MIN_PAGE_CACHE_SIZE_MB };
 /* Default behaviour is to unblock data collection if the page cache is full of dirty pages by dropping metrics */
 uint8_t rrdeng_drop_metrics_under_page_cache_pressure = 1;
+/* Use the legacy LRU replacement policy in the page cache of new instances instead of 2Q, to compare them */
+uint8_t rrdeng_page_cache_lru = 0;
 
 static inline struct rrdengine_instance *get_rrdeng_ctx_from_host(RRDHOST *host)
 {
     return host->rrdeng_ctx;
 }
 
+/* Returns the page index of a metric in the instance of a tier, NULL if the instance has no pages of it */
+static struct pg_cache_page_index *get_page_index(struct rrdengine_instance *ctx, uuid_t *id)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct pg_cache_page_index *page_index = NULL;
+    Pvoid_t *PValue;
+
+    uv_rwlock_rdlock(&pg_cache->metrics_index.lock);
+    PValue = JudyHSGet(pg_cache->metrics_index.JudyHS_array, id, sizeof(uuid_t));
+    if (likely(NULL != PValue))
+        page_index = *PValue;
+    uv_rwlock_rdunlock(&pg_cache->metrics_index.lock);
+
+    return page_index;
+}
+
+/* Returns the page index of a metric in the instance of a tier, creating it if it does not exist */
+static struct pg_cache_page_index *get_or_create_page_index(struct rrdengine_instance *ctx, uuid_t *id)
+{
+    struct page_cache *pg_cache = &ctx->pg_cache;
+    struct pg_cache_page_index *page_index;
+    Pvoid_t *PValue;
+
+    page_index = get_page_index(ctx, id);
+    if (likely(NULL != page_index))
+        return page_index;
+
+    uv_rwlock_wrlock(&pg_cache->metrics_index.lock);
+    PValue = JudyHSIns(&pg_cache->metrics_index.JudyHS_array, id, sizeof(uuid_t), PJE0);
+    if (NULL == *PValue) {
+        *PValue = page_index = create_page_index(id);
+        page_index->prev = pg_cache->metrics_index.last_page_index;
+        pg_cache->metrics_index.last_page_index = page_index;
+    } else {
+        /* another thread created it in the meantime */
+        page_index = *PValue;
+    }
+    uv_rwlock_wrunlock(&pg_cache->metrics_index.lock);
+
+    return page_index;
+}
+
+/*
+ * Returns 1 if any tier of the instance other than ctx still has pages of the metric, 0 otherwise.
+ * Rotation must not delete the dimension of such a metric, since its rollups are still queryable.
+ */
+int rrdeng_metric_in_other_tiers(struct rrdengine_instance *ctx, uuid_t *metric_id)
+{
+    struct pg_cache_page_index *page_index;
+    int tier, ret = 0;
+
+    for (tier = 0 ; tier < RRD_STORAGE_TIERS && !ret ; ++tier) {
+        if (NULL == ctx->tier_ctx[tier] || ctx->tier_ctx[tier] == ctx)
+            continue;
+        page_index = get_page_index(ctx->tier_ctx[tier], metric_id);
+        if (NULL == page_index)
+            continue;
+        uv_rwlock_rdlock(&page_index->lock);
+        ret = page_index->writers || page_index->page_count;
+        uv_rwlock_rdunlock(&page_index->lock);
+    }
+    return ret;
+}
+
 /* This UUID is not unique across hosts */
 void rrdeng_generate_legacy_uuid(const char *dim_id, char *chart_id, uuid_t *ret_uuid)
 {
@@ -144,25 +222,183 @@ void rrdeng_store_metric_init(RRDDIM *rd)
     uv_rwlock_wrlock(&page_index->lock);
     ++page_index->writers;
     uv_rwlock_wrunlock(&page_index->lock);
+
+    for (int tier = 1 ; tier < RRD_STORAGE_TIERS ; ++tier) {
+        struct rrdeng_tier_collect_handle *tier_handle = &handle->tiers[tier - 1];
+
+        memset(tier_handle, 0, sizeof(*tier_handle));
+        if (NULL == ctx || NULL == ctx->tier_ctx[tier])
+            continue;
+
+        tier_handle->page_index = page_index = get_or_create_page_index(ctx->tier_ctx[tier], rd->state->rrdeng_uuid);
+        uv_rwlock_wrlock(&page_index->lock);
+        ++page_index->writers;
+        uv_rwlock_wrunlock(&page_index->lock);
+    }
 }
 
 /* The page must be populated and referenced */
-static int page_has_only_empty_metrics(struct rrdeng_page_descr *descr)
+static int page_has_only_empty_metrics(struct rrdengine_instance *ctx, struct rrdeng_page_descr *descr)
 {
     unsigned i;
     uint8_t has_only_empty_metrics = 1;
-    storage_number *page;
 
-    page = descr->pg_cache_descr->page;
-    for (i = 0 ; i < descr->page_length / sizeof(storage_number); ++i) {
-        if (SN_EMPTY_SLOT != page[i]) {
-            has_only_empty_metrics = 0;
-            break;
+    if (ctx->tier) {
+        struct rrdeng_tier_point *points = descr->pg_cache_descr->page;
+
+        for (i = 0 ; i < descr->page_length / sizeof(*points); ++i) {
+            if (points[i].count) {
+                has_only_empty_metrics = 0;
+                break;
+            }
+        }
+    } else {
+        storage_number *page = descr->pg_cache_descr->page;
+
+        for (i = 0 ; i < descr->page_length / sizeof(storage_number); ++i) {
+            if (SN_EMPTY_SLOT != page[i]) {
+                has_only_empty_metrics = 0;
+                break;
+            }
         }
     }
     return has_only_empty_metrics;
 }
 
+/* Accounts for a new page being collected in the metric producer statistics */
+static void rrdeng_add_metric_producer(struct rrdengine_instance *ctx)
+{
+    unsigned long new_metric_API_producers, old_metric_API_max_producers, ret_metric_API_max_producers;
+
+    new_metric_API_producers = rrd_atomic_add_fetch(&ctx->stats.metric_API_producers, 1);
+    while (unlikely(new_metric_API_producers > (old_metric_API_max_producers = ctx->metric_API_max_producers))) {
+        /* Increase ctx->metric_API_max_producers */
+        ret_metric_API_max_producers = ulong_compare_and_swap(&ctx->metric_API_max_producers,
+                                                              old_metric_API_max_producers,
+                                                              new_metric_API_producers);
+        if (old_metric_API_max_producers == ret_metric_API_max_producers) {
+            /* success */
+            break;
+        }
+    }
+}
+
+static void rrdeng_store_tier_flush_current_page(struct rrdengine_instance *ctx,
+                                                 struct rrdeng_tier_collect_handle *tier_handle)
+{
+    struct rrdeng_page_descr *descr = tier_handle->descr;
+
+    if (unlikely(NULL == descr))
+        return;
+
+    if (likely(descr->page_length)) {
+        rrd_stat_atomic_add(&ctx->stats.metric_API_producers, -1);
+
+        if (page_has_only_empty_metrics(ctx, descr)) {
+            debug(D_RRDENGINE, "Tier page has empty metrics only, deleting:");
+            if (unlikely(debug_flags & D_RRDENGINE))
+                print_page_cache_descr(descr);
+            pg_cache_put(ctx, descr);
+            pg_cache_punch_hole(ctx, descr, 1, 0, NULL);
+        } else {
+            rrdeng_commit_page(ctx, descr, tier_handle->page_correlation_id);
+        }
+    } else {
+        freez(descr->pg_cache_descr->page);
+        rrdeng_destroy_pg_cache_descr(ctx, descr->pg_cache_descr);
+        freez(descr);
+    }
+    tier_handle->descr = NULL;
+}
+
+/* Appends a rolled up point to the page of a tier, the points of a page are always update_every apart */
+static void rrdeng_store_tier_point(struct rrdengine_instance *ctx, struct rrdeng_tier_collect_handle *tier_handle,
+                                    usec_t point_in_time, struct rrdeng_tier_point *point)
+{
+    struct rrdeng_page_descr *descr = tier_handle->descr;
+    void *page;
+
+    if (unlikely(NULL == descr || descr->page_length + sizeof(*point) > RRDENG_BLOCK_SIZE)) {
+        rrdeng_store_tier_flush_current_page(ctx, tier_handle);
+
+        page = rrdeng_create_page(ctx, &tier_handle->page_index->id, &descr);
+        fatal_assert(page);
+
+        tier_handle->descr = descr;
+        tier_handle->page_correlation_id =
+            rrd_atomic_fetch_add(&ctx->pg_cache.committed_page_index.latest_corr_id, 1);
+    }
+    page = descr->pg_cache_descr->page;
+    memcpy((uint8_t *)page + descr->page_length, point, sizeof(*point));
+    pg_cache_atomic_set_pg_info(descr, point_in_time, descr->page_length + sizeof(*point));
+
+    if (unlikely(INVALID_TIME == descr->start_time)) {
+        descr->start_time = point_in_time;
+        rrdeng_add_metric_producer(ctx);
+        pg_cache_insert(ctx, tier_handle->page_index, descr);
+    } else {
+        pg_cache_add_new_metric_time(tier_handle->page_index, descr);
+    }
+}
+
+/*
+ * Adds the rollups of a point of the tier below to the interval of a tier being rolled up. When the point belongs to
+ * a later interval, the previous interval is stored as a point of the tier and it is rolled up to the tier above.
+ */
+static void rrdeng_store_tier_next(RRDDIM *rd, int tier, time_t now, calculated_number sum,
+                                   calculated_number min, calculated_number max, uint32_t count)
+{
+    struct rrdeng_collect_handle *handle = &rd->state->handle.rrdeng;
+    struct rrdeng_tier_collect_handle *tier_handle;
+    struct rrdengine_instance *ctx;
+    time_t step, interval_end;
+
+    if (tier >= RRD_STORAGE_TIERS || NULL == (ctx = handle->ctx->tier_ctx[tier]))
+        return;
+    tier_handle = &handle->tiers[tier - 1];
+
+    step = (time_t)rd->update_every * ctx->tier_grouping;
+    interval_end = (now + step - 1) / step * step;
+
+    if (tier_handle->interval_end != interval_end) {
+        if (unlikely(interval_end < tier_handle->interval_end)) {
+            /* out of order point, the interval it belongs to has already been stored */
+            return;
+        }
+        if (likely(tier_handle->interval_end)) {
+            struct rrdeng_tier_point point;
+
+            point.sum = (double)tier_handle->sum;
+            point.min = (float)tier_handle->min;
+            point.max = (float)tier_handle->max;
+            point.count = tier_handle->count;
+            rrdeng_store_tier_point(ctx, tier_handle, tier_handle->interval_end * USEC_PER_SEC, &point);
+
+            rrdeng_store_tier_next(rd, tier + 1, tier_handle->interval_end, tier_handle->sum, tier_handle->min,
+                                   tier_handle->max, tier_handle->count);
+
+            if (unlikely(interval_end - tier_handle->interval_end > step)) {
+                /* collection stopped for whole intervals, start a new page so that points stay step apart */
+                rrdeng_store_tier_flush_current_page(ctx, tier_handle);
+            }
+        }
+        tier_handle->interval_end = interval_end;
+        tier_handle->sum = 0;
+        tier_handle->min = NAN;
+        tier_handle->max = NAN;
+        tier_handle->count = 0;
+    }
+
+    if (likely(count)) {
+        if (!tier_handle->count || min < tier_handle->min)
+            tier_handle->min = min;
+        if (!tier_handle->count || max > tier_handle->max)
+            tier_handle->max = max;
+        tier_handle->sum += sum;
+        tier_handle->count += count;
+    }
+}
+
 void rrdeng_store_metric_flush_current_page(RRDDIM *rd)
 {
     struct rrdeng_collect_handle *handle;
@@ -186,7 +422,7 @@ void rrdeng_store_metric_flush_current_page(RRDDIM *rd)
             /* unpin old second page */
             pg_cache_put(ctx, handle->prev_descr);
         }
-        page_is_empty = page_has_only_empty_metrics(descr);
+        page_is_empty = page_has_only_empty_metrics(ctx, descr);
         if (page_is_empty) {
             debug(D_RRDENGINE, "Page has empty metrics only, deleting:");
             if (unlikely(debug_flags & D_RRDENGINE))
@@ -276,25 +512,23 @@ void rrdeng_store_metric_next(RRDDIM *rd, usec_t point_in_time, storage_number n
     if (perfect_page_alignment)
         rd->rrdset->rrddim_page_alignment = descr->page_length;
     if (unlikely(INVALID_TIME == descr->start_time)) {
-        unsigned long new_metric_API_producers, old_metric_API_max_producers, ret_metric_API_max_producers;
         descr->start_time = point_in_time;
-
-        new_metric_API_producers = rrd_atomic_add_fetch(&ctx->stats.metric_API_producers, 1);
-        while (unlikely(new_metric_API_producers > (old_metric_API_max_producers = ctx->metric_API_max_producers))) {
-            /* Increase ctx->metric_API_max_producers */
-            ret_metric_API_max_producers = ulong_compare_and_swap(&ctx->metric_API_max_producers,
-                                                                  old_metric_API_max_producers,
-                                                                  new_metric_API_producers);
-            if (old_metric_API_max_producers == ret_metric_API_max_producers) {
-                /* success */
-                break;
-            }
-        }
-
+        rrdeng_add_metric_producer(ctx);
         pg_cache_insert(ctx, rd->state->page_index, descr);
     } else {
         pg_cache_add_new_metric_time(rd->state->page_index, descr);
     }
+
+    if (ctx->tier_ctx[1]) {
+        calculated_number value = NAN;
+        uint32_t count = 0;
+
+        if (likely(does_storage_number_exist(number))) {
+            value = unpack_storage_number(number);
+            count = 1;
+        }
+        rrdeng_store_tier_next(rd, 1, (time_t)(point_in_time / USEC_PER_SEC), value, value, value, count);
+    }
 }
 
 /*
@@ -322,6 +556,20 @@ int rrdeng_store_metric_finalize(RRDDIM *rd)
     }
     uv_rwlock_wrunlock(&page_index->lock);
 
+    /* the interval being rolled up is incomplete, it is dropped */
+    for (int tier = 1 ; tier < RRD_STORAGE_TIERS ; ++tier) {
+        struct rrdeng_tier_collect_handle *tier_handle = &handle->tiers[tier - 1];
+
+        if (NULL == (page_index = tier_handle->page_index))
+            continue;
+        rrdeng_store_tier_flush_current_page(ctx->tier_ctx[tier], tier_handle);
+        uv_rwlock_wrlock(&page_index->lock);
+        if (--page_index->writers || page_index->page_count)
+            can_delete_metric = 0;
+        uv_rwlock_wrunlock(&page_index->lock);
+        tier_handle->page_index = NULL;
+    }
+
    return can_delete_metric;
 }
 
@@ -534,12 +782,29 @@ unsigned rrdeng_variable_step_boundaries(RRDSET *st, time_t start_time, time_t e
  * The handle must be released with rrdeng_load_metric_final().
  */
 void rrdeng_load_metric_init(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle, time_t start_time, time_t end_time)
+{
+    rrdeng_load_metric_init_tier(rd, rrdimm_handle, start_time, end_time, 0, TIER_QUERY_FETCH_AVERAGE);
+}
+
+/*
+ * Gets a handle for loading metrics from a storage tier of the database. The points of the tiers above 0 are
+ * converted to the rollup selected by tier_query_fetch. Falls back to tier 0 if the tier is not enabled.
+ * The handle must be released with rrdeng_load_metric_final().
+ */
+void rrdeng_load_metric_init_tier(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle, time_t start_time,
+                                  time_t end_time, int tier, TIER_QUERY_FETCH tier_query_fetch)
 {
     struct rrdeng_query_handle *handle;
     struct rrdengine_instance *ctx;
     unsigned pages_nr;
 
     ctx = get_rrdeng_ctx_from_host(rd->rrdset->rrdhost);
+    if (unlikely(tier < 0 || tier >= RRD_STORAGE_TIERS || NULL == ctx->tier_ctx[tier]))
+        tier = 0;
+    else
+        ctx = ctx->tier_ctx[tier];
+    rrdimm_handle->tier = tier;
+    rrdimm_handle->tier_query_fetch = tier_query_fetch;
     rrdimm_handle->start_time = start_time;
     rrdimm_handle->end_time = end_time;
     handle = &rrdimm_handle->rrdeng;
@@ -562,7 +827,7 @@ storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle
     struct rrdengine_instance *ctx;
     struct rrdeng_page_descr *descr;
     storage_number *page, ret;
-    unsigned position, entries;
+    unsigned position, entries, point_size;
     usec_t next_page_time = 0, current_position_time, page_end_time = 0;
     uint32_t page_length;
 
@@ -578,9 +843,10 @@ storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle
         pg_cache_atomic_get_pg_info(descr, &page_end_time, &page_length);
     }
     position = handle->position + 1;
+    point_size = RRDENG_PAGE_POINT_SIZE(ctx);
 
     if (unlikely(NULL == descr ||
-                 position >= (page_length / sizeof(storage_number)))) {
+                 position >= (page_length / point_size))) {
         /* We need to get a new page */
         if (descr) {
             /* Drop old page's reference */
@@ -612,7 +878,7 @@ storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle
         }
         if (unlikely(descr->start_time != page_end_time && next_page_time > descr->start_time)) {
             /* we're in the middle of the page somewhere */
-            entries = page_length / sizeof(storage_number);
+            entries = page_length / point_size;
             position = ((uint64_t)(next_page_time - descr->start_time)) * (entries - 1) /
                        (page_end_time - descr->start_time);
         } else {
@@ -620,8 +886,29 @@ storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle
         }
     }
     page = descr->pg_cache_descr->page;
-    ret = page[position];
-    entries = page_length / sizeof(storage_number);
+    if (unlikely(ctx->tier)) {
+        struct rrdeng_tier_point *point = &((struct rrdeng_tier_point *)page)[position];
+        calculated_number value;
+
+        switch (rrdimm_handle->tier_query_fetch) {
+            case TIER_QUERY_FETCH_MIN:
+                value = point->min;
+                break;
+            case TIER_QUERY_FETCH_MAX:
+                value = point->max;
+                break;
+            case TIER_QUERY_FETCH_SUM:
+                value = point->sum;
+                break;
+            default:
+                value = point->count ? point->sum / point->count : NAN;
+                break;
+        }
+        ret = point->count ? pack_storage_number(value, SN_EXISTS) : SN_EMPTY_SLOT;
+    } else {
+        ret = page[position];
+    }
+    entries = page_length / point_size;
     if (entries > 1) {
         usec_t dt;
 
@@ -682,13 +969,91 @@ time_t rrdeng_metric_latest_time(RRDDIM *rd)
 
     return page_index->latest_time / USEC_PER_SEC;
 }
+/* Returns the oldest time of the metric across all storage tiers */
 time_t rrdeng_metric_oldest_time(RRDDIM *rd)
 {
+    struct rrdengine_instance *ctx;
     struct pg_cache_page_index *page_index;
+    usec_t oldest_time;
 
     page_index = rd->state->page_index;
+    oldest_time = page_index->oldest_time;
 
-    return page_index->oldest_time / USEC_PER_SEC;
+    ctx = get_rrdeng_ctx_from_host(rd->rrdset->rrdhost);
+    for (int tier = 1 ; ctx && tier < RRD_STORAGE_TIERS ; ++tier) {
+        if (NULL == ctx->tier_ctx[tier])
+            break;
+        page_index = get_page_index(ctx->tier_ctx[tier], rd->state->rrdeng_uuid);
+        if (page_index && INVALID_TIME != page_index->oldest_time &&
+            (INVALID_TIME == oldest_time || page_index->oldest_time < oldest_time))
+            oldest_time = page_index->oldest_time;
+    }
+
+    return oldest_time / USEC_PER_SEC;
+}
+
+/* Returns the oldest time of the chart in a storage tier, INVALID_TIME if the tier has no pages of it */
+static usec_t rrdeng_chart_oldest_time(RRDSET *st, struct rrdengine_instance *ctx)
+{
+    struct pg_cache_page_index *page_index;
+    usec_t oldest_time = INVALID_TIME;
+    RRDDIM *rd;
+
+    rrdset_rdlock(st);
+    rrddim_foreach_read(rd, st) {
+        page_index = ctx->tier ? get_page_index(ctx, rd->state->rrdeng_uuid) : rd->state->page_index;
+        if (page_index && INVALID_TIME != page_index->oldest_time &&
+            (INVALID_TIME == oldest_time || page_index->oldest_time < oldest_time))
+            oldest_time = page_index->oldest_time;
+    }
+    rrdset_unlock(st);
+
+    return oldest_time;
+}
+
+/*
+ * Picks the storage tier of a chart to query the time range [start_time,end_time] for the given number of points.
+ * It is the highest tier whose points are not coarser than the points of the query, or a higher tier if the range
+ * starts before the retention of that one. Sets (*update_everyp) to the update every of the points of the tier.
+ * @return the tier, 0 if the chart has no tiers or the collected points are needed.
+ */
+int rrdeng_query_tier(RRDSET *st, time_t start_time, time_t end_time, long points, int *update_everyp)
+{
+    struct rrdengine_instance *ctx;
+    time_t point_duration;
+    usec_t oldest_time, next_oldest_time;
+    int tier, best_tier = 0;
+
+    *update_everyp = st->update_every;
+    ctx = get_rrdeng_ctx_from_host(st->rrdhost);
+    if (NULL == ctx || NULL == ctx->tier_ctx[1])
+        return 0;
+
+    if (points < 0)
+        points = -points;
+    if (0 == points || end_time <= start_time)
+        return 0;
+    point_duration = (end_time - start_time) / points;
+
+    for (tier = 1 ; tier < RRD_STORAGE_TIERS && ctx->tier_ctx[tier] ; ++tier) {
+        if ((time_t)st->update_every * ctx->tier_ctx[tier]->tier_grouping <= point_duration)
+            best_tier = tier;
+    }
+
+    /* the data of the query range may have been rotated out of the chosen tier, but still be in the ones above */
+    oldest_time = rrdeng_chart_oldest_time(st, ctx->tier_ctx[best_tier]);
+    while (best_tier + 1 < RRD_STORAGE_TIERS && ctx->tier_ctx[best_tier + 1] &&
+           (INVALID_TIME == oldest_time || oldest_time / USEC_PER_SEC > (usec_t)start_time)) {
+        next_oldest_time = rrdeng_chart_oldest_time(st, ctx->tier_ctx[best_tier + 1]);
+        if (INVALID_TIME == next_oldest_time ||
+            (INVALID_TIME != oldest_time && next_oldest_time >= oldest_time))
+            break;
+        oldest_time = next_oldest_time;
+        ++best_tier;
+    }
+
+    *update_everyp = (int)(st->update_every * ctx->tier_ctx[best_tier]->tier_grouping);
+    return best_tier;
 }
 
 /* Also gets a reference for the page */
@@ -806,7 +1171,7 @@ void *rrdeng_get_page(struct rrdengine_instance *ctx, uuid_t *id, usec_t point_i
  * You must not change the indices of the statistics or user code will break.
  * You must not exceed RRDENG_NR_STATS or it will crash.
  */
-void rrdeng_get_37_statistics(struct rrdengine_instance *ctx, unsigned long long *array)
+void rrdeng_get_40_statistics(struct rrdengine_instance *ctx, unsigned long long *array)
 {
     if (ctx == NULL)
         return;
@@ -850,7 +1215,37 @@ void rrdeng_get_37_statistics(struct rrdengine_instance *ctx, unsigned long long
     array[34] = (uint64_t)global_pg_cache_over_half_dirty_events;
     array[35] = (uint64_t)ctx->stats.flushing_pressure_page_deletions;
     array[36] = (uint64_t)global_flushing_pressure_page_deletions;
-    fatal_assert(RRDENG_NR_STATS == 37);
+    array[37] = (uint64_t)ctx->stats.xt_cache_hits;
+    array[38] = (uint64_t)ctx->stats.xt_cache_misses;
+    array[39] = (uint64_t)ctx->stats.xt_cache_evictions;
+    fatal_assert(RRDENG_NR_STATS == 40);
+}
+
+/*
+ * Adds the command queue statistics of an instance and of its storage tiers to the arrays, which are indexed by
+ * opcode: the number of queued commands, the number of dequeued commands and the total time in usec that the
+ * dequeued commands spent queued.
+ */
+void rrdeng_get_cmd_queue_statistics(struct rrdengine_instance *ctx, unsigned long long *queued,
+                                     unsigned long long *dispatched, unsigned long long *latency_usec)
+{
+    struct rrdengine_worker_config *wc;
+    unsigned i;
+    int tier;
+
+    if (ctx == NULL)
+        return;
+
+    for (tier = 0 ; tier < RRD_STORAGE_TIERS ; ++tier) {
+        if (tier && NULL == ctx->tier_ctx[tier])
+            break;
+        wc = tier ? &ctx->tier_ctx[tier]->worker_config : &ctx->worker_config;
+        for (i = 0 ; i < RRDENG_MAX_OPCODE ; ++i) {
+            queued[i] += wc->cmd_queues[i].size;
+            dispatched[i] += wc->cmd_stats[i].dispatched;
+            latency_usec[i] += wc->cmd_stats[i].latency_usec;
+        }
+    }
 }
 
 /* Releases reference to page */
@@ -861,10 +1256,13 @@ void rrdeng_put_page(struct rrdengine_instance *ctx, void *handle)
 }
 
 /*
+ * Initializes the instance of a storage tier. Tier 0 owns the metadata log, the instances of the tiers above it share
+ * the metadata log of parent, which must be the initialized instance of tier 0.
  * Returns 0 on success, negative on error
  */
-int rrdeng_init(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb,
-                unsigned disk_space_mb)
+static int rrdeng_init_tier(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_path,
+                            unsigned page_cache_mb, unsigned disk_space_mb, struct rrdengine_instance *parent,
+                            int tier)
 {
     struct rrdengine_instance *ctx;
     int error;
@@ -890,7 +1288,16 @@ int rrdeng_init(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_p
     } else {
         *ctxp = ctx = callocz(1, sizeof(*ctx));
     }
-    ctx->global_compress_alg = RRD_LZ4;
+    ctx->tier = (uint8_t)tier;
+    if (parent) {
+        ctx->page_type = PAGE_TIER;
+        ctx->tier_grouping = parent->tier_ctx[tier - 1]->tier_grouping * default_rrdeng_tier_grouping[tier];
+    } else {
+        ctx->page_type = PAGE_METRICS;
+        ctx->tier_grouping = 1;
+    }
+    ctx->tier_ctx[tier] = ctx;
+    ctx->global_compress_alg = default_rrdeng_compression_algorithm;
     if (page_cache_mb < RRDENG_MIN_PAGE_CACHE_SIZE_MB)
         page_cache_mb = RRDENG_MIN_PAGE_CACHE_SIZE_MB;
     ctx->max_cache_pages = page_cache_mb * (1048576LU / RRDENG_BLOCK_SIZE);
@@ -909,11 +1316,13 @@ int rrdeng_init(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_p
     ctx->drop_metrics_under_page_cache_pressure = rrdeng_drop_metrics_under_page_cache_pressure;
     ctx->metric_API_max_producers = 0;
     ctx->quiesce = NO_QUIESCE;
-    ctx->metalog_ctx = NULL; /* only set this after the metadata log has finished initializing */
+    /* only set this after the metadata log has finished initializing */
+    ctx->metalog_ctx = parent ? parent->metalog_ctx : NULL;
     ctx->host = host;
 
     memset(&ctx->worker_config, 0, sizeof(ctx->worker_config));
     ctx->worker_config.ctx = ctx;
+    init_xt_cache();
     init_page_cache(ctx);
     init_commit_log(ctx);
     error = init_rrd_files(ctx);
@@ -930,6 +1339,8 @@ int rrdeng_init(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_p
     if (ctx->worker_config.error) {
         goto error_after_rrdeng_worker;
     }
+    if (parent)
+        return 0;
     error = metalog_init(ctx);
     if (error) {
         error("Failed to initialize metadata log file event loop.");
@@ -950,6 +1361,62 @@ int rrdeng_init(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_p
     return UV_EIO;
 }
 
+/*
+ * Initializes the instances of the storage tiers above 0 of the multihost database, in sibling directories of the
+ * one of tier 0. Each tier has its own page cache, of default_rrdeng_tier_page_cache_mb, on top of the one of tier 0.
+ * A tier that fails to initialize disables itself and the tiers above it.
+ */
+static void rrdeng_init_multidb_tiers(struct rrdengine_instance *ctx, char *dbfiles_path)
+{
+    char tier_path[FILENAME_MAX + 1];
+    struct rrdengine_instance *tier_ctx;
+    int tier, storage_tiers = default_rrdeng_storage_tiers;
+
+    if (storage_tiers > RRD_STORAGE_TIERS)
+        storage_tiers = RRD_STORAGE_TIERS;
+
+    for (tier = 1 ; tier < storage_tiers ; ++tier) {
+        if (default_rrdeng_tier_grouping[tier] < 2) {
+            error("DBENGINE: tier %d must roll up at least 2 points of tier %d, disabling tiers above %d.",
+                  tier, tier - 1, tier - 1);
+            break;
+        }
+        snprintfz(tier_path, FILENAME_MAX, "%s-tier%d", dbfiles_path, tier);
+        if (mkdir(tier_path, 0775) != 0 && errno != EEXIST) {
+            error("DBENGINE: cannot create directory '%s', disabling tiers above %d.", tier_path, tier - 1);
+            break;
+        }
+        if (rrdeng_init_tier(NULL, &tier_ctx, tier_path, (unsigned)default_rrdeng_tier_page_cache_mb[tier],
+                             (unsigned)default_multidb_tier_disk_quota_mb[tier], ctx, tier)) {
+            error("DBENGINE: failed to initialize tier %d in '%s', disabling tiers above %d.",
+                  tier, tier_path, tier - 1);
+            break;
+        }
+        for (int i = 0 ; i < tier ; ++i)
+            tier_ctx->tier_ctx[i] = ctx->tier_ctx[i];
+        for (int i = 0 ; i < tier ; ++i)
+            ctx->tier_ctx[i]->tier_ctx[tier] = tier_ctx;
+        info("DBENGINE: tier %d of the multihost database is in '%s', 1 point every %u collected points, "
+             "with a page cache of %d MiB.", tier, tier_path, tier_ctx->tier_grouping,
+             default_rrdeng_tier_page_cache_mb[tier]);
+    }
+}
+
+/*
+ * Returns 0 on success, negative on error
+ */
+int rrdeng_init(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb,
+                unsigned disk_space_mb)
+{
+    int error;
+
+    error = rrdeng_init_tier(host, ctxp, dbfiles_path, page_cache_mb, disk_space_mb, NULL, 0);
+    if (!error && NULL == ctxp)
+        rrdeng_init_multidb_tiers(&multidb_ctx, dbfiles_path);
+
+    return error;
+}
+
 /*
  * Returns 0 on success, 1 on error
  */
@@ -961,6 +1428,14 @@ int rrdeng_exit(struct rrdengine_instance *ctx)
         return 1;
     }
 
+    if (0 == ctx->tier) {
+        /* the tiers above 0 share the metadata log of tier 0, shut them down first */
+        for (int tier = RRD_STORAGE_TIERS - 1 ; tier > 0 ; --tier) {
+            if (ctx->tier_ctx[tier])
+                rrdeng_exit(ctx->tier_ctx[tier]);
+        }
+    }
+
     /* TODO: add page to page cache */
     cmd.opcode = RRDENG_SHUTDOWN;
     rrdeng_enq_cmd(&ctx->worker_config, &cmd);
@@ -969,6 +1444,7 @@ int rrdeng_exit(struct rrdengine_instance *ctx)
 
     finalize_rrd_files(ctx);
     //metalog_exit(ctx->metalog_ctx);
+    xt_cache_delete_instance(ctx);
     free_page_cache(ctx);
 
     if (ctx != &multidb_ctx) {
@@ -994,6 +1470,13 @@ void rrdeng_prepare_exit(struct rrdengine_instance *ctx)
     wait_for_completion(&ctx->rrdengine_completion);
     destroy_completion(&ctx->rrdengine_completion);
 
+    if (0 == ctx->tier) {
+        for (int tier = 1 ; tier < RRD_STORAGE_TIERS ; ++tier) {
+            if (ctx->tier_ctx[tier])
+                rrdeng_prepare_exit(ctx->tier_ctx[tier]);
+        }
+    }
+
     //metalog_prepare_exit(ctx->metalog_ctx);
 }
 
@@ -8,14 +8,24 @@
 #define RRDENG_MIN_PAGE_CACHE_SIZE_MB (8)
 #define RRDENG_MIN_DISK_SPACE_MB (64)
 
-#define RRDENG_NR_STATS (37)
+#define RRDENG_DEFAULT_EXTENT_CACHE_SIZE_MB (16)
+
+#define RRDENG_NR_STATS (40)
 
 #define RRDENG_FD_BUDGET_PER_INSTANCE (50)
 
 extern int default_rrdeng_page_cache_mb;
 extern int default_rrdeng_disk_quota_mb;
 extern int default_multidb_disk_quota_mb;
+extern int default_rrdeng_storage_tiers;
+extern int default_rrdeng_worker_threads;
+extern int default_rrdeng_extent_cache_mb;
+extern uint8_t default_rrdeng_compression_algorithm;
+extern int default_rrdeng_tier_grouping[RRD_STORAGE_TIERS];
+extern int default_multidb_tier_disk_quota_mb[RRD_STORAGE_TIERS];
+extern int default_rrdeng_tier_page_cache_mb[RRD_STORAGE_TIERS];
 extern uint8_t rrdeng_drop_metrics_under_page_cache_pressure;
+extern uint8_t rrdeng_page_cache_lru;
 extern struct rrdengine_instance multidb_ctx;
 
 struct rrdeng_region_info {
@@ -46,12 +56,19 @@ extern unsigned
                                     struct rrdeng_region_info **region_info_arrayp, unsigned *max_intervalp, struct context_param *context_param_list);
 extern void rrdeng_load_metric_init(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle,
                                     time_t start_time, time_t end_time);
+extern void rrdeng_load_metric_init_tier(RRDDIM *rd, struct rrddim_query_handle *rrdimm_handle,
+                                         time_t start_time, time_t end_time, int tier,
+                                         TIER_QUERY_FETCH tier_query_fetch);
+extern int rrdeng_query_tier(RRDSET *st, time_t start_time, time_t end_time, long points, int *update_everyp);
+extern int rrdeng_metric_in_other_tiers(struct rrdengine_instance *ctx, uuid_t *metric_id);
 extern storage_number rrdeng_load_metric_next(struct rrddim_query_handle *rrdimm_handle, time_t *current_time);
 extern int rrdeng_load_metric_is_finished(struct rrddim_query_handle *rrdimm_handle);
 extern void rrdeng_load_metric_finalize(struct rrddim_query_handle *rrdimm_handle);
 extern time_t rrdeng_metric_latest_time(RRDDIM *rd);
 extern time_t rrdeng_metric_oldest_time(RRDDIM *rd);
-extern void rrdeng_get_37_statistics(struct rrdengine_instance *ctx, unsigned long long *array);
+extern void rrdeng_get_40_statistics(struct rrdengine_instance *ctx, unsigned long long *array);
+extern void rrdeng_get_cmd_queue_statistics(struct rrdengine_instance *ctx, unsigned long long *queued,
+                                            unsigned long long *dispatched, unsigned long long *latency_usec);
 
 /* must call once before using anything */
 extern int rrdeng_init(RRDHOST *host, struct rrdengine_instance **ctxp, char *dbfiles_path, unsigned page_cache_mb,
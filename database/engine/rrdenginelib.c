@@ -214,8 +214,8 @@ int is_legacy_child(const char *machine_guid)
     uuid_t uuid;
     char  dbengine_file[FILENAME_MAX+1];
 
-    if (unlikely(!strcmp(machine_guid, "unittest-dbengine") || !strcmp(machine_guid, "dbengine-dataset") ||
-                 !strcmp(machine_guid, "dbengine-stress-test"))) {
+    if (unlikely(!strcmp(machine_guid, "unittest-dbengine") || !strcmp(machine_guid, "unittest-dbengine-gorilla") ||
+                 !strcmp(machine_guid, "dbengine-dataset") || !strcmp(machine_guid, "dbengine-stress-test"))) {
         return 1;
     }
     if (!uuid_parse(machine_guid, uuid)) {
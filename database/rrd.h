@@ -316,6 +316,21 @@ struct rrddim {
     storage_number values[];                        // the array of values - THIS HAS TO BE THE LAST MEMBER
 };
 
+// ----------------------------------------------------------------------------
+// database engine storage tiers
+// tier 0 keeps the collected points, every higher tier keeps rollups (sum, min,
+// max and count) of a number of points of the tier below it
+
+#define RRD_STORAGE_TIERS 3
+
+// which of the rollups of a higher tier point a query is interested in
+typedef enum tier_query_fetch {
+    TIER_QUERY_FETCH_AVERAGE = 0,
+    TIER_QUERY_FETCH_MIN,
+    TIER_QUERY_FETCH_MAX,
+    TIER_QUERY_FETCH_SUM
+} TIER_QUERY_FETCH;
+
 // ----------------------------------------------------------------------------
 // iterator state for RRD dimension data collection
 union rrddim_collect_handle {
@@ -330,6 +345,16 @@ union rrddim_collect_handle {
         struct rrdengine_instance *ctx;
         // set to 1 when this dimension is not page aligned with the other dimensions in the chart
         uint8_t unaligned_page;
+
+        // the rollups of the higher tiers (index 0 is tier 1), updated on every collected point
+        struct rrdeng_tier_collect_handle {
+            struct rrdeng_page_descr *descr;
+            unsigned long page_correlation_id;
+            struct pg_cache_page_index *page_index;
+            time_t interval_end;            // the end of the interval being rolled up, 0 if none yet
+            calculated_number sum, min, max;
+            uint32_t count;                 // the number of points of the interval that exist
+        } tiers[RRD_STORAGE_TIERS - 1];
     } rrdeng; // state the database engine uses
 #endif
 };
@@ -352,6 +377,8 @@ struct rrddim_query_handle {
     RRDDIM *rd;
     time_t start_time;
     time_t end_time;
+    int tier;                              // the storage tier queried - only the database engine has tiers above 0
+    TIER_QUERY_FETCH tier_query_fetch;     // the rollup returned by the tiers above 0
     union {
         struct {
             long slot;
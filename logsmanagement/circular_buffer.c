@@ -11,343 +11,279 @@
 #include "helper.h"
 #include "parser.h"
 
-static uv_loop_t *circ_buff_loop = NULL;
+/**
+ * @brief Get a parse request from the pool of a circular buffer, allocating a new one if the pool is empty
+ * @details Must only be called from the thread of the uv_loop_t the requests are queued on.
+ */
+static Circ_buff_parse_req_t *parse_req_get(Circ_buff_t *buff){
+    Circ_buff_parse_req_t *req = buff->parse_reqs_free;
+    if(likely(req)) buff->parse_reqs_free = req->next_free;
+    else req = callocz(1, sizeof(Circ_buff_parse_req_t));
+    req->next_chunk = NULL;
+    req->next_free = NULL;
+    return req;
+}
 
 /**
- * @brief Cleans up after an execution of the msg_parser function. 
+ * @brief Returns the parse requests of all the chunks of an item to the pool, 
+ * once the after work callbacks of all of them have run.
  */
-static void msg_parser_cleanup(uv_work_t *req, int status){
-    freez(req);
+static void msg_parser_cleanup(uv_work_t *work, int status){
+    Circ_buff_parse_req_t *req = (Circ_buff_parse_req_t *) work;
+    Circ_buff_parse_req_t *leader = req->leader;
+    if(--leader->after_work_pending) return;
+
+    Circ_buff_t *buff = leader->p_file_info->msg_buff;
+    for(req = leader; req; ){
+        Circ_buff_parse_req_t *next_chunk = req->next_chunk;
+        req->next_free = buff->parse_reqs_free;
+        buff->parse_reqs_free = req;
+        req = next_chunk;
+    }
 }
 
 /**
- * @brief Performs all the processing required for a raw log message
- * @details For the time being, this function compresses a raw log message. In the
- * future, additional processing (such as parsing and/or streaming) will be performed.
+ * @brief Merges the parser metrics of a chunk of a log message into the metrics of its log source
+ * @details parser_mut of p_file_info must be held.
  * @todo Metrics addition part needs refactoring.
  */
-static void msg_parser(uv_work_t *req){
-    struct File_info *p_file_info = (struct File_info *) req->data;
-    Circ_buff_t *buff = p_file_info->msg_buff;
+static void msg_parser_metrics_merge(struct File_info *p_file_info, const Log_parser_metrics_t *parser_metrics){
+    /* Number of lines */
+    p_file_info->parser_metrics->num_lines_total += parser_metrics->num_lines_total;
+    p_file_info->parser_metrics->num_lines_rate += parser_metrics->num_lines_rate;
+
+    /* Vhost */
+    if(p_file_info->parser_config->chart_config & CHART_VHOST){
+        for(int i = 0; i < parser_metrics->vhost_arr.size; i++){
+            const int j = parser_metrics_vhost_get(&p_file_info->parser_metrics->vhost_arr, parser_metrics->vhost_arr.vhosts[i].name);
+            p_file_info->parser_metrics->vhost_arr.vhosts[j].count += parser_metrics->vhost_arr.vhosts[i].count;
+        }
+    }
 
-    uv_mutex_lock(&buff->mut);
-    m_assert(buff->parse_next_index != buff->head_index, "More msg_parser() called than Message_t items in buff that need parsing");
-    /* This needs to be within mut lock as another msg_parser() in different thread 
-     * (albeit unlikely) could be changing parsed_index at the same time as this thread */
-    Log_parser_buffs_t *parser_buff_current =  &buff->parser_buffs[(buff->parse_next_index) & BUFF_SIZE_MASK]; 
-    Message_t *buff_msg_current = &buff->msgs[(buff->parse_next_index++) & BUFF_SIZE_MASK]; 
-    uv_mutex_unlock(&buff->mut);
+    /* Port */
+    if(p_file_info->parser_config->chart_config & CHART_PORT){
+        for(int i = 0; i < parser_metrics->port_arr.size; i++){
+            const int j = parser_metrics_port_get(&p_file_info->parser_metrics->port_arr, parser_metrics->port_arr.ports[i].port);
+            p_file_info->parser_metrics->port_arr.ports[j].count += parser_metrics->port_arr.ports[i].count;
+        }
+    }
 
-    if(p_file_info->parser_config){ 
-        // TODO: verify bool should be set through log source configuration.
-        Log_parser_metrics_t parser_metrics = parse_text_buf(parser_buff_current, buff_msg_current->text, buff_msg_current->text_size, 
-            p_file_info->parser_config, 1);
-        if(parser_metrics.num_lines_rate == 0) fatal("Parsed buffer did not contain any text or was of 0 size.");
+    /* Req Client - IP version */
+    if(p_file_info->parser_config->chart_config & CHART_IP_VERSION){
+        p_file_info->parser_metrics->ip_ver.v4 += parser_metrics->ip_ver.v4;
+        p_file_info->parser_metrics->ip_ver.v6 += parser_metrics->ip_ver.v6;
+        p_file_info->parser_metrics->ip_ver.invalid += parser_metrics->ip_ver.invalid;
+    }
 
-        uv_mutex_lock(p_file_info->parser_mut);
-        // This part needs refactoring
-
-        /* Number of lines */
-        p_file_info->parser_metrics->num_lines_total += parser_metrics.num_lines_total;
-        p_file_info->parser_metrics->num_lines_rate += parser_metrics.num_lines_rate;
-        fprintf(stderr, "NDLGS NumLines: Total:%lld Rate:%lld\n", p_file_info->parser_metrics->num_lines_total, p_file_info->parser_metrics->num_lines_rate);
-
-        /* Vhost */
-        if(p_file_info->parser_config->chart_config & CHART_VHOST){
-            for(int i = 0; i < parser_metrics.vhost_arr.size; i++){
-                int j;
-                for(j = 0; j < p_file_info->parser_metrics->vhost_arr.size ; j++){
-                    if(!strcmp(parser_metrics.vhost_arr.vhosts[i].name, p_file_info->parser_metrics->vhost_arr.vhosts[j].name)) {
-                        p_file_info->parser_metrics->vhost_arr.vhosts[j].count += parser_metrics.vhost_arr.vhosts[i].count;
-                        break;
-                    }
-                }
-                if(p_file_info->parser_metrics->vhost_arr.size == j){
-                    p_file_info->parser_metrics->vhost_arr.size++;
-
-                    if(p_file_info->parser_metrics->vhost_arr.size >= p_file_info->parser_metrics->vhost_arr.size_max){
-                        p_file_info->parser_metrics->vhost_arr.size_max = p_file_info->parser_metrics->vhost_arr.size * LOG_PARSER_METRICS_VHOST_BUFFS_SCALE_FACTOR + 1;
-                        
-                        p_file_info->parser_metrics->vhost_arr.vhosts = reallocz(p_file_info->parser_metrics->vhost_arr.vhosts, 
-                            p_file_info->parser_metrics->vhost_arr.size_max * sizeof(struct log_parser_metrics_vhost));
-                    }
-
-                    snprintf(p_file_info->parser_metrics->vhost_arr.vhosts[p_file_info->parser_metrics->vhost_arr.size - 1].name, 
-                        VHOST_MAX_LEN, "%s", parser_metrics.vhost_arr.vhosts[i].name);
-
-                    p_file_info->parser_metrics->vhost_arr.vhosts[p_file_info->parser_metrics->vhost_arr.size - 1].count = parser_metrics.vhost_arr.vhosts[i].count;
-                }
-            }
-            freez(parser_metrics.vhost_arr.vhosts); // TODO: Avoid mallocz()/freez() in future by reusing buffs
-        }
+    /* Request Client - Unique clients all-time and current poll */
+    if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_ALL_TIME)
+        parser_metrics_req_clients_merge(&p_file_info->parser_metrics->req_clients_alltime_arr, &parser_metrics->req_clients_current_arr);
+    if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_CURRENT)
+        parser_metrics_req_clients_merge(&p_file_info->parser_metrics->req_clients_current_arr, &parser_metrics->req_clients_current_arr);
+
+    /* Request methods */
+    if(p_file_info->parser_config->chart_config & CHART_REQ_METHODS){
+        p_file_info->parser_metrics->req_method.acl += parser_metrics->req_method.acl;
+        p_file_info->parser_metrics->req_method.baseline_control += parser_metrics->req_method.baseline_control;
+        p_file_info->parser_metrics->req_method.bind += parser_metrics->req_method.bind;
+        p_file_info->parser_metrics->req_method.checkin += parser_metrics->req_method.checkin;
+        p_file_info->parser_metrics->req_method.checkout += parser_metrics->req_method.checkout;
+        p_file_info->parser_metrics->req_method.connect += parser_metrics->req_method.copy;
+        p_file_info->parser_metrics->req_method.delet += parser_metrics->req_method.delet;
+        p_file_info->parser_metrics->req_method.get += parser_metrics->req_method.get;
+        p_file_info->parser_metrics->req_method.head += parser_metrics->req_method.head;
+        p_file_info->parser_metrics->req_method.label += parser_metrics->req_method.label;
+        p_file_info->parser_metrics->req_method.link += parser_metrics->req_method.link;
+        p_file_info->parser_metrics->req_method.lock += parser_metrics->req_method.lock;
+        p_file_info->parser_metrics->req_method.merge += parser_metrics->req_method.merge;
+        p_file_info->parser_metrics->req_method.mkactivity += parser_metrics->req_method.mkactivity;
+        p_file_info->parser_metrics->req_method.mkcalendar += parser_metrics->req_method.mkcalendar;
+        p_file_info->parser_metrics->req_method.mkcol += parser_metrics->req_method.mkcol;
+        p_file_info->parser_metrics->req_method.mkredirectref += parser_metrics->req_method.mkredirectref;
+        p_file_info->parser_metrics->req_method.mkworkspace += parser_metrics->req_method.mkworkspace;
+        p_file_info->parser_metrics->req_method.move += parser_metrics->req_method.move;
+        p_file_info->parser_metrics->req_method.options += parser_metrics->req_method.options;
+        p_file_info->parser_metrics->req_method.orderpatch += parser_metrics->req_method.orderpatch;
+        p_file_info->parser_metrics->req_method.patch += parser_metrics->req_method.patch;
+        p_file_info->parser_metrics->req_method.post += parser_metrics->req_method.post;
+        p_file_info->parser_metrics->req_method.pri += parser_metrics->req_method.pri;
+        p_file_info->parser_metrics->req_method.propfind += parser_metrics->req_method.propfind;
+        p_file_info->parser_metrics->req_method.proppatch += parser_metrics->req_method.proppatch;
+        p_file_info->parser_metrics->req_method.put += parser_metrics->req_method.put;
+        p_file_info->parser_metrics->req_method.rebind += parser_metrics->req_method.rebind;
+        p_file_info->parser_metrics->req_method.report += parser_metrics->req_method.report;
+        p_file_info->parser_metrics->req_method.search += parser_metrics->req_method.search;
+        p_file_info->parser_metrics->req_method.trace += parser_metrics->req_method.trace;
+        p_file_info->parser_metrics->req_method.unbind += parser_metrics->req_method.unbind;
+        p_file_info->parser_metrics->req_method.uncheckout += parser_metrics->req_method.uncheckout;
+        p_file_info->parser_metrics->req_method.unlink += parser_metrics->req_method.unlink;
+        p_file_info->parser_metrics->req_method.unlock += parser_metrics->req_method.unlock;
+        p_file_info->parser_metrics->req_method.update += parser_metrics->req_method.update;
+        p_file_info->parser_metrics->req_method.updateredirectref += parser_metrics->req_method.updateredirectref;
+    }
 
-        /* Port */
-        if(p_file_info->parser_config->chart_config & CHART_PORT){
-            for(int i = 0; i < parser_metrics.port_arr.size; i++){
-                int j;
-                for(j = 0; j < p_file_info->parser_metrics->port_arr.size ; j++){
-                    if(parser_metrics.port_arr.ports[i].port == p_file_info->parser_metrics->port_arr.ports[j].port) {
-                        p_file_info->parser_metrics->port_arr.ports[j].count += parser_metrics.port_arr.ports[i].count;
-                        break;
-                    }
-                }
-                if(p_file_info->parser_metrics->port_arr.size == j){
-                    p_file_info->parser_metrics->port_arr.size++;
-
-                    if(p_file_info->parser_metrics->port_arr.size >= p_file_info->parser_metrics->port_arr.size_max){
-                        p_file_info->parser_metrics->port_arr.size_max = p_file_info->parser_metrics->port_arr.size * LOG_PARSER_METRICS_PORT_BUFFS_SCALE_FACTOR + 1;
-
-                        p_file_info->parser_metrics->port_arr.ports = reallocz(p_file_info->parser_metrics->port_arr.ports, 
-                            p_file_info->parser_metrics->port_arr.size_max * sizeof(struct log_parser_metrics_port));
-                    }
-                    
-                    p_file_info->parser_metrics->port_arr.ports[p_file_info->parser_metrics->port_arr.size - 1].port = parser_metrics.port_arr.ports[i].port;
-                    p_file_info->parser_metrics->port_arr.ports[p_file_info->parser_metrics->port_arr.size - 1].count = parser_metrics.port_arr.ports[i].count;
-                }
-            }
-            freez(parser_metrics.port_arr.ports); // TODO: Avoid mallocz()/freez() in future by reusing buffs
-        }
+    /* Request protocol */
+    if(p_file_info->parser_config->chart_config & CHART_REQ_PROTO){
+        p_file_info->parser_metrics->req_proto.http_1 += parser_metrics->req_proto.http_1;
+        p_file_info->parser_metrics->req_proto.http_1_1 += parser_metrics->req_proto.http_1_1;
+        p_file_info->parser_metrics->req_proto.http_2 += parser_metrics->req_proto.http_2;
+        p_file_info->parser_metrics->req_proto.other += parser_metrics->req_proto.other;
+    }
 
-        /* Req Client - IP version */
-        if(p_file_info->parser_config->chart_config & CHART_IP_VERSION){
-            p_file_info->parser_metrics->ip_ver.v4 += parser_metrics.ip_ver.v4;
-            p_file_info->parser_metrics->ip_ver.v6 += parser_metrics.ip_ver.v6;
-            p_file_info->parser_metrics->ip_ver.invalid += parser_metrics.ip_ver.invalid;
-        }
+    /* Request bandwidth */
+    if(p_file_info->parser_config->chart_config & CHART_BANDWIDTH){
+        p_file_info->parser_metrics->bandwidth.req_size += parser_metrics->bandwidth.req_size;
+        p_file_info->parser_metrics->bandwidth.resp_size += parser_metrics->bandwidth.resp_size;
+    }
 
-        for(int i = 0; i < parser_metrics.req_clients_current_arr.ipv4_size; i++){
-            int j;
-
-            /* Request Client - Unique IPv4 clients all-time */
-            if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_ALL_TIME){
-                for(j = 0; j < p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size ; j++){
-                    if(!strcmp(parser_metrics.req_clients_current_arr.ipv4_req_clients[i], p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_req_clients[j])) break;
-                }
-                if(p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size == j){
-                    p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size++;
-
-                    if(p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size >= p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size_max){
-                        p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size_max = p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size * LOG_PARSER_METRICS_REQ_CLIENTS_BUFFS_SCALE_FACTOR + 1;
-                    
-                        p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_req_clients = reallocz(p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_req_clients, 
-                            p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size_max * sizeof(*p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_req_clients));
-                    }
-                    
-                    snprintf(p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_req_clients[p_file_info->parser_metrics->req_clients_alltime_arr.ipv4_size - 1], 
-                        REQ_CLIENT_MAX_LEN, "%s", parser_metrics.req_clients_current_arr.ipv4_req_clients[i]);
-                }
-            }
+    /* Request processing time */
+    if(p_file_info->parser_config->chart_config & CHART_REQ_PROC_TIME){
+        if(parser_metrics->req_proc_time.min < p_file_info->parser_metrics->req_proc_time.min 
+            || p_file_info->parser_metrics->req_proc_time.min == 0) p_file_info->parser_metrics->req_proc_time.min = parser_metrics->req_proc_time.min;
+        if(parser_metrics->req_proc_time.max > p_file_info->parser_metrics->req_proc_time.max 
+            || p_file_info->parser_metrics->req_proc_time.max == 0) p_file_info->parser_metrics->req_proc_time.max = parser_metrics->req_proc_time.max;
+        p_file_info->parser_metrics->req_proc_time.sum += parser_metrics->req_proc_time.sum;
+        p_file_info->parser_metrics->req_proc_time.count += parser_metrics->req_proc_time.count;
+        parser_metrics_latency_hist_merge(&p_file_info->parser_metrics->req_proc_time.hist, &parser_metrics->req_proc_time.hist);
+    }
 
-            /* Request Client - Unique IPv4 clients current poll */
-            if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_CURRENT){
-                for(j = 0; j < p_file_info->parser_metrics->req_clients_current_arr.ipv4_size ; j++){
-                    if(!strcmp(parser_metrics.req_clients_current_arr.ipv4_req_clients[i], p_file_info->parser_metrics->req_clients_current_arr.ipv4_req_clients[j])) break;
-                }
-                if(p_file_info->parser_metrics->req_clients_current_arr.ipv4_size == j){
-                    p_file_info->parser_metrics->req_clients_current_arr.ipv4_size++;
-
-                    if(p_file_info->parser_metrics->req_clients_current_arr.ipv4_size >= p_file_info->parser_metrics->req_clients_current_arr.ipv4_size_max){
-                        p_file_info->parser_metrics->req_clients_current_arr.ipv4_size_max = p_file_info->parser_metrics->req_clients_current_arr.ipv4_size * LOG_PARSER_METRICS_REQ_CLIENTS_BUFFS_SCALE_FACTOR + 1;
-                    
-                        p_file_info->parser_metrics->req_clients_current_arr.ipv4_req_clients = reallocz(p_file_info->parser_metrics->req_clients_current_arr.ipv4_req_clients, 
-                            p_file_info->parser_metrics->req_clients_current_arr.ipv4_size_max * sizeof(*p_file_info->parser_metrics->req_clients_current_arr.ipv4_req_clients));
-                    }
-
-                    snprintf(p_file_info->parser_metrics->req_clients_current_arr.ipv4_req_clients[p_file_info->parser_metrics->req_clients_current_arr.ipv4_size - 1], 
-                        REQ_CLIENT_MAX_LEN, "%s", parser_metrics.req_clients_current_arr.ipv4_req_clients[i]);
-                }
-            }
-        }
-        if(p_file_info->parser_config->chart_config & (CHART_REQ_CLIENT_CURRENT | CHART_REQ_CLIENT_ALL_TIME)){
-            freez(parser_metrics.req_clients_current_arr.ipv4_req_clients); // TODO: Avoid mallocz()/freez() in future by reusing buffs
-        }
+    /* Upstream response time */
+    if(p_file_info->parser_config->chart_config & CHART_UPS_RESP_TIME)
+        parser_metrics_latency_hist_merge(&p_file_info->parser_metrics->ups_resp_time_hist, &parser_metrics->ups_resp_time_hist);
+
+    /* Response code family */
+    if(p_file_info->parser_config->chart_config & CHART_RESP_CODE_FAMILY){
+        p_file_info->parser_metrics->resp_code_family.resp_1xx += parser_metrics->resp_code_family.resp_1xx;
+        p_file_info->parser_metrics->resp_code_family.resp_2xx += parser_metrics->resp_code_family.resp_2xx;
+        p_file_info->parser_metrics->resp_code_family.resp_3xx += parser_metrics->resp_code_family.resp_3xx;
+        p_file_info->parser_metrics->resp_code_family.resp_4xx += parser_metrics->resp_code_family.resp_4xx;
+        p_file_info->parser_metrics->resp_code_family.resp_5xx += parser_metrics->resp_code_family.resp_5xx;
+        p_file_info->parser_metrics->resp_code_family.other += parser_metrics->resp_code_family.other;
+    }
 
-        for(int i = 0; i < parser_metrics.req_clients_current_arr.ipv6_size; i++){
-            int j;
-
-            /* Request Client - Unique IPv6 clients all-time */
-            if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_ALL_TIME){
-                for(j = 0; j < p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size ; j++){
-                    if(!strcmp(parser_metrics.req_clients_current_arr.ipv6_req_clients[i], p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_req_clients[j])) break;
-                }
-                if(p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size == j){
-                    p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size++;
-
-                    if(p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size >= p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size_max){
-                        p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size_max = p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size * LOG_PARSER_METRICS_REQ_CLIENTS_BUFFS_SCALE_FACTOR + 1;
-                    
-                        p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_req_clients = reallocz(p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_req_clients, 
-                            p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size_max * sizeof(*p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_req_clients));
-                    }
-
-                    snprintf(p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_req_clients[p_file_info->parser_metrics->req_clients_alltime_arr.ipv6_size - 1], 
-                        REQ_CLIENT_MAX_LEN, "%s", parser_metrics.req_clients_current_arr.ipv6_req_clients[i]);
-                }
-            }
+    /* Response code */
+    if(p_file_info->parser_config->chart_config & CHART_RESP_CODE){
+        for(int i = 0; i < 501; i++) p_file_info->parser_metrics->resp_code[i] += parser_metrics->resp_code[i];
+    }
 
-            /* Request Client - Unique IPv6 clients current poll */
-            if(p_file_info->parser_config->chart_config & CHART_REQ_CLIENT_CURRENT){
-                for(j = 0; j < p_file_info->parser_metrics->req_clients_current_arr.ipv6_size ; j++){
-                    if(!strcmp(parser_metrics.req_clients_current_arr.ipv6_req_clients[i], p_file_info->parser_metrics->req_clients_current_arr.ipv6_req_clients[j])) break;
-                }
-                if(p_file_info->parser_metrics->req_clients_current_arr.ipv6_size == j){
-                    p_file_info->parser_metrics->req_clients_current_arr.ipv6_size++;
-
-                    if(p_file_info->parser_metrics->req_clients_current_arr.ipv6_size >= p_file_info->parser_metrics->req_clients_current_arr.ipv6_size_max){
-                        p_file_info->parser_metrics->req_clients_current_arr.ipv6_size_max = p_file_info->parser_metrics->req_clients_current_arr.ipv6_size * LOG_PARSER_METRICS_REQ_CLIENTS_BUFFS_SCALE_FACTOR + 1;
-                    
-                        p_file_info->parser_metrics->req_clients_current_arr.ipv6_req_clients = reallocz(p_file_info->parser_metrics->req_clients_current_arr.ipv6_req_clients, 
-                            p_file_info->parser_metrics->req_clients_current_arr.ipv6_size_max * sizeof(*p_file_info->parser_metrics->req_clients_current_arr.ipv6_req_clients));
-                    }
-
-                    snprintf(p_file_info->parser_metrics->req_clients_current_arr.ipv6_req_clients[p_file_info->parser_metrics->req_clients_current_arr.ipv6_size - 1], 
-                        REQ_CLIENT_MAX_LEN, "%s", parser_metrics.req_clients_current_arr.ipv6_req_clients[i]);
-                }
-            }
-        }
-        if(p_file_info->parser_config->chart_config & (CHART_REQ_CLIENT_CURRENT | CHART_REQ_CLIENT_ALL_TIME)){
-            freez(parser_metrics.req_clients_current_arr.ipv6_req_clients); // TODO: Avoid mallocz()/freez() in future by reusing buffs
-        }
+    /* Response code type */
+    if(p_file_info->parser_config->chart_config & CHART_RESP_CODE_TYPE){
+        p_file_info->parser_metrics->resp_code_type.resp_success += parser_metrics->resp_code_type.resp_success;
+        p_file_info->parser_metrics->resp_code_type.resp_redirect += parser_metrics->resp_code_type.resp_redirect;
+        p_file_info->parser_metrics->resp_code_type.resp_bad += parser_metrics->resp_code_type.resp_bad;
+        p_file_info->parser_metrics->resp_code_type.resp_error += parser_metrics->resp_code_type.resp_error;
+        p_file_info->parser_metrics->resp_code_type.other += parser_metrics->resp_code_type.other;
+    }
 
-        /* Request methods */
-        if(p_file_info->parser_config->chart_config & CHART_REQ_METHODS){
-            p_file_info->parser_metrics->req_method.acl += parser_metrics.req_method.acl;
-            p_file_info->parser_metrics->req_method.baseline_control += parser_metrics.req_method.baseline_control;
-            p_file_info->parser_metrics->req_method.bind += parser_metrics.req_method.bind;
-            p_file_info->parser_metrics->req_method.checkin += parser_metrics.req_method.checkin;
-            p_file_info->parser_metrics->req_method.checkout += parser_metrics.req_method.checkout;
-            p_file_info->parser_metrics->req_method.connect += parser_metrics.req_method.copy;
-            p_file_info->parser_metrics->req_method.delet += parser_metrics.req_method.delet;
-            p_file_info->parser_metrics->req_method.get += parser_metrics.req_method.get;
-            p_file_info->parser_metrics->req_method.head += parser_metrics.req_method.head;
-            p_file_info->parser_metrics->req_method.label += parser_metrics.req_method.label;
-            p_file_info->parser_metrics->req_method.link += parser_metrics.req_method.link;
-            p_file_info->parser_metrics->req_method.lock += parser_metrics.req_method.lock;
-            p_file_info->parser_metrics->req_method.merge += parser_metrics.req_method.merge;
-            p_file_info->parser_metrics->req_method.mkactivity += parser_metrics.req_method.mkactivity;
-            p_file_info->parser_metrics->req_method.mkcalendar += parser_metrics.req_method.mkcalendar;
-            p_file_info->parser_metrics->req_method.mkcol += parser_metrics.req_method.mkcol;
-            p_file_info->parser_metrics->req_method.mkredirectref += parser_metrics.req_method.mkredirectref;
-            p_file_info->parser_metrics->req_method.mkworkspace += parser_metrics.req_method.mkworkspace;
-            p_file_info->parser_metrics->req_method.move += parser_metrics.req_method.move;
-            p_file_info->parser_metrics->req_method.options += parser_metrics.req_method.options;
-            p_file_info->parser_metrics->req_method.orderpatch += parser_metrics.req_method.orderpatch;
-            p_file_info->parser_metrics->req_method.patch += parser_metrics.req_method.patch;
-            p_file_info->parser_metrics->req_method.post += parser_metrics.req_method.post;
-            p_file_info->parser_metrics->req_method.pri += parser_metrics.req_method.pri;
-            p_file_info->parser_metrics->req_method.propfind += parser_metrics.req_method.propfind;
-            p_file_info->parser_metrics->req_method.proppatch += parser_metrics.req_method.proppatch;
-            p_file_info->parser_metrics->req_method.put += parser_metrics.req_method.put;
-            p_file_info->parser_metrics->req_method.rebind += parser_metrics.req_method.rebind;
-            p_file_info->parser_metrics->req_method.report += parser_metrics.req_method.report;
-            p_file_info->parser_metrics->req_method.search += parser_metrics.req_method.search;
-            p_file_info->parser_metrics->req_method.trace += parser_metrics.req_method.trace;
-            p_file_info->parser_metrics->req_method.unbind += parser_metrics.req_method.unbind;
-            p_file_info->parser_metrics->req_method.uncheckout += parser_metrics.req_method.uncheckout;
-            p_file_info->parser_metrics->req_method.unlink += parser_metrics.req_method.unlink;
-            p_file_info->parser_metrics->req_method.unlock += parser_metrics.req_method.unlock;
-            p_file_info->parser_metrics->req_method.update += parser_metrics.req_method.update;
-            p_file_info->parser_metrics->req_method.updateredirectref += parser_metrics.req_method.updateredirectref;
-        }
+    /* SSL protocol */
+    if(p_file_info->parser_config->chart_config & CHART_SSL_PROTO){
+        p_file_info->parser_metrics->ssl_proto.tlsv1 += parser_metrics->ssl_proto.tlsv1;
+        p_file_info->parser_metrics->ssl_proto.tlsv1_1 += parser_metrics->ssl_proto.tlsv1_1;
+        p_file_info->parser_metrics->ssl_proto.tlsv1_2 += parser_metrics->ssl_proto.tlsv1_2;
+        p_file_info->parser_metrics->ssl_proto.tlsv1_3 += parser_metrics->ssl_proto.tlsv1_3;
+        p_file_info->parser_metrics->ssl_proto.sslv2 += parser_metrics->ssl_proto.sslv2;
+        p_file_info->parser_metrics->ssl_proto.sslv3 += parser_metrics->ssl_proto.sslv3;
+        p_file_info->parser_metrics->ssl_proto.other += parser_metrics->ssl_proto.other;
+    }
 
-        /* Request protocol */
-        if(p_file_info->parser_config->chart_config & CHART_REQ_PROTO){
-            p_file_info->parser_metrics->req_proto.http_1 += parser_metrics.req_proto.http_1;
-            p_file_info->parser_metrics->req_proto.http_1_1 += parser_metrics.req_proto.http_1_1;
-            p_file_info->parser_metrics->req_proto.http_2 += parser_metrics.req_proto.http_2;
-            p_file_info->parser_metrics->req_proto.other += parser_metrics.req_proto.other;
+    /* SSL cipher suite */
+    if(p_file_info->parser_config->chart_config & CHART_SSL_CIPHER){
+        for(int i = 0; i < parser_metrics->ssl_cipher_arr.size; i++){
+            const int j = parser_metrics_ssl_cipher_get(&p_file_info->parser_metrics->ssl_cipher_arr, parser_metrics->ssl_cipher_arr.ssl_ciphers[i].string);
+            p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count += parser_metrics->ssl_cipher_arr.ssl_ciphers[i].count;
         }
+    }
 
-        /* Request bandwidth */
-        if(p_file_info->parser_config->chart_config & CHART_BANDWIDTH){
-            p_file_info->parser_metrics->bandwidth.req_size += parser_metrics.bandwidth.req_size;
-            p_file_info->parser_metrics->bandwidth.resp_size += parser_metrics.bandwidth.resp_size;
-        }
+}
 
-        /* Request processing time */
-        if(p_file_info->parser_config->chart_config & CHART_REQ_PROC_TIME){
-            if(parser_metrics.req_proc_time.min < p_file_info->parser_metrics->req_proc_time.min 
-                || p_file_info->parser_metrics->req_proc_time.min == 0) p_file_info->parser_metrics->req_proc_time.min = parser_metrics.req_proc_time.min;
-            if(parser_metrics.req_proc_time.max > p_file_info->parser_metrics->req_proc_time.max 
-                || p_file_info->parser_metrics->req_proc_time.max == 0) p_file_info->parser_metrics->req_proc_time.max = parser_metrics.req_proc_time.max;
-            p_file_info->parser_metrics->req_proc_time.sum += parser_metrics.req_proc_time.sum;
-            p_file_info->parser_metrics->req_proc_time.count += parser_metrics.req_proc_time.count;
-        }
+/**
+ * @brief Performs all the processing required for a chunk of a raw log message
+ * @details Each log message is split at newline boundaries into chunks that are parsed 
+ * concurrently, into metrics local to each chunk. The last chunk to finish parsing merges 
+ * the metrics of all the chunks into the metrics of the log source (with a single 
+ * acquisition of parser_mut) and then compresses the whole log message. In the future, 
+ * additional processing (such as streaming) will be performed.
+ */
+static void msg_parser(uv_work_t *work){
+    Circ_buff_parse_req_t *req = (Circ_buff_parse_req_t *) work;
+    struct File_info *p_file_info = req->p_file_info;
+    Circ_buff_t *buff = p_file_info->msg_buff;
 
-        /* Response code family */
-        if(p_file_info->parser_config->chart_config & CHART_RESP_CODE_FAMILY){
-            p_file_info->parser_metrics->resp_code_family.resp_1xx += parser_metrics.resp_code_family.resp_1xx;
-            p_file_info->parser_metrics->resp_code_family.resp_2xx += parser_metrics.resp_code_family.resp_2xx;
-            p_file_info->parser_metrics->resp_code_family.resp_3xx += parser_metrics.resp_code_family.resp_3xx;
-            p_file_info->parser_metrics->resp_code_family.resp_4xx += parser_metrics.resp_code_family.resp_4xx;
-            p_file_info->parser_metrics->resp_code_family.resp_5xx += parser_metrics.resp_code_family.resp_5xx;
-            p_file_info->parser_metrics->resp_code_family.other += parser_metrics.resp_code_family.other;
-        }
+    if(p_file_info->parser_config){
+        // TODO: verify bool should be set through log source configuration.
+        req->metrics = parse_text_buf(&req->parser_buffs, req->text, req->text_size, p_file_info->parser_config, 1);
+    }
 
-        /* Response code */
-        if(p_file_info->parser_config->chart_config & CHART_RESP_CODE){
-            for(int i = 0; i < 501; i++) p_file_info->parser_metrics->resp_code[i] += parser_metrics.resp_code[i];
-        }
+    /* Only the last chunk to be parsed carries on, at which point the metrics of all 
+     * the chunks are visible to it (due to the atomic decrement). */
+    Circ_buff_parse_req_t *leader = req->leader;
+    if(__atomic_sub_fetch(&leader->chunks_pending, 1, __ATOMIC_SEQ_CST)) return;
 
-        /* Response code type */
-        if(p_file_info->parser_config->chart_config & CHART_RESP_CODE_TYPE){
-            p_file_info->parser_metrics->resp_code_type.resp_success += parser_metrics.resp_code_type.resp_success;
-            p_file_info->parser_metrics->resp_code_type.resp_redirect += parser_metrics.resp_code_type.resp_redirect;
-            p_file_info->parser_metrics->resp_code_type.resp_bad += parser_metrics.resp_code_type.resp_bad;
-            p_file_info->parser_metrics->resp_code_type.resp_error += parser_metrics.resp_code_type.resp_error;
-            p_file_info->parser_metrics->resp_code_type.other += parser_metrics.resp_code_type.other;
-        }
+    Message_t *buff_msg_current = &buff->msgs[leader->index & buff->size_mask]; 
 
-        /* SSL protocol */
-        if(p_file_info->parser_config->chart_config & CHART_SSL_PROTO){
-            p_file_info->parser_metrics->ssl_proto.tlsv1 += parser_metrics.ssl_proto.tlsv1;
-            p_file_info->parser_metrics->ssl_proto.tlsv1_1 += parser_metrics.ssl_proto.tlsv1_1;
-            p_file_info->parser_metrics->ssl_proto.tlsv1_2 += parser_metrics.ssl_proto.tlsv1_2;
-            p_file_info->parser_metrics->ssl_proto.tlsv1_3 += parser_metrics.ssl_proto.tlsv1_3;
-            p_file_info->parser_metrics->ssl_proto.sslv2 += parser_metrics.ssl_proto.sslv2;
-            p_file_info->parser_metrics->ssl_proto.sslv3 += parser_metrics.ssl_proto.sslv3;
-            p_file_info->parser_metrics->ssl_proto.other += parser_metrics.ssl_proto.other;
-        }
+    unsigned long long num_lines_rate = 0;
+    if(p_file_info->parser_config){ 
+        for(req = leader; req; req = req->next_chunk) num_lines_rate += req->metrics.num_lines_rate;
+        if(num_lines_rate == 0) fatal("Parsed buffer did not contain any text or was of 0 size.");
 
-        /* SSL cipher suite */
-        if(p_file_info->parser_config->chart_config & CHART_SSL_CIPHER){
-            for(int i = 0; i < parser_metrics.ssl_cipher_arr.size; i++){
-                int j;
-                for(j = 0; j < p_file_info->parser_metrics->ssl_cipher_arr.size ; j++){
-                    if(!strcmp(parser_metrics.ssl_cipher_arr.ssl_ciphers[i].string, p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].string)) {
-                        p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[j].count += parser_metrics.ssl_cipher_arr.ssl_ciphers[i].count;
-                        break;
-                    }
-                }
-                if(p_file_info->parser_metrics->ssl_cipher_arr.size == j){
-                    p_file_info->parser_metrics->ssl_cipher_arr.size++;
-
-                    if(p_file_info->parser_metrics->ssl_cipher_arr.size >= p_file_info->parser_metrics->ssl_cipher_arr.size_max){
-                        p_file_info->parser_metrics->ssl_cipher_arr.size_max = p_file_info->parser_metrics->ssl_cipher_arr.size * LOG_PARSER_METRICS_SLL_CIPHER_BUFFS_SCALE_FACTOR + 1;
-                        
-                        p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers = reallocz(p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers, 
-                            p_file_info->parser_metrics->ssl_cipher_arr.size_max * sizeof(struct log_parser_metrics_ssl_cipher));
-                    }
-
-                    snprintf(p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[p_file_info->parser_metrics->ssl_cipher_arr.size - 1].string, 
-                        SSL_CIPHER_SUITE_MAX_LEN, "%s", parser_metrics.ssl_cipher_arr.ssl_ciphers[i].string);
-
-                    p_file_info->parser_metrics->ssl_cipher_arr.ssl_ciphers[p_file_info->parser_metrics->ssl_cipher_arr.size - 1].count = parser_metrics.ssl_cipher_arr.ssl_ciphers[i].count;
-                }
-            }
-            freez(parser_metrics.ssl_cipher_arr.ssl_ciphers); // TODO: Avoid mallocz()/freez() in future by reusing buffs
+        uv_mutex_lock(p_file_info->parser_mut);
+        for(req = leader; req; req = req->next_chunk) msg_parser_metrics_merge(p_file_info, &req->metrics);
+        uv_mutex_unlock(p_file_info->parser_mut);
+
+        for(req = leader; req; req = req->next_chunk){
+            parser_metrics_free(&req->metrics); // TODO: Avoid mallocz()/freez() in future by reusing buffs
         }
+    }
 
-        uv_mutex_unlock(p_file_info->parser_mut);
+    /* In metrics-only mode, the text is discarded now that it has been parsed, 
+     * except for any lines that must be kept. The item is still read by the DB 
+     * writer (which skips it, if empty), to release its space in order. */
+    if(p_file_info->metrics_only){
+        const size_t text_size = buff_msg_current->text_size;
+        size_t text_size_kept = 0;
+        if(p_file_info->keep_matcher || p_file_info->keep_sample_interval){
+            const uint64_t first_line_no = __atomic_fetch_add(&p_file_info->keep_sample_lines, num_lines_rate, __ATOMIC_SEQ_CST);
+            text_size_kept = filter_lines(buff_msg_current->text, text_size, p_file_info->keep_matcher, 
+                                          p_file_info->keep_sample_interval, first_line_no);
+        }
+        buff_msg_current->text_size = text_size_kept;
+        __atomic_sub_fetch(&buff->text_size_total, text_size - text_size_kept, __ATOMIC_SEQ_CST);
+        if(!text_size_kept){
+            buff_msg_current->text_compressed_size = 0;
+            buff_msg_current->bloom_size = 0;
+            goto parsed;
+        }
     }
 
+    buff_msg_current->codec = p_file_info->compr_codec;
+    if(p_file_info->compr_codec == LOGS_COMPR_CODEC_LZ4_DICT){
+        const struct compr_dict *compr_dict = &p_file_info->compr_dicts[p_file_info->compr_dicts_num - 1];
+        buff_msg_current->dict_id = compr_dict->id;
+        buff_msg_current->dict = compr_dict->data;
+        buff_msg_current->dict_size = compr_dict->size;
+        buff_msg_current->dict_stream = compr_dict->lz4_stream;
+    }
     compress_text(buff_msg_current);
+
+    /* Build bloom filter of message, so that keyword searches in the DB can skip it without decompressing it */
+    unsigned bloom_hashes;
+    buff_msg_current->bloom_size = keyword_bloom_filter_size(buff_msg_current->text, buff_msg_current->text_size, &bloom_hashes);
+    if(buff_msg_current->bloom_size > buff_msg_current->bloom_size_max){
+        buff_msg_current->bloom_size_max = buff_msg_current->bloom_size;
+        buff_msg_current->bloom = reallocz(buff_msg_current->bloom, buff_msg_current->bloom_size_max);
+    }
+    keyword_bloom_filter_build(buff_msg_current->text, buff_msg_current->text_size, 
+                               buff_msg_current->bloom, buff_msg_current->bloom_size, bloom_hashes);
 #if VALIDATE_COMPRESSION
     Message_t *temp_msg = callocz(1, sizeof(Message_t));
     temp_msg->text_compressed_size = buff_msg_current->text_compressed_size;
     temp_msg->text_compressed = callocz(1, temp_msg->text_compressed_size);
     memcpy(temp_msg->text_compressed, buff_msg_current->text_compressed, buff_msg_current->text_compressed_size);
     temp_msg->text_size = buff_msg_current->text_size;
+    temp_msg->codec = buff_msg_current->codec;
+    temp_msg->dict_id = buff_msg_current->dict_id;
+    temp_msg->dict = buff_msg_current->dict;
+    temp_msg->dict_size = buff_msg_current->dict_size;
     decompress_text(temp_msg, NULL);
     int cmp_res = memcmp(buff_msg_current->text, temp_msg->text, buff_msg_current->text_size);
     m_assert(!cmp_res, "Decompressed text != compressed text!");
@@ -356,38 +292,61 @@ static void msg_parser(uv_work_t *req){
     freez(temp_msg);
 #endif  // VALIDATE_COMPRESSION
 
-    uv_mutex_lock(&buff->mut);
-    buff->parsed_index++;
-    uv_mutex_unlock(&buff->mut);
+parsed:
+    /* Mark item as parsed and advance the parsed cursor over any contiguous parsed 
+     * items. Items may finish parsing out of order, so the cursor can only move up 
+     * to the first item that is still being parsed (which will advance it when done). */
+    __atomic_store_n(&buff_msg_current->status, CIRC_BUFF_ITEM_STATUS_PARSED, __ATOMIC_SEQ_CST);
+    uint64_t parsed = __atomic_load_n(&buff->parsed, __ATOMIC_SEQ_CST);
+    while(parsed != __atomic_load_n(&buff->head, __ATOMIC_SEQ_CST) && 
+          __atomic_load_n(&buff->msgs[parsed & buff->size_mask].status, __ATOMIC_SEQ_CST) == CIRC_BUFF_ITEM_STATUS_PARSED){
+        if(__atomic_compare_exchange_n(&buff->parsed, &parsed, parsed + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            parsed++;
+    }
 }
 
 /**
  * @brief Insert Message_t type items into the circular buffer of the file struct.
- * @details If the circular buffer is full, no new data will be inserted until there 
- * is enough space again.
- * If COMPRESSION_ENABLED is true, this function will also synchronously compress the text
- * of the Message_t inserted into the buffer.
+ * @details If the circular buffer is full (either out of items or out of its memory
+ * budget), no new data will be inserted until there is enough space again. In that 
+ * case, if allow_dropped_logs is set, the text will be dropped (and skipped in the
+ * log file), otherwise it will be left unconsumed so that the next read of the log 
+ * file is deferred until the DB writer has freed up space (backpressure).
+ * The text of the inserted Message_t will be parsed (in concurrent chunks, if large 
+ * enough) and compressed asynchronously by msg_parser(), in the threadpool of loop.
  * If VALIDATE_COMPRESSION is true, the compressed text will be validated by decompressing
  * it and comparing it against the original text.
  * The individual item buffers will grow as required (times BUFF_SCALE_FACTOR and remain at maximum size. 
  * @param p_file_info The file info struct containing the circular buffer and the text to 
  * be imported into it.
+ * @param loop Event loop to queue the parse requests on. The function must only be called 
+ * from the thread running this loop (as is always the case for the same circular buffer).
+ * @return 0 if the text was inserted into the buffer, -1 if the buffer was full.
  */
-void circ_buff_write(struct File_info *p_file_info) {
+int circ_buff_write(struct File_info *p_file_info, uv_loop_t *loop) {
     uint64_t end_time;
     const uint64_t start_time = get_unix_time_ms();
 
     Circ_buff_t *buff = p_file_info->msg_buff;
 
-    uv_mutex_lock(&buff->mut);
-    if (((buff->head_index + 1) & BUFF_SIZE_MASK) == (buff->tail_index & BUFF_SIZE_MASK)) {
-        uv_mutex_unlock(&buff->mut);
-        fprintf_log(LOGS_MANAG_WARNING, stderr, "Buffer out of space! Losing data!\n");
-        return;
+    const uint64_t head = buff->head; // No need for atomic load of head - only circ_buff_write can change it
+    const uint64_t tail = __atomic_load_n(&buff->tail, __ATOMIC_SEQ_CST);
+    const size_t text_size_total = __atomic_load_n(&buff->text_size_total, __ATOMIC_SEQ_CST);
+    if (head - tail >= (uint64_t) buff->num_of_items || 
+        (head != tail && text_size_total + p_file_info->buff_size > buff->text_size_total_max)) {
+        if(buff->allow_dropped_logs){
+            fprintf_log(LOGS_MANAG_WARNING, stderr, "Buffer out of space! Losing data!\n");
+            __atomic_add_fetch(&buff->num_of_msgs_dropped, 1, __ATOMIC_SEQ_CST);
+            p_file_info->filesize += p_file_info->buff_size - 1;
+        }
+        else {
+            fprintf_log(LOGS_MANAG_WARNING, stderr, "Buffer out of space! Deferring read of %s.\n", p_file_info->filename);
+            __atomic_add_fetch(&buff->num_of_writes_deferred, 1, __ATOMIC_SEQ_CST);
+        }
+        return -1;
     }
-    uv_mutex_unlock(&buff->mut);
 
-    Message_t *buff_msg_current = &buff->msgs[(buff->head_index) & BUFF_SIZE_MASK];  // No need to lock mut for reading head_index - only circ_buff_write can change it
+    Message_t *buff_msg_current = &buff->msgs[head & buff->size_mask];
 
     char *temp_text = buff_msg_current->text;
     size_t temp_size_max = buff_msg_current->text_size_max;
@@ -397,6 +356,7 @@ void circ_buff_write(struct File_info *p_file_info) {
     buff_msg_current->text_size = p_file_info->buff_size;
     buff_msg_current->text_size_max = p_file_info->buff_size_max;
     buff_msg_current->timestamp = get_unix_time_ms();
+    buff_msg_current->status = CIRC_BUFF_ITEM_STATUS_UNPROCESSED;
 
     p_file_info->buff = temp_text;
     p_file_info->buff_size = 0;
@@ -409,82 +369,156 @@ void circ_buff_write(struct File_info *p_file_info) {
 
     p_file_info->filesize += buff_msg_current->text_size - 1;
 
-    uv_mutex_lock(&buff->mut);
-    buff->head_index++;
-    buff->size++;
-    uv_mutex_unlock(&buff->mut);
+    __atomic_add_fetch(&buff->text_size_total, buff_msg_current->text_size, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&buff->head, head + 1, __ATOMIC_SEQ_CST); // Publish item only after it has been fully written
 
+    /* Split the text at newline boundaries into chunks to be parsed concurrently, 
+     * with at least CIRC_BUFF_PARSE_CHUNK_MIN_SIZE bytes per chunk. */
+    int num_of_chunks = 1;
     if(p_file_info->parser_config){
-    // TODO: Can we get rid of malloc here?
-        uv_work_t *req = mallocz(sizeof(uv_work_t));
-        req->data = (void *) p_file_info; 
-        uv_queue_work(circ_buff_loop, req, msg_parser, msg_parser_cleanup);
+        num_of_chunks = (int) (buff_msg_current->text_size / CIRC_BUFF_PARSE_CHUNK_MIN_SIZE);
+        if(num_of_chunks < 1) num_of_chunks = 1;
+        if(num_of_chunks > CIRC_BUFF_PARSE_CHUNKS_MAX) num_of_chunks = CIRC_BUFF_PARSE_CHUNKS_MAX;
+    }
+    char *const text_end = buff_msg_current->text + buff_msg_current->text_size;
+    char *chunk_start = buff_msg_current->text;
+    Circ_buff_parse_req_t *leader = NULL, *prev = NULL;
+    int chunks = 0;
+    while(chunk_start < text_end || !chunks){
+        char *chunk_end = text_end;
+        if(chunks < num_of_chunks - 1){
+            char *split = buff_msg_current->text + buff_msg_current->text_size * (chunks + 1) / num_of_chunks;
+            if(split < chunk_start) split = chunk_start;
+            char *newline = memchr(split, '\n', (size_t) (text_end - split));
+            if(newline) chunk_end = newline + 1;
+        }
+
+        Circ_buff_parse_req_t *req = parse_req_get(buff);
+        req->p_file_info = p_file_info;
+        req->index = head;
+        req->text = chunk_start;
+        req->text_size = (size_t) (chunk_end - chunk_start);
+        if(prev) prev->next_chunk = req;
+        else leader = req;
+        req->leader = leader;
+        prev = req;
+        chunks++;
+        chunk_start = chunk_end;
     }
+    leader->chunks_pending = chunks;
+    leader->after_work_pending = chunks;
+    for(Circ_buff_parse_req_t *req = leader; req; req = req->next_chunk) 
+        uv_queue_work(loop, &req->work, msg_parser, msg_parser_cleanup);
 
     end_time = get_unix_time_ms();
     fprintf_log(LOGS_MANAG_INFO, stderr, "It took %" PRIu64 "ms to insert message into buffer.\n", end_time - start_time);
+    return 0;
 }
 
 /**
  * @brief Read items from the circular buffer.
  * @details This function will return a pointer to the next item in the circular buffer
- * each time it is called, until the read_index matches the parsed_index i.e. all the 
- * compressed (and parsed) items in the buffer have been read. Only then the tail_index 
- * will be updated to indicate that all the read items space can be reused. Otherwise, 
- * the items between the tail_index and the read_index cannot be written.
+ * each time it is called, until the read cursor matches the parsed cursor i.e. all the 
+ * compressed (and parsed) items in the buffer have been read. The space of the read 
+ * items cannot be reused until circ_buff_read_done() is called, so they remain valid 
+ * (e.g. to be written to the DB in batches) until then.
  * @param buff The circular buffer to read items from.
- * @return Pointer to the Message_t type item of the circular buffer to be read.
+ * @return Pointer to the Message_t type item of the circular buffer to be read, or 
+ * NULL if there are no more items to be read.
  * */
 Message_t *circ_buff_read(Circ_buff_t *buff) {
-    uv_mutex_lock(&buff->mut);
-    if ((buff->parsed_index & BUFF_SIZE_MASK) == (buff->read_index & BUFF_SIZE_MASK)) {
-        buff->tail_index = buff->read_index;
-        uv_mutex_unlock(&buff->mut);
+    if (buff->read == __atomic_load_n(&buff->parsed, __ATOMIC_SEQ_CST)) {
         fprintf_log(LOGS_MANAG_DEBUG, stderr, "No more items to read from circular buffer!\n");
         return NULL;
     }
-    Message_t *p_msg = &buff->msgs[(buff->read_index++) & BUFF_SIZE_MASK];
-    // TODO: buff->size should be updated when tail_index is moved, not when read_index is moved.
-    buff->size--;
-    uv_mutex_unlock(&buff->mut);
-    return p_msg;
+    return &buff->msgs[(buff->read++) & buff->size_mask];
 };
 
+/**
+ * @brief Check if there are any items ready to be read from the circular buffer.
+ * @details Unlike circ_buff_read(), it does not move the read cursor, so it can be 
+ * used by the consumer to find out if there is anything to do before doing it.
+ * @param buff The circular buffer to check.
+ * @return Number of parsed items that have not been read yet.
+ * */
+uint64_t circ_buff_read_pending(Circ_buff_t *buff) {
+    return __atomic_load_n(&buff->parsed, __ATOMIC_SEQ_CST) - buff->read;
+}
+
+/**
+ * @brief Release the items read from the circular buffer.
+ * @details Updates the tail cursor to indicate that the space of all the items 
+ * returned by circ_buff_read() so far can be reused. 
+ * @param buff The circular buffer to release the read items of.
+ * */
+void circ_buff_read_done(Circ_buff_t *buff) {
+    size_t text_size_freed = 0;
+    for(uint64_t i = buff->tail; i != buff->read; i++) 
+        text_size_freed += buff->msgs[i & buff->size_mask].text_size;
+    __atomic_sub_fetch(&buff->text_size_total, text_size_freed, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&buff->tail, buff->read, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Return the items read from the circular buffer.
+ * @details Rewinds the read cursor to the tail cursor, so that all the items returned 
+ * by circ_buff_read() since the last circ_buff_read_done() will be read again 
+ * (e.g. because they could not be persisted).
+ * @param buff The circular buffer to return the read items to.
+ * */
+void circ_buff_read_undo(Circ_buff_t *buff) {
+    buff->read = buff->tail;
+}
+
 /**
  * @brief Search circular buffer according to the query_params.
- * @details Currently, the buffer can only be searched according to 
- * the timestamp range of the query parameters and not the keyword.
- * @warning It is not required to acquire buff->mut when reading tail_index, 
- * because it can only be changed through circ_buff_read() and this function
- * i.e. circ_buff_search() and circ_buff_read() are mutually exclusive due 
+ * @details The parsed items of the buffer are searched according to the timestamp 
+ * range of the query parameters and the keyword (if any). Items still being parsed 
+ * are skipped, as the text of items of metrics-only log sources is filtered in place 
+ * while being parsed.
+ * @warning It is not required to atomically read the tail cursor, 
+ * because it can only be changed through circ_buff_read_done() and this function
+ * i.e. circ_buff_search() and circ_buff_read_done() are mutually exclusive due 
  * to db_set_lock() and db_release_lock() in queries and when writing to DB.
  * @param buff Buffer to be searched
  * @param p_query_params Query parameters to search according to.
  */
 void circ_buff_search(Circ_buff_t *buff, logs_query_params_t *p_query_params, size_t max_query_page_size) {
-    uv_mutex_lock(&buff->mut);
-    uint8_t head_index_tmp = (buff->head_index & BUFF_SIZE_MASK);
-    uv_mutex_unlock(&buff->mut);
+    const uint64_t head = __atomic_load_n(&buff->parsed, __ATOMIC_SEQ_CST);
 
-    if (head_index_tmp == (buff->tail_index & BUFF_SIZE_MASK)) {
+    if (head == buff->tail) {
         fprintf_log(LOGS_MANAG_INFO, stderr, "Circ buff empty! Won't be searched.\n");
         return;  // Nothing to do if buff is emtpy
     }
 
-    for (uint8_t i = (buff->tail_index & BUFF_SIZE_MASK); i != head_index_tmp; i = (i + 1) % CIRCULAR_BUFF_SIZE) {
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "tail:%d head:%d i:%d\n", buff->tail_index & BUFF_SIZE_MASK, head_index_tmp, i);
-
-        if (buff->msgs[i].timestamp >= p_query_params->start_timestamp && buff->msgs[i].timestamp <= p_query_params->end_timestamp) {
-            fprintf_log(LOGS_MANAG_INFO, stderr, "Found text in circ buffer with timestamp: %" PRIu64 "\n", buff->msgs[i].timestamp);
-            fprintf_log(LOGS_MANAG_DEBUG, stdout, "Text to add: %s\n", buff->msgs[i].text);
-
-            buffer_increase(p_query_params->results_buff, buff->msgs[i].text_size);
-            memcpy(&p_query_params->results_buff->buffer[p_query_params->results_buff->len], buff->msgs[i].text, buff->msgs[i].text_size);
-            // buffer_overflow_check(p_query_params->results_buff);
-            p_query_params->results_buff->len += buff->msgs[i].text_size - 1; // -1 due to terminating NUL char
-
-            if(p_query_params->results_buff->len >= max_query_page_size){
-                p_query_params->end_timestamp = buff->msgs[i].timestamp;
+    for (uint64_t j = buff->tail; j != head; j++) {
+        Message_t *p_msg = &buff->msgs[j & buff->size_mask];
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "tail:%" PRIu64 " head:%" PRIu64 " j:%" PRIu64 "\n", buff->tail, head, j);
+
+        if (p_msg->text_size && p_msg->timestamp >= p_query_params->start_timestamp && p_msg->timestamp <= p_query_params->end_timestamp) {
+            fprintf_log(LOGS_MANAG_INFO, stderr, "Found text in circ buffer with timestamp: %" PRIu64 "\n", p_msg->timestamp);
+            fprintf_log(LOGS_MANAG_DEBUG, stdout, "Text to add: %s\n", p_msg->text);
+
+            buffer_increase(p_query_params->results_buff, p_msg->text_size + 1); // +1 as keyword search may append a newline to the last line
+            const size_t res_offset = p_query_params->results_buff->len;
+            char *const res = &p_query_params->results_buff->buffer[res_offset];
+            size_t size;
+            if(!p_query_params->keyword_matcher){
+                memcpy(res, p_msg->text, p_msg->text_size);
+                // buffer_overflow_check(p_query_params->results_buff);
+                size = p_msg->text_size;
+            }
+            else size = search_keyword(p_msg->text, p_msg->text_size, res, p_query_params->keyword_matcher);
+            /* Lines not matching the predicate (if any) are filtered out in place */
+            if(size && p_query_params->predicate_search) size = filter_lines_by_predicate(res, size, p_query_params->predicate_search);
+            /* Results returned already by the previous page of the query are dropped */
+            if(size && logs_query_res_skip(p_query_params, p_msg->timestamp, size - 1)) size = 0;
+            p_query_params->results_buff->len += size ? size - 1 : 0; // -1 due to terminating NUL char
+            if(size) logs_query_res_append(p_query_params, p_msg->timestamp, res_offset);
+
+            if(logs_query_quota_reached(p_query_params, max_query_page_size)){
+                p_query_params->end_timestamp = p_msg->timestamp;
+                p_query_params->truncated = 1;
                 // p_query_params->results_buff->len++; // In this case keep NUL char
                 break;
             }
@@ -492,44 +526,43 @@ void circ_buff_search(Circ_buff_t *buff, logs_query_params_t *p_query_params, si
     }
 }
 
-uint8_t circ_buff_get_size(Circ_buff_t *buff) {
-    uv_mutex_lock(&buff->mut);
-    uint8_t size = buff->size;
-    uv_mutex_unlock(&buff->mut);
-    return size;
+/**
+ * @brief Get number of items in use in the circular buffer
+ */
+int circ_buff_get_size(Circ_buff_t *buff) {
+    return (int) (__atomic_load_n(&buff->head, __ATOMIC_SEQ_CST) - __atomic_load_n(&buff->tail, __ATOMIC_SEQ_CST));
 }
 
 /**
- * @brief Process the events of the uv_loop_t related to the circular buffer
+ * @brief Get a snapshot of the occupancy and counters of the circular buffer
+ * @param[in] buff Circular buffer to get the statistics of
+ * @param[out] stats Where the statistics will be stored
  */
-static void circ_buff_loop_run(void *arg){
-    uv_run(circ_buff_loop, UV_RUN_DEFAULT);
+void circ_buff_get_stats(Circ_buff_t *buff, Circ_buff_stats_t *stats){
+    stats->num_of_items = circ_buff_get_size(buff);
+    stats->num_of_items_max = buff->num_of_items;
+    stats->text_size_total = __atomic_load_n(&buff->text_size_total, __ATOMIC_SEQ_CST);
+    stats->text_size_total_max = buff->text_size_total_max;
+    stats->num_of_writes_deferred = __atomic_load_n(&buff->num_of_writes_deferred, __ATOMIC_SEQ_CST);
+    stats->num_of_msgs_dropped = __atomic_load_n(&buff->num_of_msgs_dropped, __ATOMIC_SEQ_CST);
 }
 
 /**
  * @brief Create and initialise a new Circ_buff_t circular buffer
- * @ The first time that the function is executed, it will also create the event loop
- * to by used by any circular buffer functions (as and when required). 
+ * @param num_of_items Maximum number of items of the buffer. It will be rounded up to a power of 2.
+ * @param text_size_total_max Memory budget of the buffer (in bytes).
+ * @param allow_dropped_logs Boolean. If set, logs will be dropped rather than deferred when the buffer is full.
  * @return Pointer to the initialised circular buffer
  */ 
-Circ_buff_t *circ_buff_init() {
-    int rc = 0;
+Circ_buff_t *circ_buff_init(int num_of_items, size_t text_size_total_max, int allow_dropped_logs) {
     Circ_buff_t *buff = callocz(1, sizeof(Circ_buff_t));
-    *buff = (Circ_buff_t){0};
-    buff->tail_index = buff->read_index = buff->parsed_index = buff->parse_next_index = buff->head_index = 0;
-    buff->size = 0;
-    rc = uv_mutex_init(&buff->mut);
-    if (unlikely(rc)){
-        fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_mutex_init() error: (%d) %s\n", rc, uv_strerror(rc));
-        fatal("uv_mutex_init() error: (%d) %s\n", rc, uv_strerror(rc));
-    }
-    if(!circ_buff_loop){
-        circ_buff_loop = mallocz(sizeof(uv_loop_t));
-        rc = uv_loop_init(circ_buff_loop);
-        if (unlikely(rc)) fatal("uv_loop_init() error");
-        uv_thread_t *circ_buff_loop_run_thread = mallocz(sizeof(uv_thread_t));
-        rc = uv_thread_create(circ_buff_loop_run_thread, circ_buff_loop_run, NULL);
-        if (unlikely(rc)) fatal("uv_thread_create() error");
-    }
+
+    buff->num_of_items = 2;
+    while(buff->num_of_items < num_of_items) buff->num_of_items <<= 1;
+    buff->size_mask = (uint64_t) buff->num_of_items - 1;
+    buff->msgs = callocz(buff->num_of_items, sizeof(Message_t));
+    buff->text_size_total_max = text_size_total_max;
+    buff->allow_dropped_logs = allow_dropped_logs;
+
     return buff;
 }
@@ -15,7 +15,8 @@
 #include "query.h"
 #include "file_info.h"
 
-#define BUFF_SIZE_MASK (CIRCULAR_BUFF_SIZE - 1U)
+#define CIRC_BUFF_ITEM_STATUS_UNPROCESSED 0 /**< Item inserted in the circular buffer but not parsed and compressed yet **/
+#define CIRC_BUFF_ITEM_STATUS_PARSED 1      /**< Item parsed and compressed, ready to be read by the DB writer **/
 
 /** 
  * @struct Message
@@ -26,30 +27,93 @@
 typedef struct Message {
     uint64_t timestamp;              /**< Unix timestamp in milliseconds. */
     uint8_t db_fileInfos_Id;         /**< ID of File_info that the current message is associated to in the respective metadata table in DB. */
+    uint8_t status;                  /**< Status of the item when stored in a circular buffer, see CIRC_BUFF_ITEM_STATUS_*. Accessed atomically. */
     char *text;                      /**< Uncompressed text of the message */
     size_t text_size;                /**< Size of #text string */
     size_t text_size_max;            /**< Size of #text buffer (never reducing, always growing) */
     void *text_compressed;           /**< Compressed text of the message */
     size_t text_compressed_size;     /**< Size of #text_compressed */
     size_t text_compressed_size_max; /**< Size of #text_compressed buffer (never reducing, always growing */
+    uint8_t codec;                   /**< Codec of #text_compressed, see LOGS_COMPR_CODEC_* */
+    int dict_id;                     /**< Id of the dictionary #text_compressed was compressed with (0 if none) */
+    const char *dict;                /**< Dictionary #text_compressed was (or will be) compressed with, if codec is LOGS_COMPR_CODEC_LZ4_DICT */
+    size_t dict_size;                /**< Size of #dict */
+    const LZ4_stream_t *dict_stream; /**< #dict already loaded in an LZ4 stream (optional, NULL to load #dict for each compression) */
+    uint8_t *bloom;                  /**< Trigram bloom filter of #text, see keyword_bloom_filter_build() */
+    size_t bloom_size;               /**< Size of #bloom */
+    size_t bloom_size_max;           /**< Size of #bloom buffer (never reducing, always growing) */
 } Message_t;
 
+/** 
+ * @struct Circ_buff_parse_req
+ * @brief Request to parse a chunk of a log message of a circular buffer in the threadpool.
+ * @details The chunks of a log message are linked through #next_chunk, starting from the 
+ * first one (the leader), which also keeps track of how many of them are still pending.
+ * Requests are pooled per circular buffer and never freed.
+ */
+typedef struct Circ_buff_parse_req {
+    uv_work_t work;                             /**< Threadpool request. Must be the first member. */
+    struct File_info *p_file_info;              /**< Log source of the log message */
+    uint64_t index;                             /**< Cursor of the log message in the circular buffer */
+    char *text;                                 /**< Chunk of the text of the log message (whole lines) */
+    size_t text_size;                           /**< Size of #text */
+    Log_parser_buffs_t parser_buffs;            /**< Parser buffers, reused by every chunk parsed with this request */
+    Log_parser_metrics_t metrics;               /**< Metrics of this chunk only */
+    struct Circ_buff_parse_req *leader;         /**< Request of the first chunk of the log message */
+    struct Circ_buff_parse_req *next_chunk;     /**< Request of the next chunk of the log message */
+    int chunks_pending;                         /**< Leader only: number of chunks still to be parsed. Accessed atomically. */
+    int after_work_pending;                     /**< Leader only: number of chunks whose after work callback has not run yet */
+    struct Circ_buff_parse_req *next_free;      /**< Next request in the pool of free requests */
+} Circ_buff_parse_req_t;
+
+/** 
+ * @struct Circ_buff
+ * @brief Bounded circular buffer of log messages of a single log source.
+ * @details There is a single producer (circ_buff_write(), called from the main loop), 
+ * multiple parsers (msg_parser(), executed in the threadpool, possibly several of them 
+ * per item) and a single consumer 
+ * (circ_buff_read(), called from the DB writer). Rather than a mutex, the cursors
+ * are accessed atomically. They increase monotonically and never wrap around (they
+ * are mapped to an item using #size_mask), so that (head - tail) is always the 
+ * number of items in use. 
+ */
 typedef struct Circ_buff {
-    Message_t msgs[CIRCULAR_BUFF_SIZE];
-    uint8_t head_index;                 /**< Index pointing at one item after the last inserted msg */
-    uint8_t tail_index;                 /**< Index pointing at the oldest valid msg in the buffer */
-    uint8_t read_index;                 /**< Index pointing at one item after the last read msg */
-    uint8_t parsed_index;               /**< Index pointing at one item after the last parsed (i.e. ready to be read) msg */
-    uint8_t parse_next_index;           /**< Index pointing at the next item to be parsed. Required due to asynchronous logic of parser. */
-    uint8_t size;
-    uv_mutex_t mut;
-    Log_parser_buffs_t parser_buffs[CIRCULAR_BUFF_SIZE];
+    int num_of_items;                   /**< Number of items in #msgs. Always a power of 2. */
+    uint64_t size_mask;                 /**< Mask used to map a cursor to an item of #msgs (num_of_items - 1) */
+    Message_t *msgs;                    /**< Array of #num_of_items log messages */
+    uint64_t head;                      /**< Cursor pointing at one item after the last inserted msg. Only changed by circ_buff_write(). */
+    uint64_t parsed;                    /**< Cursor pointing at one item after the last parsed (i.e. ready to be read) msg */
+    uint64_t read;                      /**< Cursor pointing at one item after the last read msg. Only changed by circ_buff_read() and circ_buff_read_undo(). */
+    uint64_t tail;                      /**< Cursor pointing at the oldest valid msg in the buffer. Only changed by circ_buff_read_done(). */
+    size_t text_size_total;             /**< Total size of the text of all the items between #tail and #head */
+    size_t text_size_total_max;         /**< Memory budget of the buffer. No new item will be inserted if it would exceed it (unless the buffer is empty). */
+    int allow_dropped_logs;             /**< Boolean. If set, new logs will be dropped when the buffer is full. Otherwise, the next file read will be deferred. */
+    uint64_t num_of_writes_deferred;    /**< Number of writes (and file reads) deferred due to the buffer being full */
+    uint64_t num_of_msgs_dropped;       /**< Number of messages dropped due to the buffer being full */
+    Circ_buff_parse_req_t *parse_reqs_free; /**< Pool of free parse requests. Only accessed from the thread of circ_buff_write(). */
 } Circ_buff_t;
 
-void circ_buff_write(struct File_info *p_file_info);
+/** 
+ * @struct Circ_buff_stats
+ * @brief Snapshot of the occupancy and counters of a circular buffer, used for charts.
+ */
+typedef struct Circ_buff_stats {
+    int num_of_items;               /**< Number of items in use */
+    int num_of_items_max;           /**< Capacity of the buffer in items */
+    size_t text_size_total;         /**< Total size of the text of the items in use */
+    size_t text_size_total_max;     /**< Memory budget of the buffer */
+    uint64_t num_of_writes_deferred;
+    uint64_t num_of_msgs_dropped;
+} Circ_buff_stats_t;
+
+int circ_buff_write(struct File_info *p_file_info, uv_loop_t *loop);
 Message_t *circ_buff_read(Circ_buff_t *buff);
+uint64_t circ_buff_read_pending(Circ_buff_t *buff);
+void circ_buff_read_done(Circ_buff_t *buff);
+void circ_buff_read_undo(Circ_buff_t *buff);
 void circ_buff_search(Circ_buff_t *buff, logs_query_params_t *query_params, size_t max_query_page_size);
-uint8_t circ_buff_get_size(Circ_buff_t *buff);
-Circ_buff_t *circ_buff_init();
+int circ_buff_get_size(Circ_buff_t *buff);
+void circ_buff_get_stats(Circ_buff_t *buff, Circ_buff_stats_t *stats);
+Circ_buff_t *circ_buff_init(int num_of_items, size_t text_size_total_max, int allow_dropped_logs);
 
 #endif  // CIRCULAR_BUFFER_H_
@@ -7,10 +7,78 @@
 #include "compression.h"
 #include "helper.h"
 
+/**
+ * @brief Get compression codec from its configuration string
+ * @param str "lz4", "lz4hc" or "lz4 dictionary" (NULL means "lz4")
+ * @return One of LOGS_COMPR_CODEC_*, or -1 if str is invalid.
+ */
+int compr_codec_from_str(const char *str){
+    if(!str || !strcmp(str, "lz4")) return LOGS_COMPR_CODEC_LZ4F;
+    if(!strcmp(str, "lz4hc")) return LOGS_COMPR_CODEC_LZ4F_HC;
+    if(!strcmp(str, "lz4 dictionary")) return LOGS_COMPR_CODEC_LZ4_DICT;
+    return -1;
+}
+
+/**
+ * @brief Load a compression dictionary in an LZ4 stream
+ * @details The dictionary is hashed once, so that the stream can be shared (read-only) 
+ * by all the messages compressed with it, see Message_t::dict_stream.
+ * @param dict Dictionary, it must outlive the stream.
+ * @param dict_size Size of dict
+ * @return The stream, to be released with LZ4_freeStream().
+ */
+LZ4_stream_t *compr_dict_stream_create(const char *dict, size_t dict_size){
+    LZ4_stream_t *lz4_stream = LZ4_createStream();
+    if(unlikely(!lz4_stream)) fatal("LZ4_createStream() failed");
+    LZ4_loadDict(lz4_stream, dict, (int) dict_size);
+    return lz4_stream;
+}
+
+/**
+ * @brief Compress text using a dictionary
+ * @details The text is compressed as a single LZ4 block, using msg->dict. If 
+ * msg->dict_stream is set, the per-thread working stream starts from it instead of 
+ * loading the dictionary again. LZ4_attach_dictionary() is only part of the public 
+ * (shared library) API since LZ4 v1.10, so older versions copy the loaded stream.
+ * It falls back to LOGS_COMPR_CODEC_LZ4F if that fails.
+ * @return 0 on success, -1 on failure
+ */
+static int compress_text_with_dict(Message_t *msg){
+    const int outbufCapacity = LZ4_compressBound((int) msg->text_size);
+    if(unlikely(!outbufCapacity || !msg->dict || !msg->dict_size)) return -1;
+    if (!msg->text_compressed || (size_t) outbufCapacity > msg->text_compressed_size_max) {
+        msg->text_compressed_size_max = outbufCapacity * BUFF_SCALE_FACTOR;
+        msg->text_compressed = reallocz(msg->text_compressed, msg->text_compressed_size_max);
+    }
+
+    static thread_local LZ4_stream_t *lz4_stream = NULL;
+    if(unlikely(!lz4_stream && !(lz4_stream = LZ4_createStream()))) return -1;
+
+    if(likely(msg->dict_stream)){
+#if LZ4_VERSION_NUMBER >= 11000
+        LZ4_resetStream_fast(lz4_stream);
+        LZ4_attach_dictionary(lz4_stream, msg->dict_stream);
+#else
+        memcpy(lz4_stream, msg->dict_stream, sizeof(LZ4_stream_t));
+#endif
+    }
+    else{
+        LZ4_resetStream_fast(lz4_stream);
+        LZ4_loadDict(lz4_stream, msg->dict, (int) msg->dict_size);
+    }
+    const int compressed_size = LZ4_compress_fast_continue(lz4_stream, msg->text, msg->text_compressed, 
+                                                           (int) msg->text_size, outbufCapacity, 1);
+    if(unlikely(compressed_size <= 0)) return -1;
+
+    msg->text_compressed_size = (size_t) compressed_size;
+    return 0;
+}
+
 /**
  * @brief Compress text
- * @details This function will compress the text stored in msg. The results will be stored
- * inside the Message_t msg struct as well.
+ * @details This function will compress the text stored in msg, using the codec (and 
+ * dictionary, if applicable) of msg. The results will be stored inside the Message_t 
+ * msg struct as well.
  * @param[in,out] msg Message_t struct that holds the original text, its size, the 
  * compressed results and their size too.
  */
@@ -18,7 +86,22 @@ void compress_text(Message_t *msg) {
     uint64_t end_time;
     const uint64_t start_time = get_unix_time_ms();
 
-    size_t const outbufCapacity = LZ4F_compressFrameBound(msg->text_size, &kPrefs);
+    if(msg->codec == LOGS_COMPR_CODEC_LZ4_DICT){
+        if(likely(!compress_text_with_dict(msg))) goto done;
+        fprintf_log(LOGS_MANAG_ERROR, stderr, "Compression with dictionary failed, falling back to LZ4 frame\n");
+        msg->codec = LOGS_COMPR_CODEC_LZ4F;
+    }
+    if(msg->codec != LOGS_COMPR_CODEC_LZ4_DICT){
+        msg->dict_id = 0;
+        msg->dict = NULL;
+        msg->dict_size = 0;
+        msg->dict_stream = NULL;
+    }
+
+    LZ4F_preferences_t prefs = kPrefs;
+    if(msg->codec == LOGS_COMPR_CODEC_LZ4F_HC) prefs.compressionLevel = COMPR_LZ4HC_LEVEL;
+
+    size_t const outbufCapacity = LZ4F_compressFrameBound(msg->text_size, &prefs);
     fprintf_log(LOGS_MANAG_DEBUG, stderr, "Max outbufCapacity: %zuB\n", outbufCapacity);
     if (!msg->text_compressed || outbufCapacity > msg->text_compressed_size_max) {
         msg->text_compressed_size_max = outbufCapacity * BUFF_SCALE_FACTOR;
@@ -28,8 +111,9 @@ void compress_text(Message_t *msg) {
 
     msg->text_compressed_size = LZ4F_compressFrame(msg->text_compressed, outbufCapacity,
                                                    msg->text, msg->text_size,
-                                                   &kPrefs);
+                                                   &prefs);
 
+done:
     end_time = get_unix_time_ms();
     fprintf_log(LOGS_MANAG_INFO, stderr, "Original size: %zuB Compressed size: %zuB Ratio: x%zu\n",
                 msg->text_size, msg->text_compressed_size, msg->text_size / msg->text_compressed_size);
@@ -53,7 +137,8 @@ static size_t get_block_size(const LZ4F_frameInfo_t* info) {
 
 /**
  * @brief Decompress compressed text
- * @details This function will decompress the compressed text stored in msg. If out_buf is NULL,
+ * @details This function will decompress the compressed text stored in msg, according to its 
+ * codec (msg->dict must be set too, if it was compressed with a dictionary). If out_buf is NULL,
  * the results of the decompression will be stored inside the Message_t msg struct. Otherwise,
  * the results will be stored in out_buf (which must be large enough to store them).
  * @param[in,out] msg Message_t struct that stores the compressed text, its size and the 
@@ -61,61 +146,87 @@ static size_t get_block_size(const LZ4F_frameInfo_t* info) {
  * @param[in,out] out_buf Buffer to store the results of the decompression. In case it is NULL,
  * the results will be stored back in the msg struct. The out_buf must be pre-allocated and
  * large enough (equal to msg->text_size at least).
+ * @return 0 on success, -1 if the text could not be decompressed (e.g. corrupted or missing 
+ * dictionary), in which case the results are blanked with spaces.
  */
-void decompress_text(Message_t *msg, char* out_buf) {
+int decompress_text(Message_t *msg, char* out_buf) {
     const uint64_t start_time = get_unix_time_ms();
+    int failed = 0;
+
+    /* Dictionary compressed text is a single LZ4 block, of known decompressed size */
+    if(msg->codec == LOGS_COMPR_CODEC_LZ4_DICT){
+        if(out_buf == NULL) out_buf = msg->text = mallocz(msg->text_size);
+        const int rc = msg->dict ? LZ4_decompress_safe_usingDict(msg->text_compressed, out_buf, (int) msg->text_compressed_size, 
+                                                                 (int) msg->text_size, msg->dict, (int) msg->dict_size) : -1;
+        if(unlikely(rc != (int) msg->text_size)){
+            fprintf_log(LOGS_MANAG_ERROR, stderr, "Decompression with dictionary %d error: %d\n", msg->dict_id, rc);
+            failed = 1;
+        }
+        goto done;
+    }
+
+    if(out_buf == NULL) out_buf = msg->text = mallocz(msg->text_size);
 
     // Create decompression context
     LZ4F_dctx *dctx;
     size_t dctxStatus = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
     if (LZ4F_isError(dctxStatus)) {
         fprintf_log(LOGS_MANAG_ERROR, stderr, "LZ4F_dctx creation error: %s\n", LZ4F_getErrorName(dctxStatus));
+        failed = 1;
+        goto done;
     }
 
     // Retrieve Frame header
     LZ4F_frameInfo_t info;
-    size_t consumedSize = LZ4F_HEADER_SIZE_MAX;  // Ensure that header will be read
+    size_t consumedSize = msg->text_compressed_size < LZ4F_HEADER_SIZE_MAX ? msg->text_compressed_size : LZ4F_HEADER_SIZE_MAX;
     size_t const fires = LZ4F_getFrameInfo(dctx, &info, msg->text_compressed, &consumedSize);
     if (LZ4F_isError(fires)) {
         fprintf_log(LOGS_MANAG_ERROR, stderr, "LZ4F_getFrameInfo error: %s\n", LZ4F_getErrorName(fires));
+        failed = 1;
+    }
+    else if (unlikely(msg->text_size != info.contentSize)) {
+        /* The expected size is known from the metadata, a frame of another size must not be decompressed in out_buf */
+        fprintf_log(LOGS_MANAG_ERROR, stderr, "Decompressed size mismatch: %zu != %llu\n", msg->text_size, info.contentSize);
+        failed = 1;
     }
     fprintf_log(LOGS_MANAG_DEBUG, stderr, "Header size: %zu\n", consumedSize);
-    //fprintf(stderr, "msg->text_size: %zu, info.contentSize: %llu\n", msg->text_size, info.contentSize);
-    m_assert(msg->text_size == info.contentSize, "msg->text_size should be equal to info.contentSize");
 
     // Decompress
-    msg->text_size = (size_t) info.contentSize;  // Expected size of decompressed text
-    if(out_buf == NULL)
-        msg->text = mallocz(msg->text_size);        // Destination buffer
-    size_t srcSize = msg->text_compressed_size;  // text_compressed_size needs to be known!
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "sizeof decompressed content (msg->text_size): %zu\n", msg->text_size);
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "sizeof msg->text_compressed (bytes to decompress): %zu\n", srcSize);
-
-    size_t ret = 1;
     size_t decompressedSize = 0;
-    size_t dstSize = msg->text_size;
-    char **dstBuffer;
-    if(out_buf == NULL)
-        dstBuffer = &msg->text;
-    else
-        dstBuffer = &out_buf;
-    int i = 0;
-    while (ret != 0) {
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Iter: %d\n", i++);
-        ret = LZ4F_decompress(dctx, *dstBuffer + decompressedSize, &dstSize,
-                              (char *)msg->text_compressed + consumedSize,  // Cast to (char *) as (void *) arithmetic is illegal.
-                              &srcSize, /* LZ4F_decompressOptions_t */ NULL);
-        if (LZ4F_isError(ret)) 
-            fprintf_log(LOGS_MANAG_ERROR, stderr, "Decompression error: %s\n", LZ4F_getErrorName(ret));
-
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Number of decompressed bytes (dstSize): %zu\n", dstSize);
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Number of consumed bytes (srcSize): %zu\n", srcSize);
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "ret of LZ4F_decompress: %zu\n", ret);
-
-        consumedSize += srcSize;
-        decompressedSize += dstSize;
-        dstSize = info.contentSize - decompressedSize;
-        m_assert(i < 2, "There should only be 1 execution of decompression loop");
+    if(!failed){
+        size_t srcSize = msg->text_compressed_size - consumedSize;  // text_compressed_size needs to be known!
+        size_t dstSize = msg->text_size;
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "sizeof decompressed content (msg->text_size): %zu\n", msg->text_size);
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "sizeof msg->text_compressed (bytes to decompress): %zu\n", srcSize);
+
+        size_t ret = 1;
+        int i = 0;
+        while (ret != 0) {
+            fprintf_log(LOGS_MANAG_DEBUG, stderr, "Iter: %d\n", i++);
+            ret = LZ4F_decompress(dctx, out_buf + decompressedSize, &dstSize,
+                                  (char *)msg->text_compressed + consumedSize,  // Cast to (char *) as (void *) arithmetic is illegal.
+                                  &srcSize, /* LZ4F_decompressOptions_t */ NULL);
+            if (LZ4F_isError(ret)) {
+                fprintf_log(LOGS_MANAG_ERROR, stderr, "Decompression error: %s\n", LZ4F_getErrorName(ret));
+                failed = 1;
+                break;
+            }
+
+            fprintf_log(LOGS_MANAG_DEBUG, stderr, "Number of decompressed bytes (dstSize): %zu\n", dstSize);
+            fprintf_log(LOGS_MANAG_DEBUG, stderr, "Number of consumed bytes (srcSize): %zu\n", srcSize);
+            fprintf_log(LOGS_MANAG_DEBUG, stderr, "ret of LZ4F_decompress: %zu\n", ret);
+
+            consumedSize += srcSize;
+            decompressedSize += dstSize;
+            if (ret && (consumedSize >= msg->text_compressed_size || !srcSize && !dstSize)) {
+                fprintf_log(LOGS_MANAG_ERROR, stderr, "Decompression error: truncated LZ4 frame\n");
+                failed = 1;
+                break;
+            }
+            dstSize = msg->text_size - decompressedSize;
+            srcSize = msg->text_compressed_size - consumedSize;
+        }
+        if (!failed && decompressedSize != msg->text_size) failed = 1;
     }
 
     // Free decompression context
@@ -124,6 +235,11 @@ void decompress_text(Message_t *msg, char* out_buf) {
         fprintf_log(LOGS_MANAG_ERROR, stderr, "LZ4F_dctx creation error: %s\n", LZ4F_getErrorName(dctxStatus));
     }
 
-    const uint64_t end_time = get_unix_time_ms();
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "It took %" PRId64 "ms to decompress.\n", end_time - start_time);
+done:
+    if(unlikely(failed) && msg->text_size){
+        memset(out_buf, ' ', msg->text_size);
+        out_buf[msg->text_size - 1] = '\0';
+    }
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "It took %" PRId64 "ms to decompress.\n", get_unix_time_ms() - start_time);
+    return failed ? -1 : 0;
 }
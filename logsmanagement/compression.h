@@ -7,10 +7,15 @@
 #ifndef COMPRESSION_H_
 #define COMPRESSION_H_
 
+#include <lz4.h>
 #include <lz4frame.h>
 #include "circular_buffer.h"
 #include "config_.h"
 
+#define LOGS_COMPR_CODEC_LZ4F 0       /**< Independent LZ4 frame with default preferences (kPrefs). Default and codec of any logs stored before codecs were introduced. */
+#define LOGS_COMPR_CODEC_LZ4F_HC 1    /**< Independent LZ4 frame, compressed with LZ4HC (COMPR_LZ4HC_LEVEL) for higher ratio. */
+#define LOGS_COMPR_CODEC_LZ4_DICT 2   /**< LZ4 block compressed using a per-source dictionary. The decompressed size must be known. */
+
 static const LZ4F_preferences_t kPrefs = {
     {LZ4F_max64KB, LZ4F_blockLinked, LZ4F_noContentChecksum, LZ4F_frame,
      1 /* set content size flag */, 0 /* no dictID */, LZ4F_noBlockChecksum},
@@ -20,7 +25,9 @@ static const LZ4F_preferences_t kPrefs = {
     {0, 0, 0}, /* reserved, must be set to 0 */
 };
 
+int compr_codec_from_str(const char *str);
+LZ4_stream_t *compr_dict_stream_create(const char *dict, size_t dict_size);
 void compress_text(Message_t *msg);
-void decompress_text(Message_t *msg, char* out_buf);
+int decompress_text(Message_t *msg, char* out_buf);
 
 #endif  // COMPRESSION_H_
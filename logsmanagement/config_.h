@@ -12,9 +12,24 @@
 #define GiB * 1073741824UL
 
 #define MAX_LOG_MSG_SIZE 50 MiB   /**< Maximum allowable log message size (in Bytes) to be stored in message queue and DB. **/
-#define DB_FLUSH_BUFF_INTERVAL 8000U /**< Interval (in ms) to attempt to flush individual queues to DB. **/
+#define DB_FLUSH_BUFF_INTERVAL 8000U /**< Default interval (in ms) to attempt to flush individual queues to DB, unless configured otherwise through "db flush interval ms". **/
+#define DB_WRITER_BATCH_DEFAULT_MAX_MSGS 32 /**< Default maximum number of log messages written to DB with a single vectored write and INSERT, unless configured otherwise through "db write batch max messages". **/
+#define DB_WRITER_BATCH_MAX_MSGS 64 /**< Upper limit of "db write batch max messages". **/
+#define DB_WRITER_BATCH_MAX_BYTES 8 MiB /**< Maximum size of the compressed log messages written to DB with a single vectored write, unless a single log message is larger. **/
+#define DB_WRITER_THREADS_DEFAULT 4 /**< Default number of DB writer threads shared by all log sources, unless configured otherwise through "db writer threads" in [global]. **/
+#define DB_COMPACTOR_INTERVAL_DEFAULT 60 /**< Default interval (in seconds) between runs of the DB compactor, which enforces the retention of the log sources and recompresses their cold BLOBs, unless configured otherwise through "db compaction interval secs" in [global]. **/
+#define DB_METADATA_CACHE_SIZE_DEFAULT 2000 /**< Default page cache size (in KiB) of the metadata DB of each log source, unless configured otherwise through "db metadata cache size KiB" in [global]. **/
 #define LOG_FILE_READ_INTERVAL 1000U /**< Minimum interval (in ms) to permit reading of log file contents in message queue. **/
-#define CIRCULAR_BUFF_SIZE (16U)     /**< IMPORTANT!: Needs to always be a power of 2! Also, note that true size is CIRCULAR_BUFF_SIZE - 1 because 1 element is empty when buff is full **/
+#define CIRC_BUFF_DEFAULT_MAX_ITEMS 16  /**< Default maximum number of items of the circular buffer of each log source, unless configured otherwise through "circular buffer max items". Rounded up to a power of 2. **/
+#define CIRC_BUFF_DEFAULT_MAX_SIZE 64 MiB /**< Default memory budget of the circular buffer of each log source, unless configured otherwise through "circular buffer max size MiB". **/
+#define REQ_CLIENTS_ALLTIME_DEFAULT_MAX_MEM 32 MiB /**< Default memory cap of the hash sets of all-time unique client IPs of a log source, unless configured otherwise through "unique client IPs - all-time max memory MiB". **/
+#define REQ_CLIENTS_HLL_DEFAULT_PRECISION 14 /**< Default HyperLogLog precision of unique client IPs, when "unique client IPs - counting" is "hyperloglog", unless configured otherwise through "unique client IPs - hyperloglog precision". Standard error is about 1.04 / sqrt(2^precision). **/
+#define REQ_CLIENTS_HLL_MIN_PRECISION 4 /**< Minimum allowable "unique client IPs - hyperloglog precision". **/
+#define REQ_CLIENTS_HLL_MAX_PRECISION 18 /**< Maximum allowable "unique client IPs - hyperloglog precision". **/
+#define CIRC_BUFF_PARSE_CHUNK_MIN_SIZE 256 KiB /**< Minimum size of the chunks a log message is split into, to be parsed concurrently. **/
+#define CIRC_BUFF_PARSE_CHUNKS_MAX 8 /**< Maximum number of chunks a log message is split into, to be parsed concurrently. **/
+#define COMPR_DICT_SIZE 32 KiB /**< Size of the compression dictionary of a log source, when "compression" is set to "lz4 dictionary". Must not exceed 64 KiB. **/
+#define COMPR_LZ4HC_LEVEL 9 /**< Compression level used when "compression" is set to "lz4hc" (LZ4HC_CLEVEL_DEFAULT). **/
 #define VALIDATE_COMPRESSION 0 /**< For testing purposes only as it slows down compression considerably. **/
 #define MAX_FILE_SIGNATURE_SIZE 1 KiB /**< Maximum signature size to uniquely identify a file. It is used to detect log rotations. */
 #define FS_EVENTS_REENABLE_INTERVAL 1000U /**< Interval to wait for before attempting to re-register a certain log file, after it was not found (due to rotation or other reason). **/
@@ -22,5 +37,11 @@
 
 #define BLOB_MAX_SIZE 200 MiB /**< Maximum quota for BLOB files, used to store compressed logs. When exceeded, the BLOB file will be rotated. **/
 #define BLOB_MAX_FILES 10	  /**< Maximum allowed number of BLOB files (per collection) that are used to store compressed logs. When exceeded, the olderst one will be overwritten. **/
+#define DB_BLOOM_FILTER_FALSE_POSITIVE_RATE 0.01 /**< Target false positive rate (per trigram) of the trigram bloom filter stored along with each log message, used to skip messages in keyword searches. **/
+#define DB_BLOOM_FILTER_MAX_HASHES 16 /**< Maximum number of hashes (bits per trigram) of the trigram bloom filter of a log message. **/
+#define DB_BLOOM_FILTER_SKETCH_SIZE 4 KiB /**< Size of the bitmap used to estimate the distinct trigrams of a log message, to size its bloom filter. **/
+#define DB_BLOOM_FILTER_MIN_SIZE 64 /**< Minimum size of the trigram bloom filter of a log message (in Bytes). Must be a power of 2. **/
+#define DB_BLOOM_FILTER_MAX_SIZE 64 KiB /**< Maximum size of the trigram bloom filter of a log message (in Bytes). Must be a power of 2. **/
+#define DB_SEARCH_SPAN_MAX_SIZE 4 MiB /**< Maximum size of a contiguous BLOB span that will be read with a single read operation when searching the DB. **/
 
 #endif  // CONFIG__H_
@@ -17,9 +17,11 @@
 #define MAIN_DB "main.db" /**< Primary DB with just 1 table - MAIN_COLLECTIONS_TABLE **/
 #define MAIN_COLLECTIONS_TABLE "LogCollections"
 #define BLOB_STORE_FILENAME "logs.bin"
+#define BLOB_COMPACT_FILENAME BLOB_STORE_FILENAME ".compact" /**< Temporary file a BLOB is recompressed into by the DB compactor (followed by the BLOB Id) **/
 #define METADATA_DB_FILENAME "metadata.db"
 #define LOGS_TABLE "Logs"
 #define BLOBS_TABLE "Blobs"
+#define DICTS_TABLE "Dicts"
 
 static uv_loop_t *db_loop;
 static sqlite3 *main_db;
@@ -76,229 +78,1842 @@ char *db_get_sqlite_version() {
     return text;
 }
 
-static void db_writer(void *arg){
-	int rc = 0;
-	struct File_info *p_file_info = *((struct File_info **) arg);
-	fprintf_log(LOGS_MANAG_DEBUG, stderr, "Entering writer thread for: %s\n", p_file_info->filename);
+/**
+ * @brief Prepare a multi-row LOGS_TABLE INSERT statement
+ * @param db Metadata DB of the log source
+ * @param num_of_rows Number of rows (i.e. log messages) to be inserted by the statement
+ * @return The prepared statement
+ */
+static sqlite3_stmt *db_writer_prepare_logs_insert(sqlite3 *db, int num_of_rows){
+	static const char insert_prefix[] = "INSERT INTO " LOGS_TABLE "("
+										"FK_BLOB_Id,"
+										"BLOB_Offset,"
+										"Timestamp,"
+										"Msg_compr_size,"
+										"Msg_decompr_size,"
+										"Bloom,"
+										"Codec,"
+										"Dict_id"
+										") VALUES ";
+	static const char insert_row[] = "(?,?,?,?,?,?,?,?),";
+	char sql[sizeof(insert_prefix) + DB_WRITER_BATCH_MAX_MSGS * (sizeof(insert_row) - 1) + 1];
 	
-	uv_loop_t *writer_loop = mallocz(sizeof(uv_loop_t));
-    rc = uv_loop_init(writer_loop);
-    if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-    
-    /* Prepare LOGS_TABLE INSERT statement */
+	m_assert(num_of_rows > 0 && num_of_rows <= DB_WRITER_BATCH_MAX_MSGS, "num_of_rows out of range");
+	char *p = stpcpy(sql, insert_prefix);
+	for(int i = 0; i < num_of_rows; i++) p = stpcpy(p, insert_row);
+	*(p - 1) = ';'; // Replace last ','
+
 	sqlite3_stmt *stmt_logs_insert;
-	rc = sqlite3_prepare_v2(p_file_info->db,
-                        "INSERT INTO " LOGS_TABLE "("
-                        "FK_BLOB_Id,"
-                        "BLOB_Offset,"
-                        "Timestamp,"
-                        "Msg_compr_size,"
-                        "Msg_decompr_size"
-                        ") VALUES (?,?,?,?,?) ;",
-                        -1, &stmt_logs_insert, NULL);
-    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-     
-    /* Prepare BLOBS_TABLE UPDATE statement */
+	int rc = sqlite3_prepare_v2(db, sql, -1, &stmt_logs_insert, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	return stmt_logs_insert;
+}
+
+/**
+ * @brief Make any renames in the DB directory of a log source durable
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ * @param db_dir DB directory of the log source
+ */
+static void db_dir_sync(uv_loop_t *loop, const char *db_dir){
+	uv_fs_t req;
+	int rc = uv_fs_open(loop, &req, db_dir, UV_FS_O_RDONLY, 0, NULL);
+	uv_fs_req_cleanup(&req);
+	if(unlikely(rc < 0)){
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to open %s for syncing: %s\n", db_dir, uv_strerror(rc));
+		return;
+	}
+	const uv_file dir_handle = rc;
+	rc = uv_fs_fsync(loop, &req, dir_handle, NULL);
+	uv_fs_req_cleanup(&req);
+	if(unlikely(rc)) fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to sync %s: %s\n", db_dir, uv_strerror(rc));
+	uv_fs_close(loop, &req, dir_handle, NULL);
+	uv_fs_req_cleanup(&req);
+}
+
+/**
+ * @brief Check if a file exists
+ * @return Size of the file, or -1 if it does not exist.
+ */
+static int64_t db_file_size(uv_loop_t *loop, const char *path){
+	uv_fs_t stat_req;
+	const int rc = uv_fs_stat(loop, &stat_req, path, NULL);
+	const int64_t size = rc ? -1 : (int64_t) uv_fs_get_statbuf(&stat_req)->st_size;
+	uv_fs_req_cleanup(&stat_req);
+	return size;
+}
+
+/**
+ * @brief Check if the BLOB file with a certain number exists
+ */
+static int db_blob_file_exists(uv_loop_t *loop, const char *db_dir, int num){
+	char path[FILENAME_MAX + 1];
+	snprintf(path, FILENAME_MAX, "%s" BLOB_STORE_FILENAME ".%d", db_dir, num);
+	return db_file_size(loop, path) >= 0;
+}
+
+/**
+ * @brief Rename the BLOB file with a certain number to another number
+ * @return 0 on success, a libuv error code otherwise
+ */
+static int db_blob_file_rename(uv_loop_t *loop, const char *db_dir, int from, int to){
+	char old_path[FILENAME_MAX + 1], new_path[FILENAME_MAX + 1];
+	uv_fs_t rename_req;
+	snprintf(old_path, FILENAME_MAX, "%s" BLOB_STORE_FILENAME ".%d", db_dir, from);
+	snprintf(new_path, FILENAME_MAX, "%s" BLOB_STORE_FILENAME ".%d", db_dir, to);
+	const int rc = uv_fs_rename(loop, &rename_req, old_path, new_path, NULL);
+	uv_fs_req_cleanup(&rename_req);
+	return rc;
+}
+
+/**
+ * @brief Rename the BLOB with a certain number to another number in BLOBS_TABLE
+ * @param stmt_rotate_blobs Prepared "UPDATE ... SET Filename = ? WHERE Filename = ?" statement
+ */
+static void db_blob_metadata_rename(sqlite3_stmt *stmt_rotate_blobs, int from, int to){
+	char old_filename[sizeof(BLOB_STORE_FILENAME) + 12], new_filename[sizeof(BLOB_STORE_FILENAME) + 12];
+	snprintf(old_filename, sizeof(old_filename), BLOB_STORE_FILENAME ".%d", from);
+	snprintf(new_filename, sizeof(new_filename), BLOB_STORE_FILENAME ".%d", to);
+	int rc = sqlite3_bind_text(stmt_rotate_blobs, 1, new_filename, -1, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_text(stmt_rotate_blobs, 2, old_filename, -1, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(stmt_rotate_blobs);
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_reset(stmt_rotate_blobs);
+}
+
+/**
+ * @brief State of the DB writer of a single log source
+ */
+typedef struct db_writer {
+	struct File_info *p_file_info;
+	sqlite3_stmt *stmt_logs_insert[DB_WRITER_BATCH_MAX_MSGS + 1]; /**< LOGS_TABLE multi-row INSERT statements, one for each batch size, prepared when first needed */
 	sqlite3_stmt *stmt_blobs_update;
+	sqlite3_stmt *stmt_rotate_blobs;
+	sqlite3_stmt *stmt_blobs_set_zero_filesize;
+	sqlite3_stmt *stmt_logs_delete;
+	sqlite3_stmt *stmt_blobs_get;               /**< Used by the DB compactor: metadata of all the BLOBs */
+	sqlite3_stmt *stmt_blob_filename_get;       /**< Used by the DB compactor: filename of a BLOB */
+	sqlite3_stmt *stmt_blob_msgs_get;           /**< Used by the DB compactor: metadata of the log messages of a BLOB */
+	sqlite3_stmt *stmt_logs_update_compacted;   /**< Used by the DB compactor: metadata of a recompressed log message */
+	sqlite3_stmt *stmt_blobs_set_compacted;     /**< Used by the DB compactor: metadata of a recompressed BLOB */
+	int64_t blob_filesize;          /**< Filesize of the current write-to BLOB */
+	int64_t metadata_page_size;     /**< Page size of metadata DB, used to convert the pages written by SQLite to bytes */
+	usec_t next_flush_time;         /**< Monotonic time when the next flush of this log source is due */
+	int busy;                       /**< Set while a worker of the pool is flushing this log source */
+} db_writer_t;
+
+/**
+ * @brief Pool of worker threads that flush the circular buffers of all the log sources to the DB
+ * @details Instead of one thread per log source, a fixed number of workers services all the 
+ * writers. Each worker picks the (non-busy) writer whose flush is due the earliest, scanning 
+ * in round-robin order so that ties are resolved fairly, flushes it and reschedules it.
+ */
+static struct db_writer_pool {
+	uv_mutex_t mut;
+	uv_cond_t cond;
+	db_writer_t **writers;
+	int num_of_writers;
+	int rr_next;                    /**< Round-robin offset to start searching for the next writer from */
+} db_writer_pool;
+
+/**
+ * @brief Initialise the DB writer of a log source
+ * @param p_file_info Log source, its metadata DB must already be initialised.
+ * @return The DB writer of the log source
+ */
+static db_writer_t *db_writer_init(struct File_info *p_file_info){
+	int rc = 0;
+	db_writer_t *writer = callocz(1, sizeof(db_writer_t));
+	writer->p_file_info = p_file_info;
+     
+    /* Prepare BLOBS_TABLE UPDATE statement. It also keeps track of the newest log message 
+     * of the BLOB (just inserted), used to enforce retention and to delete the log messages
+     * of the BLOB with a range DELETE, as they are always contiguous in LOGS_TABLE. */
 	rc = sqlite3_prepare_v2(p_file_info->db,
                             "UPDATE " BLOBS_TABLE
-                            " SET Filesize = Filesize + ?"
+                            " SET Filesize = Filesize + ?, Last_timestamp = ?, Last_log_id = last_insert_rowid()"
                             " WHERE Id = ? ;",
-                            -1, &stmt_blobs_update, NULL);
+                            -1, &writer->stmt_blobs_update, NULL);
     if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
     
-    /* Prepare BLOBS_TABLE Filename rotate statement */
-	sqlite3_stmt *stmt_rotate_blobs;
+    /* Prepare BLOBS_TABLE Filename rotate statement. Filenames must be matched as a whole, 
+     * e.g. replacing "1" with "2" must not turn "logs.bin.10" into "logs.bin.20". */
 	rc = sqlite3_prepare_v2(p_file_info->db,
 							"UPDATE " BLOBS_TABLE
-							" SET Filename = REPLACE(Filename, ?, ?);",
-							-1, &stmt_rotate_blobs, NULL);
+							" SET Filename = ? WHERE Filename = ? ;",
+							-1, &writer->stmt_rotate_blobs, NULL);
 	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
 	
 	/* Prepare BLOBS_TABLE UPDATE SET zero filesize statement */
-	sqlite3_stmt *stmt_blobs_set_zero_filesize;
 	rc = sqlite3_prepare_v2(p_file_info->db,
                             "UPDATE " BLOBS_TABLE
-                            " SET Filesize = 0"
+                            " SET Filesize = 0, Last_timestamp = 0, Last_log_id = 0, Compacted = 0"
                             " WHERE Id = ? ;",
-                            -1, &stmt_blobs_set_zero_filesize, NULL);
+                            -1, &writer->stmt_blobs_set_zero_filesize, NULL);
     if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
     
-    /* Prepare LOGS_TABLE DELETE statement */
-	sqlite3_stmt *stmt_logs_delete;
+    /* Prepare LOGS_TABLE DELETE statement (a range DELETE on the primary key) */
 	rc = sqlite3_prepare_v2(p_file_info->db,
                             "DELETE FROM " LOGS_TABLE
-                            " WHERE FK_BLOB_Id = ? ;",
-                            -1, &stmt_logs_delete, NULL);
+                            " WHERE Id <= (SELECT Last_log_id FROM " BLOBS_TABLE " WHERE Id = ?1) AND FK_BLOB_Id = ?1 ;",
+                            -1, &writer->stmt_logs_delete, NULL);
+    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+
+    /* Prepare statements of the DB compactor */
+	rc = sqlite3_prepare_v2(p_file_info->db,
+                            "SELECT Id, Filesize, Last_timestamp, Last_log_id, Compacted FROM " BLOBS_TABLE " ;",
+                            -1, &writer->stmt_blobs_get, NULL);
+    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_prepare_v2(p_file_info->db,
+                            "SELECT Filename FROM " BLOBS_TABLE " WHERE Id = ? ;",
+                            -1, &writer->stmt_blob_filename_get, NULL);
+    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_prepare_v2(p_file_info->db,
+                            "SELECT Id, BLOB_Offset, Msg_compr_size, Msg_decompr_size, Codec, Dict_id FROM " LOGS_TABLE
+                            " WHERE Id > ? AND Id <= ? AND FK_BLOB_Id = ? ORDER BY Id ;",
+                            -1, &writer->stmt_blob_msgs_get, NULL);
+    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_prepare_v2(p_file_info->db,
+                            "UPDATE " LOGS_TABLE
+                            " SET BLOB_Offset = ?, Msg_compr_size = ?, Codec = ?, Dict_id = ?"
+                            " WHERE Id = ? ;",
+                            -1, &writer->stmt_logs_update_compacted, NULL);
+    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_prepare_v2(p_file_info->db,
+                            "UPDATE " BLOBS_TABLE
+                            " SET Filesize = ?, Compacted = 1"
+                            " WHERE Id = ? ;",
+                            -1, &writer->stmt_blobs_set_compacted, NULL);
     if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
 		
 	/* Get initial filesize of logs.bin.0 BLOB */
     sqlite3_stmt *stmt_retrieve_filesize_from_id;
 	rc = sqlite3_prepare_v2(p_file_info->db,
-							"SELECT Filesize FROM " BLOBS_TABLE 
-							" WHERE Id = ? ;",
-							-1, &stmt_retrieve_filesize_from_id, NULL);
+							"SELECT Filesize FROM " BLOBS_TABLE 
+							" WHERE Id = ? ;",
+							-1, &stmt_retrieve_filesize_from_id, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_int(stmt_retrieve_filesize_from_id, 1, p_file_info->blob_write_handle_offset);
+    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+    rc = sqlite3_step(stmt_retrieve_filesize_from_id);
+	if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__);
+	writer->blob_filesize = (int64_t) sqlite3_column_int64(stmt_retrieve_filesize_from_id, 0);
+	sqlite3_finalize(stmt_retrieve_filesize_from_id);
+	
+	fprintf_log(LOGS_MANAG_DEBUG, stderr, "initial blob_filesize: %" PRId64 "\n", writer->blob_filesize);
+	
+	/* Get page size of metadata DB */
+	sqlite3_stmt *stmt_get_page_size;
+	rc = sqlite3_prepare_v2(p_file_info->db, "PRAGMA page_size;", -1, &stmt_get_page_size, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	if (sqlite3_step(stmt_get_page_size) == SQLITE_ROW) writer->metadata_page_size = sqlite3_column_int64(stmt_get_page_size, 0);
+	sqlite3_finalize(stmt_get_page_size);
+
+	writer->next_flush_time = now_monotonic_usec() + (usec_t) p_file_info->db_flush_interval * USEC_PER_MS;
+
+	return writer;
+}
+
+/**
+ * @brief Drop all the log messages of a BLOB
+ * @details The metadata of the log messages are deleted with a range DELETE and the 
+ * BLOB is truncated. The BLOB file itself is kept, as BLOB Ids (and file handles) are
+ * fixed. Must be called with the DB lock of the log source held.
+ * @param writer DB writer of the log source
+ * @param blob_id Id of the BLOB in BLOBS_TABLE
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ */
+static void db_blob_drop(db_writer_t *writer, int blob_id, uv_loop_t *loop){
+	int rc = 0;
+	struct File_info *p_file_info = writer->p_file_info;
+	uv_fs_t trunc_req;
+
+	/* The log messages must be deleted before Last_log_id is reset */
+	sqlite3_exec(p_file_info->db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+	rc = sqlite3_bind_int(writer->stmt_logs_delete, 1, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(writer->stmt_logs_delete);
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_reset(writer->stmt_logs_delete);
+	rc = sqlite3_bind_int(writer->stmt_blobs_set_zero_filesize, 1, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(writer->stmt_blobs_set_zero_filesize);
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_reset(writer->stmt_blobs_set_zero_filesize);
+	sqlite3_exec(p_file_info->db, "END TRANSACTION;", NULL, NULL, NULL);
+
+	rc = uv_fs_ftruncate(loop, &trunc_req, p_file_info->blob_handles[blob_id], 0, NULL);
+	if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+	uv_fs_req_cleanup(&trunc_req);
+}
+
+/**
+ * @brief Write a batch of buffers to a file, retrying on partial writes
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ * @param file File handle to write to
+ * @param bufs Buffers to write. They are modified to track the progress of partial writes.
+ * @param nbufs Number of buffers in bufs
+ * @param offset Offset in file to write the buffers at
+ * @return 0 on success, a libuv error code otherwise
+ */
+static int db_writev_all(uv_loop_t *loop, uv_file file, uv_buf_t *bufs, unsigned int nbufs, int64_t offset){
+	uv_fs_t write_req;
+	while(nbufs){
+		const int rc = uv_fs_write(loop, &write_req, file, bufs, nbufs, offset, NULL);
+		uv_fs_req_cleanup(&write_req);
+		if(unlikely(rc < 0)) return rc;
+		if(unlikely(rc == 0)) return UV_EIO; // No progress, don't retry forever
+
+		/* Skip whatever was written, to retry the rest */
+		size_t written = (size_t) rc;
+		offset += rc;
+		while(nbufs && written >= bufs->len){
+			written -= bufs->len;
+			bufs++;
+			nbufs--;
+		}
+		if(nbufs){
+			bufs->base += written;
+			bufs->len -= (unsigned int) written;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Flush the circular buffer of a log source to the DB
+ * @details Any messages in the circular buffer are written to the current BLOB and their 
+ * metadata to the LOGS_TABLE. The BLOBs are also rotated, if required. If writing to the 
+ * BLOB fails, the whole flush is rolled back and its messages are left in the circular 
+ * buffer, to be retried on the next flush.
+ * @param writer DB writer of the log source
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ */
+static void db_writer_flush(db_writer_t *writer, uv_loop_t *loop){
+	int rc = 0;
+	struct File_info *p_file_info = writer->p_file_info;
+	Message_t *p_msg, *p_msg_carry = NULL;
+	Message_t *batch_msgs[DB_WRITER_BATCH_MAX_MSGS];
+	uv_buf_t batch_bufs[DB_WRITER_BATCH_MAX_MSGS];
+	uv_fs_t dsync_req;
+
+	/* Nothing to flush - don't hold up queries of the log source with the DB lock. 
+	 * The BLOB cannot have grown since the last flush, so no rotation is due either. */
+	if(!circ_buff_read_pending(p_file_info->msg_buff)) return;
+
+	db_set_lock(p_file_info->db_mut);
+	const usec_t flush_start_time = now_monotonic_usec();
+	const int64_t flush_start_blob_filesize = writer->blob_filesize;
+
+	/* Retrieve msgs and store them in DB in batches, until there are no more msgs in the buffer. 
+	 * Each batch is written in the BLOB with a single vectored write, its metadata are 
+	 * inserted with a single multi-row INSERT and the BLOB filesize is updated once. 
+	 * A batch is limited both in messages and in bytes (DB_WRITER_BATCH_MAX_BYTES); a message 
+	 * that does not fit in the bytes of a batch is carried over to the next one. */
+	int batch_msgs_num = 0, batch_full = 0, flush_msgs_num = 0, flush_batches_num = 0, in_transaction = 0;
+	size_t flush_size = 0, flush_text_size = 0;
+	do {
+		size_t batch_size = 0, batch_text_size = 0;
+		batch_msgs_num = 0;
+		batch_full = 0;
+		while(batch_msgs_num < p_file_info->db_write_batch_max_msgs){
+			if(p_msg_carry){
+				p_msg = p_msg_carry;
+				p_msg_carry = NULL;
+			}
+			else if(!(p_msg = circ_buff_read(p_file_info->msg_buff))) break;
+			if(!p_msg->text_size) continue; // Nothing was kept of this message (metrics-only log source)
+			if(batch_msgs_num && batch_size + p_msg->text_compressed_size > DB_WRITER_BATCH_MAX_BYTES){
+				p_msg_carry = p_msg;
+				break;
+			}
+			batch_msgs[batch_msgs_num] = p_msg;
+			batch_bufs[batch_msgs_num] = uv_buf_init((char *) p_msg->text_compressed, (unsigned int) p_msg->text_compressed_size);
+			batch_size += p_msg->text_compressed_size;
+			batch_text_size += p_msg->text_size;
+			batch_msgs_num++;
+		}
+		batch_full = p_msg_carry || batch_msgs_num == p_file_info->db_write_batch_max_msgs;
+		if(!batch_msgs_num) break;
+
+		/* The transaction is only started once there is something to write to the DB, 
+		 * as all the messages of metrics-only log sources may have been discarded. */
+		if(!in_transaction){
+			sqlite3_exec(p_file_info->db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+			in_transaction = 1;
+		}
+		
+		/* Write log messages of batch in BLOB, synchronously at the end of the BLOB file */
+		rc = db_writev_all(loop, p_file_info->blob_handles[p_file_info->blob_write_handle_offset], 
+			batch_bufs, (unsigned int) batch_msgs_num, writer->blob_filesize);
+		if(unlikely(rc)) break;
+		
+		/* Write metadata of log messages of batch in LOGS_TABLE */
+		if(unlikely(!writer->stmt_logs_insert[batch_msgs_num])) 
+			writer->stmt_logs_insert[batch_msgs_num] = db_writer_prepare_logs_insert(p_file_info->db, batch_msgs_num);
+		sqlite3_stmt *const stmt = writer->stmt_logs_insert[batch_msgs_num];
+		int64_t msg_offset = writer->blob_filesize;
+		for(int i = 0; i < batch_msgs_num; i++){
+			p_msg = batch_msgs[i];
+			const int col = i * 8;
+			fprintf_log(LOGS_MANAG_DEBUG, stderr, "DB msg timestamp: %" PRIu64 "\n", p_msg->timestamp);
+            fprintf_log(LOGS_MANAG_DEBUG, stderr, "DB msg size: %zu\n", p_msg->text_size);
+            rc = sqlite3_bind_int(stmt, col + 1, p_file_info->blob_write_handle_offset);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_int64(stmt, col + 2, (sqlite3_int64) msg_offset);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_int64(stmt, col + 3, (sqlite3_int64) p_msg->timestamp);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_int64(stmt, col + 4, (sqlite3_int64) p_msg->text_compressed_size);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_int64(stmt, col + 5, (sqlite3_int64)p_msg->text_size);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_blob(stmt, col + 6, p_msg->bloom, (int) p_msg->bloom_size, SQLITE_STATIC);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_int(stmt, col + 7, p_msg->codec);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_int(stmt, col + 8, p_msg->dict_id);
+            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+            msg_offset += (int64_t) p_msg->text_compressed_size;
+		}
+        rc = sqlite3_step(stmt);
+        if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+        sqlite3_reset(stmt);
+        
+        /* Update metadata of BLOBs filesize in BLOBS_TABLE, once per batch */
+        rc = sqlite3_bind_int64(writer->stmt_blobs_update, 1, (sqlite3_int64) batch_size);
+        if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+        rc = sqlite3_bind_int64(writer->stmt_blobs_update, 2, (sqlite3_int64) batch_msgs[batch_msgs_num - 1]->timestamp);
+        if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+        rc = sqlite3_bind_int(writer->stmt_blobs_update, 3, p_file_info->blob_write_handle_offset);
+        if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+        rc = sqlite3_step(writer->stmt_blobs_update);
+        if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+        sqlite3_reset(writer->stmt_blobs_update);
+        rc = 0;
+		
+		/* Increase BLOB offset and read next batch until no more messages in buff */
+		writer->blob_filesize += (int64_t) batch_size;
+		flush_msgs_num += batch_msgs_num;
+		flush_batches_num++;
+		flush_size += batch_size;
+		flush_text_size += batch_text_size;
+	} while(batch_full);
+
+	/* Only sync the BLOB if anything was written to it during this flush */
+	if(!rc && flush_msgs_num){
+		rc = uv_fs_fdatasync(loop, &dsync_req, 
+			p_file_info->blob_handles[p_file_info->blob_write_handle_offset], NULL);
+		uv_fs_req_cleanup(&dsync_req);
+	}
+
+	if(unlikely(rc)){
+		/* Nothing of this flush is persisted: its messages stay in the circular buffer 
+		 * and are written again from the same offset on the next flush (the BLOBs are 
+		 * not opened in append mode, so the explicit offset of the writes is honoured). 
+		 * Any bytes that did land are truncated away, so that the BLOB does not end in 
+		 * a partial message if the next flush writes fewer bytes or never happens. */
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to write logs of %s to BLOB, will retry: %s\n", 
+			p_file_info->filename, uv_strerror(rc));
+		uv_fs_t trunc_req;
+		const int trunc_rc = uv_fs_ftruncate(loop, &trunc_req, 
+			p_file_info->blob_handles[p_file_info->blob_write_handle_offset], flush_start_blob_filesize, NULL);
+		uv_fs_req_cleanup(&trunc_req);
+		if(unlikely(trunc_rc)) fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to truncate BLOB of %s: %s\n", 
+			p_file_info->filename, uv_strerror(trunc_rc));
+		if(in_transaction) sqlite3_exec(p_file_info->db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		writer->blob_filesize = flush_start_blob_filesize;
+		circ_buff_read_undo(p_file_info->msg_buff);
+		db_release_lock(p_file_info->db_mut);
+		return;
+	}
+	if(in_transaction) sqlite3_exec(p_file_info->db, "END TRANSACTION;", NULL, NULL, NULL);
+	//sqlite3_wal_checkpoint_v2(p_file_info->db,NULL,SQLITE_CHECKPOINT_PASSIVE,0,0);
+
+	/* The messages have been persisted, so their space in the circular buffer can be reused. */
+	circ_buff_read_done(p_file_info->msg_buff);
+
+	if(flush_msgs_num){
+		__atomic_add_fetch(&p_file_info->db_writer_stats.num_of_batches, flush_batches_num, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&p_file_info->db_writer_stats.num_of_msgs, flush_msgs_num, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&p_file_info->db_writer_stats.text_bytes, flush_text_size, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&p_file_info->db_writer_stats.blob_bytes, flush_size, __ATOMIC_SEQ_CST);
+
+		int metadata_pages_written = 0, metadata_pages_written_hwm = 0;
+		if(sqlite3_db_status(p_file_info->db, SQLITE_DBSTATUS_CACHE_WRITE, &metadata_pages_written, &metadata_pages_written_hwm, 1) == SQLITE_OK)
+			__atomic_add_fetch(&p_file_info->db_writer_stats.metadata_bytes, 
+				(uint64_t) metadata_pages_written * (uint64_t) writer->metadata_page_size, __ATOMIC_SEQ_CST);
+
+		const uint64_t flush_latency = (uint64_t) (now_monotonic_usec() - flush_start_time);
+		uint64_t flush_latency_max = __atomic_load_n(&p_file_info->db_writer_stats.commit_latency_usec_max, __ATOMIC_SEQ_CST);
+		while(flush_latency > flush_latency_max && 
+			  !__atomic_compare_exchange_n(&p_file_info->db_writer_stats.commit_latency_usec_max, &flush_latency_max, 
+			  							   flush_latency, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+	}
+	
+	/* If the filesize of the current write-to BLOB is > BLOB_MAX_SIZE, rotate BLOBs */
+	if(writer->blob_filesize > BLOB_MAX_SIZE){
+		const uint64_t start_time = get_unix_time_ms();
+
+		/* Rotate the BLOBs, so that logs.bin.0 is the newest one. Each step is made durable 
+		 * before the next one, so that db_blobs_rotation_recover() can always tell how far 
+		 * an interrupted rotation got: (1) Increase the ending numbers of the BLOB files by 1, 
+		 * (2) do the same for BLOBS_TABLE Filenames (in a single transaction), (3) replace 
+		 * the maximum number with 0 in the BLOB files and (4) in BLOBS_TABLE Filenames. */
+		/* (1) */
+		for(int i = BLOB_MAX_FILES - 1; i >= 0; i--){
+			rc = db_blob_file_rename(loop, p_file_info->db_dir, i, i + 1);
+			if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+		}
+		db_dir_sync(loop, p_file_info->db_dir);
+		/* (2) */
+		sqlite3_exec(p_file_info->db, "PRAGMA synchronous = FULL; BEGIN TRANSACTION;", NULL, NULL, NULL);
+		for(int i = BLOB_MAX_FILES - 1; i >= 0; i--) db_blob_metadata_rename(writer->stmt_rotate_blobs, i, i + 1);
+		sqlite3_exec(p_file_info->db, "END TRANSACTION; PRAGMA synchronous = 1;", NULL, NULL, NULL);
+		/* (3) */
+		rc = db_blob_file_rename(loop, p_file_info->db_dir, BLOB_MAX_FILES, 0);
+		if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+		db_dir_sync(loop, p_file_info->db_dir);
+		/* (4) */
+		db_blob_metadata_rename(writer->stmt_rotate_blobs, BLOB_MAX_FILES, 0);
+		
+		/* (a) Update blob_write_handle_offset, (b) drop the logs of the new write-to 
+		 * BLOB (unless the DB compactor already has) and (c) reset writer->blob_filesize */
+		/* (a) */ 
+		p_file_info->blob_write_handle_offset = p_file_info->blob_write_handle_offset == 1 ? BLOB_MAX_FILES : p_file_info->blob_write_handle_offset - 1;
+		/* (b) */ 
+		db_blob_drop(writer, p_file_info->blob_write_handle_offset, loop);
+		/* (c) */
+		writer->blob_filesize = 0;
+
+		fprintf_log(LOGS_MANAG_INFO, stderr,
+            "It took %" PRId64 "ms to rotate BLOBs\n",
+            (int64_t)get_unix_time_ms() - start_time);
+	}
+	// TODO: Can db_release_lock(p_file_info->db_mut) be moved before if(writer->blob_filesize > BLOB_MAX_SIZE) ?
+	db_release_lock(p_file_info->db_mut);
+}
+
+/**
+ * @brief Worker thread of the DB writer pool
+ */
+static void db_writer_pool_worker(void *arg){
+	uv_loop_t *worker_loop = mallocz(sizeof(uv_loop_t)); // Only used for synchronous file operations
+	int rc = uv_loop_init(worker_loop);
+	if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+
+	uv_mutex_lock(&db_writer_pool.mut);
+	while(1){
+		/* Find the non-busy writer that is due to be flushed the earliest */
+		db_writer_t *writer = NULL;
+		int writer_off = 0;
+		for(int i = 0; i < db_writer_pool.num_of_writers; i++){
+			const int off = (db_writer_pool.rr_next + i) % db_writer_pool.num_of_writers;
+			db_writer_t *candidate = db_writer_pool.writers[off];
+			if(candidate->busy) continue;
+			if(!writer || candidate->next_flush_time < writer->next_flush_time){
+				writer = candidate;
+				writer_off = off;
+			}
+		}
+
+		/* All writers are busy - wait for one of them to finish */
+		if(!writer){
+			uv_cond_wait(&db_writer_pool.cond, &db_writer_pool.mut);
+			continue;
+		}
+
+		/* Earliest flush not due yet - wait until it is (or until the writers change) */
+		const usec_t now = now_monotonic_usec();
+		if(writer->next_flush_time > now){
+			(void) uv_cond_timedwait(&db_writer_pool.cond, &db_writer_pool.mut, (writer->next_flush_time - now) * NSEC_PER_USEC);
+			continue;
+		}
+
+		writer->busy = 1;
+		db_writer_pool.rr_next = (writer_off + 1) % db_writer_pool.num_of_writers;
+		uv_mutex_unlock(&db_writer_pool.mut);
+
+		db_writer_flush(writer, worker_loop);
+
+		uv_mutex_lock(&db_writer_pool.mut);
+		writer->busy = 0;
+		writer->next_flush_time = now_monotonic_usec() + (usec_t) writer->p_file_info->db_flush_interval * USEC_PER_MS;
+		uv_cond_signal(&db_writer_pool.cond);
+	}
+}
+
+/**
+ * @brief Add a column to a table, if it was created before the column was introduced
+ * @param db Metadata DB of the log source
+ * @param table Name of the table
+ * @param column_name Name of the column
+ * @param column_def Definition of the column, e.g. "INTEGER NOT NULL DEFAULT 0"
+ */
+static void db_table_add_column(sqlite3 *db, const char *table, const char *column_name, const char *column_def){
+	int rc = 0;
+	char *err_msg = NULL;
+	sqlite3_stmt *stmt_check_if_column_exists;
+	rc = sqlite3_prepare_v2(db,
+							"SELECT COUNT(*) FROM pragma_table_info(?) WHERE name = ?;",
+							-1, &stmt_check_if_column_exists, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_text(stmt_check_if_column_exists, 1, table, -1, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_text(stmt_check_if_column_exists, 2, column_name, -1, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(stmt_check_if_column_exists);
+	if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__);
+	const int column_exists = sqlite3_column_int(stmt_check_if_column_exists, 0);
+	sqlite3_finalize(stmt_check_if_column_exists);
+	if(column_exists) return;
+
+	char *sql = mallocz(snprintf(NULL, 0, "ALTER TABLE %s ADD COLUMN %s %s;", table, column_name, column_def) + 1);
+	sprintf(sql, "ALTER TABLE %s ADD COLUMN %s %s;", table, column_name, column_def);
+	rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+	freez(sql);
+	if (unlikely(rc != SQLITE_OK)) {
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to add %s column to %s. SQL error: %s\n", column_name, table, err_msg);
+		sqlite3_free(err_msg);
+		fatal("Failed to add %s column to %s\n", column_name, table);
+	}
+}
+
+/**
+ * @brief Train a compression dictionary for a log source
+ * @details LZ4 dictionaries are raw content, so the most recent COMPR_DICT_SIZE 
+ * bytes (of whole lines) of the log source are used, as they are the most likely 
+ * to resemble the logs that will follow.
+ * @param p_file_info Log source to train the dictionary for
+ * @param[out] dict_size Size of the returned dictionary
+ * @return The dictionary, or NULL if the log source is too small to train one.
+ */
+static char *db_compr_dict_train(struct File_info *p_file_info, size_t *dict_size){
+	int rc = 0;
+	uv_fs_t open_req, read_req, close_req;
+
+	rc = uv_fs_open(db_loop, &open_req, p_file_info->filename, O_RDONLY, 0, NULL);
+	uv_fs_req_cleanup(&open_req);
+	if(unlikely(rc < 0)) return NULL;
+	const uv_file file_handle = rc;
+
+	const int64_t offset = p_file_info->filesize > COMPR_DICT_SIZE ? (int64_t) (p_file_info->filesize - COMPR_DICT_SIZE) : 0;
+	char *dict = mallocz(COMPR_DICT_SIZE);
+	uv_buf_t uv_buf = uv_buf_init(dict, COMPR_DICT_SIZE);
+	rc = uv_fs_read(db_loop, &read_req, file_handle, &uv_buf, 1, offset, NULL);
+	uv_fs_req_cleanup(&read_req);
+	uv_fs_close(db_loop, &close_req, file_handle, NULL);
+	uv_fs_req_cleanup(&close_req);
+
+	/* Skip any partial first line, unless the whole file was read */
+	size_t start = 0;
+	if(rc > 0 && offset){
+		char *first_nl = memchr(dict, '\n', (size_t) rc);
+		start = first_nl ? (size_t) (first_nl - dict) + 1 : (size_t) rc;
+	}
+	if(rc <= 0 || (size_t) rc - start < 1 KiB){
+		freez(dict);
+		return NULL;
+	}
+	*dict_size = (size_t) rc - start;
+	memmove(dict, &dict[start], *dict_size);
+	return dict;
+}
+
+/**
+ * @brief Load (and create, if required) the compression dictionaries of a log source
+ * @details All the dictionaries stored in DICTS_TABLE are loaded, as they may be required
+ * to decompress older log messages. If the log source is configured to compress with a 
+ * dictionary but there is none yet, one is trained and stored. If that is not possible, 
+ * the log source falls back to LOGS_COMPR_CODEC_LZ4F.
+ * @param p_file_info Log source, its metadata DB must already be initialised.
+ */
+static void db_compr_dicts_init(struct File_info *p_file_info){
+	int rc = 0;
+	sqlite3_stmt *stmt_retrieve_dicts;
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"SELECT Id, Dict FROM " DICTS_TABLE " ORDER BY Id ASC;",
+							-1, &stmt_retrieve_dicts, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	while((rc = sqlite3_step(stmt_retrieve_dicts)) == SQLITE_ROW){
+		p_file_info->compr_dicts = reallocz(p_file_info->compr_dicts, (p_file_info->compr_dicts_num + 1) * sizeof(struct compr_dict));
+		struct compr_dict *compr_dict = &p_file_info->compr_dicts[p_file_info->compr_dicts_num++];
+		compr_dict->id = sqlite3_column_int(stmt_retrieve_dicts, 0);
+		const void *data = sqlite3_column_blob(stmt_retrieve_dicts, 1);
+		compr_dict->size = (size_t) sqlite3_column_bytes(stmt_retrieve_dicts, 1);
+		compr_dict->data = mallocz(compr_dict->size ? compr_dict->size : 1);
+		if(compr_dict->size) memcpy(compr_dict->data, data, compr_dict->size);
+		compr_dict->lz4_stream = compr_dict_stream_create(compr_dict->data, compr_dict->size);
+	}
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_finalize(stmt_retrieve_dicts);
+
+	if(p_file_info->compr_codec != LOGS_COMPR_CODEC_LZ4_DICT || p_file_info->compr_dicts_num) return;
+
+	size_t dict_size = 0;
+	char *dict = db_compr_dict_train(p_file_info, &dict_size);
+	if(!dict){
+		fprintf_log(LOGS_MANAG_WARNING, stderr, "Not enough logs to train a compression dictionary for %s, " 
+			"dictionary compression will not be used.\n", p_file_info->filename);
+		p_file_info->compr_codec = LOGS_COMPR_CODEC_LZ4F;
+		return;
+	}
+
+	sqlite3_stmt *stmt_insert_dict;
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"INSERT INTO " DICTS_TABLE " (Dict) VALUES (?);",
+							-1, &stmt_insert_dict, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_blob(stmt_insert_dict, 1, dict, (int) dict_size, SQLITE_STATIC);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(stmt_insert_dict);
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_finalize(stmt_insert_dict);
+
+	p_file_info->compr_dicts = reallocz(p_file_info->compr_dicts, sizeof(struct compr_dict));
+	p_file_info->compr_dicts[0].id = (int) sqlite3_last_insert_rowid(p_file_info->db);
+	p_file_info->compr_dicts[0].data = dict;
+	p_file_info->compr_dicts[0].size = dict_size;
+	p_file_info->compr_dicts[0].lz4_stream = compr_dict_stream_create(dict, dict_size);
+	p_file_info->compr_dicts_num = 1;
+}
+
+/**
+ * @brief Find a compression dictionary of a log source by its id
+ * @return The dictionary, or NULL if not found.
+ */
+static inline const struct compr_dict *db_compr_dict_get(struct File_info *p_file_info, int dict_id){
+	for(int i = p_file_info->compr_dicts_num - 1; i >= 0; i--){
+		if(p_file_info->compr_dicts[i].id == dict_id) return &p_file_info->compr_dicts[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief Metadata of a BLOB, as used by the DB compactor
+ */
+typedef struct db_blob_info {
+	int id;
+	int64_t filesize;
+	uint64_t last_timestamp;    /**< Timestamp of the newest log message of the BLOB */
+	int64_t last_log_id;        /**< Id of the newest log message of the BLOB in LOGS_TABLE */
+	int compacted;              /**< Boolean. Set if the BLOB has been recompressed */
+} db_blob_info_t;
+
+/**
+ * @brief Retrieve the metadata of all the BLOBs of a log source
+ * @details Must be called with the DB lock of the log source held.
+ * @param writer DB writer of the log source
+ * @param[out] blobs Metadata of the BLOBs, indexed by their Id (item 0 not used)
+ * @return Total size of the BLOBs
+ */
+static int64_t db_blobs_get(db_writer_t *writer, db_blob_info_t blobs[BLOB_MAX_FILES + 1]){
+	int rc = 0;
+	int64_t total_size = 0;
+	memset(blobs, 0, (BLOB_MAX_FILES + 1) * sizeof(db_blob_info_t));
+	while((rc = sqlite3_step(writer->stmt_blobs_get)) == SQLITE_ROW){
+		const int id = sqlite3_column_int(writer->stmt_blobs_get, 0);
+		if(unlikely(id < 1 || id > BLOB_MAX_FILES)) continue;
+		blobs[id].id = id;
+		blobs[id].filesize = (int64_t) sqlite3_column_int64(writer->stmt_blobs_get, 1);
+		blobs[id].last_timestamp = (uint64_t) sqlite3_column_int64(writer->stmt_blobs_get, 2);
+		blobs[id].last_log_id = (int64_t) sqlite3_column_int64(writer->stmt_blobs_get, 3);
+		blobs[id].compacted = sqlite3_column_int(writer->stmt_blobs_get, 4);
+		total_size += blobs[id].filesize;
+	}
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_reset(writer->stmt_blobs_get);
+	return total_size;
+}
+
+/**
+ * @brief Find the oldest BLOB of a log source that can be dropped
+ * @details BLOBs are written to in descending Id order (wrapping around), so the oldest 
+ * one is the first non-empty BLOB after the current write-to BLOB, in that order. The 
+ * write-to BLOB itself is never returned. Must be called with the DB lock held.
+ * @param p_file_info Log source
+ * @param blobs Metadata of the BLOBs, as returned by db_blobs_get()
+ * @return Id of the oldest BLOB, or 0 if all BLOBs but the write-to one are empty.
+ */
+static int db_blob_oldest(struct File_info *p_file_info, const db_blob_info_t blobs[BLOB_MAX_FILES + 1]){
+	int id = p_file_info->blob_write_handle_offset;
+	for(int i = 1; i < BLOB_MAX_FILES; i++){
+		id = id == 1 ? BLOB_MAX_FILES : id - 1;
+		if(blobs[id].filesize) return id;
+	}
+	return 0;
+}
+
+/**
+ * @brief Enforce the retention (max age and max size) of a log source
+ * @details The oldest BLOBs are dropped, one at a time and each one under a separate 
+ * acquisition of the DB lock, so that DB writers and queries are not blocked for long.
+ * @param writer DB writer of the log source
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ */
+static void db_compactor_enforce_retention(db_writer_t *writer, uv_loop_t *loop){
+	struct File_info *p_file_info = writer->p_file_info;
+	db_blob_info_t blobs[BLOB_MAX_FILES + 1];
+
+	while(1){
+		int dropped = 0;
+		const uint64_t now = get_unix_time_ms();
+
+		db_set_lock(p_file_info->db_mut);
+		const int64_t total_size = db_blobs_get(writer, blobs);
+		const int oldest = db_blob_oldest(p_file_info, blobs);
+		if(oldest && ((p_file_info->retention_max_age && blobs[oldest].last_timestamp + p_file_info->retention_max_age < now) ||
+		   			  (p_file_info->retention_max_size && (uint64_t) total_size > p_file_info->retention_max_size))){
+			db_blob_drop(writer, oldest, loop);
+			dropped = 1;
+		}
+		db_release_lock(p_file_info->db_mut);
+
+		if(!dropped) break;
+		fprintf_log(LOGS_MANAG_INFO, stderr, "Dropped %" PRId64 " bytes of logs of %s due to retention\n", 
+			blobs[oldest].filesize, p_file_info->filename);
+	}
+}
+
+/**
+ * @brief Enforce the disk space budget shared by all the log sources
+ * @details While the total size of the BLOBs of all the log sources exceeds the budget, 
+ * the BLOB whose newest log message is the oldest one, across all the log sources, is 
+ * dropped. Write-to BLOBs are never dropped, so the budget may still be exceeded by them.
+ * @param disk_space_budget Budget (in bytes)
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ */
+static void db_compactor_enforce_disk_space_budget(uint64_t disk_space_budget, uv_loop_t *loop){
+	db_blob_info_t blobs[BLOB_MAX_FILES + 1];
+
+	while(1){
+		uint64_t total_size = 0;
+		db_writer_t *victim_writer = NULL;
+		db_blob_info_t victim = {0};
+
+		for(int i = 0; i < db_writer_pool.num_of_writers; i++){
+			db_writer_t *writer = db_writer_pool.writers[i];
+			db_set_lock(writer->p_file_info->db_mut);
+			total_size += (uint64_t) db_blobs_get(writer, blobs);
+			const int oldest = db_blob_oldest(writer->p_file_info, blobs);
+			db_release_lock(writer->p_file_info->db_mut);
+			if(oldest && (!victim_writer || blobs[oldest].last_timestamp < victim.last_timestamp)){
+				victim_writer = writer;
+				victim = blobs[oldest];
+			}
+		}
+		if(total_size <= disk_space_budget || !victim_writer) break;
+
+		/* The BLOB may have changed since it was selected, so verify it before dropping it */
+		struct File_info *p_file_info = victim_writer->p_file_info;
+		db_set_lock(p_file_info->db_mut);
+		db_blobs_get(victim_writer, blobs);
+		const int still_valid = victim.id != p_file_info->blob_write_handle_offset && 
+								blobs[victim.id].filesize && blobs[victim.id].last_log_id == victim.last_log_id;
+		if(still_valid) db_blob_drop(victim_writer, victim.id, loop);
+		db_release_lock(p_file_info->db_mut);
+
+		if(still_valid)
+			fprintf_log(LOGS_MANAG_INFO, stderr, "Dropped %" PRId64 " bytes of logs of %s due to the disk space budget\n", 
+				victim.filesize, p_file_info->filename);
+	}
+}
+
+/**
+ * @brief Recompress the log messages of a BLOB into another file
+ * @details Each log message is read from the BLOB, decompressed and recompressed with 
+ * LOGS_COMPR_CODEC_LZ4F_HC. A log message is copied as it is if it does not get any smaller, 
+ * or if it cannot be decompressed (e.g. its dictionary is missing), so that no log message 
+ * is ever lost or replaced by a blank one. The offset, compressed size, codec and dictionary 
+ * id of each log message are updated to those in the new file.
+ * @param p_file_info Log source of the BLOB
+ * @param blob_handle File handle of the BLOB to read the log messages from
+ * @param compact_handle File handle of the (empty) file to write the log messages to
+ * @param[in,out] msgs Metadata of the log messages of the BLOB, in BLOB order
+ * @param msgs_num Number of log messages in msgs
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ * @param[out] compact_filesize Size of the new file
+ * @return 0 on success, -1 on read or write failure (e.g. a short read, if the 
+ * BLOB was truncated in the meantime).
+ */
+int db_blob_recompress(struct File_info *p_file_info, uv_file blob_handle, uv_file compact_handle, 
+					   db_compact_msg_t *msgs, int msgs_num, uv_loop_t *loop, int64_t *compact_filesize){
+	int rc = 0, failed = 0;
+	uv_fs_t fs_req;
+	char *compressed = NULL, *text = NULL;
+	size_t compressed_size_max = 0, text_size_max = 0;
+	Message_t compact_msg = {0};
+
+	*compact_filesize = 0;
+	for(int i = 0; i < msgs_num && !failed; i++){
+		db_compact_msg_t *msg = &msgs[i];
+
+		if(msg->text_compressed_size > compressed_size_max){
+			compressed_size_max = msg->text_compressed_size * BUFF_SCALE_FACTOR;
+			compressed = reallocz(compressed, compressed_size_max);
+		}
+		uv_buf_t uv_buf = uv_buf_init(compressed, (unsigned int) msg->text_compressed_size);
+		rc = uv_fs_read(loop, &fs_req, blob_handle, &uv_buf, 1, msg->offset, NULL);
+		uv_fs_req_cleanup(&fs_req);
+		if(unlikely(rc < 0 || (size_t) rc != msg->text_compressed_size)){
+			failed = 1;
+			break;
+		}
+
+		uv_buf = uv_buf_init(compressed, (unsigned int) msg->text_compressed_size);
+		if(msg->codec != LOGS_COMPR_CODEC_LZ4F_HC){
+			Message_t temp_msg = {0};
+			temp_msg.text_compressed = compressed;
+			temp_msg.text_compressed_size = msg->text_compressed_size;
+			temp_msg.text_size = msg->text_size;
+			temp_msg.codec = (uint8_t) msg->codec;
+			temp_msg.dict_id = msg->dict_id;
+			int recompress = 1;
+			if(temp_msg.codec == LOGS_COMPR_CODEC_LZ4_DICT){
+				const struct compr_dict *compr_dict = db_compr_dict_get(p_file_info, temp_msg.dict_id);
+				temp_msg.dict = compr_dict ? compr_dict->data : NULL;
+				temp_msg.dict_size = compr_dict ? compr_dict->size : 0;
+				recompress = compr_dict != NULL;
+			}
+			if(msg->text_size > text_size_max){
+				text_size_max = msg->text_size * BUFF_SCALE_FACTOR;
+				text = reallocz(text, text_size_max);
+			}
+			if(unlikely(!recompress || decompress_text(&temp_msg, text))){
+				fprintf_log(LOGS_MANAG_WARNING, stderr, "Log message %" PRId64 " of %s cannot be decompressed, " 
+					"it will be kept as it is\n", msg->id, p_file_info->filename);
+				recompress = 0;
+			}
+
+			if(recompress){
+				compact_msg.text = text;
+				compact_msg.text_size = msg->text_size;
+				compact_msg.codec = LOGS_COMPR_CODEC_LZ4F_HC;
+				compress_text(&compact_msg);
+				if(compact_msg.text_compressed_size && compact_msg.text_compressed_size < msg->text_compressed_size){
+					uv_buf = uv_buf_init(compact_msg.text_compressed, (unsigned int) compact_msg.text_compressed_size);
+					msg->codec = LOGS_COMPR_CODEC_LZ4F_HC;
+					msg->dict_id = 0;
+				}
+			}
+		}
+
+		rc = uv_fs_write(loop, &fs_req, compact_handle, &uv_buf, 1, *compact_filesize, NULL);
+		uv_fs_req_cleanup(&fs_req);
+		if(unlikely(rc < 0 || (size_t) rc != uv_buf.len)){
+			failed = 1;
+			break;
+		}
+		msg->offset = *compact_filesize;
+		msg->text_compressed_size = uv_buf.len;
+		*compact_filesize += (int64_t) uv_buf.len;
+	}
+	freez(compressed);
+	freez(text);
+	freez(compact_msg.text_compressed);
+	return failed ? -1 : 0;
+}
+
+/**
+ * @brief Recompress a BLOB that is no longer written to with LOGS_COMPR_CODEC_LZ4F_HC
+ * @details The log messages are read and recompressed into a temporary file without 
+ * holding the DB lock. Then, under the DB lock and only if the BLOB has not changed in 
+ * the meantime, the metadata of the log messages are updated and the temporary file 
+ * replaces the BLOB, in a single transaction. Log messages that do not get any smaller 
+ * are copied as they are.
+ * @param writer DB writer of the log source
+ * @param blob_id Id of the BLOB in BLOBS_TABLE
+ * @param loop uv_loop_t to be used for the (synchronous) file operations
+ */
+static void db_blob_compact(db_writer_t *writer, int blob_id, uv_loop_t *loop){
+	int rc = 0;
+	struct File_info *p_file_info = writer->p_file_info;
+	db_blob_info_t blobs[BLOB_MAX_FILES + 1];
+	db_compact_msg_t *msgs = NULL;
+	int msgs_num = 0, msgs_size = 0;
+	uv_fs_t fs_req;
+
+	/* 1. Retrieve the metadata of the log messages of the BLOB. As they are contiguous 
+	 * in LOGS_TABLE, only the range after the newest log message of any older BLOB 
+	 * needs to be scanned. */
+	db_set_lock(p_file_info->db_mut);
+	db_blobs_get(writer, blobs);
+	const db_blob_info_t blob = blobs[blob_id];
+	int64_t first_log_id_excl = 0;
+	for(int id = 1; id <= BLOB_MAX_FILES; id++){
+		if(blobs[id].last_log_id < blob.last_log_id && blobs[id].last_log_id > first_log_id_excl)
+			first_log_id_excl = blobs[id].last_log_id;
+	}
+	rc = sqlite3_bind_int64(writer->stmt_blob_msgs_get, 1, (sqlite3_int64) first_log_id_excl);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_int64(writer->stmt_blob_msgs_get, 2, (sqlite3_int64) blob.last_log_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_int(writer->stmt_blob_msgs_get, 3, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	while((rc = sqlite3_step(writer->stmt_blob_msgs_get)) == SQLITE_ROW){
+		if(msgs_num == msgs_size){
+			msgs_size = msgs_size ? msgs_size * 2 : 256;
+			msgs = reallocz(msgs, msgs_size * sizeof(db_compact_msg_t));
+		}
+		msgs[msgs_num].id = (int64_t) sqlite3_column_int64(writer->stmt_blob_msgs_get, 0);
+		msgs[msgs_num].offset = (int64_t) sqlite3_column_int64(writer->stmt_blob_msgs_get, 1);
+		msgs[msgs_num].text_compressed_size = (size_t) sqlite3_column_int64(writer->stmt_blob_msgs_get, 2);
+		msgs[msgs_num].text_size = (size_t) sqlite3_column_int64(writer->stmt_blob_msgs_get, 3);
+		msgs[msgs_num].codec = sqlite3_column_int(writer->stmt_blob_msgs_get, 4);
+		msgs[msgs_num].dict_id = sqlite3_column_int(writer->stmt_blob_msgs_get, 5);
+		msgs_num++;
+	}
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_reset(writer->stmt_blob_msgs_get);
+	db_release_lock(p_file_info->db_mut);
+
+	/* 2. Recompress the log messages into the temporary file, without holding the DB lock. 
+	 * If the BLOB is dropped or rotated in the meantime, a short read may occur, in which 
+	 * case the results are discarded. */
+	char compact_path[FILENAME_MAX + 1];
+	snprintf(compact_path, FILENAME_MAX, "%s" BLOB_COMPACT_FILENAME ".%d", p_file_info->db_dir, blob_id);
+	rc = uv_fs_open(loop, &fs_req, compact_path, UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC, 0644, NULL);
+	uv_fs_req_cleanup(&fs_req);
+	if(unlikely(rc < 0)){
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to open %s: %s\n", compact_path, uv_strerror(rc));
+		freez(msgs);
+		return;
+	}
+	const uv_file compact_handle = rc;
+
+	int64_t compact_filesize = 0;
+	int failed = db_blob_recompress(p_file_info, p_file_info->blob_handles[blob_id], compact_handle, 
+									msgs, msgs_num, loop, &compact_filesize);
+
+	if(!failed){
+		rc = uv_fs_fdatasync(loop, &fs_req, compact_handle, NULL);
+		uv_fs_req_cleanup(&fs_req);
+		if(unlikely(rc)) failed = 1;
+	}
+	uv_fs_close(loop, &fs_req, compact_handle, NULL);
+	uv_fs_req_cleanup(&fs_req);
+
+	/* 3. Under the DB lock, replace the BLOB with the temporary file, unless the BLOB
+	 * has changed in the meantime (i.e. it was rotated to or dropped). */
+	db_set_lock(p_file_info->db_mut);
+	db_blobs_get(writer, blobs);
+	const int still_valid = !failed && blob_id != p_file_info->blob_write_handle_offset && !blobs[blob_id].compacted && 
+							blobs[blob_id].last_log_id == blob.last_log_id && blobs[blob_id].filesize == blob.filesize;
+	if(!still_valid || compact_filesize >= blob.filesize){
+		/* The temporary file must be gone before the BLOB is marked as compacted, 
+		 * otherwise db_blob_compaction_recover() would use it to replace the BLOB. */
+		uv_fs_unlink(loop, &fs_req, compact_path, NULL);
+		uv_fs_req_cleanup(&fs_req);
+		if(still_valid){ // Nothing to be gained, just don't try again
+			rc = sqlite3_bind_int64(writer->stmt_blobs_set_compacted, 1, (sqlite3_int64) blob.filesize);
+			if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+			rc = sqlite3_bind_int(writer->stmt_blobs_set_compacted, 2, blob_id);
+			if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+			rc = sqlite3_step(writer->stmt_blobs_set_compacted);
+			if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+			sqlite3_reset(writer->stmt_blobs_set_compacted);
+		}
+		db_release_lock(p_file_info->db_mut);
+		freez(msgs);
+		return;
+	}
+
+	rc = sqlite3_bind_int(writer->stmt_blob_filename_get, 1, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(writer->stmt_blob_filename_get);
+	if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__);
+	char blob_path[FILENAME_MAX + 1];
+	snprintf(blob_path, FILENAME_MAX, "%s%s", p_file_info->db_dir, sqlite3_column_text(writer->stmt_blob_filename_get, 0));
+	sqlite3_reset(writer->stmt_blob_filename_get);
+
+	/* The metadata are committed (durably) before the temporary file replaces the BLOB, 
+	 * so that db_blob_compaction_recover() can complete the replacement after a crash. */
+	sqlite3_exec(p_file_info->db, "PRAGMA synchronous = FULL; BEGIN TRANSACTION;", NULL, NULL, NULL);
+	for(int i = 0; i < msgs_num; i++){
+		rc = sqlite3_bind_int64(writer->stmt_logs_update_compacted, 1, (sqlite3_int64) msgs[i].offset);
+		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+		rc = sqlite3_bind_int64(writer->stmt_logs_update_compacted, 2, (sqlite3_int64) msgs[i].text_compressed_size);
+		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+		rc = sqlite3_bind_int(writer->stmt_logs_update_compacted, 3, msgs[i].codec);
+		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+		rc = sqlite3_bind_int(writer->stmt_logs_update_compacted, 4, msgs[i].dict_id);
+		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+		rc = sqlite3_bind_int64(writer->stmt_logs_update_compacted, 5, (sqlite3_int64) msgs[i].id);
+		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+		rc = sqlite3_step(writer->stmt_logs_update_compacted);
+		if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+		sqlite3_reset(writer->stmt_logs_update_compacted);
+	}
+	rc = sqlite3_bind_int64(writer->stmt_blobs_set_compacted, 1, (sqlite3_int64) compact_filesize);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_int(writer->stmt_blobs_set_compacted, 2, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(writer->stmt_blobs_set_compacted);
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_reset(writer->stmt_blobs_set_compacted);
+
+	sqlite3_exec(p_file_info->db, "END TRANSACTION; PRAGMA synchronous = 1;", NULL, NULL, NULL);
+
+	/* If the replacement fails, the temporary file is kept and the replacement 
+	 * is completed by db_blob_compaction_recover() on the next start. */
+	rc = uv_fs_rename(loop, &fs_req, compact_path, blob_path, NULL);
+	uv_fs_req_cleanup(&fs_req);
+	if (unlikely(rc)){
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to replace %s with %s, it will be replaced on the next start: %s\n", 
+			blob_path, compact_path, uv_strerror(rc));
+		db_release_lock(p_file_info->db_mut);
+		freez(msgs);
+		return;
+	}
+	db_dir_sync(loop, p_file_info->db_dir);
+
+	/* Reopen the BLOB, as the old handle still refers to the replaced file */
+	rc = uv_fs_open(loop, &fs_req, blob_path, UV_FS_O_RDWR | UV_FS_O_CREAT | UV_FS_O_RANDOM, 0644, NULL);
+	uv_fs_req_cleanup(&fs_req);
+	if (unlikely(rc < 0)){
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to reopen %s: %s\n", blob_path, uv_strerror(rc));
+		db_release_lock(p_file_info->db_mut);
+		freez(msgs);
+		return;
+	}
+	uv_fs_close(loop, &fs_req, p_file_info->blob_handles[blob_id], NULL);
+	uv_fs_req_cleanup(&fs_req);
+	p_file_info->blob_handles[blob_id] = rc;
+	db_release_lock(p_file_info->db_mut);
+
+	fprintf_log(LOGS_MANAG_INFO, stderr, "Compacted %s from %" PRId64 " to %" PRId64 " bytes\n", 
+		blob_path, blob.filesize, compact_filesize);
+	freez(msgs);
+}
+
+/**
+ * @brief Configuration of the DB compactor
+ */
+static struct db_compactor {
+	uint64_t disk_space_budget;     /**< Disk space budget (in bytes) of all the log sources (0 for no limit) */
+	int interval;                   /**< Interval (in seconds) between runs */
+} db_compactor;
+
+/**
+ * @brief DB compactor thread
+ * @details Periodically, it enforces the retention of each log source and the disk 
+ * space budget and then recompresses the cold BLOBs of the log sources that are 
+ * configured so. It only ever holds the DB lock of a log source for short periods, 
+ * so ingestion and queries are not blocked.
+ */
+static void db_compactor_worker(void *arg){
+	uv_loop_t *compactor_loop = mallocz(sizeof(uv_loop_t)); // Only used for synchronous file operations
+	int rc = uv_loop_init(compactor_loop);
+	if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+
+	while(1){
+		sleep_usec((usec_t) db_compactor.interval * USEC_PER_SEC);
+
+		for(int i = 0; i < db_writer_pool.num_of_writers; i++){
+			db_writer_t *writer = db_writer_pool.writers[i];
+			if(writer->p_file_info->retention_max_age || writer->p_file_info->retention_max_size)
+				db_compactor_enforce_retention(writer, compactor_loop);
+		}
+
+		if(db_compactor.disk_space_budget)
+			db_compactor_enforce_disk_space_budget(db_compactor.disk_space_budget, compactor_loop);
+
+		for(int i = 0; i < db_writer_pool.num_of_writers; i++){
+			db_writer_t *writer = db_writer_pool.writers[i];
+			struct File_info *p_file_info = writer->p_file_info;
+			if(!p_file_info->compact_cold_blobs) continue;
+
+			/* Compact the cold BLOBs, starting from the most recently written one */
+			db_blob_info_t blobs[BLOB_MAX_FILES + 1];
+			int candidates[BLOB_MAX_FILES], candidates_num = 0;
+			db_set_lock(p_file_info->db_mut);
+			db_blobs_get(writer, blobs);
+			int id = p_file_info->blob_write_handle_offset;
+			for(int j = 1; j < BLOB_MAX_FILES; j++){
+				id = id == BLOB_MAX_FILES ? 1 : id + 1;
+				if(blobs[id].filesize && !blobs[id].compacted) candidates[candidates_num++] = id;
+			}
+			db_release_lock(p_file_info->db_mut);
+
+			for(int j = 0; j < candidates_num; j++) db_blob_compact(writer, candidates[j], compactor_loop);
+		}
+	}
+}
+
+/**
+ * @brief Complete or undo an interrupted rotation of the BLOBs of a log source
+ * @details See the rotation steps in db_writer_flush(). If a BLOB in BLOBS_TABLE has 
+ * the maximum number, steps (1) and (2) were completed, so the rotation is completed. 
+ * Otherwise, if a BLOB file with the maximum number exists, step (1) was interrupted 
+ * (before the metadata were rotated), so it is undone. The first missing BLOB file 
+ * number shows how far step (1) got.
+ * @param p_file_info Log source, its metadata DB must already be initialised.
+ */
+static void db_blobs_rotation_recover(struct File_info *p_file_info){
+	int rc = 0;
+	char max_filename[sizeof(BLOB_STORE_FILENAME) + 12];
+	snprintf(max_filename, sizeof(max_filename), BLOB_STORE_FILENAME ".%d", BLOB_MAX_FILES);
+
+	sqlite3_stmt *stmt_check_if_rotated;
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"SELECT COUNT(*) FROM " BLOBS_TABLE " WHERE Filename = ? ;",
+							-1, &stmt_check_if_rotated, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_text(stmt_check_if_rotated, 1, max_filename, -1, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(stmt_check_if_rotated);
+	if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__);
+	const int metadata_rotated = sqlite3_column_int(stmt_check_if_rotated, 0) > 0;
+	sqlite3_finalize(stmt_check_if_rotated);
+
+	const int max_file_exists = db_blob_file_exists(db_loop, p_file_info->db_dir, BLOB_MAX_FILES);
+
+	if(metadata_rotated){
+		fprintf_log(LOGS_MANAG_WARNING, stderr, "Completing interrupted rotation of BLOBs of %s\n", p_file_info->filename);
+		if(max_file_exists){
+			rc = db_blob_file_rename(db_loop, p_file_info->db_dir, BLOB_MAX_FILES, 0);
+			if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+			db_dir_sync(db_loop, p_file_info->db_dir);
+		}
+		sqlite3_stmt *stmt_rotate_blobs;
+		rc = sqlite3_prepare_v2(p_file_info->db,
+								"UPDATE " BLOBS_TABLE " SET Filename = ? WHERE Filename = ? ;",
+								-1, &stmt_rotate_blobs, NULL);
+		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+		db_blob_metadata_rename(stmt_rotate_blobs, BLOB_MAX_FILES, 0);
+		sqlite3_finalize(stmt_rotate_blobs);
+	}
+	else if(max_file_exists){
+		int missing = -1;
+		for(int i = 0; i < BLOB_MAX_FILES && missing < 0; i++){
+			if(!db_blob_file_exists(db_loop, p_file_info->db_dir, i)) missing = i;
+		}
+		if(missing < 0){
+			fprintf_log(LOGS_MANAG_WARNING, stderr, "Unexpected %s%s will be overwritten\n", p_file_info->db_dir, max_filename);
+			return;
+		}
+		fprintf_log(LOGS_MANAG_WARNING, stderr, "Undoing interrupted rotation of BLOBs of %s\n", p_file_info->filename);
+		for(int i = missing; i < BLOB_MAX_FILES; i++){
+			rc = db_blob_file_rename(db_loop, p_file_info->db_dir, i + 1, i);
+			if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+		}
+		db_dir_sync(db_loop, p_file_info->db_dir);
+	}
+}
+
+/**
+ * @brief Complete or discard an interrupted compaction of a BLOB
+ * @details A recompressed BLOB replaces the original one only after its metadata have
+ * been committed (see db_blob_compact()). So, if its temporary file is still around, it 
+ * replaces the BLOB if the metadata say so, otherwise it is discarded.
+ * @param db_dir DB directory of the log source
+ * @param blob_path Path of the BLOB
+ * @param blob_id Id of the BLOB in BLOBS_TABLE
+ * @param metadata_filesize Filesize of the BLOB in BLOBS_TABLE
+ * @param compacted Compacted flag of the BLOB in BLOBS_TABLE
+ */
+static void db_blob_compaction_recover(const char *db_dir, const char *blob_path, int blob_id, 
+									   int64_t metadata_filesize, int compacted){
+	char compact_path[FILENAME_MAX + 1];
+	uv_fs_t req;
+	snprintf(compact_path, FILENAME_MAX, "%s" BLOB_COMPACT_FILENAME ".%d", db_dir, blob_id);
+	const int64_t compact_filesize = db_file_size(db_loop, compact_path);
+	if(compact_filesize < 0) return;
+
+	if(compacted && compact_filesize == metadata_filesize){
+		fprintf_log(LOGS_MANAG_WARNING, stderr, "Completing interrupted compaction of %s\n", blob_path);
+		const int rc = uv_fs_rename(db_loop, &req, compact_path, blob_path, NULL);
+		uv_fs_req_cleanup(&req);
+		if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+		db_dir_sync(db_loop, db_dir);
+	}
+	else {
+		(void) uv_fs_unlink(db_loop, &req, compact_path, NULL);
+		uv_fs_req_cleanup(&req);
+	}
+}
+
+/**
+ * @brief Rebuild the metadata of a BLOB that is shorter than they say
+ * @details This is the case when the BLOB was lost or truncated, without its metadata 
+ * being updated (e.g. due to a crash or power loss). The metadata of any log messages 
+ * that are not (wholly) in the BLOB are deleted and the rest of the BLOB metadata are 
+ * rebuilt from the remaining ones.
+ * @param db Metadata DB of the log source
+ * @param blob_id Id of the BLOB in BLOBS_TABLE
+ * @param blob_filesize Actual size of the BLOB
+ * @return The rebuilt filesize of the BLOB, which never exceeds blob_filesize.
+ */
+static int64_t db_blob_metadata_rebuild(sqlite3 *db, int blob_id, int64_t blob_filesize){
+	int rc = 0;
+	sqlite3_stmt *stmt_logs_delete_beyond, *stmt_blobs_rebuild, *stmt_get_filesize;
+
+	rc = sqlite3_prepare_v2(db,
+							"DELETE FROM " LOGS_TABLE 
+							" WHERE FK_BLOB_Id = ?1 AND BLOB_Offset + Msg_compr_size > ?2 ;",
+							-1, &stmt_logs_delete_beyond, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_prepare_v2(db,
+							"UPDATE " BLOBS_TABLE " SET "
+							"Filesize = COALESCE((SELECT MAX(BLOB_Offset + Msg_compr_size) FROM " LOGS_TABLE " WHERE FK_BLOB_Id = ?1), 0), "
+							"Last_timestamp = COALESCE((SELECT MAX(Timestamp) FROM " LOGS_TABLE " WHERE FK_BLOB_Id = ?1), 0), "
+							"Last_log_id = COALESCE((SELECT MAX(Id) FROM " LOGS_TABLE " WHERE FK_BLOB_Id = ?1), 0), "
+							"Compacted = CASE WHEN EXISTS (SELECT 1 FROM " LOGS_TABLE " WHERE FK_BLOB_Id = ?1) THEN Compacted ELSE 0 END "
+							"WHERE Id = ?1 ;",
+							-1, &stmt_blobs_rebuild, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_prepare_v2(db,
+							"SELECT Filesize FROM " BLOBS_TABLE " WHERE Id = ? ;",
+							-1, &stmt_get_filesize, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+
+	sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+	rc = sqlite3_bind_int(stmt_logs_delete_beyond, 1, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_bind_int64(stmt_logs_delete_beyond, 2, (sqlite3_int64) blob_filesize);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(stmt_logs_delete_beyond);
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	const int msgs_deleted = sqlite3_changes(db);
+	rc = sqlite3_bind_int(stmt_blobs_rebuild, 1, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(stmt_blobs_rebuild);
+	if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+	sqlite3_exec(db, "END TRANSACTION;", NULL, NULL, NULL);
+
+	rc = sqlite3_bind_int(stmt_get_filesize, 1, blob_id);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	rc = sqlite3_step(stmt_get_filesize);
+	if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__);
+	const int64_t filesize = (int64_t) sqlite3_column_int64(stmt_get_filesize, 0);
+
+	sqlite3_finalize(stmt_logs_delete_beyond);
+	sqlite3_finalize(stmt_blobs_rebuild);
+	sqlite3_finalize(stmt_get_filesize);
+
+	fprintf_log(LOGS_MANAG_WARNING, stderr, "Dropped the metadata of %d log messages missing from BLOB %d\n", msgs_deleted, blob_id);
+	return filesize;
+}
+
+/**
+ * @brief Process the events of the uv_loop_t related to the DB API
+ */
+static void db_loop_run(void *arg){
+    uv_run(db_loop, UV_RUN_DEFAULT);
+}
+
+/**
+ * @brief Initialise the metadata DB and the BLOBs of a log source
+ * @details The metadata DB is created if it does not exist, or migrated to the latest 
+ * schema, and any inconsistencies between it and the BLOBs (due to a crash or power loss) 
+ * are healed.
+ * @param p_file_info Log source, its db_dir must already be set.
+ * @param metadata_cache_size Maximum page cache size of the metadata DB (in KiB).
+ */
+static void db_log_source_init(struct File_info *p_file_info, int metadata_cache_size){
+	int rc = 0;
+	char *err_msg = 0;
+
+	/* Create or open the metadata DB of the log source */
+	char *db_metadata_path = mallocz(snprintf(NULL, 0, "%s" METADATA_DB_FILENAME, p_file_info->db_dir) + 1);
+	sprintf(db_metadata_path, "%s" METADATA_DB_FILENAME, p_file_info->db_dir);
+	rc = sqlite3_open(db_metadata_path, &p_file_info->db);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	freez(db_metadata_path);
+
+	/* Initialise DB mutex */
+	p_file_info->db_mut = mallocz(sizeof(uv_mutex_t));
+	rc = uv_mutex_init(p_file_info->db_mut);
+    if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+
+	/* Configure metadata DB */
+	rc = sqlite3_exec(p_file_info->db,
+					  "PRAGMA auto_vacuum = INCREMENTAL;"
+					  "PRAGMA synchronous = 1;"
+					  "PRAGMA journal_mode = WAL;"
+					  "PRAGMA temp_store = MEMORY;"
+					  "PRAGMA foreign_keys = ON;",
+					  0, 0, &err_msg);
+	if (likely(rc == SQLITE_OK)) {
+		char pragma_cache_size[50];
+		snprintf(pragma_cache_size, sizeof(pragma_cache_size), "PRAGMA cache_size = -%d;", metadata_cache_size);
+		rc = sqlite3_exec(p_file_info->db, pragma_cache_size, 0, 0, &err_msg);
+	}
+	if (unlikely(rc != SQLITE_OK)) {
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to configure database for %s\n", p_file_info->filename);
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "SQL error: %s\n", err_msg);
+		sqlite3_free(err_msg);
+		fatal("Failed to configure database for %s\n, SQL error: %s\n", p_file_info->filename, err_msg);
+	} else fprintf_log(LOGS_MANAG_INFO, stderr, "Database configured successfully\n");
+
+	/* Check if BLOBS_TABLE exists or not */
+	sqlite3_stmt *stmt_check_if_BLOBS_TABLE_exists;
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"SELECT COUNT(*) FROM sqlite_master" 
+							" WHERE type='table' AND name='"BLOBS_TABLE"';",
+							-1, &stmt_check_if_BLOBS_TABLE_exists, NULL);
 	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-	rc = sqlite3_bind_int(stmt_retrieve_filesize_from_id, 1, p_file_info->blob_write_handle_offset);
-    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-    rc = sqlite3_step(stmt_retrieve_filesize_from_id);
-	if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__);
-	int64_t blob_filesize = (int64_t) sqlite3_column_int64(stmt_retrieve_filesize_from_id, 0);
-	sqlite3_finalize(stmt_retrieve_filesize_from_id);
-	
-	fprintf_log(LOGS_MANAG_DEBUG, stderr, "initial blob_filesize: %" PRId64 "\n", blob_filesize);
-	
-	
-	Message_t *p_msg;
-	uv_fs_t write_req;
-	uv_fs_t dsync_req;
-	uv_fs_t rename_req;
-	uv_fs_t trunc_req;
-	while(1){
-		db_set_lock(p_file_info->db_mut);
-		sqlite3_exec(p_file_info->db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
-		p_msg = circ_buff_read(p_file_info->msg_buff);
-		while (p_msg) {  // Retrieve msgs and store in DB until there are no more msgs in the buffer
-			
-			/* Write log message in BLOB */
-			uv_buf_t uv_buf = uv_buf_init((char *) p_msg->text_compressed, (unsigned int) p_msg->text_compressed_size);
-			rc = uv_fs_write(writer_loop, &write_req, 
-				p_file_info->blob_handles[p_file_info->blob_write_handle_offset], 
-				&uv_buf, 1, blob_filesize, NULL); // Write synchronously at the end of the BLOB file
-			if(unlikely(rc < 0)) fatal("Failed to write logs management BLOB");
-			uv_fs_req_cleanup(&write_req);
-			
-			/* Write metadata of log message in LOGS_TABLE */
-			fprintf_log(LOGS_MANAG_DEBUG, stderr, "DB msg timestamp: %" PRIu64 "\n", p_msg->timestamp);
-            fprintf_log(LOGS_MANAG_DEBUG, stderr, "DB msg size: %zu\n", p_msg->text_size);
-            rc = sqlite3_bind_int(stmt_logs_insert, 1, p_file_info->blob_write_handle_offset);
-            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_bind_int64(stmt_logs_insert, 2, (sqlite3_int64) blob_filesize);
-            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_bind_int64(stmt_logs_insert, 3, (sqlite3_int64) p_msg->timestamp);
-            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_bind_int64(stmt_logs_insert, 4, (sqlite3_int64) p_msg->text_compressed_size);
-            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_bind_int64(stmt_logs_insert, 5, (sqlite3_int64)p_msg->text_size);
-            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_step(stmt_logs_insert);
-            if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
-            sqlite3_reset(stmt_logs_insert);
-            
-            /* Update metadata of BLOBs filesize in BLOBS_TABLE */
-            rc = sqlite3_bind_int64(stmt_blobs_update, 1, (sqlite3_int64)p_msg->text_compressed_size);
-            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_bind_int(stmt_blobs_update, 2, p_file_info->blob_write_handle_offset);
-            if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_step(stmt_blobs_update);
-            if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
-            sqlite3_reset(stmt_blobs_update);
-			
-			/* Increase BLOB offset and read next log message until no more messages in buff */
-			blob_filesize += (int64_t) p_msg->text_compressed_size;
-			p_msg = circ_buff_read(p_file_info->msg_buff);
-		}
-		rc = uv_fs_fdatasync(writer_loop, &dsync_req, 
-			p_file_info->blob_handles[p_file_info->blob_write_handle_offset], NULL);
-		if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-		sqlite3_exec(p_file_info->db, "END TRANSACTION;", NULL, NULL, NULL);
-		//sqlite3_wal_checkpoint_v2(p_file_info->db,NULL,SQLITE_CHECKPOINT_PASSIVE,0,0);
-		
-		/* If the filesize of the current write-to BLOB is > BLOB_MAX_SIZE, rotate BLOBs */
-		if(blob_filesize > BLOB_MAX_SIZE){
-			const uint64_t start_time = get_unix_time_ms();
-			char old_path[FILENAME_MAX + 1], new_path[FILENAME_MAX + 1];
-
-			/* 1. Rotate BLOBS_TABLE Filenames and path of actual BLOBs. 
-			 * Performed in 2 steps: 
-			 * (a) First increase all of their endings numbers by 1 and 
-			 * (b) then replace the maximum number with 0. */
-			sqlite3_exec(p_file_info->db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
-			for(int i = BLOB_MAX_FILES - 1; i >= 0; i--){
-				
-				/* Rotate BLOBS_TABLE Filenames */
-				rc = sqlite3_bind_int(stmt_rotate_blobs, 1, i);
-				if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-				rc = sqlite3_bind_int(stmt_rotate_blobs, 2, i + 1);
+	rc = sqlite3_step(stmt_check_if_BLOBS_TABLE_exists);
+	if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__); /* COUNT(*) query should always return SQLITE_ROW */
+
+	/* If BLOBS_TABLE doesn't exist, create and populate it */
+	if(sqlite3_column_int(stmt_check_if_BLOBS_TABLE_exists, 0) == 0){
+
+		/* 1. Create it */
+		rc = sqlite3_exec(p_file_info->db,
+                  "CREATE TABLE IF NOT EXISTS " BLOBS_TABLE "("
+                  "Id 		INTEGER 	PRIMARY KEY,"
+                  "Filename	TEXT		NOT NULL,"
+                  "Filesize INTEGER 	NOT NULL,"
+                  "Last_timestamp INTEGER NOT NULL DEFAULT 0,"
+                  "Last_log_id INTEGER NOT NULL DEFAULT 0,"
+                  "Compacted INTEGER NOT NULL DEFAULT 0"
+                  ");",
+                  0, 0, &err_msg);
+		if (unlikely(rc != SQLITE_OK)) {
+			fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to create %s. SQL error: %s\n", BLOBS_TABLE, err_msg);
+			sqlite3_free(err_msg);
+			fatal("Failed to create %s. SQL error: %s\n", BLOBS_TABLE, err_msg);
+		} else fprintf_log(LOGS_MANAG_INFO, stderr, "Table %s created successfully\n", BLOBS_TABLE);
+
+		/* 2. Populate it */
+		sqlite3_stmt *stmt_init_BLOBS_table;
+		rc = sqlite3_prepare_v2(p_file_info->db,
+                        "INSERT INTO " BLOBS_TABLE 
+                        " (Filename, Filesize) VALUES (?,?) ;",
+                        -1, &stmt_init_BLOBS_table, NULL);
+		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+		for( int i = 0; i < BLOB_MAX_FILES; i++){
+			char *filename = mallocz(snprintf(NULL, 0, BLOB_STORE_FILENAME ".%d", i) + 1);
+			sprintf(filename, BLOB_STORE_FILENAME ".%d", i);
+			rc = sqlite3_bind_text(stmt_init_BLOBS_table, 1, filename, -1, NULL);
+            if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+            rc = sqlite3_bind_int64(stmt_init_BLOBS_table, 2, (sqlite3_int64) 0);
+            if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);      
+			rc = sqlite3_step(stmt_init_BLOBS_table);
+			if (rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
+			sqlite3_reset(stmt_init_BLOBS_table);
+			freez(filename);
+		}
+		sqlite3_finalize(stmt_init_BLOBS_table);
+	}
+	sqlite3_finalize(stmt_check_if_BLOBS_TABLE_exists);
+
+	/* If LOGS_TABLE doesn't exist, create it */
+	rc = sqlite3_exec(p_file_info->db,
+                  "CREATE TABLE IF NOT EXISTS " LOGS_TABLE "("
+                  "Id 					INTEGER 	PRIMARY KEY,"
+                  "FK_BLOB_Id			INTEGER		NOT NULL,"
+                  "BLOB_Offset			INTEGER		NOT NULL,"
+                  "Timestamp 			INTEGER		NOT NULL,"
+                  "Msg_compr_size 		INTEGER		NOT NULL,"
+                  "Msg_decompr_size 	INTEGER		NOT NULL,"
+                  "Bloom 				BLOB,"
+                  "Codec 				INTEGER		NOT NULL DEFAULT 0,"
+                  "Dict_id 				INTEGER		NOT NULL DEFAULT 0,"
+                  "FOREIGN KEY (FK_BLOB_Id) REFERENCES " BLOBS_TABLE " (Id) ON DELETE CASCADE ON UPDATE CASCADE"
+                  ");",
+                  0, 0, &err_msg);
+	if (unlikely(rc != SQLITE_OK)) {
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to create %s. SQL error: %s\n", LOGS_TABLE, err_msg);
+		sqlite3_free(err_msg);
+		fatal("Failed to create %s. SQL error: %s\n", LOGS_TABLE, err_msg);
+	} else fprintf_log(LOGS_MANAG_INFO, stderr, "Table %s created successfully\n", LOGS_TABLE);
+
+	/* Add any columns to LOGS_TABLE that were introduced after it was created. 
+	 * Rows without a bloom filter (NULL) are never skipped by keyword searches and 
+	 * rows without a codec were compressed with LOGS_COMPR_CODEC_LZ4F. */
+	db_table_add_column(p_file_info->db, LOGS_TABLE, "Bloom", "BLOB");
+	db_table_add_column(p_file_info->db, LOGS_TABLE, "Codec", "INTEGER NOT NULL DEFAULT 0");
+	db_table_add_column(p_file_info->db, LOGS_TABLE, "Dict_id", "INTEGER NOT NULL DEFAULT 0");
+
+	/* Same for BLOBS_TABLE. The newest log message of BLOBs written before Last_timestamp
+	 * and Last_log_id were introduced is looked up once, so that they can be dropped too. */
+	db_table_add_column(p_file_info->db, BLOBS_TABLE, "Last_timestamp", "INTEGER NOT NULL DEFAULT 0");
+	db_table_add_column(p_file_info->db, BLOBS_TABLE, "Last_log_id", "INTEGER NOT NULL DEFAULT 0");
+	db_table_add_column(p_file_info->db, BLOBS_TABLE, "Compacted", "INTEGER NOT NULL DEFAULT 0");
+	rc = sqlite3_exec(p_file_info->db,
+					  "UPDATE " BLOBS_TABLE " SET "
+					  "Last_timestamp = COALESCE((SELECT MAX(Timestamp) FROM " LOGS_TABLE " WHERE FK_BLOB_Id = " BLOBS_TABLE ".Id), 0), "
+					  "Last_log_id = COALESCE((SELECT MAX(Id) FROM " LOGS_TABLE " WHERE FK_BLOB_Id = " BLOBS_TABLE ".Id), 0) "
+					  "WHERE Filesize > 0 AND Last_log_id = 0;",
+					  0, 0, &err_msg);
+	if (unlikely(rc != SQLITE_OK)) {
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to migrate %s. SQL error: %s\n", BLOBS_TABLE, err_msg);
+		sqlite3_free(err_msg);
+		fatal("Failed to migrate %s\n", BLOBS_TABLE);
+	}
+
+	/* If DICTS_TABLE doesn't exist, create it and then load the compression dictionaries */
+	rc = sqlite3_exec(p_file_info->db,
+                  "CREATE TABLE IF NOT EXISTS " DICTS_TABLE "("
+                  "Id 		INTEGER 	PRIMARY KEY,"
+                  "Dict 	BLOB		NOT NULL"
+                  ");",
+                  0, 0, &err_msg);
+	if (unlikely(rc != SQLITE_OK)) {
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to create %s. SQL error: %s\n", DICTS_TABLE, err_msg);
+		sqlite3_free(err_msg);
+		fatal("Failed to create %s\n", DICTS_TABLE);
+	}
+	db_compr_dicts_init(p_file_info);
+
+	/* Create covering index on LOGS_TABLE Timestamp. It includes all the columns needed by 
+	 * db_search(), so that a time range query can be answered by the index alone, already
+	 * sorted by time and BLOB offset, without any lookups in LOGS_TABLE. The previous 
+	 * indexes (logs_timestamps_idx and logs_timestamps_covering_idx, without the codec
+	 * columns) are superseded, so drop them if they exist. */
+	rc = sqlite3_exec(p_file_info->db,
+					  "DROP INDEX IF EXISTS logs_timestamps_idx;"
+					  "DROP INDEX IF EXISTS logs_timestamps_covering_idx;"
+					  "CREATE INDEX IF NOT EXISTS logs_timestamps_codec_covering_idx "
+					  "ON " LOGS_TABLE "(Timestamp, FK_BLOB_Id, BLOB_Offset, Msg_compr_size, Msg_decompr_size, Codec, Dict_id);",
+					  0, 0, &err_msg);
+	if (unlikely(rc != SQLITE_OK)) {
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to create logs_timestamps_codec_covering_idx. SQL error: %s\n", err_msg);
+		sqlite3_free(err_msg);
+	} else fprintf_log(LOGS_MANAG_INFO, stderr, "logs_timestamps_codec_covering_idx created successfully\n");
+
+	/* Complete or undo any interrupted rotation of the BLOBs, before the BLOB filenames are relied upon */
+	db_blobs_rotation_recover(p_file_info);
+
+	/* Remove excess BLOBs beyond BLOB_MAX_FILES (from both DB and disk storage) */
+	{
+		sqlite3_stmt *stmt_get_BLOBS_TABLE_size;
+		rc = sqlite3_prepare_v2(p_file_info->db,
+			"SELECT MAX(Id) FROM " BLOBS_TABLE ";",
+			-1, &stmt_get_BLOBS_TABLE_size, NULL);
+		if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+		rc = sqlite3_step(stmt_get_BLOBS_TABLE_size);
+		if (rc != SQLITE_ROW) fatal_sqlite3_err(rc, __LINE__);
+		int blobs_table_max_id = sqlite3_column_int(stmt_get_BLOBS_TABLE_size, 0);
+		sqlite3_finalize(stmt_get_BLOBS_TABLE_size);
+
+		sqlite3_stmt *stmt_retrieve_filename_last_digits; // This statement retrieves the last digit(s) from the Filename column of BLOBS_TABLE
+		rc = sqlite3_prepare_v2(p_file_info->db,
+			"WITH split(word, str) AS ( SELECT '', (SELECT Filename FROM " BLOBS_TABLE " WHERE Id = ? ) || '.' "
+			"UNION ALL SELECT substr(str, 0, instr(str, '.')), substr(str, instr(str, '.')+1) FROM split WHERE str!='' ) "
+			"SELECT word FROM split WHERE word!='' ORDER BY LENGTH(str) LIMIT 1;",
+			-1, &stmt_retrieve_filename_last_digits, NULL);
+		if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+
+		sqlite3_stmt *stmt_delete_row_by_id; 
+		rc = sqlite3_prepare_v2(p_file_info->db,
+			"DELETE FROM " BLOBS_TABLE " WHERE Id = ?;",
+			-1, &stmt_delete_row_by_id, NULL);
+		if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+
+		for (int id = 1; id <= blobs_table_max_id; id++){
+
+			// fprintf_log(LOGS_MANAG_DEBUG, stderr, "----Id:: %d\n", id);
+			rc = sqlite3_bind_int(stmt_retrieve_filename_last_digits, 1, id);
+			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+			rc = sqlite3_step(stmt_retrieve_filename_last_digits);
+			if (rc == SQLITE_DONE){ // No BLOB with this Id, it will be renumbered below
+				sqlite3_reset(stmt_retrieve_filename_last_digits);
+				continue;
+			}
+			if (rc != SQLITE_ROW) fatal_sqlite3_err(rc, __LINE__);
+			int last_digits = sqlite3_column_int(stmt_retrieve_filename_last_digits, 0);
+			sqlite3_reset(stmt_retrieve_filename_last_digits);
+
+			/* If last_digits > BLOB_MAX_FILES - 1, then some BLOB files will need to be removed
+			 * (both from DB BLOBS_TABLE and also from the disk) */
+			if(last_digits > BLOB_MAX_FILES - 1){
+
+				// Delete entry from DB BLOBS_TABLE
+				rc = sqlite3_bind_int(stmt_delete_row_by_id, 1, id);
 				if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-				rc = sqlite3_step(stmt_rotate_blobs);
-				if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
-				sqlite3_reset(stmt_rotate_blobs);
-				
-				/* Rotate path of BLOBs */
-				sprintf(old_path, "%s" BLOB_STORE_FILENAME ".%d", p_file_info->db_dir, i);
-				sprintf(new_path, "%s" BLOB_STORE_FILENAME ".%d", p_file_info->db_dir, i + 1);
-				rc = uv_fs_rename(writer_loop, &rename_req, old_path, new_path, NULL);
-				if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-				uv_fs_req_cleanup(&rename_req);
+				rc = sqlite3_step(stmt_delete_row_by_id);
+				if (rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
+				sqlite3_reset(stmt_delete_row_by_id);
+
+				// Delete BLOB file from filesystem
+				char blob_delete_path[FILENAME_MAX + 1];
+				sprintf(blob_delete_path, "%s" BLOB_STORE_FILENAME ".%d", p_file_info->db_dir, last_digits);
+				uv_fs_t unlink_req;
+			    rc = uv_fs_unlink(db_loop, &unlink_req, blob_delete_path, NULL);
+			    if (rc) fprintf(stderr, "Delete %s error: %s\n", blob_delete_path, uv_strerror(rc));
+			    uv_fs_req_cleanup(&unlink_req);
+
 			}
-			/* Replace the maximum number with 0 in SQLite DB. */
-			rc = sqlite3_bind_int(stmt_rotate_blobs, 1, BLOB_MAX_FILES);
-			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-			rc = sqlite3_bind_int(stmt_rotate_blobs, 2, 0);
+		}
+		sqlite3_finalize(stmt_retrieve_filename_last_digits);
+		sqlite3_finalize(stmt_delete_row_by_id);
+
+
+		/* Renumber the remaining BLOBs from 1 with a single set-based UPDATE, keeping their order. 
+		 * The new Ids are computed before any row is updated and each row only moves to a lower 
+		 * Id, one freed by a row with a lower Id that has moved already (the rows are updated 
+		 * in Id order), so the Ids never collide. Nothing is updated if no BLOBs were removed. */
+		rc = sqlite3_exec(p_file_info->db,
+			"UPDATE " BLOBS_TABLE " SET Id = Renumbered.New_id "
+			"FROM (SELECT Id AS Old_id, ROW_NUMBER() OVER (ORDER BY Id) AS New_id FROM " BLOBS_TABLE ") AS Renumbered "
+			"WHERE " BLOBS_TABLE ".Id = Renumbered.Old_id AND " BLOBS_TABLE ".Id != Renumbered.New_id;",
+			0, 0, NULL);
+		if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+
+	}
+
+	/* Traverse BLOBS_TABLE, open logs.bin.X files and store their file handles in p_file_info array. 
+	 * Any BLOB that does not match its metadata (due to a crash or power loss) is healed, by either 
+	 * truncating the BLOB or rebuilding its metadata. */
+	sqlite3_stmt *stmt_retrieve_metadata_from_id;
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"SELECT Filename, Filesize, Compacted FROM " BLOBS_TABLE 
+							" WHERE Id = ? ;",
+							-1, &stmt_retrieve_metadata_from_id, NULL);
+	if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+
+	/* The end of the newest log message of a BLOB must match its filesize. Being a lookup
+	 * by primary key, this is a cheap check, regardless of the number of log messages. */
+	sqlite3_stmt *stmt_retrieve_last_log_end;
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"SELECT BLOB_Offset + Msg_compr_size FROM " LOGS_TABLE 
+							" WHERE Id = (SELECT Last_log_id FROM " BLOBS_TABLE " WHERE Id = ?1) AND FK_BLOB_Id = ?1 ;",
+							-1, &stmt_retrieve_last_log_end, NULL);
+	if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+
+	uv_fs_t open_req;
+	for(int id = 1; id <= BLOB_MAX_FILES; id++){
+		/* Open BLOB file based on filename stored in BLOBS_TABLE. */
+		rc = sqlite3_bind_int(stmt_retrieve_metadata_from_id, 1, id);
+        if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+		rc = sqlite3_step(stmt_retrieve_metadata_from_id);
+		if (rc != SQLITE_ROW) fatal_sqlite3_err(rc, __LINE__);
+		char *filename = mallocz(snprintf(NULL, 0, "%s%s", 
+			p_file_info->db_dir, 
+			sqlite3_column_text(stmt_retrieve_metadata_from_id, 0)) + 1);
+		sprintf(filename, "%s%s", p_file_info->db_dir, 
+			sqlite3_column_text(stmt_retrieve_metadata_from_id, 0));
+		int64_t metadata_filesize = (int64_t) sqlite3_column_int64(stmt_retrieve_metadata_from_id, 1);
+
+		db_blob_compaction_recover(p_file_info->db_dir, filename, id, metadata_filesize, 
+			sqlite3_column_int(stmt_retrieve_metadata_from_id, 2));
+
+		rc = uv_fs_open(db_loop, &open_req, filename, 
+			UV_FS_O_RDWR | UV_FS_O_CREAT | UV_FS_O_RANDOM , 0644, NULL);
+		if (unlikely(rc < 0)) fatal_libuv_err(rc, __LINE__);
+		fprintf_log(LOGS_MANAG_DEBUG, stderr, "Opened file: %s\n", filename);
+		p_file_info->blob_handles[id] = open_req.result; 	// open_req.result of a uv_fs_t is the file descriptor in case of the uv_fs_open
+
+		/* Get filesize of BLOB file. */ 
+		uv_fs_t stat_req;
+		rc = uv_fs_fstat(db_loop, &stat_req, p_file_info->blob_handles[id], NULL);
+		if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+		uv_stat_t *statbuf = uv_fs_get_statbuf(&stat_req);
+		int64_t blob_filesize = (int64_t) statbuf->st_size;
+		uv_fs_req_cleanup(&stat_req);
+
+		/* Check that the metadata of the BLOB are consistent with its log messages */
+		if(metadata_filesize){
+			rc = sqlite3_bind_int(stmt_retrieve_last_log_end, 1, id);
 			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-			rc = sqlite3_step(stmt_rotate_blobs);
-			if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
-			sqlite3_reset(stmt_rotate_blobs);
-			sqlite3_exec(p_file_info->db, "END TRANSACTION;", NULL, NULL, NULL);
-			
-			/* Replace the maximum number with 0 in BLOB files. */
-			sprintf(old_path, "%s" BLOB_STORE_FILENAME ".%d", p_file_info->db_dir, BLOB_MAX_FILES);
-			sprintf(new_path, "%s" BLOB_STORE_FILENAME ".%d", p_file_info->db_dir, 0);
-			rc = uv_fs_rename(writer_loop, &rename_req, old_path, new_path, NULL);
-			if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-			uv_fs_req_cleanup(&rename_req);
-			
-			/* (a) Update blob_write_handle_offset, (b) truncate new write-to BLOB, 
-			 * (c) update filesize of truncated BLOB in SQLite DB, (d) delete
-			 * respective logs in LOGS_TABLE for the truncated BLOB and (e)
-			 * reset blob_filesize */
-			/* (a) */ 
-			p_file_info->blob_write_handle_offset = p_file_info->blob_write_handle_offset == 1 ? BLOB_MAX_FILES : p_file_info->blob_write_handle_offset - 1;
-			/* (b) */ 
-			rc = uv_fs_ftruncate(writer_loop, &trunc_req, p_file_info->blob_handles[p_file_info->blob_write_handle_offset], 0, NULL);						
-			if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-			uv_fs_req_cleanup(&trunc_req);
-			/* (c) */ 
-			rc = sqlite3_bind_int(stmt_blobs_set_zero_filesize, 1, p_file_info->blob_write_handle_offset);
-            if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_step(stmt_blobs_set_zero_filesize);
-			if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
-			sqlite3_reset(stmt_blobs_set_zero_filesize);
-			/* (d) */
-			rc = sqlite3_bind_int(stmt_logs_delete, 1, p_file_info->blob_write_handle_offset);
-            if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-            rc = sqlite3_step(stmt_logs_delete);
-			if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
-			sqlite3_reset(stmt_logs_delete);
-			/* (e) */
-			blob_filesize = 0;
+			rc = sqlite3_step(stmt_retrieve_last_log_end);
+			const int64_t last_log_end = rc == SQLITE_ROW ? (int64_t) sqlite3_column_int64(stmt_retrieve_last_log_end, 0) : -1;
+			if (unlikely(rc != SQLITE_ROW && rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
+			sqlite3_reset(stmt_retrieve_last_log_end);
+			if(unlikely(last_log_end != metadata_filesize)){
+				fprintf_log(LOGS_MANAG_WARNING, stderr, "Inconsistent metadata for '%s'. Will attempt to fix.\n", filename);
+				metadata_filesize = db_blob_metadata_rebuild(p_file_info->db, id, 
+					blob_filesize < metadata_filesize ? blob_filesize : metadata_filesize);
+			}
+		}
 
-			fprintf_log(LOGS_MANAG_INFO, stderr,
-                "It took %" PRId64 "ms to rotate BLOBs\n",
-                (int64_t)get_unix_time_ms() - start_time);
+		/* If blob_filesize < metadata_filesize, the BLOB was lost or truncated (e.g. it was 
+		 * dropped but the metadata were not committed) - rebuild the metadata from the 
+		 * log messages that are still in the BLOB. This may leave a partial log message 
+		 * at the end of the BLOB, so then truncate the BLOB too. */
+		if(unlikely(blob_filesize < metadata_filesize)){
+			fprintf_log(LOGS_MANAG_WARNING, stderr, "blob_filesize < metadata_filesize for '%s'. Will attempt to fix.\n", filename);
+			metadata_filesize = db_blob_metadata_rebuild(p_file_info->db, id, blob_filesize);
 		}
-		// TODO: Can db_release_lock(p_file_info->db_mut) be moved before if(blob_filesize > BLOB_MAX_SIZE) ?
-		db_release_lock(p_file_info->db_mut);
-		sleep_ms(DB_FLUSH_BUFF_INTERVAL);
+
+		/* If blob_filesize > metadata_filesize, truncate the BLOB to the metadata filesize, as the 
+		 * program crashed or terminated after writing to the BLOB but before the metadata were committed. */
+		if(unlikely(blob_filesize > metadata_filesize)){
+			fprintf_log(LOGS_MANAG_WARNING, stderr, "blob_filesize > metadata_filesize for '%s'. Will attempt to fix.\n", filename);
+			uv_fs_t trunc_req;
+		    rc = uv_fs_ftruncate(db_loop, &trunc_req, p_file_info->blob_handles[id], 
+		    	metadata_filesize, NULL);
+		    if(unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+		    uv_fs_req_cleanup(&trunc_req);
+		}
+
+		/* Initialise blob_write_handle with logs.bin.0 */
+		if(filename[strlen(filename) - 1] == '0')
+			p_file_info->blob_write_handle_offset = id;
+
+		freez(filename);
+		uv_fs_req_cleanup(&open_req);
+		sqlite3_reset(stmt_retrieve_metadata_from_id);
 	}
+	sqlite3_finalize(stmt_retrieve_metadata_from_id);
+	sqlite3_finalize(stmt_retrieve_last_log_end);
+
+	/* Prepare (once) the statement used by db_search() to retrieve the metadata of the 
+	 * log messages within a time range. BLOB Ids match 1-1 with FK_BLOB_Id, so no JOIN 
+	 * with BLOBS_TABLE is required. */
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"SELECT Timestamp, Msg_compr_size, Msg_decompr_size, BLOB_Offset, FK_BLOB_Id, Codec, Dict_id "
+							"FROM " LOGS_TABLE " INDEXED BY logs_timestamps_codec_covering_idx "
+							"WHERE Timestamp BETWEEN ? AND ? "
+							"ORDER BY Timestamp, FK_BLOB_Id, BLOB_Offset;",
+							-1, &p_file_info->stmt_get_log_msg_metadata, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+
+	/* Same as above, but also retrieving the bloom filter of each log message. Used by 
+	 * keyword searches only, as the Bloom column is not part of the covering index. */
+	rc = sqlite3_prepare_v2(p_file_info->db,
+							"SELECT Timestamp, Msg_compr_size, Msg_decompr_size, BLOB_Offset, FK_BLOB_Id, Codec, Dict_id, Bloom "
+							"FROM " LOGS_TABLE " INDEXED BY logs_timestamps_codec_covering_idx "
+							"WHERE Timestamp BETWEEN ? AND ? "
+							"ORDER BY Timestamp, FK_BLOB_Id, BLOB_Offset;",
+							-1, &p_file_info->stmt_get_log_msg_metadata_bloom, NULL);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
 }
 
 /**
- * @brief Process the events of the uv_loop_t related to the DB API
+ * @brief Initialise db_loop and the DB writer pool, unless already initialised
  */
-static void db_loop_run(void *arg){
-    uv_run(db_loop, UV_RUN_DEFAULT);
+static void db_loop_init(void){
+	int rc = 0;
+
+	if(db_loop) return;
+
+	rc = uv_mutex_init(&db_writer_pool.mut);
+	if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+	rc = uv_cond_init(&db_writer_pool.cond);
+	if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+
+	db_loop = mallocz(sizeof(uv_loop_t));
+	rc = uv_loop_init(db_loop);
+	if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+}
+
+/**
+ * @brief Open the metadata DB and BLOBs of a log source and register its DB writer
+ * @details Used by db_init() for each log source, but also by the unit tests, 
+ * which do not start any of the DB API threads.
+ * @param p_file_info Log source, its db_dir must already be set.
+ * @param metadata_cache_size Maximum page cache size of the metadata DB (in KiB).
+ */
+void db_log_source_open(struct File_info *p_file_info, int metadata_cache_size){
+	db_loop_init();
+	db_log_source_init(p_file_info, metadata_cache_size);
+
+	/* Register the DB writer of this log source with the writer pool */
+	db_writer_t *writer = db_writer_init(p_file_info);
+	uv_mutex_lock(&db_writer_pool.mut);
+	db_writer_pool.writers = reallocz(db_writer_pool.writers, (db_writer_pool.num_of_writers + 1) * sizeof(db_writer_t *));
+	db_writer_pool.writers[db_writer_pool.num_of_writers++] = writer;
+	uv_mutex_unlock(&db_writer_pool.mut);
+}
+
+/**
+ * @brief Find the DB writer of a log source in the writer pool
+ * @details Must be called with db_writer_pool.mut held.
+ * @return Offset of the writer in db_writer_pool.writers, or -1 if not found.
+ */
+static int db_writer_pool_find(struct File_info *p_file_info){
+	for(int i = 0; i < db_writer_pool.num_of_writers; i++){
+		if(db_writer_pool.writers[i]->p_file_info == p_file_info) return i;
+	}
+	return -1;
+}
+
+/**
+ * @brief Flush the circular buffer of a log source to the DB synchronously
+ * @details Only meant for the unit tests, as it does not coordinate with 
+ * the DB writer pool threads.
+ * @param p_file_info Log source opened with db_log_source_open()
+ */
+void db_log_source_flush(struct File_info *p_file_info){
+	uv_mutex_lock(&db_writer_pool.mut);
+	const int off = db_writer_pool_find(p_file_info);
+	db_writer_t *writer = off >= 0 ? db_writer_pool.writers[off] : NULL;
+	uv_mutex_unlock(&db_writer_pool.mut);
+	if(likely(writer)) db_writer_flush(writer, db_loop);
+}
+
+/**
+ * @brief Close the metadata DB and BLOBs of a log source and unregister its DB writer
+ * @details Only meant for the unit tests, as it does not coordinate with the DB 
+ * writer pool threads or the DB compactor. The log source can be opened again 
+ * with db_log_source_open(), which will run the startup recovery.
+ * @param p_file_info Log source opened with db_log_source_open()
+ */
+void db_log_source_close(struct File_info *p_file_info){
+	uv_mutex_lock(&db_writer_pool.mut);
+	const int off = db_writer_pool_find(p_file_info);
+	db_writer_t *writer = off >= 0 ? db_writer_pool.writers[off] : NULL;
+	if(likely(writer)){
+		memmove(&db_writer_pool.writers[off], &db_writer_pool.writers[off + 1], 
+			(size_t) (db_writer_pool.num_of_writers - off - 1) * sizeof(db_writer_t *));
+		db_writer_pool.num_of_writers--;
+		db_writer_pool.rr_next = 0;
+	}
+	uv_mutex_unlock(&db_writer_pool.mut);
+
+	if(likely(writer)){
+		for(int i = 1; i <= DB_WRITER_BATCH_MAX_MSGS; i++) sqlite3_finalize(writer->stmt_logs_insert[i]);
+		sqlite3_finalize(writer->stmt_blobs_update);
+		sqlite3_finalize(writer->stmt_rotate_blobs);
+		sqlite3_finalize(writer->stmt_blobs_set_zero_filesize);
+		sqlite3_finalize(writer->stmt_logs_delete);
+		sqlite3_finalize(writer->stmt_blobs_get);
+		sqlite3_finalize(writer->stmt_blob_filename_get);
+		sqlite3_finalize(writer->stmt_blob_msgs_get);
+		sqlite3_finalize(writer->stmt_logs_update_compacted);
+		sqlite3_finalize(writer->stmt_blobs_set_compacted);
+		freez(writer);
+	}
+
+	sqlite3_finalize(p_file_info->stmt_get_log_msg_metadata);
+	sqlite3_finalize(p_file_info->stmt_get_log_msg_metadata_bloom);
+	p_file_info->stmt_get_log_msg_metadata = p_file_info->stmt_get_log_msg_metadata_bloom = NULL;
+
+	uv_fs_t close_req;
+	for(int id = 1; id <= BLOB_MAX_FILES; id++){
+		uv_fs_close(db_loop, &close_req, p_file_info->blob_handles[id], NULL);
+		uv_fs_req_cleanup(&close_req);
+		p_file_info->blob_handles[id] = 0;
+	}
+
+	int rc = sqlite3_close(p_file_info->db);
+	if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+	p_file_info->db = NULL;
+	uv_mutex_destroy(p_file_info->db_mut);
+	freez(p_file_info->db_mut);
+	p_file_info->db_mut = NULL;
+
+	for(int i = 0; i < p_file_info->compr_dicts_num; i++){
+		LZ4_freeStream(p_file_info->compr_dicts[i].lz4_stream);
+		freez(p_file_info->compr_dicts[i].data);
+	}
+	freez(p_file_info->compr_dicts);
+	p_file_info->compr_dicts = NULL;
+	p_file_info->compr_dicts_num = 0;
 }
 
-void db_init() {
+/**
+ * @brief Initialise the DB API
+ * @details Opens (or creates) the main DB and the metadata DB and BLOBs of 
+ * each log source and starts the DB writer pool.
+ * @param num_of_writer_threads Number of DB writer pool threads, shared by all 
+ * the log sources (it will not exceed the number of log sources).
+ * @param metadata_cache_size Maximum page cache size of each metadata DB (in KiB).
+ * @param disk_space_budget Disk space budget (in bytes) of the BLOBs of all the log 
+ * sources, enforced by the DB compactor (0 for no limit).
+ * @param compactor_interval Interval (in seconds) between runs of the DB compactor.
+ */
+void db_init(int num_of_writer_threads, int metadata_cache_size, uint64_t disk_space_budget, int compactor_interval) {
 	int rc = 0;
     char *err_msg = 0;
     uv_fs_t mkdir_req;
-    
-    db_loop = mallocz(sizeof(uv_loop_t));
-    rc = uv_loop_init(db_loop);
-    if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+
+    db_loop_init();
 
     snprintf(main_db_dir, FILENAME_MAX, "%s/logs_management_db", netdata_configured_cache_dir);
     snprintf(main_db_path, FILENAME_MAX, "%s/" MAIN_DB, main_db_dir);
@@ -440,327 +2055,148 @@ void db_init() {
         }
         sqlite3_reset(stmt_search_if_log_source_exists);
         
-        /* Create or open metadata DBs for each log collection */
-        char *db_metadata_path = mallocz(snprintf(NULL, 0, "%s" METADATA_DB_FILENAME, p_file_infos_arr->data[i]->db_dir) + 1);
-		sprintf(db_metadata_path, "%s" METADATA_DB_FILENAME, p_file_infos_arr->data[i]->db_dir);
-		rc = sqlite3_open(db_metadata_path, &p_file_infos_arr->data[i]->db);
-		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-		freez(db_metadata_path);
-
-		/* Initialise DB mutex */
-		p_file_infos_arr->data[i]->db_mut = mallocz(sizeof(uv_mutex_t));
-		rc = uv_mutex_init(p_file_infos_arr->data[i]->db_mut);
-	    if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-		
-		/* Configure metadata DB */
-		rc = sqlite3_exec(p_file_infos_arr->data[i]->db,
-						  "PRAGMA auto_vacuum = INCREMENTAL;"
-						  "PRAGMA synchronous = 1;"
-						  "PRAGMA journal_mode = WAL;"
-						  "PRAGMA temp_store = MEMORY;"
-						  "PRAGMA foreign_keys = ON;",
-						  0, 0, &err_msg);
-		if (unlikely(rc != SQLITE_OK)) {
-			fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to configure database for %s\n", p_file_infos_arr->data[i]->filename);
-			fprintf_log(LOGS_MANAG_ERROR, stderr, "SQL error: %s\n", err_msg);
-			sqlite3_free(err_msg);
-			fatal("Failed to configure database for %s\n, SQL error: %s\n", p_file_infos_arr->data[i]->filename, err_msg);
-		} else fprintf_log(LOGS_MANAG_INFO, stderr, "Database configured successfully\n");
-		
-		/* Check if BLOBS_TABLE exists or not */
-		sqlite3_stmt *stmt_check_if_BLOBS_TABLE_exists;
-		rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-								"SELECT COUNT(*) FROM sqlite_master" 
-								" WHERE type='table' AND name='"BLOBS_TABLE"';",
-								-1, &stmt_check_if_BLOBS_TABLE_exists, NULL);
-		if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-		rc = sqlite3_step(stmt_check_if_BLOBS_TABLE_exists);
-		if (unlikely(rc != SQLITE_ROW)) fatal_sqlite3_err(rc, __LINE__); /* COUNT(*) query should always return SQLITE_ROW */
-		
-		/* If BLOBS_TABLE doesn't exist, create and populate it */
-		if(sqlite3_column_int(stmt_check_if_BLOBS_TABLE_exists, 0) == 0){
-			
-			/* 1. Create it */
-			rc = sqlite3_exec(p_file_infos_arr->data[i]->db,
-                      "CREATE TABLE IF NOT EXISTS " BLOBS_TABLE "("
-                      "Id 		INTEGER 	PRIMARY KEY,"
-                      "Filename	TEXT		NOT NULL,"
-                      "Filesize INTEGER 	NOT NULL"
-                      ");",
-                      0, 0, &err_msg);
-			if (unlikely(rc != SQLITE_OK)) {
-				fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to create %s. SQL error: %s\n", BLOBS_TABLE, err_msg);
-				sqlite3_free(err_msg);
-				fatal("Failed to create %s. SQL error: %s\n", BLOBS_TABLE, err_msg);
-			} else fprintf_log(LOGS_MANAG_INFO, stderr, "Table %s created successfully\n", BLOBS_TABLE);
-			
-			/* 2. Populate it */
-			sqlite3_stmt *stmt_init_BLOBS_table;
-			rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-                            "INSERT INTO " BLOBS_TABLE 
-                            " (Filename, Filesize) VALUES (?,?) ;",
-                            -1, &stmt_init_BLOBS_table, NULL);
-			if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
-			for( int i = 0; i < BLOB_MAX_FILES; i++){
-				char *filename = mallocz(snprintf(NULL, 0, BLOB_STORE_FILENAME ".%d", i) + 1);
-				sprintf(filename, BLOB_STORE_FILENAME ".%d", i);
-				rc = sqlite3_bind_text(stmt_init_BLOBS_table, 1, filename, -1, NULL);
-                if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-                rc = sqlite3_bind_int64(stmt_init_BLOBS_table, 2, (sqlite3_int64) 0);
-                if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);      
-				rc = sqlite3_step(stmt_init_BLOBS_table);
-				if (rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
-				sqlite3_reset(stmt_init_BLOBS_table);
-				freez(filename);
-			}
-			sqlite3_finalize(stmt_init_BLOBS_table);
-		}
-		sqlite3_finalize(stmt_check_if_BLOBS_TABLE_exists);
-		
-		/* If LOGS_TABLE doesn't exist, create it */
-		rc = sqlite3_exec(p_file_infos_arr->data[i]->db,
-                      "CREATE TABLE IF NOT EXISTS " LOGS_TABLE "("
-                      "Id 					INTEGER 	PRIMARY KEY,"
-                      "FK_BLOB_Id			INTEGER		NOT NULL,"
-                      "BLOB_Offset			INTEGER		NOT NULL,"
-                      "Timestamp 			INTEGER		NOT NULL,"
-                      "Msg_compr_size 		INTEGER		NOT NULL,"
-                      "Msg_decompr_size 	INTEGER		NOT NULL,"
-                      "FOREIGN KEY (FK_BLOB_Id) REFERENCES " BLOBS_TABLE " (Id) ON DELETE CASCADE ON UPDATE CASCADE"
-                      ");",
-                      0, 0, &err_msg);
-		if (unlikely(rc != SQLITE_OK)) {
-			fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to create %s. SQL error: %s\n", LOGS_TABLE, err_msg);
-			sqlite3_free(err_msg);
-			fatal("Failed to create %s. SQL error: %s\n", LOGS_TABLE, err_msg);
-		} else fprintf_log(LOGS_MANAG_INFO, stderr, "Table %s created successfully\n", LOGS_TABLE);
-		
-		// Create index on LOGS_TABLE Timestamp
-		/* TODO: If this doesn't speed up queries, check SQLITE R*tree module. 
-		 * Requires benchmarking with/without index. */
-		rc = sqlite3_exec(p_file_infos_arr->data[i]->db,
-						  "CREATE INDEX IF NOT EXISTS logs_timestamps_idx "
-						  "ON " LOGS_TABLE "(Timestamp);",
-						  0, 0, &err_msg);
-		if (unlikely(rc != SQLITE_OK)) {
-			fprintf_log(LOGS_MANAG_ERROR, stderr, "Failed to create logs_timestamps_idx. SQL error: %s\n", err_msg);
-			sqlite3_free(err_msg);
-		} else fprintf_log(LOGS_MANAG_INFO, stderr, "logs_timestamps_idx created successfully\n");
-
-		/* Remove excess BLOBs beyond BLOB_MAX_FILES (from both DB and disk storage) */
-		{
-			sqlite3_stmt *stmt_get_BLOBS_TABLE_size;
-			rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-				"SELECT MAX(Id) FROM " BLOBS_TABLE ";",
-				-1, &stmt_get_BLOBS_TABLE_size, NULL);
-			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-			rc = sqlite3_step(stmt_get_BLOBS_TABLE_size);
-			if (rc != SQLITE_ROW) fatal_sqlite3_err(rc, __LINE__);
-			int blobs_table_max_id = sqlite3_column_int(stmt_get_BLOBS_TABLE_size, 0);
-
-			sqlite3_stmt *stmt_retrieve_filename_last_digits; // This statement retrieves the last digit(s) from the Filename column of BLOBS_TABLE
-			rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-				"WITH split(word, str) AS ( SELECT '', (SELECT Filename FROM " BLOBS_TABLE " WHERE Id = ? ) || '.' "
-				"UNION ALL SELECT substr(str, 0, instr(str, '.')), substr(str, instr(str, '.')+1) FROM split WHERE str!='' ) "
-				"SELECT word FROM split WHERE word!='' ORDER BY LENGTH(str) LIMIT 1;",
-				-1, &stmt_retrieve_filename_last_digits, NULL);
-			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-
-			sqlite3_stmt *stmt_delete_row_by_id; 
-			rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-				"DELETE FROM " BLOBS_TABLE " WHERE Id = ?;",
-				-1, &stmt_delete_row_by_id, NULL);
-			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+        db_log_source_open(p_file_infos_arr->data[i], metadata_cache_size);
+    }
+    sqlite3_finalize(stmt_get_last_id);
+    sqlite3_finalize(stmt_search_if_log_source_exists);
+    sqlite3_finalize(stmt_insert_log_collection_metadata);
 
-			for (int id = 1; id <= blobs_table_max_id; id++){
+    /* Create the (fixed number of) DB writer pool worker threads, shared by all the log sources */
+    if(db_writer_pool.num_of_writers){
+    	if(num_of_writer_threads > db_writer_pool.num_of_writers) num_of_writer_threads = db_writer_pool.num_of_writers;
+    	if(num_of_writer_threads < 1) num_of_writer_threads = 1;
+    	for(int i = 0; i < num_of_writer_threads; i++){
+    		uv_thread_t *db_writer_thread = mallocz(sizeof(uv_thread_t));
+    		rc = uv_thread_create(db_writer_thread, db_writer_pool_worker, NULL);
+    		if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+    	}
+    	fprintf_log(LOGS_MANAG_INFO, stderr, "Created %d DB writer threads for %d log sources\n", 
+    		num_of_writer_threads, db_writer_pool.num_of_writers);
+    }
 
-				// fprintf_log(LOGS_MANAG_DEBUG, stderr, "----Id:: %d\n", id);
-				rc = sqlite3_bind_int(stmt_retrieve_filename_last_digits, 1, id);
-				if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-				rc = sqlite3_step(stmt_retrieve_filename_last_digits);
-				if (rc != SQLITE_ROW) fatal_sqlite3_err(rc, __LINE__);
-				int last_digits = sqlite3_column_int(stmt_retrieve_filename_last_digits, 0);
-				sqlite3_reset(stmt_retrieve_filename_last_digits);
+    /* Create the DB compactor thread, only if there is anything for it to do */
+    int compactor_needed = disk_space_budget > 0;
+    for(int i = 0; i < db_writer_pool.num_of_writers; i++){
+    	const struct File_info *p_file_info = db_writer_pool.writers[i]->p_file_info;
+    	if(p_file_info->retention_max_age || p_file_info->retention_max_size || p_file_info->compact_cold_blobs) compactor_needed = 1;
+    }
+    if(db_writer_pool.num_of_writers && compactor_needed){
+    	db_compactor.disk_space_budget = disk_space_budget;
+    	db_compactor.interval = compactor_interval > 0 ? compactor_interval : DB_COMPACTOR_INTERVAL_DEFAULT;
+    	uv_thread_t *db_compactor_thread = mallocz(sizeof(uv_thread_t));
+    	rc = uv_thread_create(db_compactor_thread, db_compactor_worker, NULL);
+    	if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
+    }
 
-				/* If last_digits > BLOB_MAX_FILES - 1, then some BLOB files will need to be removed
-				 * (both from DB BLOBS_TABLE and also from the disk) */
-				if(last_digits > BLOB_MAX_FILES - 1){
-
-					// Delete entry from DB BLOBS_TABLE
-					rc = sqlite3_bind_int(stmt_delete_row_by_id, 1, id);
-					if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-					rc = sqlite3_step(stmt_delete_row_by_id);
-					if (rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
-					sqlite3_reset(stmt_delete_row_by_id);
-
-					// Delete BLOB file from filesystem
-					char blob_delete_path[FILENAME_MAX + 1];
-					sprintf(blob_delete_path, "%s" BLOB_STORE_FILENAME ".%d", p_file_infos_arr->data[i]->db_dir, last_digits);
-					uv_fs_t unlink_req;
-				    rc = uv_fs_unlink(db_loop, &unlink_req, blob_delete_path, NULL);
-				    if (rc) fprintf(stderr, "Delete %s error: %s\n", blob_delete_path, uv_strerror(rc));
-				    uv_fs_req_cleanup(&unlink_req);
-				   
-				}
-			}
-			sqlite3_finalize(stmt_retrieve_filename_last_digits);
-			sqlite3_finalize(stmt_delete_row_by_id);
+    uv_thread_t *db_loop_run_thread = mallocz(sizeof(uv_thread_t));
+    if(unlikely(uv_thread_create(db_loop_run_thread, db_loop_run, NULL))) fatal("uv_thread_create() error");
+}
 
+/**
+ * @brief Metadata of a log message that is part of a contiguous BLOB span
+ */
+typedef struct db_span_msg {
+	uint64_t timestamp;
+	size_t text_compressed_size;
+	size_t text_size;
+	uint8_t codec;
+	int dict_id;
+} db_span_msg_t;
 
-			int old_blobs_table_ids[BLOB_MAX_FILES];
-			int off = 0;
-			sqlite3_stmt *stmt_retrieve_all_ids; 
-			rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-				"SELECT Id FROM " BLOBS_TABLE " ORDER BY Id ASC;",
-				-1, &stmt_retrieve_all_ids, NULL);
-			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+/**
+ * @brief Search a contiguous BLOB span
+ * @details This function reads all the compressed log messages of a contiguous 
+ * BLOB span with a single read operation and then decompresses them, one by one,
+ * appending them to the results buffer until the max_query_page_size is reached.
+ * @param[in,out] p_query_params Query parameters, including the results buffer.
+ * @param[in] p_file_info File_info struct of the log source being searched.
+ * @param[in] blob_id Id of the BLOB the span belongs to.
+ * @param[in] span_offset Offset of the first byte of the span in the BLOB.
+ * @param[in] span_size Size of the span in bytes.
+ * @param[in] span_msgs Metadata of the log messages of the span, in BLOB order.
+ * @param[in] span_msgs_num Number of items in span_msgs.
+ * @param[in] max_query_page_size Maximum size of the results buffer.
+ * @return 1 if max_query_page_size was reached, 0 if it was not, -1 if the span 
+ * could not be read from the BLOB.
+ */
+static int db_search_span(logs_query_params_t *p_query_params, struct File_info *p_file_info, 
+						  int blob_id, int64_t span_offset, size_t span_size, 
+						  db_span_msg_t *span_msgs, int span_msgs_num, size_t max_query_page_size){
+	int rc = 0;
 
-			rc = sqlite3_step(stmt_retrieve_all_ids);
-			while(rc == SQLITE_ROW){
-				old_blobs_table_ids[off++] = sqlite3_column_int(stmt_retrieve_all_ids, 0);
-				rc = sqlite3_step(stmt_retrieve_all_ids);
-			}
-			if (rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
-			sqlite3_finalize(stmt_retrieve_all_ids);
+	if(unlikely(span_size > p_file_info->search_span_buff_size)){
+		p_file_info->search_span_buff_size = span_size * BUFF_SCALE_FACTOR;
+		p_file_info->search_span_buff = reallocz(p_file_info->search_span_buff, p_file_info->search_span_buff_size);
+	}
 
-			sqlite3_stmt *stmt_update_id; 
-			rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-				"UPDATE " BLOBS_TABLE " SET Id = ? WHERE Id = ?;",
-				-1, &stmt_update_id, NULL);
-			if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
+	/* Retrieve compressed log messages of the whole span from BLOB file. A read may return 
+	 * fewer bytes than requested, so it is repeated for the rest of the span, until EOF. 
+	 * db_loop is only passed for the bookkeeping of the requests: synchronous requests 
+	 * (without a callback) run in the calling thread and are not registered with the loop, 
+	 * so the threads of concurrent queries can use it. */
+	size_t span_read = 0;
+	while(span_read < span_size){
+		uv_buf_t uv_buf = uv_buf_init(p_file_info->search_span_buff + span_read, (unsigned int) (span_size - span_read));
+		uv_fs_t read_req;
+		rc = uv_fs_read(db_loop, &read_req, p_file_info->blob_handles[blob_id], &uv_buf, 1, 
+		                span_offset + (int64_t) span_read, NULL);
+		uv_fs_req_cleanup(&read_req);
+		if(unlikely(rc <= 0)) break;
+		span_read += (size_t) rc;
+	}
+	if(unlikely(span_read < span_size)){
+		fprintf_log(LOGS_MANAG_ERROR, stderr, "Short read of BLOB span (%zu out of %zu bytes) for %s: %s\n", 
+			span_read, span_size, p_file_info->filename, rc < 0 ? uv_strerror(rc) : "end of file");
+		return -1;
+	}
 
-			for (int i = 0; i < BLOB_MAX_FILES; i++){
-				// fprintf_log(LOGS_MANAG_DEBUG, stderr, "----Id to set:: %d\n", i + 1);
-				// fprintf_log(LOGS_MANAG_DEBUG, stderr, "----Id before:: %d\n", old_blobs_table_ids[i]);
-				rc = sqlite3_bind_int(stmt_update_id, 1, i + 1);
-				if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-				rc = sqlite3_bind_int(stmt_update_id, 2, old_blobs_table_ids[i]);
-				if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-				rc = sqlite3_step(stmt_update_id);
-				if (rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
-				sqlite3_reset(stmt_update_id);
-			}
-			sqlite3_finalize(stmt_update_id);
+	const int keyword_search = p_query_params->keyword_matcher != NULL;
+	Message_t temp_msg = {0};
+	char *p_compressed = p_file_info->search_span_buff;
+	for(int i = 0; i < span_msgs_num; i++){
+		temp_msg.timestamp = span_msgs[i].timestamp;
+		temp_msg.text_compressed = p_compressed;
+		temp_msg.text_compressed_size = span_msgs[i].text_compressed_size;
+		temp_msg.text_size = span_msgs[i].text_size;
+		temp_msg.codec = span_msgs[i].codec;
+		temp_msg.dict_id = span_msgs[i].dict_id;
+		if(temp_msg.codec == LOGS_COMPR_CODEC_LZ4_DICT){
+			const struct compr_dict *compr_dict = db_compr_dict_get(p_file_info, temp_msg.dict_id);
+			temp_msg.dict = compr_dict ? compr_dict->data : NULL;
+			temp_msg.dict_size = compr_dict ? compr_dict->size : 0;
+		}
+		p_compressed += temp_msg.text_compressed_size;
 
+		/* Append retrieved results to BUFFER */
+		buffer_increase(p_query_params->results_buff, temp_msg.text_size + 1); // +1 as keyword search may append a newline to the last line
+		const size_t res_offset = p_query_params->results_buff->len;
+		char *const res = &p_query_params->results_buff->buffer[res_offset];
+		size_t size;
+		/* Log messages that cannot be decompressed are skipped */
+		if(!keyword_search){
+			size = decompress_text(&temp_msg, res) ? 0 : temp_msg.text_size;
+		}
+		else {
+			size = decompress_text(&temp_msg, NULL) ? 0 : 
+				search_keyword(temp_msg.text, temp_msg.text_size, res, p_query_params->keyword_matcher);
+			freez(temp_msg.text);
 		}
+		/* Lines not matching the predicate (if any) are filtered out in place */
+		if(size && p_query_params->predicate_search) size = filter_lines_by_predicate(res, size, p_query_params->predicate_search);
+		/* Results returned already by the previous page of the query are dropped */
+		if(size && logs_query_res_skip(p_query_params, temp_msg.timestamp, size - 1)) size = 0;
+		p_query_params->results_buff->len += size ? size - 1 : 0; // -1 due to terminating NUL char
+		if(size) logs_query_res_append(p_query_params, temp_msg.timestamp, res_offset);
 
-		/* Traverse BLOBS_TABLE, open logs.bin.X files and store their file handles in p_file_info array. */
-		sqlite3_stmt *stmt_retrieve_metadata_from_id;
-		rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-								"SELECT Filename, Filesize FROM " BLOBS_TABLE 
-								" WHERE Id = ? ;",
-								-1, &stmt_retrieve_metadata_from_id, NULL);
-		if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-		
-		sqlite3_stmt *stmt_retrieve_total_logs_size;
-		rc = sqlite3_prepare_v2(p_file_infos_arr->data[i]->db,
-								"SELECT SUM(Msg_compr_size) FROM " LOGS_TABLE 
-								" WHERE FK_BLOB_Id = ? GROUP BY FK_BLOB_Id ;",
-								-1, &stmt_retrieve_total_logs_size, NULL);
-		if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-		
-		uv_fs_t open_req;
-		for(int id = 1; id <= BLOB_MAX_FILES; id++){
-			/* Open BLOB file based on filename stored in BLOBS_TABLE. */
-			rc = sqlite3_bind_int(stmt_retrieve_metadata_from_id, 1, id);
-            if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-			rc = sqlite3_step(stmt_retrieve_metadata_from_id);
-			if (rc != SQLITE_ROW) fatal_sqlite3_err(rc, __LINE__);
-			char *filename = mallocz(snprintf(NULL, 0, "%s%s", 
-				p_file_infos_arr->data[i]->db_dir, 
-				sqlite3_column_text(stmt_retrieve_metadata_from_id, 0)) + 1);
-			sprintf(filename, "%s%s", p_file_infos_arr->data[i]->db_dir, 
-				sqlite3_column_text(stmt_retrieve_metadata_from_id, 0));
-			rc = uv_fs_open(db_loop, &open_req, filename, 
-				UV_FS_O_RDWR | UV_FS_O_CREAT | UV_FS_O_APPEND | UV_FS_O_RANDOM , 0644, NULL);
-			if (unlikely(rc < 0)) fatal_libuv_err(rc, __LINE__);
-			fprintf_log(LOGS_MANAG_DEBUG, stderr, "Opened file: %s\n", filename);
-			p_file_infos_arr->data[i]->blob_handles[id] = open_req.result; 	// open_req.result of a uv_fs_t is the file descriptor in case of the uv_fs_open
-			int64_t metadata_filesize = (int64_t) sqlite3_column_int64(stmt_retrieve_metadata_from_id, 1);
-			
-			/* Retrieve total log messages compressed size from LOGS_TABLE for current FK_BLOB_Id
-			 * Only for asserting whether correct - not used elsewhere. If no rows are returned, it means
-			 * it is probably the initial execution of the program so still valid (except if rc is other
-			 * than SQLITE_DONE, which is an error then). */
-			rc = sqlite3_bind_int(stmt_retrieve_total_logs_size, 1, id);
-            if (rc != SQLITE_OK) fatal_sqlite3_err(rc, __LINE__);
-			rc = sqlite3_step(stmt_retrieve_total_logs_size);
-			if (rc == SQLITE_ROW){ 
-				int64_t total_logs_filesize = (int64_t) sqlite3_column_int64(stmt_retrieve_total_logs_size, 0);
-				m_assert(total_logs_filesize == metadata_filesize, "Metadata filesize != total logs filesize");
-			}
-			else if (unlikely(rc != SQLITE_DONE)) fatal_sqlite3_err(rc, __LINE__);
-			
-			/* Get filesize of BLOB file. */ 
-			uv_fs_t stat_req;
-			rc = uv_fs_stat(db_loop, &stat_req, filename, NULL);
-			if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-			uv_stat_t *statbuf = uv_fs_get_statbuf(&stat_req);
-			int64_t blob_filesize = (int64_t) statbuf->st_size;
-			uv_fs_req_cleanup(&stat_req);
-			
-			do{
-				/* Case 1: blob_filesize == metadata_filesize (equal, either both zero or not): All good */
-				if(likely(blob_filesize == metadata_filesize))
-					break;
-				
-				/* Case 2: blob_filesize == 0 && metadata_filesize > 0: fatal(), however could it mean that 
-				 * EXT_BLOB_STORE_FILENAME was rotated but the SQLite metadata wasn't updated? So can it 
-				 * maybe be recovered by un-rotating? Either way, treat as fatal() for now. */
-				 // TODO: Can we avoid fatal()? 
-				if(unlikely(blob_filesize == 0 && metadata_filesize > 0)){
-					fprintf_log(LOGS_MANAG_ERROR, stderr, "blob_filesize == 0 but metadata_filesize > 0\n");
-					fatal("blob_filesize == 0 but metadata_filesize > 0");
-				}
-				
-				/* Case 3: blob_filesize > metadata_filesize: Truncate binary to sqlite filesize, program 
-				 * crashed or terminated after writing BLOBs to external file but before metadata was updated */
-				if(unlikely(blob_filesize > metadata_filesize)){
-					fprintf_log(LOGS_MANAG_WARNING, stderr, "blob_filesize > metadata_filesize for '%s'. Will attempt to fix.\n", filename);
-					uv_fs_t trunc_req;
-				    rc = uv_fs_ftruncate(db_loop, &trunc_req, p_file_infos_arr->data[i]->blob_handles[id], 
-				    	metadata_filesize, NULL);
-				    if(unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-				    uv_fs_req_cleanup(&trunc_req);
-				    break;
-				}
+		fprintf_log(LOGS_MANAG_DEBUG, stderr, "Timestamp decompressed: %" PRIu64 "\n", (uint64_t)temp_msg.timestamp);
 
-				/* Case 4: blob_filesize < metadata_filesize: unrecoverable (and what-should-be impossible
-				 * state), delete external binaries, clear metadata record and then fatal() */
-				// TODO: Delete external BLOB and clear metadata from DB, start from clean state but the most recent logs.
-		    	if(unlikely(blob_filesize < metadata_filesize)){
-		    		fprintf_log(LOGS_MANAG_ERROR, stderr, "blob_filesize < metadata_filesize for '%s'. \n", filename);
-		        	fatal("blob_filesize < metadata_filesize for '%s'. \n", filename);
-		        }
-
-			    /* Case 5: default if none of the above, should never reach here, fatal() */
-				fatal("invalid case when comparing blob_filesize with metadata_filesize");
-			} while(0);
-			
-			
-			/* Initialise blob_write_handle with logs.bin.0 */
-			if(filename[strlen(filename) - 1] == '0')
-				p_file_infos_arr->data[i]->blob_write_handle_offset = id;
-				
-			freez(filename);
-			uv_fs_req_cleanup(&open_req);
-			sqlite3_reset(stmt_retrieve_total_logs_size);
-			sqlite3_reset(stmt_retrieve_metadata_from_id);
+		if(logs_query_quota_reached(p_query_params, max_query_page_size)){
+			p_query_params->end_timestamp = temp_msg.timestamp;
+			p_query_params->truncated = 1;
+			return 1;
 		}
-		sqlite3_finalize(stmt_retrieve_metadata_from_id);
-		
-		/* Create synchronous writer thread, one for each log source */
-		uv_thread_t *db_writer_thread = mallocz(sizeof(uv_thread_t));
-		rc = uv_thread_create(db_writer_thread, db_writer, &p_file_infos_arr->data[i]);
-		if (unlikely(rc)) fatal_libuv_err(rc, __LINE__);
-		
-    }
-    sqlite3_finalize(stmt_get_last_id);
-    sqlite3_finalize(stmt_search_if_log_source_exists);
-    sqlite3_finalize(stmt_insert_log_collection_metadata);
-
-    uv_thread_t *db_loop_run_thread = mallocz(sizeof(uv_thread_t));
-    if(unlikely(uv_thread_create(db_loop_run_thread, db_loop_run, NULL))) fatal("uv_thread_create() error");
+	}
+	return 0;
 }
 
 /**
@@ -769,28 +2205,31 @@ void db_init() {
  * query parameters. If any results are found, it will decompress the text
  * of each returned row and add it to the results buffer, up to a maximum
  * amount of bytes. 
- * @todo Implement keyword search as well. For now, this only searches for timestamps.
+ * 
+ * The metadata of the log messages are retrieved through a cached prepared
+ * statement that is answered by a covering index, sorted by time. Consecutive
+ * rows that are stored contiguously in the same BLOB are grouped into spans 
+ * (of up to DB_SEARCH_SPAN_MAX_SIZE bytes), so that each span is retrieved
+ * with a single sequential read rather than one read per row.
+ * @return 0 on success, -1 if the log messages of a span could not be read from its BLOB, 
+ * in which case the results appended to the results buffer are incomplete.
  * @todo What happens in case SQLITE_CORRUPT error? See if it can be handled, for now just fatal().
  * @todo Change results buffer to be long-lived.
  */
-void db_search(logs_query_params_t *p_query_params, struct File_info *p_file_info, size_t max_query_page_size) {
+int db_search(logs_query_params_t *p_query_params, struct File_info *p_file_info, size_t max_query_page_size) {
 	fprintf_log(LOGS_MANAG_INFO, stderr, "\nSearching DB...!\n");
     int rc = 0;
-    Message_t temp_msg = {0};
-    int64_t blob_offset = 0;
-    int blob_handles_offset = 0;
-
-    // Prepare "SELECT" statement used to retrieve log metadata in case of query
-    // TODO: Avoid preparing statement for each db_search call, but how if tied to specific db handle?
-    // TODO: Limit number of results returned through SQLite Query to speed up search?
-    sqlite3_stmt *stmt_retrieve_log_msg_metadata;
-    rc = sqlite3_prepare_v2(p_file_info->db,
-    						"SELECT Timestamp, Msg_compr_size , Msg_decompr_size, BLOB_Offset, " BLOBS_TABLE".Id "
-    						"FROM " LOGS_TABLE " INNER JOIN " BLOBS_TABLE 
-    						" ON " LOGS_TABLE ".FK_BLOB_Id = " BLOBS_TABLE ".Id "
-    						"WHERE Timestamp BETWEEN ? AND ?;",
-                            -1, &stmt_retrieve_log_msg_metadata, NULL);
-    if (unlikely(rc != SQLITE_OK)) fatal_sqlite3_err(rc, __LINE__);
+    const int keyword_search = p_query_params->keyword_matcher != NULL;
+    const int bloom_search = keyword_search && keyword_matcher_bloom_usable(p_query_params->keyword_matcher);
+    sqlite3_stmt *stmt_retrieve_log_msg_metadata = bloom_search ? p_file_info->stmt_get_log_msg_metadata_bloom : 
+                                                                  p_file_info->stmt_get_log_msg_metadata;
+
+    db_span_msg_t *span_msgs = NULL;
+    int span_msgs_num = 0, span_msgs_max = 0;
+    int span_blob_id = 0;
+    int64_t span_offset = 0;
+    size_t span_size = 0, span_text_size = 0;
+    int quota_reached = 0;
 
     sqlite3_exec(p_file_info->db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
     rc = sqlite3_bind_int64(stmt_retrieve_log_msg_metadata, 1, (sqlite3_int64)p_query_params->start_timestamp);
@@ -804,45 +2243,63 @@ void db_search(logs_query_params_t *p_query_params, struct File_info *p_file_inf
 
     while (rc == SQLITE_ROW) {
     	/* Retrieve metadata from DB */
-        temp_msg.timestamp = (uint64_t)sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 0);
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Timestamp retrieved: %" PRIu64 "\n", (uint64_t)temp_msg.timestamp);
-        temp_msg.text_compressed_size = (size_t)sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 1);
-        temp_msg.text_size = (size_t)sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 2);
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Size of results from query: %zu\n", temp_msg.text_size);
-        blob_offset = (int64_t) sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 3);
-        blob_handles_offset = sqlite3_column_int(stmt_retrieve_log_msg_metadata, 4);
-
-        /* Retrieve compressed log messages from BLOB file */
-        temp_msg.text_compressed = mallocz(temp_msg.text_compressed_size);
-        uv_buf_t uv_buf = uv_buf_init(temp_msg.text_compressed, temp_msg.text_compressed_size);
-	    uv_fs_t read_req;
-	    // TODO: Using db_loop here in separate thread (although synchronously) - thread-safe ?
-	    rc = uv_fs_read(db_loop, &read_req, p_file_info->blob_handles[blob_handles_offset], &uv_buf, 1, blob_offset, NULL);
-        if (rc < 0) fatal_libuv_err(rc, __LINE__);
-	    uv_fs_req_cleanup(&read_req);
-
-	    /* Append retrieved results to BUFFER */
-	    buffer_increase(p_query_params->results_buff, temp_msg.text_size);
-	    if(!p_query_params->keyword || !*p_query_params->keyword || !strcmp(p_query_params->keyword, " ")){
-	    	decompress_text(&temp_msg, &p_query_params->results_buff->buffer[p_query_params->results_buff->len]);
-	    	p_query_params->results_buff->len += temp_msg.text_size - 1; // -1 due to terminating NUL char
-	        // buffer_overflow_check(p_query_params->results_buff);
-	    } 
-	    else {
-	    	decompress_text(&temp_msg, NULL);
-	    	const size_t size = search_keyword(temp_msg.text, &p_query_params->results_buff->buffer[p_query_params->results_buff->len], p_query_params->keyword, 1);
-		    p_query_params->results_buff->len += size ? size - 1 : 0; // -1 due to terminating NUL char
-		    freez(temp_msg.text);
-	    }
-
-	    freez(temp_msg.text_compressed);
-        
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Timestamp decompressed: %" PRIu64 "\n", (uint64_t)temp_msg.timestamp);
+        const uint64_t timestamp = (uint64_t)sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 0);
+        const size_t text_compressed_size = (size_t)sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 1);
+        const size_t text_size = (size_t)sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 2);
+        const int64_t blob_offset = (int64_t) sqlite3_column_int64(stmt_retrieve_log_msg_metadata, 3);
+        const int blob_id = sqlite3_column_int(stmt_retrieve_log_msg_metadata, 4);
+        const uint8_t codec = (uint8_t) sqlite3_column_int(stmt_retrieve_log_msg_metadata, 5);
+        const int dict_id = sqlite3_column_int(stmt_retrieve_log_msg_metadata, 6);
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Timestamp retrieved: %" PRIu64 "\n", timestamp);
+
+        /* Skip (without reading or decompressing) messages that cannot contain the keyword. 
+         * This also breaks the current span, as the message bytes will not be contiguous. */
+        if(bloom_search){
+            const uint8_t *bloom = sqlite3_column_blob(stmt_retrieve_log_msg_metadata, 7); // Must be called before sqlite3_column_bytes()
+            const size_t bloom_size = (size_t) sqlite3_column_bytes(stmt_retrieve_log_msg_metadata, 7);
+            if(!keyword_matcher_bloom_may_match(p_query_params->keyword_matcher, bloom, bloom_size)){
+                rc = sqlite3_step(stmt_retrieve_log_msg_metadata);
+                if (rc != SQLITE_ROW && rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
+                continue;
+            }
+        }
+
+        /* If this message cannot extend the current span, search the span first */
+        if(span_msgs_num && (blob_id != span_blob_id || 
+                             blob_offset != span_offset + (int64_t) span_size ||
+                             span_size + text_compressed_size > DB_SEARCH_SPAN_MAX_SIZE)){
+        	quota_reached = db_search_span(p_query_params, p_file_info, span_blob_id, span_offset, span_size, 
+        	                               span_msgs, span_msgs_num, max_query_page_size);
+        	span_msgs_num = 0;
+        	if(quota_reached) break; // Either the quota was reached or the span could not be read
+        }
+
+        /* Append message to (new or existing) span */
+        if(!span_msgs_num){
+        	span_blob_id = blob_id;
+        	span_offset = blob_offset;
+        	span_size = span_text_size = 0;
+        }
+        if(unlikely(span_msgs_num == span_msgs_max)){
+        	span_msgs_max = span_msgs_max ? span_msgs_max * 2 : 64;
+        	span_msgs = reallocz(span_msgs, span_msgs_max * sizeof(db_span_msg_t));
+        }
+        span_msgs[span_msgs_num].timestamp = timestamp;
+        span_msgs[span_msgs_num].text_compressed_size = text_compressed_size;
+        span_msgs[span_msgs_num].text_size = text_size;
+        span_msgs[span_msgs_num].codec = codec;
+        span_msgs[span_msgs_num].dict_id = dict_id;
+        span_msgs_num++;
+        span_size += text_compressed_size;
+        span_text_size += text_size - 1; // -1 due to terminating NUL char
 
-        if(p_query_params->results_buff->len >= max_query_page_size){
-        	p_query_params->end_timestamp = temp_msg.timestamp;
-        	// p_query_params->results_buff->len++; // In this case keep NUL char
-        	break;
+        /* In case of no keyword or predicate, the results are not filtered, so there is no need to 
+         * extend the span any further if it is already enough to fill up the max_query_page_size. */
+        if(!keyword_search && !p_query_params->predicate_search && p_query_params->results_buff->len - p_query_params->quota_uncounted + span_text_size >= max_query_page_size){
+        	quota_reached = db_search_span(p_query_params, p_file_info, span_blob_id, span_offset, span_size, 
+        	                               span_msgs, span_msgs_num, max_query_page_size);
+        	span_msgs_num = 0;
+        	if(quota_reached) break;
         }
 
         rc = sqlite3_step(stmt_retrieve_log_msg_metadata);
@@ -850,6 +2307,13 @@ void db_search(logs_query_params_t *p_query_params, struct File_info *p_file_inf
         if (rc != SQLITE_ROW && rc != SQLITE_DONE) fatal_sqlite3_err(rc, __LINE__);
     }
 
+    if(!quota_reached && span_msgs_num)
+    	quota_reached = db_search_span(p_query_params, p_file_info, span_blob_id, span_offset, span_size, 
+    	                               span_msgs, span_msgs_num, max_query_page_size);
+
     sqlite3_exec(p_file_info->db, "END TRANSACTION;", NULL, NULL, NULL);
-    if(sqlite3_finalize(stmt_retrieve_log_msg_metadata) != SQLITE_OK) fatal("sqlite3_finalize(stmt_retrieve_log_msg_metadata) error");
-}
\ No newline at end of file
+    sqlite3_reset(stmt_retrieve_log_msg_metadata);
+    sqlite3_clear_bindings(stmt_retrieve_log_msg_metadata);
+    freez(span_msgs);
+    return quota_reached < 0 ? -1 : 0;
+}
@@ -12,10 +12,27 @@
 #include "query.h"
 #include "file_info.h"	
 
+/**
+ * @brief Metadata of a log message of a BLOB that is being recompressed
+ */
+typedef struct db_compact_msg {
+	int64_t id;                     /**< Id of the log message in LOGS_TABLE */
+	int64_t offset;                 /**< Offset in the BLOB (old, then new) */
+	size_t text_compressed_size;    /**< Compressed size (old, then new) */
+	size_t text_size;
+	int codec;                      /**< Codec (old, then new) */
+	int dict_id;                    /**< Compression dictionary id (old, then new) */
+} db_compact_msg_t;
+
 void db_set_lock(uv_mutex_t *db_mut);
 void db_release_lock(uv_mutex_t *db_mut);
 char *db_get_sqlite_version(void);
-void db_init(void);
-void db_search(logs_query_params_t *query_params, struct File_info *p_file_info, size_t max_query_page_size);
+void db_init(int num_of_writer_threads, int metadata_cache_size, uint64_t disk_space_budget, int compactor_interval);
+void db_log_source_open(struct File_info *p_file_info, int metadata_cache_size);
+void db_log_source_flush(struct File_info *p_file_info);
+void db_log_source_close(struct File_info *p_file_info);
+int db_blob_recompress(struct File_info *p_file_info, uv_file blob_handle, uv_file compact_handle, 
+					   db_compact_msg_t *msgs, int msgs_num, uv_loop_t *loop, int64_t *compact_filesize);
+int db_search(logs_query_params_t *query_params, struct File_info *p_file_info, size_t max_query_page_size);
 
 #endif  // DB_API_H_
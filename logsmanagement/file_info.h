@@ -7,6 +7,7 @@
 #ifndef FILE_INFO_H_
 #define FILE_INFO_H_
 
+#include <lz4.h>
 #include "sqlite3.h"
 #include "config_.h"
 #include "parser.h"
@@ -14,6 +15,28 @@
 // Forward declaration to break circular dependency
 struct Circ_buff;
 
+/**
+ * @brief Counters of the DB writer of a log source, updated atomically and used for charts.
+ */
+struct db_writer_stats {
+    uint64_t num_of_batches;            /**< Number of vectored BLOB writes (and multi-row INSERTs) */
+    uint64_t num_of_msgs;               /**< Number of log messages written */
+    uint64_t text_bytes;                /**< Uncompressed size of the log messages written */
+    uint64_t blob_bytes;                /**< Bytes written to BLOBs */
+    uint64_t metadata_bytes;            /**< Bytes written by SQLite for the metadata DB */
+    uint64_t commit_latency_usec_max;   /**< Max latency of a flush (from acquiring the DB lock up to the commit). Reset when read for charts. */
+};
+
+/**
+ * @brief Compression dictionary of a log source, as stored in the DB.
+ */
+struct compr_dict {
+    int id;         /**< Id of dictionary in the DB */
+    char *data;     /**< Dictionary contents */
+    size_t size;    /**< Size of #data */
+    LZ4_stream_t *lz4_stream;   /**< LZ4 stream with #data loaded, see compr_dict_stream_create() */
+};
+
 struct File_info {
     uint8_t db_fileInfos_Id;                       /**< ID of File_info entry in respective metadata table in DB. */
     sqlite3 *db;                                   /**< DB that stores metadata for this log source */
@@ -21,23 +44,46 @@ struct File_info {
     uv_mutex_t *db_mut;                            /**< DB access mutex */
     uv_file blob_handles[BLOB_MAX_FILES + 1];      /**< Item 0 not used - just for matching 1-1 with DB ids **/
     int blob_write_handle_offset;
+    int db_flush_interval;                         /**< Interval (in ms) to flush the circular buffer to the DB */
+    int db_write_batch_max_msgs;                   /**< Maximum number of log messages per vectored write and INSERT */
+    struct db_writer_stats db_writer_stats;        /**< Counters of the DB writer */
+    uint64_t retention_max_age;                    /**< Log messages older than this (in ms) are dropped by the DB compactor, a whole BLOB at a time (0 for no limit) */
+    uint64_t retention_max_size;                   /**< Maximum total size (in bytes) of the BLOBs of this log source, enforced by the DB compactor (0 for no limit other than the BLOBs ring) */
+    uint8_t compact_cold_blobs;                    /**< Boolean. If set, the DB compactor recompresses the BLOBs that are no longer written to with LOGS_COMPR_CODEC_LZ4F_HC */
+    uint8_t compr_codec;                           /**< Codec used to compress new log messages, see LOGS_COMPR_CODEC_* */
+    struct compr_dict *compr_dicts;                /**< All the compression dictionaries of this log source, in ascending id order. The last one is used for compression. */
+    int compr_dicts_num;                           /**< Number of items in #compr_dicts */
+    sqlite3_stmt *stmt_get_log_msg_metadata;       /**< Cached prepared statement used to retrieve the metadata of the log messages within a time range */
+    sqlite3_stmt *stmt_get_log_msg_metadata_bloom; /**< Same as #stmt_get_log_msg_metadata, also retrieving the bloom filter of each log message */
+    char *search_span_buff;                        /**< Reusable buffer that contiguous BLOB spans are read into when searching the DB */
+    size_t search_span_buff_size;                  /**< Size of #search_span_buff */
     const char *filename;                          /**< Full path of log source */
     const char *file_basename;                     /**< Basename of log source */
     uv_fs_event_t *fs_event_req;
     uv_timer_t *enable_file_changed_events_timer;
-    uint8_t force_file_changed_cb;                 /**< Boolean to indicate whether an immediate call of the file_changed_cb() function is needed */
-    uint64_t filesize;                             /**< Offset of where the next read operation needs to start from */
+    uint8_t force_file_changed_cb;                 /**< Boolean to indicate whether a check of the log file is needed when enable_file_changed_events_timer expires */
+    uint8_t fs_event_rewatch;                      /**< Boolean to indicate whether the FS events watch must be re-registered (after the log file was renamed) */
+    uint64_t filesize;                             /**< Offset up to which the log file has been consumed (excluding #line_carry) */
     int8_t access_lock;                            /**< Boolean used to forbid a new file read operation before the previous one has finished */
     char *buff;                                    /**< Pointed to the base of the buffer used to read the log messages into. */
     size_t buff_size;                              /**< Size of the buffer used to read the log messages into. */
     size_t buff_size_max;                          /**< Max size of the buffer used to read the log messages into. */
     uv_buf_t uvBuf;                                /**< libuv buffer data type, primarily used to read the log messages into. Implemented using #buff and #buff_size. See also http://docs.libuv.org/en/v1.x/misc.html#c.uv_buf_t */
-    uv_file file_handle;                           /**< File handle */
+    uv_file file_handle;                           /**< File handle, kept open until the log file is rotated */
+    uint64_t file_ino;                             /**< Inode of the file #file_handle refers to, used to detect log rotations */
+    uint64_t file_dev;                             /**< Device of the file #file_handle refers to, used to detect log rotations */
+    char *line_carry;                              /**< Partial line at the end of the last read, carried over to the next read */
+    size_t line_carry_size;                        /**< Size of the partial line in #line_carry. It is located at #filesize in the log file. */
+    size_t line_carry_size_max;                    /**< Allocated size of #line_carry */
     struct Circ_buff *msg_buff;                    /**< Associated circular buffer - only one should exist per log source. */
-    char *signature;                               /**< Signature using #signature_size bytes from the beginning of the log to uniquely identify a log file */
+    char signature[MAX_FILE_SIGNATURE_SIZE];       /**< Signature using #signature_size bytes from the beginning of the log to uniquely identify a log file */
     size_t signature_size;                         /**< Size of #signature. */
     Log_parser_config_t *parser_config;            /**< Configuration to be user by log parser - read from XX.conf */ 
     Log_parser_metrics_t *parser_metrics;
+    uint8_t metrics_only;                          /**< Boolean. If set, log messages are only parsed for metrics and then discarded, except for the lines kept through #keep_matcher and #keep_sample_interval */
+    Keyword_matcher_t *keep_matcher;               /**< Metrics-only mode: lines matching it are still stored (NULL if none) */
+    int keep_sample_interval;                      /**< Metrics-only mode: 1 in every #keep_sample_interval lines is still stored (0 if none) */
+    uint64_t keep_sample_lines;                    /**< Metrics-only mode: number of lines considered for sampling so far. Accessed atomically. */
     uv_mutex_t *parser_mut;
     const char *chart_name;
 };
@@ -19,6 +19,7 @@
 #include <time.h>
 #include <uv.h>
 #include "circular_buffer.h"
+#include "compression.h"
 #include "config_.h"
 #include "db_api.h"
 #include "file_info.h"
@@ -29,6 +30,8 @@
 #endif  // LOGS_MANAGEMENT_STRESS_TEST
 #include "parser.h"
 
+#define CONFIG_SECTION_LOGS_MANAG_GLOBAL "global" /**< Section of log_management.conf with settings shared by all log sources (i.e. not a log source) */
+
 static struct config log_management_config = {
     .first_section = NULL,
     .last_section = NULL,
@@ -120,6 +123,7 @@ static void handle_UV_ENOENT_err(struct File_info *p_file_info) {
     }
 
     p_file_info->filesize = 0;
+    p_file_info->line_carry_size = 0;
 
     // Send signal to re-enable fs events
     uv_mutex_lock(&p_file_infos_arr->fs_events_reenable_lock);
@@ -149,9 +153,9 @@ static int file_close(struct File_info *p_file_info) {
 
 /**
  * @brief Opens a log file
- * @details Synchronously open a file (as read-only) using the libuv API. 
+ * @details Synchronously open a file (as read-only) using the libuv API. The file is kept
+ * open and read with positional reads, until it is rotated.
  * @param p_file_info #File_info struct containing the necessary data to open the file.
- * @todo Investigate if use of memory-mapping will speed up subsequent file read operations.
  */
 static int file_open(struct File_info *p_file_info) {
     int rc = 0;
@@ -169,50 +173,79 @@ static int file_open(struct File_info *p_file_info) {
     return rc;
 }
 
+/**
+ * @brief Re-open a log file
+ * @details Used when the log file the kept-open #File_info.file_handle refers to has been 
+ * replaced (e.g. after a log rotation), so that the new file found at the same path is read.
+ * @param p_file_info #File_info struct of the log file to re-open.
+ * @param statbuf Result of the stat() of the path of the log file.
+ * @return 0 on success, libuv error code otherwise.
+ */
+static int file_reopen(struct File_info *p_file_info, const uv_stat_t *statbuf) {
+    (void)file_close(p_file_info);
+    int rc = file_open(p_file_info);
+    if (likely(rc >= 0)) {
+        p_file_info->file_ino = statbuf->st_ino;
+        p_file_info->file_dev = statbuf->st_dev;
+        rc = 0;
+    }
+    return rc;
+}
+
+/**
+ * @brief Forward declaration, see definition for details.
+ */
+static void file_changed_check(struct File_info *p_file_info);
+
 /**
  * @brief Timer callback function to re-enable file changed events. 
- * @details The function is responsible for re-enabling the FS event handle callback. Because there may be
- * messages that were missed when the file events were not being processed (i.e. for the duration
- * of #LOG_FILE_READ_INTERVAL), a "forced" call of #file_changed_cb() will take place (if and only if 
- * the #force_file_changed_cb variable is set). The value of the #force_file_changed_cb is set or cleared 
- * in #enable_file_changed_events.
+ * @details The function is responsible for re-registering the FS events watch, if it 
+ * was stopped due to the log file being renamed. Because any FS events that arrive 
+ * while the timer is active are coalesced (see #file_changed_cb()), a "forced" call of 
+ * #file_changed_check() will take place (if and only if the #force_file_changed_cb 
+ * variable is set). The value of the #force_file_changed_cb is set or cleared in 
+ * #enable_file_changed_events() and set by #file_changed_cb().
  * @param handle Timer handle.
  */
 static void enable_file_changed_events_timer_cb(uv_timer_t *handle) {
     int rc = 0;
     struct File_info *p_file_info = handle->data;
 
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Scheduling uv_fs_event for %s\n", p_file_info->filename);
-    rc = uv_fs_event_start(p_file_info->fs_event_req, file_changed_cb, p_file_info->filename, 0);
-    if (rc) {
-        fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_event_start() for %s failed (%d): %s\n",
-                    p_file_info->filename, rc, uv_strerror(rc));
-        if (rc == UV_ENOENT) {
-            handle_UV_ENOENT_err(p_file_info);
-        } else
-            m_assert(!rc, "uv_fs_event_start() failed");
+    if (p_file_info->fs_event_rewatch) {
+        p_file_info->fs_event_rewatch = 0;
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Scheduling uv_fs_event for %s\n", p_file_info->filename);
+        rc = uv_fs_event_start(p_file_info->fs_event_req, file_changed_cb, p_file_info->filename, 0);
+        if (rc) {
+            fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_event_start() for %s failed (%d): %s\n",
+                        p_file_info->filename, rc, uv_strerror(rc));
+            if (rc == UV_ENOENT) {
+                handle_UV_ENOENT_err(p_file_info);
+                return;
+            } else
+                m_assert(!rc, "uv_fs_event_start() failed");
+        }
     }
 
     if (p_file_info->force_file_changed_cb) {
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Forcing uv_fs_event for %s\n", p_file_info->filename);
-        file_changed_cb((uv_fs_event_t *)handle, p_file_info->file_basename, 0, 0);
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Forcing file changed check for %s\n", p_file_info->filename);
+        file_changed_check(p_file_info);
     }
 }
 
 /**
  * @brief Starts a timer that will re-enable file_changed events when it expires
- * @details The purpose of this function is to re-enable file events but limit them to a maximum
- * of 1 per #LOG_FILE_READ_INTERVAL, to reduce CPU usage. 
+ * @details The purpose of this function is to limit reads of a log file to a maximum
+ * of 1 per #LOG_FILE_READ_INTERVAL, to bound CPU usage regardless of the rate of the logs. 
+ * While the timer is active, FS events are only recorded (see #file_changed_cb()).
  * @param p_file_info Struct containing the timer handle associated with the respective file info struct.
- * @param force_file_changed_cb Boolean variable. If set, a call to file_changed_cb() will be "force" as
- * soon as the file event monitoring has been re-enabled. 
+ * @param force_file_changed_cb Boolean variable. If set, a check of the log file will be "forced" as
+ * soon as the timer expires, even if no FS events arrive in the meantime. 
  * @return 0 on success
  */
 static int enable_file_changed_events(struct File_info *p_file_info, uint8_t force_file_changed_cb) {
     int rc = 0;
     p_file_info->enable_file_changed_events_timer->data = p_file_info;
     p_file_info->force_file_changed_cb = force_file_changed_cb;
-    // TODO: Change the timer implementation to start once, there is no reason to start-stop.
     rc = uv_timer_start(p_file_info->enable_file_changed_events_timer,
                         (uv_timer_cb)enable_file_changed_events_timer_cb, LOG_FILE_READ_INTERVAL, 0);
     if (unlikely(rc)) {
@@ -225,7 +258,12 @@ static int enable_file_changed_events(struct File_info *p_file_info, uint8_t for
 /**
  * @brief Read text from a log file
  * @details Callback called in #check_if_filesize_changed_cb() to read text
- * from a log file into a Message_t struct.
+ * from a log file into a Message_t struct. 
+ * 
+ * #File_info.buff starts with the partial line carried over from the previous 
+ * read (if any), followed by the newly read bytes. Only whole lines are written
+ * to the circular buffer, whereas any trailing partial line is carried over to 
+ * the next read, rather than being read from the file again.
  */
 static void read_file_cb(uv_fs_t *req) {
     struct File_info *p_file_info = req->data;
@@ -239,115 +277,106 @@ static void read_file_cb(uv_fs_t *req) {
         fprintf_log(LOGS_MANAG_ERROR, stderr, "Read error: %s\n", uv_strerror(req->result));
         m_assert(0, "Should never reach EOF");
     } else if (likely(req->result > 0)) {
-        while (p_file_info->buff[p_file_info->buff_size - 1] != '\n') {  // Check if a half-line was read
-            p_file_info->buff_size--;
-            if (!p_file_info->buff_size)
-                goto free_access_lock;
+        const size_t carry_size = p_file_info->line_carry_size;
+        const size_t total_size = carry_size + (size_t) req->result;
+
+        /* The carried over partial line contains no newline, so only the newly read bytes are scanned. 
+         * If there is no newline at all but MAX_LOG_MSG_SIZE has been reached, the line is too long 
+         * to ever be completed, so it is split. */
+        const char *last_newline = memrchr(&p_file_info->buff[carry_size], '\n', (size_t) req->result);
+        size_t msg_size = 0;
+        if (last_newline) msg_size = (size_t) (last_newline - p_file_info->buff) + 1;
+        else if (total_size >= MAX_LOG_MSG_SIZE) msg_size = total_size;
+
+        /* Carry over any trailing partial line */
+        p_file_info->line_carry_size = total_size - msg_size;
+        if (p_file_info->line_carry_size > p_file_info->line_carry_size_max) {
+            p_file_info->line_carry_size_max = p_file_info->line_carry_size * BUFF_SCALE_FACTOR;
+            p_file_info->line_carry = reallocz(p_file_info->line_carry, p_file_info->line_carry_size_max);
+        }
+        memcpy(p_file_info->line_carry, &p_file_info->buff[msg_size], p_file_info->line_carry_size);
+
+        if (msg_size) {
+            /* Null-terminate p_file_info->buff using the extra byte 
+             * that was reallocz'd in check_if_filesize_changed_cb(); */
+            p_file_info->buff[msg_size] = '\0';
+            p_file_info->buff_size = msg_size + 1;
+
+            /* If the circular buffer is full and dropped logs are not allowed, the filesize will 
+             * not be updated and the text (including the partial line) will be read again by 
+             * the next (forced) check, i.e. the next read is deferred. */
+            const uint64_t filesize = p_file_info->filesize;
+            (void)circ_buff_write(p_file_info, main_loop);
+            if (p_file_info->filesize == filesize) p_file_info->line_carry_size = 0;
+            fprintf_log(LOGS_MANAG_INFO, stderr, "Circ buff size for %s: %d\n" LOG_SEPARATOR,
+                        p_file_info->file_basename, circ_buff_get_size(p_file_info->msg_buff));
         }
-
-        /* Null-terminate p_file_info->buff using the extra byte (in case needed)
-         * that was reallocz'd in check_if_file_changed_cb(); */
-        p_file_info->buff[p_file_info->buff_size++] = '\0';
-
-        circ_buff_write(p_file_info);
-        fprintf_log(LOGS_MANAG_INFO, stderr, "Circ buff size for %s: %d\n" LOG_SEPARATOR,
-                    p_file_info->file_basename, circ_buff_get_size(p_file_info->msg_buff));
-
-        // fprintf(stderr, "New filesize %" PRIu64 " for %s\n", p_file_info->filesize, p_file_info->filename);
     }
 
-free_access_lock:
     p_file_info->access_lock = 0;
     fprintf_log(LOGS_MANAG_DEBUG, stderr, "Access_lock released for %s\n", p_file_info->file_basename);
-    (void)file_close(p_file_info);
     (void)enable_file_changed_events(p_file_info, 1);
     uv_fs_req_cleanup(req);
     freez(req);
 }
 
-static int check_file_rotation(struct File_info *p_file_info, uint64_t new_filesize) {
-    uint64_t end_time;
-    uint64_t start_time = get_unix_time_ms();
-    int rc = 0;
-    int rotated = -1;
-    if (new_filesize < p_file_info->signature_size) {
-        // Filesize smaller than signature_size so log must have rotated
-        // All we need to do is updated the signature - no need to memcmp with old signature
-        m_assert(rotated == -1, "Rotated cannot be other than -1 at this point!");
-        rotated = 1;
-
-        p_file_info->signature_size = (size_t)new_filesize;
-        // TODO: Realloc down p_file_info->signature here? Not sure if needed as that will grow at some point soon!
-        p_file_info->uvBuf = uv_buf_init(p_file_info->signature, p_file_info->signature_size);
-        uv_fs_t read_req;
-        rc = uv_fs_read(main_loop, &read_req, p_file_info->file_handle, &p_file_info->uvBuf, 1, 0, NULL);
-        if (rc < 0)
-            fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_read() error for %s\n", p_file_info->filename);
-        m_assert(rc >= 0, "uv_fs_read() failed");
-        uv_fs_req_cleanup(&read_req);
+/**
+ * @brief Read the signature of a log file
+ * @param p_file_info #File_info struct of the log file.
+ * @param signature Buffer of at least MAX_FILE_SIGNATURE_SIZE bytes to read the signature into.
+ * @param filesize Current size of the log file.
+ * @return Size of the signature read.
+ */
+static size_t file_signature_read(struct File_info *p_file_info, char *signature, uint64_t filesize) {
+    const size_t signature_size = filesize > MAX_FILE_SIGNATURE_SIZE ? MAX_FILE_SIGNATURE_SIZE : (size_t)filesize;
+    uv_buf_t uv_buf = uv_buf_init(signature, signature_size);
+    uv_fs_t read_req;
+    int rc = uv_fs_read(main_loop, &read_req, p_file_info->file_handle, &uv_buf, 1, 0, NULL);
+    if (unlikely(rc < 0))
+        fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_read() for %s failed: (%d) %s\n", p_file_info->filename, rc, uv_strerror(rc));
+    m_assert(rc >= 0, "uv_fs_read() failed");
+    uv_fs_req_cleanup(&read_req);
+    return rc < 0 ? 0 : (size_t) rc;
+}
 
-        end_time = get_unix_time_ms();
-        fprintf_log(LOGS_MANAG_INFO, stderr, "(1) It took %" PRIu64 "ms to check file rotation.\n", end_time - start_time);
-        return rotated;
-    }
-    if ((int64_t)new_filesize < (int64_t)p_file_info->filesize) {
-        // Filesize reduced (but larger than signature) so log must have rotated
-        // No need to memcmp in this case, just update the signature
-        m_assert(rotated == -1, "Rotated cannot be other than -1 at this point!");
+/**
+ * @brief Check if a log file has been rotated
+ * @details A log file has been rotated if:
+ * - a different file (inode) is now found at its path, in which case the file is re-opened, 
+ * - it has been truncated, i.e. its size is less than the bytes that have been consumed already,
+ * - its signature changed (copy-truncate rotation followed by enough new logs), which only needs
+ *   to be checked while the signature is less than MAX_FILE_SIGNATURE_SIZE or the file grew.
+ * @param p_file_info #File_info struct of the log file.
+ * @param statbuf Result of the stat() of the path of the log file.
+ * @return 1 if rotated, 0 if not, libuv error code if the new file could not be opened.
+ */
+static int check_file_rotation(struct File_info *p_file_info, const uv_stat_t *statbuf) {
+    const uint64_t start_time = get_unix_time_ms();
+    const uint64_t new_filesize = statbuf->st_size;
+    int rotated = 0;
+
+    if (statbuf->st_ino != p_file_info->file_ino || statbuf->st_dev != p_file_info->file_dev) {
+        int rc = file_reopen(p_file_info, statbuf);
+        if (unlikely(rc)) return rc;
         rotated = 1;
-
-        p_file_info->signature_size = new_filesize > MAX_FILE_SIGNATURE_SIZE ? MAX_FILE_SIGNATURE_SIZE : (size_t)new_filesize;
-        // TODO: Refactor next line with temp pointer, currently in risk of memory leak in case reallocz fails!
-        p_file_info->signature = reallocz(p_file_info->signature, p_file_info->signature_size);
-        p_file_info->uvBuf = uv_buf_init(p_file_info->signature, p_file_info->signature_size);
-        uv_fs_t read_req;
-        rc = uv_fs_read(main_loop, &read_req, p_file_info->file_handle, &p_file_info->uvBuf, 1, 0, NULL);
-        if (rc < 0)
-            fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_read() error for %s\n", p_file_info->filename);
-        m_assert(rc >= 0, "uv_fs_read() failed");
-        uv_fs_req_cleanup(&read_req);
-
-        end_time = get_unix_time_ms();
-        fprintf_log(LOGS_MANAG_INFO, stderr, "(2) It took %" PRIu64 "ms to check file rotation.\n", end_time - start_time);
-        return rotated;
-    }
-    if (new_filesize >= p_file_info->signature_size && new_filesize >= p_file_info->filesize) {
-        // Filesize larger than signature_size and also larger than old p_file_info->filesize
-        // Not sure if log has rotated - need to memcmp signatures
-        m_assert(rotated == -1, "Rotated cannot be other than -1 at this point!");
-
-        size_t comp_buff_size = new_filesize > MAX_FILE_SIGNATURE_SIZE ? MAX_FILE_SIGNATURE_SIZE : (size_t)new_filesize;
-        char *comp_buff = mallocz(comp_buff_size);
-        p_file_info->uvBuf = uv_buf_init(comp_buff, comp_buff_size);
-        uv_fs_t read_req;
-        rc = uv_fs_read(main_loop, &read_req, p_file_info->file_handle, &p_file_info->uvBuf, 1, 0, NULL);
-        if (rc < 0)
-            fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_read() error for %s\n", p_file_info->filename);
-        m_assert(rc >= 0, "uv_fs_read() failed");
-        uv_fs_req_cleanup(&read_req);
-
-        // TODO: Use fixed-size signature buffer to reduce number of reallocs
-        p_file_info->signature = reallocz(p_file_info->signature, comp_buff_size);
-        rotated = memcmp(p_file_info->signature, comp_buff, p_file_info->signature_size) ? 1 : 0;
-        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Signature size: %zuB Comp buff size: %zuB\n", p_file_info->signature_size, comp_buff_size);
-        fprintf_log(LOGS_MANAG_DEBUG, stderr,
-                    "signature:\n%.*s\n" LOG_SEPARATOR
-                    "comp_buff:\n%.*s\n" LOG_SEPARATOR,
-                    p_file_info->signature_size, p_file_info->signature,
-                    comp_buff_size, comp_buff);
-
-        // Update signature
-        p_file_info->signature_size = comp_buff_size;
-        memcpy(p_file_info->signature, comp_buff, p_file_info->signature_size);
-
-        freez(comp_buff);
-
-        end_time = get_unix_time_ms();
-        fprintf_log(LOGS_MANAG_INFO, stderr, "(3) It took %" PRIu64 "ms to check file rotation.\n", end_time - start_time);
-        return rotated;
+    } else if (new_filesize < p_file_info->filesize + p_file_info->line_carry_size) {
+        rotated = 1;
+    } else if (new_filesize > p_file_info->filesize + p_file_info->line_carry_size || 
+               p_file_info->signature_size < MAX_FILE_SIGNATURE_SIZE) {
+        char comp_buff[MAX_FILE_SIGNATURE_SIZE];
+        const size_t comp_buff_size = file_signature_read(p_file_info, comp_buff, new_filesize);
+        rotated = (comp_buff_size < p_file_info->signature_size || 
+                   memcmp(p_file_info->signature, comp_buff, p_file_info->signature_size)) ? 1 : 0;
+        if (!rotated) {
+            // Update signature, in case more of it is available now
+            memcpy(p_file_info->signature, comp_buff, comp_buff_size);
+            p_file_info->signature_size = comp_buff_size;
+        }
     }
 
-    m_assert(0, "Should never reach this point");
+    if (rotated) p_file_info->signature_size = file_signature_read(p_file_info, p_file_info->signature, new_filesize);
+
+    fprintf_log(LOGS_MANAG_INFO, stderr, "It took %" PRIu64 "ms to check file rotation.\n", get_unix_time_ms() - start_time);
     return rotated;
 }
 
@@ -362,23 +391,17 @@ static void check_if_filesize_changed_cb(uv_fs_t *req) {
             handle_UV_ENOENT_err(p_file_info);
         else
             m_assert(0, "Error in check_if_filesize_changed_cb");
+        p_file_info->access_lock = 0;
         goto cleanup_and_return;
     }
 
-    if (p_file_info->access_lock) {
-        // File already accessed by another check_if_filesize_changed_cb callback
-        // TODO: Is access_lock still needed now that events can stop and restart? Keep for now.
-        fprintf_log(LOGS_MANAG_ERROR, stderr, "Could not acquire access_lock for %s\n", p_file_info->file_basename);
-        (void)enable_file_changed_events(p_file_info, 0);
-        goto cleanup_and_return;
-    }
-
-    p_file_info->access_lock = 1;
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Access_lock acquired for %s\n", p_file_info->file_basename);
+    // Get new filesize
+    uv_stat_t *statbuf = uv_fs_get_statbuf(req);
+    uint64_t new_filesize = statbuf->st_size;
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "New filesize %s: %" PRIu64 "B\n", p_file_info->file_basename, new_filesize);
 
-    // Open file
-    // TODO: Keep file open rather than opening/closing each time in this function
-    rc = file_open(p_file_info);
+    // Check file rotation
+    rc = check_file_rotation(p_file_info, statbuf);
     if (unlikely(rc < 0)) {
         fprintf_log(LOGS_MANAG_ERROR, stderr, "Error in file_open() (%d): %s\n", rc, uv_strerror(rc));
         if (rc == UV_ENOENT)
@@ -388,66 +411,62 @@ static void check_if_filesize_changed_cb(uv_fs_t *req) {
         p_file_info->access_lock = 0;
         goto cleanup_and_return;
     }
-
-    // Get new filesize
-    uv_stat_t *statbuf = uv_fs_get_statbuf(req);
-    uint64_t new_filesize = statbuf->st_size;
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "New filesize %s: %" PRIu64 "B\n", p_file_info->file_basename, new_filesize);
-
-    // Check file rotation
-    if (check_file_rotation(p_file_info, new_filesize)) {
+    if (rc) {
         p_file_info->filesize = 0;  // New log file - we want to start reading from the beginning!
+        p_file_info->line_carry_size = 0;
         fprintf_log(LOGS_MANAG_INFO, stderr, "Rotated:%s\n", p_file_info->filename);
     } else
-        fprintf_log(LOGS_MANAG_INFO, stderr, "Not rotated:%s\n", p_file_info->filename);
-    uint64_t old_filesize = p_file_info->filesize;
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Not rotated:%s\n", p_file_info->filename);
+
+    /* Bytes up to read_offset have already been read, either consumed (up to filesize) or carried over */
+    const uint64_t read_offset = p_file_info->filesize + p_file_info->line_carry_size;
 
     /* CASE 1: Filesize has increased */
-    if (likely((int64_t)new_filesize - (int64_t)old_filesize > 0)) {
-        size_t filesize_diff = (size_t)(new_filesize - old_filesize >= MAX_LOG_MSG_SIZE ? MAX_LOG_MSG_SIZE : new_filesize - old_filesize);
+    if (likely(new_filesize > read_offset)) {
+        const size_t carry_size = p_file_info->line_carry_size;
+        size_t filesize_diff = (size_t)(new_filesize - read_offset >= MAX_LOG_MSG_SIZE - carry_size ? 
+                                        MAX_LOG_MSG_SIZE - carry_size : new_filesize - read_offset);
 
-#if 1
-        if (filesize_diff == MAX_LOG_MSG_SIZE) {
+        if (filesize_diff == MAX_LOG_MSG_SIZE - carry_size) {
             fprintf_log(LOGS_MANAG_WARNING, stderr, "File %s increased by %" PRIu64
                                          "KB (more than MAX_LOG_MSG_SIZE)! "
                                          "Will read only MAX_LOG_MSG_SIZE instead!\n",
                         p_file_info->file_basename,
-                        (new_filesize - old_filesize) / 1000);
-            fprintf_log(LOGS_MANAG_DEBUG, stderr, "filesize_diff %s:%" PRIu64 "B:\n", p_file_info->file_basename, filesize_diff);
+                        (new_filesize - read_offset) / 1000);
         }
-#endif
 
-        uv_fs_t *read_req = mallocz(sizeof(uv_fs_t));
-        read_req->data = p_file_info;
-        p_file_info->buff_size = filesize_diff;
-        if (!p_file_info->buff || filesize_diff > p_file_info->buff_size_max) {
-            p_file_info->buff_size_max = filesize_diff * BUFF_SCALE_FACTOR;
+        /* +1 byte to null-terminate p_file_info->buff in read_file_cb() */
+        if (!p_file_info->buff || carry_size + filesize_diff + 1 > p_file_info->buff_size_max) {
+            p_file_info->buff_size_max = (carry_size + filesize_diff + 1) * BUFF_SCALE_FACTOR;
             p_file_info->buff = reallocz(p_file_info->buff, p_file_info->buff_size_max);
         }
         m_assert(p_file_info->buff, "Realloc buffer must not be NULL!");
-        p_file_info->uvBuf = uv_buf_init(p_file_info->buff, p_file_info->buff_size);
+        memcpy(p_file_info->buff, p_file_info->line_carry, carry_size);
+        p_file_info->buff_size = carry_size + filesize_diff;
+
+        uv_fs_t *read_req = mallocz(sizeof(uv_fs_t));
+        read_req->data = p_file_info;
+        p_file_info->uvBuf = uv_buf_init(&p_file_info->buff[carry_size], filesize_diff);
         rc = uv_fs_read(main_loop, read_req, p_file_info->file_handle,
-                        &p_file_info->uvBuf, 1, old_filesize, read_file_cb);
+                        &p_file_info->uvBuf, 1, read_offset, read_file_cb);
         if (rc)
             fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_read() error for %s\n", p_file_info->filename);
         m_assert(!rc, "uv_fs_read() failed");
         goto cleanup_and_return;
     }
-    /* CASE 2: Filesize remains the same */
-    else if (unlikely(new_filesize == old_filesize)) {
-        fprintf_log(LOGS_MANAG_WARNING, stderr, "%s changed but filesize remains the same\n", p_file_info->file_basename);
+    /* CASE 2: Filesize remains the same (or only a partial line was added earlier) */
+    else if (unlikely(new_filesize == read_offset)) {
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "%s changed but filesize remains the same\n", p_file_info->file_basename);
     }
-    /* CASE 3: Filesize reduced */
+    /* CASE 3: Filesize reduced - cannot happen, as it would have been detected as a rotation */
     else {
-        // TODO: Filesize reduced - error or log archived?? For now just assert
         fprintf_log(LOGS_MANAG_ERROR, stderr, "Filesize of %s reduced by %" PRId64 "B!!",
-                    p_file_info->file_basename, (int64_t)new_filesize - (int64_t)old_filesize);
+                    p_file_info->file_basename, (int64_t)new_filesize - (int64_t)read_offset);
         m_assert(0, "Filesize reduced!");
     }
 
     p_file_info->access_lock = 0;
     fprintf_log(LOGS_MANAG_DEBUG, stderr, "Access_lock released for %s\n", p_file_info->file_basename);
-    (void)file_close(p_file_info);
     (void)enable_file_changed_events(p_file_info, 0);
 
 cleanup_and_return:
@@ -455,22 +474,16 @@ static void check_if_filesize_changed_cb(uv_fs_t *req) {
     freez(req);
 }
 
-static void file_changed_cb(uv_fs_event_t *handle, const char *file_basename, int events, int status) {
+/**
+ * @brief Check if a log file has changed and read any new logs
+ * @details Asynchronously stat() the log file, continuing in #check_if_filesize_changed_cb().
+ * @param p_file_info #File_info struct of the log file to check.
+ */
+static void file_changed_check(struct File_info *p_file_info) {
     int rc = 0;
-    struct File_info *p_file_info = handle->data;
-
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "File changed! %s\n", file_basename ? file_basename : "");
-
-    rc = uv_fs_event_stop(p_file_info->fs_event_req);
-    if (rc) {
-        fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_event_stop() error for %s: %s \n",
-                    p_file_info->filename, uv_strerror(rc));
-        m_assert(!rc, "uv_fs_event_stop() failed");
-    }
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "%s %s\n", file_basename, !p_file_info->force_file_changed_cb ? "forced file_changed_cb()" : "regular file_changed_cb()");
 
-    // if (events & UV_RENAME)
-    //    sleep_ms(LOG_ROTATION_WAIT_TIME);  // If renamed likely that log was rotated - wait a while for new log to be created.
+    p_file_info->access_lock = 1;
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Access_lock acquired for %s\n", p_file_info->file_basename);
 
     uv_fs_t *stat_req = mallocz(sizeof(uv_fs_t));
     stat_req->data = p_file_info;
@@ -479,8 +492,42 @@ static void file_changed_cb(uv_fs_event_t *handle, const char *file_basename, in
     if (unlikely(rc)) {
         fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_stat error: %s\n", uv_strerror(rc));
         m_assert(!rc, "uv_fs_stat error");
+        p_file_info->access_lock = 0;
+        freez(stat_req);
     }
-    m_assert(!strcmp(file_basename, p_file_info->file_basename), "file_basename argument should equal struct file_basename");
+}
+
+/**
+ * @brief Callback of the FS events (inotify on Linux) of a log file
+ * @details The FS events watch is kept registered, so that bursts of modification events 
+ * are coalesced: if the log file is already being read or it was read less than 
+ * #LOG_FILE_READ_INTERVAL ago, the event is only recorded and it will be handled when 
+ * #enable_file_changed_events_timer_cb() runs. Only a rename stops the watch, so that it 
+ * can be re-registered for whatever file is found at the same path later.
+ */
+static void file_changed_cb(uv_fs_event_t *handle, const char *file_basename, int events, int status) {
+    int rc = 0;
+    struct File_info *p_file_info = handle->data;
+
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "File changed! %s\n", file_basename ? file_basename : "");
+
+    if (events & UV_RENAME) {
+        rc = uv_fs_event_stop(p_file_info->fs_event_req);
+        if (rc) {
+            fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_event_stop() error for %s: %s \n",
+                        p_file_info->filename, uv_strerror(rc));
+            m_assert(!rc, "uv_fs_event_stop() failed");
+        }
+        p_file_info->fs_event_rewatch = 1;
+    }
+
+    if (p_file_info->access_lock || uv_is_active((uv_handle_t *)p_file_info->enable_file_changed_events_timer)) {
+        fprintf_log(LOGS_MANAG_DEBUG, stderr, "Coalescing FS event for %s\n", p_file_info->file_basename);
+        p_file_info->force_file_changed_cb = 1;
+        return;
+    }
+
+    file_changed_check(p_file_info);
 }
 
 static void register_file_changed_listener(struct File_info *p_file_info) {
@@ -500,7 +547,8 @@ static void register_file_changed_listener(struct File_info *p_file_info) {
     if (unlikely(rc))
         fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_timer_init() for %s failed\n", p_file_info->filename);
     m_assert(!rc, "uv_timer_init() failed");
-    uv_fs_event_start(p_file_info->fs_event_req, file_changed_cb, p_file_info->filename, 0);
+    p_file_info->enable_file_changed_events_timer->data = p_file_info;
+    rc = uv_fs_event_start(p_file_info->fs_event_req, file_changed_cb, p_file_info->filename, 0);
     if (rc)
         fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_event_start() for %s failed\n", p_file_info->filename);
     m_assert(!rc, "uv_fs_event_start() failed");
@@ -512,26 +560,15 @@ static void register_file_changed_listener(struct File_info *p_file_info) {
  * which can later be used to identify the file.
  */
 static void file_signature_init(struct File_info *p_file_info) {
-    int rc = 0;
-
-    p_file_info->signature_size = p_file_info->filesize > MAX_FILE_SIGNATURE_SIZE ? MAX_FILE_SIGNATURE_SIZE : (size_t)p_file_info->filesize;
-    p_file_info->signature = mallocz(p_file_info->signature_size);
-    p_file_info->uvBuf = uv_buf_init(p_file_info->signature, p_file_info->signature_size);
-
-    uv_fs_t read_req;
-    rc = uv_fs_read(main_loop, &read_req, p_file_info->file_handle, &p_file_info->uvBuf, 1, 0, NULL);
-    if (unlikely(rc < 0))
-        fprintf_log(LOGS_MANAG_ERROR, stderr, "uv_fs_read() for %s failed: (%d) %s\n", p_file_info->filename, rc, uv_strerror(rc));
-    m_assert(rc >= 0, "uv_fs_read() failed");
-    uv_fs_req_cleanup(&read_req);
+    p_file_info->signature_size = file_signature_read(p_file_info, p_file_info->signature, p_file_info->filesize);
 
     fprintf_log(LOGS_MANAG_INFO, stderr,
                 "Initialising signature for file %s, signature size %zu\n",
                 p_file_info->file_basename, p_file_info->signature_size);
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Signature: %s\n" LOG_SEPARATOR, p_file_info->signature);
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Signature: %.*s\n" LOG_SEPARATOR, (int) p_file_info->signature_size, p_file_info->signature);
 }
 
-static struct File_info *monitor_log_file_init(const char *filename) {
+static struct File_info *monitor_log_file_init(const char *filename, int circ_buff_max_items, size_t circ_buff_max_size, int circ_buff_allow_dropped_logs) {
     int rc = 0;
 
     fprintf_log(LOGS_MANAG_INFO, stderr,
@@ -564,6 +601,8 @@ static struct File_info *monitor_log_file_init(const char *filename) {
         fprintf_log(LOGS_MANAG_INFO, stderr, "Size of %s: %lldKB\n", p_file_info->filename,
                     (long long)statbuf->st_size / 1000);
         p_file_info->filesize = statbuf->st_size;
+        p_file_info->file_ino = statbuf->st_ino;
+        p_file_info->file_dev = statbuf->st_dev;
     }
     uv_fs_req_cleanup(&stat_req);
 
@@ -574,7 +613,7 @@ static struct File_info *monitor_log_file_init(const char *filename) {
 
     file_signature_init(p_file_info);  // TODO: Error check
 
-    p_file_info->msg_buff = circ_buff_init();
+    p_file_info->msg_buff = circ_buff_init(circ_buff_max_items, circ_buff_max_size, circ_buff_allow_dropped_logs);
 
     register_file_changed_listener(p_file_info);  // TODO: Error check
 
@@ -701,6 +740,7 @@ static void config_init(){
     do{
     	/* Check if log parsing is enabled in configuration */
         fprintf(stderr, "NDLGS Processing section: %s\n", config_section->name);
+        if(!strcmp(config_section->name, CONFIG_SECTION_LOGS_MANAG_GLOBAL)) goto next_section;
         int enabled = appconfig_get_boolean(&log_management_config, config_section->name, "enabled", 0);
         // fprintf(stderr, "NDLGS Enabled value: %d for section: %s\n", enabled, config_section->name);
         // fprintf(stderr, "NDLGS config_section->next NULL? %s\n", config_section->next ? "yes" : "no");
@@ -713,11 +753,46 @@ static void config_init(){
         if(!log_source_path || log_source_path[0]=='\0') goto next_section;
 
 
+        /* Read circular buffer configuration */
+        int circ_buff_max_items = (int) appconfig_get_number(&log_management_config, config_section->name, 
+                                                             "circular buffer max items", CIRC_BUFF_DEFAULT_MAX_ITEMS);
+        if(circ_buff_max_items < 2) circ_buff_max_items = CIRC_BUFF_DEFAULT_MAX_ITEMS;
+        long long circ_buff_max_size = appconfig_get_number(&log_management_config, config_section->name, 
+                                                            "circular buffer max size MiB", CIRC_BUFF_DEFAULT_MAX_SIZE / (1 MiB));
+        if(circ_buff_max_size < 1) circ_buff_max_size = CIRC_BUFF_DEFAULT_MAX_SIZE / (1 MiB);
+        int circ_buff_allow_dropped_logs = appconfig_get_boolean(&log_management_config, config_section->name, 
+                                                                 "circular buffer drop logs if full", 0);
+
         /* Check if log monitoring initialisation is successful */
-        // TODO: Add option to enable parser only without log storage and queries??
-        struct File_info *p_file_info = monitor_log_file_init(log_source_path);
+        struct File_info *p_file_info = monitor_log_file_init(log_source_path, circ_buff_max_items, 
+                                                              (size_t) circ_buff_max_size MiB, circ_buff_allow_dropped_logs);
         if(!p_file_info) goto next_section; // monitor_log_file_init() was successful
 
+        /* Read DB writer configuration */
+        p_file_info->db_flush_interval = (int) appconfig_get_number(&log_management_config, config_section->name, 
+                                                                    "db flush interval ms", DB_FLUSH_BUFF_INTERVAL);
+        if(p_file_info->db_flush_interval < (int) LOG_FILE_READ_INTERVAL) p_file_info->db_flush_interval = LOG_FILE_READ_INTERVAL;
+        p_file_info->db_write_batch_max_msgs = (int) appconfig_get_number(&log_management_config, config_section->name, 
+                                                                          "db write batch max messages", DB_WRITER_BATCH_DEFAULT_MAX_MSGS);
+        if(p_file_info->db_write_batch_max_msgs < 1) p_file_info->db_write_batch_max_msgs = 1;
+        if(p_file_info->db_write_batch_max_msgs > DB_WRITER_BATCH_MAX_MSGS) p_file_info->db_write_batch_max_msgs = DB_WRITER_BATCH_MAX_MSGS;
+
+        /* Read compression configuration */
+        char *compression = appconfig_get(&log_management_config, config_section->name, "compression", "lz4");
+        const int compr_codec = compr_codec_from_str(compression);
+        if(compr_codec < 0) fprintf_log(LOGS_MANAG_ERROR, stderr, "Invalid compression '%s' for %s, using 'lz4' instead\n", 
+                                        compression, p_file_info->filename);
+        p_file_info->compr_codec = compr_codec < 0 ? LOGS_COMPR_CODEC_LZ4F : (uint8_t) compr_codec;
+
+        /* Read retention and compaction configuration, enforced by the DB compactor */
+        p_file_info->retention_max_age = (uint64_t) appconfig_get_number(&log_management_config, config_section->name, 
+                                                                         "db retention max age hours", 0) * 3600000ULL;
+        p_file_info->retention_max_size = (uint64_t) appconfig_get_number(&log_management_config, config_section->name, 
+                                                                          "db retention max size MiB", 0) MiB;
+        p_file_info->compact_cold_blobs = appconfig_get_boolean(&log_management_config, config_section->name, 
+                                                                "db compact cold logs", 0) && 
+                                          p_file_info->compr_codec != LOGS_COMPR_CODEC_LZ4F_HC; // Nothing to gain otherwise
+
         /* Check if a valid log format configuration is detected */
         char *log_format = appconfig_get(&log_management_config, config_section->name, "log format", NULL);
         const char delimiter = ' '; // TODO!!: TO READ FROM CONFIG
@@ -739,6 +814,7 @@ static void config_init(){
             // if(!p_file_info->parser_config || !p_file_info->parser_config->num_fields) assert(0); // TODO: Remove after testing!
 
 	        free(parser_buff->line);
+	        freez(parser_buff->fields);
 	        free(parser_buff);
 		}
 		else{
@@ -751,6 +827,28 @@ static void config_init(){
 
         p_file_info->chart_name = config_section->name ? strdup(config_section->name) : p_file_info->filename;
         p_file_info->parser_metrics = callocz(1, sizeof(Log_parser_metrics_t));
+        long long req_clients_alltime_max_mem = appconfig_get_number(&log_management_config, config_section->name, 
+                                                                     "unique client IPs - all-time max memory MiB", 
+                                                                     REQ_CLIENTS_ALLTIME_DEFAULT_MAX_MEM / (1 MiB));
+        if(req_clients_alltime_max_mem < 1) req_clients_alltime_max_mem = REQ_CLIENTS_ALLTIME_DEFAULT_MAX_MEM / (1 MiB);
+        p_file_info->parser_metrics->req_clients_alltime_arr.mem_max = (size_t) req_clients_alltime_max_mem MiB;
+
+        /* Read unique client IPs counting configuration. In "hyperloglog" mode, they are still counted 
+         * exactly as long as that takes less memory than the HyperLogLog registers. */
+        char *req_clients_counting = appconfig_get(&log_management_config, config_section->name, 
+                                                   "unique client IPs - counting", "exact");
+        if(!strcmp(req_clients_counting, "hyperloglog")){
+            int hll_precision = (int) appconfig_get_number(&log_management_config, config_section->name, 
+                                                           "unique client IPs - hyperloglog precision", 
+                                                           REQ_CLIENTS_HLL_DEFAULT_PRECISION);
+            if(hll_precision < REQ_CLIENTS_HLL_MIN_PRECISION) hll_precision = REQ_CLIENTS_HLL_MIN_PRECISION;
+            if(hll_precision > REQ_CLIENTS_HLL_MAX_PRECISION) hll_precision = REQ_CLIENTS_HLL_MAX_PRECISION;
+            p_file_info->parser_metrics->req_clients_current_arr.hll_precision = hll_precision;
+            p_file_info->parser_metrics->req_clients_alltime_arr.hll_precision = hll_precision;
+        }
+        else if(strcmp(req_clients_counting, "exact")) 
+            fprintf_log(LOGS_MANAG_ERROR, stderr, "Invalid unique client IPs counting '%s' for %s, using 'exact' instead\n", 
+                        req_clients_counting, p_file_info->filename);
         p_file_info->parser_mut = mallocz(sizeof(uv_mutex_t));
         rc = uv_mutex_init(p_file_info->parser_mut);
         if(rc) fatal("Failed to initialise parser_mut for %s\n", p_file_info->filename);
@@ -792,6 +890,10 @@ static void config_init(){
                 && appconfig_get_boolean(&log_management_config, config_section->name, "timings chart", 0)){ 
                 p_file_info->parser_config->chart_config |= CHART_REQ_PROC_TIME;
             }
+            if((p_file_info->parser_config->fields[j] == UPS_RESP_TIME) 
+                && appconfig_get_boolean(&log_management_config, config_section->name, "upstream timings chart", 0)){ 
+                p_file_info->parser_config->chart_config |= CHART_UPS_RESP_TIME;
+            }
             if((p_file_info->parser_config->fields[j] == RESP_CODE) 
                 && appconfig_get_boolean(&log_management_config, config_section->name, "response code families chart", 0)){ 
                 p_file_info->parser_config->chart_config |= CHART_RESP_CODE_FAMILY;
@@ -813,6 +915,20 @@ static void config_init(){
                 p_file_info->parser_config->chart_config |= CHART_SSL_CIPHER;
             }
         }
+        /* Only fields needed by the enabled charts will be extracted from now on */
+        compile_parse_plan(p_file_info->parser_config, 0);
+
+        /* Read metrics-only configuration. In this mode, log messages are discarded once parsed 
+         * (so they are neither compressed nor written to the DB), except for any lines matching 
+         * "metrics only - keep lines matching" or sampled through "metrics only - keep 1 in N lines". */
+        p_file_info->metrics_only = (uint8_t) appconfig_get_boolean(&log_management_config, config_section->name, "metrics only", 0);
+        if(p_file_info->metrics_only){
+            char *keep_keyword = appconfig_get(&log_management_config, config_section->name, "metrics only - keep lines matching", "");
+            if(keep_keyword && *keep_keyword) p_file_info->keep_matcher = keyword_matcher_create(keep_keyword, 0);
+            const int keep_sample_interval = (int) appconfig_get_number(&log_management_config, config_section->name, 
+                                                                        "metrics only - keep 1 in N lines", 0);
+            p_file_info->keep_sample_interval = keep_sample_interval > 0 ? keep_sample_interval : 0;
+        }
 
 next_section:
         config_section = config_section->next;
@@ -835,8 +951,7 @@ void logsmanagement_main(void) {
 
     // Static asserts
     COMPILE_TIME_ASSERT(DB_FLUSH_BUFF_INTERVAL > LOG_FILE_READ_INTERVAL);                                      // Do not flush to DB more frequently than reading the logs from the sources.
-    COMPILE_TIME_ASSERT(DB_FLUSH_BUFF_INTERVAL / LOG_FILE_READ_INTERVAL < CIRCULAR_BUFF_SIZE);                 // Check if enough circ buffer spaces
-    COMPILE_TIME_ASSERT((CIRCULAR_BUFF_SIZE != 0) && ((CIRCULAR_BUFF_SIZE & (CIRCULAR_BUFF_SIZE - 1)) == 0));  // CIRCULAR_BUFF_SIZE must be a power of 2.
+    COMPILE_TIME_ASSERT(DB_FLUSH_BUFF_INTERVAL / LOG_FILE_READ_INTERVAL < CIRC_BUFF_DEFAULT_MAX_ITEMS);        // Check if enough circ buffer spaces by default
     COMPILE_TIME_ASSERT(LOGS_MANAG_DEBUG ? 1 : !VALIDATE_COMPRESSION);                                         // Ensure VALIDATE_COMPRESSION is disabled in release versions.
 
     // Setup timing
@@ -854,7 +969,18 @@ void logsmanagement_main(void) {
 
     fprintf_log(LOGS_MANAG_INFO, stderr, "File monitoring setup completed. Running db_init().\n" LOG_SEPARATOR);
     
-    db_init();
+    /* Global settings, shared by all log sources */
+    int db_writer_threads = (int) appconfig_get_number(&log_management_config, CONFIG_SECTION_LOGS_MANAG_GLOBAL, 
+                                                       "db writer threads", DB_WRITER_THREADS_DEFAULT);
+    int db_metadata_cache_size = (int) appconfig_get_number(&log_management_config, CONFIG_SECTION_LOGS_MANAG_GLOBAL, 
+                                                            "db metadata cache size KiB", DB_METADATA_CACHE_SIZE_DEFAULT);
+    if(db_metadata_cache_size < 1) db_metadata_cache_size = DB_METADATA_CACHE_SIZE_DEFAULT;
+    uint64_t db_disk_space_budget = (uint64_t) appconfig_get_number(&log_management_config, CONFIG_SECTION_LOGS_MANAG_GLOBAL, 
+                                                                    "db disk space budget MiB", 0) MiB;
+    int db_compactor_interval = (int) appconfig_get_number(&log_management_config, CONFIG_SECTION_LOGS_MANAG_GLOBAL, 
+                                                           "db compaction interval secs", DB_COMPACTOR_INTERVAL_DEFAULT);
+    if(db_compactor_interval < 1) db_compactor_interval = 1;
+    db_init(db_writer_threads, db_metadata_cache_size, db_disk_space_budget, db_compactor_interval);
 
     // Timing of setup routines
     end_time = get_unix_time_ms();
@@ -876,6 +1002,7 @@ void logsmanagement_main(void) {
 #if LOGS_MANAGEMENT_STRESS_TEST
     fprintf_log(LOGS_MANAG_INFO, stderr, "p_file_infos_arr->count: %d\n", p_file_infos_arr->count);
     fprintf_log(LOGS_MANAG_INFO, stderr, LOG_SEPARATOR "Running Netdata with logs_management stress test enabled!\n" LOG_SEPARATOR);
+    run_parser_benchmark();
     static uv_thread_t run_stress_test_queries_thread_id;
     uv_thread_create(&run_stress_test_queries_thread_id, run_stress_test_queries_thread, NULL);
 #endif  // LOGS_MANAGEMENT_STRESS_TEST
@@ -7,19 +7,24 @@
 //#if !defined(_XOPEN_SOURCE) && !defined(__DARWIN__) && !defined(__APPLE__)
 #define _XOPEN_SOURCE 600 // required by strptime
 //#endif
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1 // required by memmem() and strcasestr() in search_keyword()
+#endif
 
 #include <stdio.h>
 #include <string.h>
 #include "helper.h"
+#include "config_.h"
 #include <regex.h> 
+#include <ctype.h>
+#include <arpa/inet.h>
 #include "parser.h"
+#include <math.h>
+#include <limits.h>
 #include <time.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
-static regex_t vhost_regex, req_client_regex, cipher_suite_regex;
-static int regexs_initialised = 0;
-
 const char* const csv_auto_format_guess_matrix[] = {
     "$host:$server_port $remote_addr - - [$time_local] \"$request\" $status $body_bytes_sent $request_length $request_time $upstream_response_time", // csvVhostCustom4
     "$host:$server_port $remote_addr - - [$time_local] \"$request\" $status $body_bytes_sent - - $request_length $request_time",                     // csvVhostCustom3
@@ -321,57 +326,442 @@ static inline char **parse_csv( const char *line, const char delimiter, int num_
     return buf;
 }
 
+/**
+ * @brief Split a line into fields, in place
+ * @details Single-pass and allocation-free alternative of count_fields() + parse_csv(), 
+ * used for the log lines. Each field is NUL-terminated in place and any quotes are 
+ * removed in place (with doubled quotes within quotes collapsed to one), just like 
+ * parse_csv() does, so the returned fields are slices of line.
+ * @param[in,out] line NUL-terminated line to split. It is modified in place.
+ * @param[in] delimiter Delimiter that separates the fields.
+ * @param[out] fields Array to store the fields into.
+ * @param[in] fields_max Size of the fields array. Any fields beyond it are only counted, 
+ * without being split or unquoted.
+ * @return Number of fields of line, or -1 if a quote is not terminated.
+ */
+static inline int tokenize_line(char *line, const char delimiter, char **fields, const int fields_max){
+    char *rd = line, *wr = line, *field = line;
+    int num_fields = 0, fQuote = 0;
+
+    for( ; ; rd++){
+        const char c = *rd;
+        if(fQuote){
+            if(unlikely(!c)) return -1;
+            if(c == '\"'){
+                if(rd[1] == '\"'){
+                    *wr++ = '\"';
+                    rd++;
+                }
+                else fQuote = 0;
+                continue;
+            }
+            *wr++ = c;
+            continue;
+        }
+        if(c == '\"'){
+            fQuote = 1;
+            continue;
+        }
+        if(c == delimiter || !c){
+            *wr = '\0'; // wr never overtakes rd, so at most the delimiter is overwritten
+            fields[num_fields++] = field;
+            if(!c) return num_fields;
+            if(num_fields >= fields_max) break;
+            field = ++wr;
+            continue;
+        }
+        *wr++ = c;
+    }
+
+    /* Remaining fields are not needed, just count them */
+    for(rd++; ; rd++){
+        const char c = *rd;
+        if(fQuote){
+            if(unlikely(!c)) return -1;
+            if(c == '\"'){
+                if(rd[1] == '\"') rd++;
+                else fQuote = 0;
+            }
+            continue;
+        }
+        if(c == '\"') fQuote = 1;
+        else if(c == delimiter) num_fields++;
+        else if(!c) return num_fields + 1;
+    }
+}
+
+/**
+ * @brief Validate a vhost (equivalent of regex "^[a-zA-Z0-9:.-]+$")
+ * @return 1 if valid, 0 otherwise.
+ */
+static inline int is_valid_vhost(const char *str){
+    if(unlikely(!*str)) return 0;
+    for( ; *str; str++){
+        const char c = *str;
+        if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || 
+             c == ':' || c == '.' || c == '-')) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Validate a request client address (equivalent of regex "^([0-9a-f:.]+|localhost)$")
+ * @return 1 if valid, 0 otherwise.
+ */
+static inline int is_valid_req_client(const char *str){
+    if(unlikely(!*str)) return 0;
+    if(unlikely(*str == 'l')) return !strcmp(str, "localhost");
+    for( ; *str; str++){
+        const char c = *str;
+        if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || c == ':' || c == '.')) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Validate an SSL cipher suite (equivalent of regex "^[A-Z0-9_-]+$")
+ * @return 1 if valid, 0 otherwise.
+ */
+static inline int is_valid_ssl_cipher_suite(const char *str){
+    if(unlikely(!*str)) return 0;
+    for( ; *str; str++){
+        const char c = *str;
+        if(!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-')) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Keyword matcher, compiled once per query and shared by all the searches of it.
+ */
+struct Keyword_matcher {
+    char *keyword;          /**< Keyword to be searched for (NUL-terminated) */
+    size_t keyword_size;    /**< Size of #keyword, excluding the NUL char */
+    int ignore_case;        /**< Case insensitive search if 1 */
+    int is_literal;         /**< 1 if #keyword contains no regex special characters, so it can be searched for as a plain substring */
+    regex_t regex;          /**< Compiled #keyword, used only if !#is_literal */
+    uint32_t *trigrams;     /**< Trigrams of #keyword, used to test bloom filters. NULL if bloom filters cannot be used. */
+    size_t trigrams_num;    /**< Number of items in #trigrams */
+};
+
+static inline uint8_t bloom_ascii_tolower(const char c){
+    return (c >= 'A' && c <= 'Z') ? (uint8_t) (c | 0x20) : (uint8_t) c;
+}
+
+/**
+ * @brief Hash a trigram, for bloom filters and for counting distinct trigrams
+ * @details A multiplicative hash followed by the finalizer of MurmurHash3, as the bits 
+ * of a multiplicative hash alone are too correlated for more than 2 hashes per trigram.
+ */
+static inline uint64_t bloom_trigram_hash(uint32_t trigram){
+    uint64_t hash = (uint64_t) trigram * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * @brief Set (or test) the bits of a trigram in a bloom filter
+ * @details The bits are derived from two hashes (h1 + i * h2).
+ * @param bloom The bloom filter
+ * @param bloom_bits_mask Number of bits of bloom minus 1, always a power of 2 minus 1
+ * @param hashes Number of bits per trigram
+ * @param trigram 3 (lowercase) chars packed in the lower 24 bits
+ * @param set If 1, set the bits of the trigram. Otherwise, just test them.
+ * @return 1 if all the bits of the trigram are (or have just been) set, 0 otherwise.
+ */
+static inline int bloom_trigram(uint8_t *bloom, uint64_t bloom_bits_mask, unsigned hashes, uint32_t trigram, const int set){
+    const uint64_t hash = bloom_trigram_hash(trigram);
+    const uint64_t h1 = hash & 0xFFFFFFFF;
+    const uint64_t h2 = (hash >> 32) | 1;
+    for(unsigned i = 0; i < hashes; i++){
+        const uint64_t bit = (h1 + i * h2) & bloom_bits_mask;
+        if(set) bloom[bit >> 3] |= (uint8_t) (1 << (bit & 7));
+        else if(!(bloom[bit >> 3] & (1 << (bit & 7)))) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Get the number of bits and hashes of a bloom filter, as built by keyword_bloom_filter_build()
+ * @details Bloom filters are a power of 2 bytes followed by a byte with the number of hashes.
+ * @param[out] hashes Number of hashes of the filter
+ * @return Number of bits of the filter minus 1, or 0 if bloom_size is not valid.
+ */
+static inline uint64_t bloom_filter_layout(const uint8_t *bloom, size_t bloom_size, unsigned *hashes){
+    const size_t bits_size = bloom_size - 1;
+    if(bloom_size < 2 || (bits_size & (bits_size - 1)) || !bloom[bits_size] || bloom[bits_size] > DB_BLOOM_FILTER_MAX_HASHES) return 0;
+    *hashes = bloom[bits_size];
+    return (uint64_t) bits_size * 8 - 1;
+}
+
+/**
+ * @brief Get the size of the trigram bloom filter of a text
+ * @details The filter is sized for a false positive rate of DB_BLOOM_FILTER_FALSE_POSITIVE_RATE
+ * per trigram, i.e. -ln(p) / ln(2)^2 bits per distinct trigram of the text, rounded up to a 
+ * power of 2 bytes, and the optimal number of hashes ((bits / distinct trigrams) * ln(2)) is 
+ * derived from the actual size. The distinct trigrams are estimated with linear counting, 
+ * which is accurate to a few percent well beyond the distinct trigrams that fit in 
+ * DB_BLOOM_FILTER_MAX_SIZE.
+ * @param text Text to build the bloom filter of
+ * @param text_size Size of text (including the terminating NUL char)
+ * @param[out] hashes Number of hashes to build the bloom filter with
+ * @return Size of bloom filter in bytes, a power of 2 between DB_BLOOM_FILTER_MIN_SIZE 
+ * and DB_BLOOM_FILTER_MAX_SIZE, plus 1 byte for the number of hashes.
+ */
+size_t keyword_bloom_filter_size(const char *text, size_t text_size, unsigned *hashes){
+    uint64_t sketch[DB_BLOOM_FILTER_SKETCH_SIZE / sizeof(uint64_t)] = {0};
+    const uint64_t sketch_bits = DB_BLOOM_FILTER_SKETCH_SIZE * 8;
+    uint32_t trigram = 0;
+    int line_chars = 0;
+    uint64_t sketch_bits_set = 0;
+    for(size_t i = 0; i + 1 < text_size; i++){
+        if(unlikely(text[i] == '\n')){
+            line_chars = 0;
+            continue;
+        }
+        trigram = ((trigram << 8) | bloom_ascii_tolower(text[i])) & 0xFFFFFF;
+        if(++line_chars < 3) continue;
+        const uint64_t bit = bloom_trigram_hash(trigram) & (sketch_bits - 1);
+        if(!(sketch[bit >> 6] & (1ULL << (bit & 63)))){
+            sketch[bit >> 6] |= 1ULL << (bit & 63);
+            sketch_bits_set++;
+        }
+    }
+
+    double trigrams_distinct = sketch_bits_set < sketch_bits ? 
+        -(double) sketch_bits * log((double) (sketch_bits - sketch_bits_set) / (double) sketch_bits) : 
+        (double) DB_BLOOM_FILTER_MAX_SIZE * 8;
+    if(trigrams_distinct < 1) trigrams_distinct = 1;
+
+    const double bits_needed = trigrams_distinct * -log(DB_BLOOM_FILTER_FALSE_POSITIVE_RATE) / (M_LN2 * M_LN2);
+    size_t bloom_size = DB_BLOOM_FILTER_MIN_SIZE;
+    while(bloom_size < DB_BLOOM_FILTER_MAX_SIZE && (double) bloom_size * 8 < bits_needed) 
+        bloom_size <<= 1;
+
+    const double hashes_optimal = round((double) bloom_size * 8 / trigrams_distinct * M_LN2);
+    *hashes = hashes_optimal < 1 ? 1 : hashes_optimal > DB_BLOOM_FILTER_MAX_HASHES ? DB_BLOOM_FILTER_MAX_HASHES : (unsigned) hashes_optimal;
+    return bloom_size + 1;
+}
+
+/**
+ * @brief Build the trigram bloom filter of a text
+ * @details All the (case insensitive) trigrams of each line of the text are inserted in 
+ * the bloom filter, so that keyword_matcher_bloom_may_match() can later tell whether 
+ * a literal keyword cannot be contained in the text, without the text itself.
+ * @param text Text to build the bloom filter of
+ * @param text_size Size of text (including the terminating NUL char)
+ * @param[out] bloom Bloom filter to be built
+ * @param bloom_size Size of bloom, as returned by keyword_bloom_filter_size()
+ * @param hashes Number of hashes, as returned by keyword_bloom_filter_size()
+ */
+void keyword_bloom_filter_build(const char *text, size_t text_size, uint8_t *bloom, size_t bloom_size, unsigned hashes){
+    const uint64_t bloom_bits_mask = (uint64_t) (bloom_size - 1) * 8 - 1;
+    memset(bloom, 0, bloom_size - 1);
+    bloom[bloom_size - 1] = (uint8_t) hashes;
+    uint32_t trigram = 0;
+    int line_chars = 0;
+    for(size_t i = 0; i + 1 < text_size; i++){
+        if(unlikely(text[i] == '\n')){
+            line_chars = 0;
+            continue;
+        }
+        trigram = ((trigram << 8) | bloom_ascii_tolower(text[i])) & 0xFFFFFF;
+        if(++line_chars >= 3) bloom_trigram(bloom, bloom_bits_mask, hashes, trigram, 1);
+    }
+}
+
+/**
+ * @brief Check whether a keyword matcher can make use of bloom filters
+ */
+int keyword_matcher_bloom_usable(const Keyword_matcher_t *matcher){
+    return matcher->trigrams_num > 0;
+}
+
+/**
+ * @brief Test whether a text may contain the keyword of a matcher, using its bloom filter
+ * @param matcher The keyword matcher
+ * @param bloom Bloom filter of the text, see keyword_bloom_filter_build()
+ * @param bloom_size Size of bloom. If 0 (e.g. no bloom filter is available), the text may match.
+ * @return 0 if the text definitely does not contain the keyword, 1 if it may contain it.
+ */
+int keyword_matcher_bloom_may_match(const Keyword_matcher_t *matcher, const uint8_t *bloom, size_t bloom_size){
+    unsigned hashes = 0;
+    if(!matcher->trigrams_num || !bloom) return 1;
+    const uint64_t bloom_bits_mask = bloom_filter_layout(bloom, bloom_size, &hashes);
+    if(!bloom_bits_mask) return 1;
+    for(size_t i = 0; i < matcher->trigrams_num; i++){
+        if(!bloom_trigram((uint8_t *) bloom, bloom_bits_mask, hashes, matcher->trigrams[i], 0)) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Create a keyword matcher
+ * @details If the keyword contains no (extended) regex special characters, it will be 
+ * searched for as a literal substring, bypassing the regex engine. Otherwise, it is 
+ * compiled once here. If the compilation fails, the keyword is treated as a literal too.
+ * @param keyword The keyword to be searched for
+ * @param ignore_case Case insensitive search if 1
+ * @return The keyword matcher, to be released with keyword_matcher_destroy()
+ */
+Keyword_matcher_t *keyword_matcher_create(const char *keyword, const int ignore_case){
+    Keyword_matcher_t *matcher = callocz(1, sizeof(Keyword_matcher_t));
+    matcher->keyword = strdupz(keyword);
+    matcher->keyword_size = strlen(keyword);
+    matcher->ignore_case = ignore_case;
+    matcher->is_literal = !strpbrk(keyword, ".[]()*+?{}|^$\\");
+
+    if(!matcher->is_literal){
+        const int regex_flags = ignore_case ? REG_EXTENDED | REG_NEWLINE | REG_ICASE : REG_EXTENDED | REG_NEWLINE;
+        if (regcomp(&matcher->regex, keyword, regex_flags)){
+            fprintf_log(LOGS_MANAG_ERROR, stderr, "Could not compile regular expression: %s - it will be searched for as a literal.\n", keyword);
+            matcher->is_literal = 1;
+        }
+    }
+
+    /* A literal keyword without any letters is case-insensitive by definition, 
+     * so the (faster) case-sensitive substring search can be used instead. */
+    if(matcher->is_literal && matcher->ignore_case){
+        matcher->ignore_case = 0;
+        for(size_t i = 0; i < matcher->keyword_size; i++){
+            if(isalpha((unsigned char) matcher->keyword[i])){
+                matcher->ignore_case = 1;
+                break;
+            }
+        }
+    }
+
+    /* Bloom filters can only be used to reject messages for literal keywords that are
+     * at least 3 chars long (and do not span multiple lines). */
+    if(matcher->is_literal && matcher->keyword_size >= 3 && !memchr(matcher->keyword, '\n', matcher->keyword_size)){
+        matcher->trigrams_num = matcher->keyword_size - 2;
+        matcher->trigrams = mallocz(matcher->trigrams_num * sizeof(uint32_t));
+        for(size_t i = 0; i < matcher->trigrams_num; i++){
+            matcher->trigrams[i] = (uint32_t) bloom_ascii_tolower(matcher->keyword[i]) << 16 | 
+                                   (uint32_t) bloom_ascii_tolower(matcher->keyword[i + 1]) << 8 | 
+                                   (uint32_t) bloom_ascii_tolower(matcher->keyword[i + 2]);
+        }
+    }
+
+    return matcher;
+}
+
+/**
+ * @brief Release a keyword matcher created with keyword_matcher_create()
+ */
+void keyword_matcher_destroy(Keyword_matcher_t *matcher){
+    if(!matcher) return;
+    if(!matcher->is_literal) regfree(&matcher->regex);
+    freez(matcher->trigrams);
+    freez(matcher->keyword);
+    freez(matcher);
+}
+
+/**
+ * @brief Find the next match of a keyword matcher
+ * @param matcher The keyword matcher
+ * @param cursor NUL-terminated text to be searched
+ * @param cursor_end Pointer to the terminating NUL char of cursor
+ * @return Pointer to (somewhere within) the first line matching, or NULL if there are no more matches.
+ */
+static inline char *keyword_matcher_next(const Keyword_matcher_t *matcher, char *cursor, char *cursor_end){
+    if(matcher->is_literal){
+        if(!matcher->ignore_case) return memmem(cursor, cursor_end - cursor, matcher->keyword, matcher->keyword_size);
+        return strcasestr(cursor, matcher->keyword);
+    }
+
+    regmatch_t groupArray[1];
+    if (regexec(&matcher->regex, cursor, 1, groupArray, 0) || groupArray[0].rm_so == (regoff_t)-1) return NULL;
+    return cursor + groupArray[0].rm_so;
+}
+
 /**
  * @brief Search a buffer for a keyword
- * @details Search the source buffer for a keyword and copy matches to the destination buffer
- * @param src The source buffer to be searched
- * @param dest The destination buffer where the results will be written in
- * @param keyword The keyword to be searched for in the source buffer
- * @param ignore_case Case insensitive search if 1, it does not matter if keyword characters 
- * are upper or lower case. 
- * @return Size of results
- * @todo Sanitise keyword (escape regex special characters)
+ * @details Search the source buffer for a keyword and copy the lines matching to the 
+ * destination buffer, each one terminated by a newline char. Each match is expanded 
+ * to the boundaries of its line and the search is resumed from the next line.
+ * @param src The NUL-terminated source buffer to be searched
+ * @param src_size Size of src, including the terminating NUL char
+ * @param dest The destination buffer where the results will be written in. It must be 
+ * at least src_size + 1 bytes long.
+ * @param matcher The keyword matcher, see keyword_matcher_create()
+ * @return Size of results, including the terminating NUL char (or 0 if there are no results)
  */
-size_t search_keyword(char *src, char *dest, const char *keyword, const int ignore_case){
-	char regexString[REGEX_SIZE];
-	snprintf(regexString, REGEX_SIZE, ".*(%s).*", keyword);
-
-	regex_t regex_compiled;
-	regmatch_t groupArray[1];
-	int regex_flags = ignore_case ? REG_EXTENDED | REG_NEWLINE | REG_ICASE : REG_EXTENDED | REG_NEWLINE;
-
-	if (regcomp(&regex_compiled, regexString, regex_flags)){
-		fprintf_log(LOGS_MANAG_ERROR, stderr, "Could not compile regular expression.\n");
-		fatal("Could not compile regular expression.\n");
-	};
-
-    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Searching for keyword:%s in source:\n%s\n=====***********=====\n", keyword, src);
-
-	size_t dest_off = 0;
-	char *cursor = src;
-	for (int m = 0; ; m++){
-		if (regexec(&regex_compiled, cursor, 1, groupArray, 0)) break;  // No more matches
-
-		unsigned int offset = 0;
-		if (groupArray[0].rm_so == (size_t)-1) break;  // No more groups
-
-		offset = groupArray[0].rm_eo;
-
-		fprintf_log(LOGS_MANAG_DEBUG, stderr, "Match %u: [%2u-%2u]: %.*s\n",
-			m, groupArray[0].rm_so, groupArray[0].rm_eo, groupArray[0].rm_eo - groupArray[0].rm_so,
-			cursor + groupArray[0].rm_so);
-		memcpy(&dest[dest_off], cursor + groupArray[0].rm_so, groupArray[0].rm_eo - groupArray[0].rm_so);
-		dest_off += groupArray[0].rm_eo - groupArray[0].rm_so;
-		dest[dest_off++] = '\n';
-		cursor += offset;
-	}
+size_t search_keyword(char *src, size_t src_size, char *dest, const Keyword_matcher_t *matcher){
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Searching for keyword:%s in source:\n%s\n=====***********=====\n", matcher->keyword, src);
+
+    size_t dest_off = 0;
+    char *cursor = src;
+    char *const src_end = src + src_size - 1; // Terminating NUL char
+    while (cursor < src_end){
+        char *match = keyword_matcher_next(matcher, cursor, src_end);
+        if(!match) break;  // No more matches
+
+        char *line_start = match;
+        while(line_start > cursor && *(line_start - 1) != '\n') line_start--;
+        char *line_end = memchr(match, '\n', src_end - match);
+        if(!line_end) line_end = src_end;
+
+        memcpy(&dest[dest_off], line_start, line_end - line_start);
+        dest_off += line_end - line_start;
+        dest[dest_off++] = '\n';
+        cursor = line_end + 1;
+    }
 
     if(dest_off) dest[dest_off++] = '\0';
 
-	regfree(&regex_compiled);
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Results of search\n%.*s\n=====***********=====\n", (int) dest_off, dest);
+
+    return dest_off;
+}
+
+/**
+ * @brief Keep only some of the lines of a buffer
+ * @details The lines of text that match the keyword matcher (if any) or that are sampled 
+ * (if sample_interval is set) are moved, in place and in their original order, to the 
+ * beginning of text. The n-th line of text (counting from 0) is sampled if 
+ * (first_line_no + n) is a multiple of sample_interval.
+ * @param[in,out] text The NUL-terminated text to be filtered
+ * @param[in] text_size Size of text, including the terminating NUL char
+ * @param[in] matcher Keyword matcher of the lines to keep, or NULL to keep sampled lines only
+ * @param[in] sample_interval Keep 1 in every sample_interval lines, or 0 to keep matching lines only
+ * @param[in] first_line_no Number of the first line of text, used for sampling
+ * @return Size of the kept text, including the terminating NUL char (or 0 if no lines were kept)
+ */
+size_t filter_lines(char *text, size_t text_size, const Keyword_matcher_t *matcher, 
+                    const int sample_interval, const uint64_t first_line_no){
+    if(!text_size) return 0;
+
+    size_t dest_off = 0;
+    uint64_t line_no = first_line_no;
+    char *line_start = text;
+    char *const text_end = text + text_size - 1; // Terminating NUL char
+    char *match = matcher ? keyword_matcher_next(matcher, text, text_end) : NULL;
+    while(line_start < text_end){
+        char *line_end = memchr(line_start, '\n', text_end - line_start);
+        line_end = line_end ? line_end + 1 : text_end;
+
+        int keep = sample_interval && !(line_no++ % (uint64_t) sample_interval);
+        if(match && match < line_end){
+            keep = 1;
+            /* Search for the next match before this line is moved, as only text 
+             * before line_end can be overwritten. */
+            match = line_end < text_end ? keyword_matcher_next(matcher, line_end, text_end) : NULL;
+        }
 
-	fprintf_log(LOGS_MANAG_DEBUG, stderr, "Results of search\n%.*s\n=====***********=====\n", dest_off, dest);
+        if(keep){
+            const size_t line_len = (size_t) (line_end - line_start);
+            if(text + dest_off != line_start) memmove(text + dest_off, line_start, line_len);
+            dest_off += line_len;
+        }
+        line_start = line_end;
+    }
 
+    if(dest_off) text[dest_off++] = '\0';
     return dest_off;
 }
 
@@ -386,14 +776,6 @@ Log_parser_config_t *read_parse_config(char *log_format, const char delimiter){
     int num_fields = count_fields(log_format, delimiter);
     if(num_fields <= 0) return NULL;
 
-    /* If first execution of this function, initialise regexs */
-    // TODO: Tests needed for following regexs.
-    if(!regexs_initialised){
-        assert(regcomp(&vhost_regex, "^[a-zA-Z0-9:.-]+$", REG_NOSUB | REG_EXTENDED) == 0);
-        assert(regcomp(&req_client_regex, "^([0-9a-f:.]+|localhost)$", REG_NOSUB | REG_EXTENDED) == 0);
-        assert(regcomp(&cipher_suite_regex, "^[A-Z0-9_-]+$", REG_NOSUB | REG_EXTENDED) == 0);
-    }
-
     Log_parser_config_t *parser_config = callocz(1, sizeof(Log_parser_config_t));
     parser_config->num_fields = num_fields;
     parser_config->delimiter = delimiter;
@@ -537,10 +919,75 @@ Log_parser_config_t *read_parse_config(char *log_format, const char delimiter){
 	}
 
     for(int i = 0; parsed_format[i] != NULL; i++) freez(parsed_format[i]);
+    freez(parsed_format);
+    compile_parse_plan(parser_config, 1);
     return parser_config;
 }
 
-static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log_parser_buffs_t *parser_buffs, const char *line, const int verify){
+/**
+ * @brief Get the charts that depend on a field of the log format
+ * @param[in] field Type of field
+ * @return Bitmask of chart_type_t of the charts that need the field to be extracted.
+ */
+static inline unsigned long int field_chart_deps(const log_line_field_t field){
+    switch(field){
+        case VHOST_WITH_PORT:   return CHART_VHOST | CHART_PORT;
+        case VHOST:             return CHART_VHOST;
+        case PORT:              return CHART_PORT;
+        case REQ_CLIENT:        return CHART_IP_VERSION | CHART_REQ_CLIENT_CURRENT | CHART_REQ_CLIENT_ALL_TIME;
+        case REQ:               return CHART_REQ_METHODS | CHART_REQ_PROTO;
+        case REQ_METHOD:        return CHART_REQ_METHODS;
+        case REQ_PROTO:         return CHART_REQ_PROTO;
+        case REQ_SIZE:          
+        case RESP_SIZE:         return CHART_BANDWIDTH;
+        case REQ_PROC_TIME:     return CHART_REQ_PROC_TIME;
+        case UPS_RESP_TIME:     return CHART_UPS_RESP_TIME;
+        case RESP_CODE:         return CHART_RESP_CODE_FAMILY | CHART_RESP_CODE | CHART_RESP_CODE_TYPE;
+        case SSL_PROTO:         return CHART_SSL_PROTO;
+        case SSL_CIPHER_SUITE:  return CHART_SSL_CIPHER;
+        /* REQ_SCHEME, REQ_URL, TIME and CUSTOM fields are not used by any chart */
+        default:                return 0;
+    }
+}
+
+/**
+ * @brief Compile the parse plan of a log format
+ * @details The parse plan is the list of the fields of the log format that parse_log_line() 
+ * will extract, in order. Fields that are not needed by any of the charts enabled in 
+ * parser_config->chart_config are left out, as are any fields after the last needed one, 
+ * which are then only counted rather than split. Must be called again whenever 
+ * parser_config->chart_config changes.
+ * @param[in,out] parser_config Configuration of the log format to compile the plan of.
+ * @param[in] all_fields If set, all the fields will be extracted regardless of chart_config
+ * (e.g. to detect the log format, which depends on the parsing errors of all the fields).
+ */
+void compile_parse_plan(Log_parser_config_t *parser_config, const int all_fields){
+    parser_config->plan = reallocz(parser_config->plan, parser_config->num_fields * sizeof(int));
+    parser_config->plan_size = 0;
+    parser_config->plan_fields_max = 0;
+
+    for(int i = 0; i < parser_config->num_fields; i++){
+        const log_line_field_t field = parser_config->fields[i];
+        if(all_fields || (field_chart_deps(field) & parser_config->chart_config)){
+            parser_config->plan[parser_config->plan_size++] = i;
+            parser_config->plan_fields_max = field == TIME ? i + 2 : i + 1;
+        }
+        if(field == TIME) i++; // TIME takes 2 fields, both of them extracted together
+    }
+    if(parser_config->plan_fields_max > parser_config->num_fields) parser_config->plan_fields_max = parser_config->num_fields;
+}
+
+/**
+ * @brief Parse a log line
+ * @details The line is split into fields in place (see tokenize_line()), so no memory 
+ * is allocated per line. 
+ * @param[in] parser_config Configuration of the log format.
+ * @param[in,out] parser_buffs Buffers of the parser, the results are stored in parser_buffs->log_line_parsed.
+ * @param[in,out] line Line to parse, it is modified in place.
+ * @param[in] verify If set, the values of the fields will be validated.
+ * @return Pointer to the results, or NULL if the line does not match the number of fields of the log format.
+ */
+static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log_parser_buffs_t *parser_buffs, char *line, const int verify){
     log_line_field_t *fields_format = parser_config->fields;
     const int num_fields_config = parser_config->num_fields;
     const char delimiter = parser_config->delimiter;
@@ -550,17 +997,23 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
 #if ENABLE_PARSE_LOG_LINE_FPRINTS
     fprintf(stderr, "Original line:%s\n", line);
 #endif
-    int num_fields_line = count_fields(line, delimiter);
-    char **parsed = parse_csv(line, delimiter, num_fields_line);
+    const int *plan = parser_config->plan;
+    const int plan_size = parser_config->plan_size;
+
+    if(unlikely(parser_buffs->fields_max < num_fields_config)){
+        parser_buffs->fields_max = num_fields_config;
+        parser_buffs->fields = reallocz(parser_buffs->fields, num_fields_config * sizeof(char *));
+    }
+    char **parsed = parser_buffs->fields;
+    int num_fields_line = tokenize_line(line, delimiter, parsed, parser_config->plan_fields_max);
 #if ENABLE_PARSE_LOG_LINE_FPRINTS
     fprintf(stderr, "Number of items in line: %d and expected from config: %d\n", num_fields_line, num_fields_config);
 #endif
     // assert(num_fields_config == num_fields_line); // TODO: REMOVE FROM PRODUCTION - Handle error instead?
-    if(num_fields_config != num_fields_line){ 
-        free_csv_line(parsed);
-        return NULL;
-    }
-    for(int i = 0; i < num_fields_config; i++ ){
+    if(num_fields_config != num_fields_line) return NULL;
+    for(int p = 0; p < plan_size; p++){
+        int i = plan[p];
+
         #if ENABLE_PARSE_LOG_LINE_FPRINTS
         fprintf(stderr, "===\nField %d:%s\n", i, parsed[i]);
         #endif
@@ -614,16 +1067,14 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
                 memmove(parsed[i], parsed[i]+1, strlen(parsed[i]));
             }
             if(verify){
-                int rc = regexec(&vhost_regex, parsed[i], 0, NULL, 0);
-                if(likely(!rc)) snprintf(log_line_parsed->vhost, VHOST_MAX_LEN, "%s", parsed[i]);
-                else if (rc == REG_NOMATCH) {
+                if(likely(is_valid_vhost(parsed[i]))) snprintf(log_line_parsed->vhost, VHOST_MAX_LEN, "%s", parsed[i]);
+                else {
                     #if ENABLE_PARSE_LOG_LINE_FPRINTS
                     fprintf(stderr, "VHOST is invalid\n");
                     #endif
                     log_line_parsed->vhost[0] = '\0';
                     log_line_parsed->parsing_errors++;
                 }
-                else assert(0); 
             }
             else snprintf(log_line_parsed->vhost, VHOST_MAX_LEN, "%s", parsed[i]);
             #if ENABLE_PARSE_LOG_LINE_FPRINTS
@@ -713,16 +1164,14 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
             }
 
             if(verify){
-                int rc = regexec(&req_client_regex, parsed[i], 0, NULL, 0);
-                if(likely(!rc)) snprintf(log_line_parsed->req_client, REQ_CLIENT_MAX_LEN, "%s", parsed[i]);
-                else if (rc == REG_NOMATCH) {
+                if(likely(is_valid_req_client(parsed[i]))) snprintf(log_line_parsed->req_client, REQ_CLIENT_MAX_LEN, "%s", parsed[i]);
+                else {
                     #if ENABLE_PARSE_LOG_LINE_FPRINTS
                     fprintf(stderr, "REQ_CLIENT is invalid\n");
                     #endif
                     snprintf(log_line_parsed->req_client, REQ_CLIENT_MAX_LEN, "%s", INVALID_CLIENT_IP_STR);
                     log_line_parsed->parsing_errors++;
                 }
-                else assert(0); // Can also use: regerror(rc, &req_client_regex, msgbuf, sizeof(msgbuf));
             }
             else snprintf(log_line_parsed->req_client, REQ_CLIENT_MAX_LEN, "%s", parsed[i]);
             #if ENABLE_PARSE_LOG_LINE_FPRINTS
@@ -817,8 +1266,8 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
         }
 
         if(fields_format[i] == REQ || fields_format[i] == REQ_URL){
-            if(fields_format[i] == REQ) log_line_parsed->req_URL = req_first_sep ? strdupz(req_first_sep + 1) : NULL;
-            else log_line_parsed->req_URL = strdupz(parsed[i]);
+            if(fields_format[i] == REQ) log_line_parsed->req_URL = req_first_sep ? req_first_sep + 1 : NULL;
+            else log_line_parsed->req_URL = parsed[i];
             #if ENABLE_PARSE_LOG_LINE_FPRINTS
             fprintf(stderr, "Item %d (type: REQ_URL):%s\n", i, log_line_parsed->req_URL ? log_line_parsed->req_URL : "NULL!");   
             //if(verify){} ??
@@ -1103,16 +1552,14 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
             }
 
             if(verify){
-                int rc = regexec(&cipher_suite_regex, parsed[i], 0, NULL, 0);
-                if(likely(!rc)) snprintf(log_line_parsed->ssl_cipher, SSL_CIPHER_SUITE_MAX_LEN, "%s", parsed[i]); 
-                else if (rc == REG_NOMATCH) {
+                if(likely(is_valid_ssl_cipher_suite(parsed[i]))) snprintf(log_line_parsed->ssl_cipher, SSL_CIPHER_SUITE_MAX_LEN, "%s", parsed[i]); 
+                else {
                     #if ENABLE_PARSE_LOG_LINE_FPRINTS
                     fprintf(stderr, "SSL_CIPHER_SUITE is invalid\n");
                     #endif
                     log_line_parsed->ssl_cipher[0] = '\0';
                     log_line_parsed->parsing_errors++;
                 }
-                else assert(0); // Can also use: regerror(rc, &cipher_suite_regex, msgbuf, sizeof(msgbuf));
             }
             else snprintf(log_line_parsed->ssl_cipher, SSL_CIPHER_SUITE_MAX_LEN, "%s", parsed[i]); 
             #if ENABLE_PARSE_LOG_LINE_FPRINTS
@@ -1136,15 +1583,27 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
 
             char *pch = strchr(parsed[i], '[');
             if(pch) memmove(parsed[i], parsed[i]+1, strlen(parsed[i])); //%d/%b/%Y:%H:%M:%S %z
-            struct tm ltm = {0};
-            if(strptime(parsed[i], "%d/%b/%Y:%H:%M:%S", &ltm) == NULL){
-                #if ENABLE_PARSE_LOG_LINE_FPRINTS
-                fprintf(stderr, "TIME field parsing failed\n");
-                #endif
-                log_line_parsed->timestamp = 0;
-                log_line_parsed->parsing_errors++;
-                ++i;
-                continue;
+
+            /* strptime() and mktime() are expensive, but consecutive lines usually share 
+             * the same time, so the result of the previous conversion is reused if possible. */
+            int64_t local_time;
+            if(!strcmp(parsed[i], parser_buffs->time_cache_str)) local_time = parser_buffs->time_cache;
+            else {
+                struct tm ltm = {0};
+                if(strptime(parsed[i], "%d/%b/%Y:%H:%M:%S", &ltm) == NULL){
+                    #if ENABLE_PARSE_LOG_LINE_FPRINTS
+                    fprintf(stderr, "TIME field parsing failed\n");
+                    #endif
+                    log_line_parsed->timestamp = 0;
+                    log_line_parsed->parsing_errors++;
+                    ++i;
+                    continue;
+                }
+                local_time = (int64_t) mktime(&ltm);
+                if(strlen(parsed[i]) < sizeof(parser_buffs->time_cache_str)){
+                    strcpy(parser_buffs->time_cache_str, parsed[i]);
+                    parser_buffs->time_cache = local_time;
+                }
             }
 
             // char month[20];
@@ -1165,7 +1624,7 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
             fprintf(stderr, "Timezone: int:%ld, hrs:%ld, mins:%ld\n", timezone, timezone_h, timezone_m);
             #endif
 
-            log_line_parsed->timestamp = (int64_t) mktime(&ltm) + (int64_t) timezone_h * 3600 + (int64_t) timezone_m * 60;
+            log_line_parsed->timestamp = local_time + (int64_t) timezone_h * 3600 + (int64_t) timezone_m * 60;
             #if ENABLE_PARSE_LOG_LINE_FPRINTS
             fprintf(stderr, "Extracted TIME:%lu\n", log_line_parsed->timestamp);
             #endif
@@ -1176,10 +1635,583 @@ static Log_line_parsed_t *parse_log_line(Log_parser_config_t *parser_config, Log
 
     }
 
-    free_csv_line(parsed);
     return log_line_parsed;
 }
 
+/**
+ * @brief Hash a key of the parser metrics (32-bit FNV-1a)
+ * @param[in] key Key to hash
+ * @param[in] len Length of key in bytes
+ * @return Hash of key
+ */
+static inline uint32_t metrics_hash(const void *key, size_t len){
+    const unsigned char *p = (const unsigned char *) key;
+    uint32_t hash = 2166136261U;
+    while(len--){
+        hash ^= *p++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * @brief Ensure a metrics hash index has room for one more item
+ * @details The index is doubled in size (and rehashed) whenever it would become 
+ * more than 3/4 full, so that probe sequences stay short.
+ * @param[in,out] index Hash index to grow, if needed
+ * @param[in] items Number of items currently in the index
+ */
+static void metrics_index_reserve(struct log_parser_metrics_index *index, const int items){
+    const uint32_t slots = index->slots ? index->slots_mask + 1 : 0;
+    if(likely((uint64_t) (items + 1) * 4 <= (uint64_t) slots * 3)) return;
+
+    const uint32_t new_slots = slots ? slots * 2 : LOG_PARSER_METRICS_INDEX_MIN_SLOTS;
+    const uint32_t new_mask = new_slots - 1;
+    uint64_t *new_index_slots = callocz(new_slots, sizeof(uint64_t));
+    for(uint32_t i = 0; i < slots; i++){
+        if(!index->slots[i]) continue;
+        uint32_t s = (uint32_t) (index->slots[i] >> 32) & new_mask;
+        while(new_index_slots[s]) s = (s + 1) & new_mask;
+        new_index_slots[s] = index->slots[i];
+    }
+    freez(index->slots);
+    index->slots = new_index_slots;
+    index->slots_mask = new_mask;
+}
+
+/**
+ * @brief Find a vhost in a vhosts array, adding it if not found
+ * @param[in,out] vhost_arr Array of vhosts to search (and add to)
+ * @param[in] name Name of the vhost. Only the first VHOST_MAX_LEN - 1 characters are significant.
+ * @return Index of the vhost in vhost_arr->vhosts. A newly added vhost has a count of 0.
+ */
+int parser_metrics_vhost_get(struct log_parser_metrics_vhosts_array *vhost_arr, const char *name){
+    const size_t name_len = strnlen(name, VHOST_MAX_LEN - 1);
+    const uint32_t hash = metrics_hash(name, name_len);
+
+    metrics_index_reserve(&vhost_arr->index, vhost_arr->size);
+    const uint32_t mask = vhost_arr->index.slots_mask;
+    uint32_t s;
+    for(s = hash & mask; vhost_arr->index.slots[s]; s = (s + 1) & mask){
+        const uint64_t slot = vhost_arr->index.slots[s];
+        const int i = (int) (uint32_t) slot - 1;
+        if((uint32_t) (slot >> 32) == hash && !strncmp(vhost_arr->vhosts[i].name, name, name_len) 
+            && !vhost_arr->vhosts[i].name[name_len]) return i;
+    }
+
+    /* Vhost not found in array - need to append */
+    if(vhost_arr->size == vhost_arr->size_max){
+        vhost_arr->size_max = vhost_arr->size * LOG_PARSER_METRICS_VHOST_BUFFS_SCALE_FACTOR + 1;
+        vhost_arr->vhosts = reallocz(vhost_arr->vhosts, vhost_arr->size_max * sizeof(struct log_parser_metrics_vhost));
+    }
+    memcpy(vhost_arr->vhosts[vhost_arr->size].name, name, name_len);
+    vhost_arr->vhosts[vhost_arr->size].name[name_len] = '\0';
+    vhost_arr->vhosts[vhost_arr->size].count = 0;
+    vhost_arr->index.slots[s] = (uint64_t) hash << 32 | (uint32_t) (vhost_arr->size + 1);
+    return vhost_arr->size++;
+}
+
+/**
+ * @brief Find a port in a ports array, adding it if not found
+ * @param[in,out] port_arr Array of ports to search (and add to)
+ * @param[in] port Number of the port
+ * @return Index of the port in port_arr->ports. A newly added port has a count of 0.
+ */
+int parser_metrics_port_get(struct log_parser_metrics_ports_array *port_arr, const int port){
+    const uint32_t hash = metrics_hash(&port, sizeof(port));
+
+    metrics_index_reserve(&port_arr->index, port_arr->size);
+    const uint32_t mask = port_arr->index.slots_mask;
+    uint32_t s;
+    for(s = hash & mask; port_arr->index.slots[s]; s = (s + 1) & mask){
+        const uint64_t slot = port_arr->index.slots[s];
+        const int i = (int) (uint32_t) slot - 1;
+        if((uint32_t) (slot >> 32) == hash && port_arr->ports[i].port == port) return i;
+    }
+
+    /* Port not found in array - need to append */
+    if(port_arr->size == port_arr->size_max){
+        port_arr->size_max = port_arr->size * LOG_PARSER_METRICS_PORT_BUFFS_SCALE_FACTOR + 1;
+        port_arr->ports = reallocz(port_arr->ports, port_arr->size_max * sizeof(struct log_parser_metrics_port));
+    }
+    port_arr->ports[port_arr->size].port = port;
+    port_arr->ports[port_arr->size].count = 0;
+    port_arr->index.slots[s] = (uint64_t) hash << 32 | (uint32_t) (port_arr->size + 1);
+    return port_arr->size++;
+}
+
+/**
+ * @brief Find an SSL cipher suite in an SSL ciphers array, adding it if not found
+ * @param[in,out] ssl_cipher_arr Array of SSL ciphers to search (and add to)
+ * @param[in] string SSL cipher suite. Only the first SSL_CIPHER_SUITE_MAX_LEN - 1 characters are significant.
+ * @return Index of the SSL cipher in ssl_cipher_arr->ssl_ciphers. A newly added one has a count of 0.
+ */
+int parser_metrics_ssl_cipher_get(struct log_parser_metrics_ssl_cipher_array *ssl_cipher_arr, const char *string){
+    const size_t string_len = strnlen(string, SSL_CIPHER_SUITE_MAX_LEN - 1);
+    const uint32_t hash = metrics_hash(string, string_len);
+
+    metrics_index_reserve(&ssl_cipher_arr->index, ssl_cipher_arr->size);
+    const uint32_t mask = ssl_cipher_arr->index.slots_mask;
+    uint32_t s;
+    for(s = hash & mask; ssl_cipher_arr->index.slots[s]; s = (s + 1) & mask){
+        const uint64_t slot = ssl_cipher_arr->index.slots[s];
+        const int i = (int) (uint32_t) slot - 1;
+        if((uint32_t) (slot >> 32) == hash && !strncmp(ssl_cipher_arr->ssl_ciphers[i].string, string, string_len) 
+            && !ssl_cipher_arr->ssl_ciphers[i].string[string_len]) return i;
+    }
+
+    /* SSL cipher suite not found in array - need to append */
+    if(ssl_cipher_arr->size == ssl_cipher_arr->size_max){
+        ssl_cipher_arr->size_max = ssl_cipher_arr->size * LOG_PARSER_METRICS_SLL_CIPHER_BUFFS_SCALE_FACTOR + 1;
+        ssl_cipher_arr->ssl_ciphers = reallocz(ssl_cipher_arr->ssl_ciphers, 
+                                               ssl_cipher_arr->size_max * sizeof(struct log_parser_metrics_ssl_cipher));
+    }
+    memcpy(ssl_cipher_arr->ssl_ciphers[ssl_cipher_arr->size].string, string, string_len);
+    ssl_cipher_arr->ssl_ciphers[ssl_cipher_arr->size].string[string_len] = '\0';
+    ssl_cipher_arr->ssl_ciphers[ssl_cipher_arr->size].count = 0;
+    ssl_cipher_arr->index.slots[s] = (uint64_t) hash << 32 | (uint32_t) (ssl_cipher_arr->size + 1);
+    return ssl_cipher_arr->size++;
+}
+
+/**
+ * @brief Hash a binary client IP for HyperLogLog (64-bit finalizer of MurmurHash3)
+ * @param[in] key Binary client IP (or half of it, in the case of IPv6)
+ * @return 64-bit hash of key
+ */
+static inline uint64_t req_client_hash64(uint64_t key){
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/**
+ * @brief Hash a binary client IPv6 address for HyperLogLog
+ * @param[in] addr Binary client IPv6 address
+ * @return 64-bit hash of addr
+ */
+static inline uint64_t req_client_ipv6_hash64(const struct in6_addr *addr){
+    uint64_t hi, lo;
+    memcpy(&hi, addr->s6_addr, sizeof(hi));
+    memcpy(&lo, addr->s6_addr + sizeof(hi), sizeof(lo));
+    return req_client_hash64(hi ^ req_client_hash64(lo));
+}
+
+/**
+ * @brief Add a hash to HyperLogLog registers
+ * @param[in,out] registers HyperLogLog registers (1 << precision of them)
+ * @param[in] precision Number of bits of hash used to select a register
+ * @param[in] hash 64-bit hash of the item to add
+ * @return 1 if a register was updated, 0 otherwise.
+ */
+static inline int hll_add(uint8_t *registers, const int precision, const uint64_t hash){
+    const uint64_t idx = hash >> (64 - precision);
+    const uint64_t w = hash << precision;
+    const uint8_t rank = w ? (uint8_t) (__builtin_clzll(w) + 1) : (uint8_t) (64 - precision + 1);
+    if(rank <= registers[idx]) return 0;
+    registers[idx] = rank;
+    return 1;
+}
+
+/**
+ * @brief Estimate the cardinality of HyperLogLog registers
+ * @details Raw HyperLogLog estimate, with linear counting for small cardinalities.
+ * @param[in] registers HyperLogLog registers (1 << precision of them)
+ * @param[in] precision Number of bits of hash used to select a register
+ * @return Estimated number of distinct items added to registers.
+ */
+static int hll_estimate(const uint8_t *registers, const int precision){
+    const uint32_t m = 1U << precision;
+    double sum = 0.0;
+    uint32_t zeros = 0;
+    for(uint32_t i = 0; i < m; i++){
+        sum += 1.0 / (double) (1ULL << registers[i]);
+        if(!registers[i]) zeros++;
+    }
+
+    double alpha;
+    switch(m){
+        case 16: alpha = 0.673; break;
+        case 32: alpha = 0.697; break;
+        case 64: alpha = 0.709; break;
+        default: alpha = 0.7213 / (1.0 + 1.079 / (double) m);
+    }
+    double estimate = alpha * (double) m * (double) m / sum;
+    if(estimate <= 2.5 * (double) m && zeros) estimate = (double) m * log((double) m / (double) zeros);
+    return (int) (estimate + 0.5);
+}
+
+/**
+ * @brief Switch hash sets of client IPs to HyperLogLog registers
+ * @details All the client IPs of the hash sets are added to the (zeroed) registers 
+ * and the hash sets are freed. The registers are kept when req_clients_arr is reset, 
+ * to be reused if it needs to switch to HyperLogLog again.
+ * @param[in,out] req_clients_arr Hash sets of client IPs, with a non-zero hll_precision.
+ */
+static void req_clients_hll_activate(struct log_parser_metrics_req_clients_array *req_clients_arr){
+    const int precision = req_clients_arr->hll_precision;
+    const size_t m = (size_t) 1 << precision;
+    if(!req_clients_arr->hll) req_clients_arr->hll = callocz(2, m);
+
+    for(int i = 0; i < req_clients_arr->ipv4_size_max; i++){
+        if(req_clients_arr->ipv4_req_clients[i]) 
+            hll_add(req_clients_arr->hll, precision, req_client_hash64(req_clients_arr->ipv4_req_clients[i]));
+    }
+    for(int i = 0; i < req_clients_arr->ipv6_size_max; i++){
+        if(!IN6_IS_ADDR_UNSPECIFIED(&req_clients_arr->ipv6_req_clients[i])) 
+            hll_add(&req_clients_arr->hll[m], precision, req_client_ipv6_hash64(&req_clients_arr->ipv6_req_clients[i]));
+    }
+
+    freez(req_clients_arr->ipv4_req_clients);
+    freez(req_clients_arr->ipv6_req_clients);
+    req_clients_arr->ipv4_req_clients = NULL;
+    req_clients_arr->ipv6_req_clients = NULL;
+    req_clients_arr->ipv4_size = req_clients_arr->ipv4_size_max = 0;
+    req_clients_arr->ipv6_size = req_clients_arr->ipv6_size_max = 0;
+    req_clients_arr->hll_active = 1;
+}
+
+/**
+ * @brief Grow a hash set of client IPs, if one more item would make it more than 3/4 full
+ * @details In HyperLogLog mode, the hash sets are switched to HyperLogLog registers instead, 
+ * once growing them would need more memory than the registers.
+ * @param[in,out] req_clients_arr Hash sets of client IPs, used to enforce req_clients_arr->mem_max
+ * @param[in,out] set Pointer to the IPv4 or IPv6 hash set of req_clients_arr
+ * @param[in] item_size Size of an item of set
+ * @param[in] size Number of items in set
+ * @param[in,out] size_max Number of slots of set
+ * @return 0 if there is room for one more item, 1 if req_clients_arr switched to 
+ * HyperLogLog registers, -1 if growing would exceed req_clients_arr->mem_max.
+ */
+static int req_clients_set_reserve(struct log_parser_metrics_req_clients_array *req_clients_arr, void **set, 
+                                   const size_t item_size, const int size, int *size_max){
+    if(likely((int64_t) (size + 1) * 4 <= (int64_t) *size_max * 3)) return 0;
+
+    const int new_size_max = *size_max ? *size_max * 2 : LOG_PARSER_METRICS_INDEX_MIN_SLOTS;
+    const size_t mem = (size_t) req_clients_arr->ipv4_size_max * sizeof(uint32_t) 
+                     + (size_t) req_clients_arr->ipv6_size_max * sizeof(struct in6_addr) 
+                     + (size_t) (new_size_max - *size_max) * item_size;
+    if(req_clients_arr->hll_precision && mem > ((size_t) 2 << req_clients_arr->hll_precision)){
+        req_clients_hll_activate(req_clients_arr);
+        return 1;
+    }
+    if(req_clients_arr->mem_max && mem > req_clients_arr->mem_max){
+        if(!req_clients_arr->mem_max_reached) 
+            fprintf_log(LOGS_MANAG_WARNING, stderr, "Memory cap of unique client IPs reached (%zu bytes), new clients will not be tracked\n", 
+                        req_clients_arr->mem_max);
+        req_clients_arr->mem_max_reached = 1;
+        return -1;
+    }
+
+    const int new_mask = new_size_max - 1;
+    char *new_set = callocz((size_t) new_size_max, item_size);
+    static const char empty[sizeof(struct in6_addr)] = {0};
+    for(int i = 0; i < *size_max; i++){
+        const char *item = (const char *) *set + (size_t) i * item_size;
+        if(!memcmp(item, empty, item_size)) continue;
+        const uint32_t hash = item_size == sizeof(uint32_t) ? 
+            (*(const uint32_t *) item * 0x9E3779B1U) : metrics_hash(item, item_size);
+        int s = (int) (hash ^ (hash >> 16)) & new_mask;
+        while(memcmp(new_set + (size_t) s * item_size, empty, item_size)) s = (s + 1) & new_mask;
+        memcpy(new_set + (size_t) s * item_size, item, item_size);
+    }
+    freez(*set);
+    *set = new_set;
+    *size_max = new_size_max;
+    return 0;
+}
+
+/**
+ * @brief Add a client IPv4 address to a hash set of unique client IPs
+ * @param[in,out] req_clients_arr Hash sets (or HyperLogLog registers) of unique client IPs
+ * @param[in] addr Binary IPv4 address. 0.0.0.0 is not tracked, as it marks empty slots.
+ * @return 1 if addr was added (or updated a HyperLogLog register), 0 if it was already 
+ * in the set or could not be added.
+ */
+int parser_metrics_req_client_ipv4_add(struct log_parser_metrics_req_clients_array *req_clients_arr, const uint32_t addr){
+    if(unlikely(!addr)) return 0;
+
+    if(!req_clients_arr->hll_active){
+        const int rc = req_clients_set_reserve(req_clients_arr, (void **) &req_clients_arr->ipv4_req_clients, sizeof(uint32_t), 
+                                               req_clients_arr->ipv4_size, &req_clients_arr->ipv4_size_max);
+        if(unlikely(rc < 0)) return 0;
+        if(likely(!rc)){
+            const uint32_t hash = addr * 0x9E3779B1U;
+            const int mask = req_clients_arr->ipv4_size_max - 1;
+            for(int s = (int) (hash ^ (hash >> 16)) & mask; ; s = (s + 1) & mask){
+                if(!req_clients_arr->ipv4_req_clients[s]){
+                    req_clients_arr->ipv4_req_clients[s] = addr;
+                    req_clients_arr->ipv4_size++;
+                    return 1;
+                }
+                if(req_clients_arr->ipv4_req_clients[s] == addr) return 0;
+            }
+        }
+    }
+
+    return hll_add(req_clients_arr->hll, req_clients_arr->hll_precision, req_client_hash64(addr));
+}
+
+/**
+ * @brief Add a client IPv6 address to a hash set of unique client IPs
+ * @param[in,out] req_clients_arr Hash sets (or HyperLogLog registers) of unique client IPs
+ * @param[in] addr Binary IPv6 address. :: is not tracked, as it marks empty slots.
+ * @return 1 if addr was added (or updated a HyperLogLog register), 0 if it was already 
+ * in the set or could not be added.
+ */
+int parser_metrics_req_client_ipv6_add(struct log_parser_metrics_req_clients_array *req_clients_arr, const struct in6_addr *addr){
+    if(unlikely(IN6_IS_ADDR_UNSPECIFIED(addr))) return 0;
+
+    if(!req_clients_arr->hll_active){
+        const int rc = req_clients_set_reserve(req_clients_arr, (void **) &req_clients_arr->ipv6_req_clients, sizeof(struct in6_addr), 
+                                               req_clients_arr->ipv6_size, &req_clients_arr->ipv6_size_max);
+        if(unlikely(rc < 0)) return 0;
+        if(likely(!rc)){
+            const uint32_t hash = metrics_hash(addr, sizeof(struct in6_addr));
+            const int mask = req_clients_arr->ipv6_size_max - 1;
+            for(int s = (int) (hash ^ (hash >> 16)) & mask; ; s = (s + 1) & mask){
+                if(IN6_IS_ADDR_UNSPECIFIED(&req_clients_arr->ipv6_req_clients[s])){
+                    req_clients_arr->ipv6_req_clients[s] = *addr;
+                    req_clients_arr->ipv6_size++;
+                    return 1;
+                }
+                if(IN6_ARE_ADDR_EQUAL(&req_clients_arr->ipv6_req_clients[s], addr)) return 0;
+            }
+        }
+    }
+
+    return hll_add(&req_clients_arr->hll[(size_t) 1 << req_clients_arr->hll_precision], 
+                   req_clients_arr->hll_precision, req_client_ipv6_hash64(addr));
+}
+
+/**
+ * @brief Merge unique client IPs into another set of unique client IPs
+ * @details Sets of unique client IPs can be merged regardless of their mode (exact or 
+ * HyperLogLog), as long as HyperLogLog registers are only merged into a destination 
+ * of the same hll_precision.
+ * @param[in,out] dst Unique client IPs to merge into
+ * @param[in] src Unique client IPs to merge
+ */
+void parser_metrics_req_clients_merge(struct log_parser_metrics_req_clients_array *dst, 
+                                      const struct log_parser_metrics_req_clients_array *src){
+    if(src->hll_active){
+        m_assert(dst->hll_precision == src->hll_precision, "HyperLogLog registers of different precision cannot be merged");
+        if(!dst->hll_active) req_clients_hll_activate(dst);
+        const size_t registers = (size_t) 2 << src->hll_precision;
+        for(size_t i = 0; i < registers; i++) if(src->hll[i] > dst->hll[i]) dst->hll[i] = src->hll[i];
+        return;
+    }
+
+    for(int i = 0; i < src->ipv4_size_max; i++){
+        if(src->ipv4_req_clients[i]) parser_metrics_req_client_ipv4_add(dst, src->ipv4_req_clients[i]);
+    }
+    for(int i = 0; i < src->ipv6_size_max; i++){
+        if(!IN6_IS_ADDR_UNSPECIFIED(&src->ipv6_req_clients[i])) parser_metrics_req_client_ipv6_add(dst, &src->ipv6_req_clients[i]);
+    }
+}
+
+/**
+ * @brief Get the number of unique client IPv4 addresses
+ * @param[in] req_clients_arr Unique client IPs
+ * @return Exact number of unique client IPv4 addresses, or their HyperLogLog estimate.
+ */
+int parser_metrics_req_clients_ipv4_count(const struct log_parser_metrics_req_clients_array *req_clients_arr){
+    if(!req_clients_arr->hll_active) return req_clients_arr->ipv4_size;
+    return hll_estimate(req_clients_arr->hll, req_clients_arr->hll_precision);
+}
+
+/**
+ * @brief Get the number of unique client IPv6 addresses
+ * @param[in] req_clients_arr Unique client IPs
+ * @return Exact number of unique client IPv6 addresses, or their HyperLogLog estimate.
+ */
+int parser_metrics_req_clients_ipv6_count(const struct log_parser_metrics_req_clients_array *req_clients_arr){
+    if(!req_clients_arr->hll_active) return req_clients_arr->ipv6_size;
+    return hll_estimate(&req_clients_arr->hll[(size_t) 1 << req_clients_arr->hll_precision], req_clients_arr->hll_precision);
+}
+
+/**
+ * @brief Empty the hash sets of unique client IPs, keeping their memory for reuse
+ * @details If the hash sets had switched to HyperLogLog registers, the registers are 
+ * zeroed and counting starts in exact mode again.
+ * @param[in,out] req_clients_arr Hash sets of unique client IPs to empty
+ */
+void parser_metrics_req_clients_reset(struct log_parser_metrics_req_clients_array *req_clients_arr){
+    if(req_clients_arr->hll_active){
+        memset(req_clients_arr->hll, 0, (size_t) 2 << req_clients_arr->hll_precision);
+        req_clients_arr->hll_active = 0;
+    }
+    if(req_clients_arr->ipv4_size) 
+        memset(req_clients_arr->ipv4_req_clients, 0, req_clients_arr->ipv4_size_max * sizeof(uint32_t));
+    if(req_clients_arr->ipv6_size) 
+        memset(req_clients_arr->ipv6_req_clients, 0, req_clients_arr->ipv6_size_max * sizeof(struct in6_addr));
+    req_clients_arr->ipv4_size = 0;
+    req_clients_arr->ipv6_size = 0;
+}
+
+#define LATENCY_HIST_SUB_BUCKETS (1U << LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS)
+
+/**
+ * @brief Add a latency to a latency histogram
+ * @details The bucket is found in constant time from the position of the most 
+ * significant bit of the value and the LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS
+ * bits that follow it.
+ * @param[in,out] hist Histogram to add the latency to
+ * @param[in] usec Latency in microseconds
+ */
+static inline void latency_hist_add(struct log_parser_metrics_latency_hist *hist, const uint32_t usec){
+    uint32_t bucket;
+    if(usec < LATENCY_HIST_SUB_BUCKETS) bucket = usec;
+    else {
+        const int shift = (31 - __builtin_clz(usec)) - LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS;
+        bucket = ((uint32_t) (shift + 1) << LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS) + 
+                 ((usec >> shift) & (LATENCY_HIST_SUB_BUCKETS - 1));
+    }
+    hist->buckets[bucket]++;
+    hist->count++;
+}
+
+/**
+ * @brief Get the value that represents a bucket of a latency histogram
+ * @param[in] bucket Index of the bucket
+ * @return Midpoint of the range of latencies (in microseconds) counted by the bucket.
+ */
+static inline unsigned int latency_hist_bucket_value(const uint32_t bucket){
+    if(bucket < LATENCY_HIST_SUB_BUCKETS) return bucket;
+    const int shift = (int) (bucket >> LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS) - 1;
+    const uint64_t lower = (uint64_t) (LATENCY_HIST_SUB_BUCKETS + (bucket & (LATENCY_HIST_SUB_BUCKETS - 1))) << shift;
+    const uint64_t mid = lower + ((1ULL << shift) >> 1);
+    return mid > UINT_MAX ? UINT_MAX : (unsigned int) mid;
+}
+
+/**
+ * @brief Merge a latency histogram into another one
+ * @param[in,out] dst Histogram to merge into
+ * @param[in] src Histogram to merge, left unchanged
+ */
+void parser_metrics_latency_hist_merge(struct log_parser_metrics_latency_hist *dst, 
+                                       const struct log_parser_metrics_latency_hist *src){
+    if(!src->count) return;
+    for(int i = 0; i < LOG_PARSER_METRICS_LATENCY_HIST_BUCKETS; i++) dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+}
+
+/**
+ * @brief Get a percentile of a latency histogram
+ * @param[in] hist Histogram to get the percentile of
+ * @param[in] q Quantile of the percentile, in (0, 1], e.g. 0.99 for p99
+ * @return The percentile in microseconds (within the relative error of the 
+ * histogram buckets), or 0 if the histogram is empty.
+ */
+unsigned int parser_metrics_latency_hist_percentile(const struct log_parser_metrics_latency_hist *hist, const double q){
+    if(!hist->count) return 0;
+    uint64_t rank = (uint64_t) ceil(q * (double) hist->count);
+    if(rank < 1) rank = 1;
+    uint64_t cumulative = 0;
+    for(uint32_t i = 0; i < LOG_PARSER_METRICS_LATENCY_HIST_BUCKETS; i++){
+        cumulative += hist->buckets[i];
+        if(cumulative >= rank) return latency_hist_bucket_value(i);
+    }
+    return latency_hist_bucket_value(LOG_PARSER_METRICS_LATENCY_HIST_BUCKETS - 1);
+}
+
+/**
+ * @brief Empty a latency histogram
+ * @param[in,out] hist Histogram to empty
+ */
+void parser_metrics_latency_hist_reset(struct log_parser_metrics_latency_hist *hist){
+    if(!hist->count) return;
+    memset(hist->buckets, 0, sizeof(hist->buckets));
+    hist->count = 0;
+}
+
+/**
+ * @brief Free all the arrays, hash indexes and hash sets of parser metrics
+ * @param[in,out] metrics Parser metrics whose arrays will be freed (but not metrics itself)
+ */
+void parser_metrics_free(Log_parser_metrics_t *metrics){
+    freez(metrics->vhost_arr.vhosts);
+    freez(metrics->vhost_arr.index.slots);
+    freez(metrics->port_arr.ports);
+    freez(metrics->port_arr.index.slots);
+    freez(metrics->req_clients_current_arr.ipv4_req_clients);
+    freez(metrics->req_clients_current_arr.ipv6_req_clients);
+    freez(metrics->req_clients_alltime_arr.ipv4_req_clients);
+    freez(metrics->req_clients_alltime_arr.ipv6_req_clients);
+    freez(metrics->req_clients_current_arr.hll);
+    freez(metrics->req_clients_alltime_arr.hll);
+    freez(metrics->ssl_cipher_arr.ssl_ciphers);
+    freez(metrics->ssl_cipher_arr.index.slots);
+}
+
+enum {
+    REQ_CLIENT_IP_INVALID = 0,
+    REQ_CLIENT_IPV4 = 4,
+    REQ_CLIENT_IPV6 = 6
+};
+
+/**
+ * @brief Get the IP version of the client address of a log line
+ * @return REQ_CLIENT_IPV4, REQ_CLIENT_IPV6 or REQ_CLIENT_IP_INVALID
+ */
+static inline int req_client_ip_version(const char *req_client){
+    if(!strcmp(req_client, INVALID_CLIENT_IP_STR)) return REQ_CLIENT_IP_INVALID;
+    return strchr(req_client, ':') ? REQ_CLIENT_IPV6 : REQ_CLIENT_IPV4;
+}
+
+enum {
+    REQ_PROTO_OTHER = 0,
+    REQ_PROTO_HTTP_1 = 10,
+    REQ_PROTO_HTTP_1_1 = 11,
+    REQ_PROTO_HTTP_2 = 20
+};
+
+/**
+ * @brief Get the HTTP version of the request protocol of a log line
+ * @return One of the REQ_PROTO_* values
+ */
+static inline int req_proto_version(const char *req_proto){
+    if(!strcmp(req_proto, "1") || !strcmp(req_proto, "1.0")) return REQ_PROTO_HTTP_1;
+    if(!strcmp(req_proto, "1.1")) return REQ_PROTO_HTTP_1_1;
+    if(!strcmp(req_proto, "2") || !strcmp(req_proto, "2.0")) return REQ_PROTO_HTTP_2;
+    return REQ_PROTO_OTHER;
+}
+
+/**
+ * @brief Get the family of a response code
+ * @return 1 to 5 for 1xx to 5xx response codes, 0 for any other one
+ */
+static inline int resp_code_family(const int resp_code){
+    const int family = resp_code / 100;
+    return family >= 1 && family <= 5 ? family : 0;
+}
+
+enum {
+    RESP_CODE_TYPE_OTHER = 0,
+    RESP_CODE_TYPE_SUCCESS,
+    RESP_CODE_TYPE_REDIRECT,
+    RESP_CODE_TYPE_BAD,
+    RESP_CODE_TYPE_ERROR
+};
+
+/**
+ * @brief Get the response code type of a response code
+ * @details 304 and 401 are treated as successful responses.
+ * @return One of the RESP_CODE_TYPE_* values
+ */
+static inline int resp_code_type(const int resp_code){
+    switch(resp_code_family(resp_code)){
+        case 1:
+        case 2: return RESP_CODE_TYPE_SUCCESS;
+        case 3: return resp_code == 304 ? RESP_CODE_TYPE_SUCCESS : RESP_CODE_TYPE_REDIRECT;
+        case 4: return resp_code == 401 ? RESP_CODE_TYPE_SUCCESS : RESP_CODE_TYPE_BAD;
+        case 5: return RESP_CODE_TYPE_ERROR;
+        default: return RESP_CODE_TYPE_OTHER;
+    }
+}
+
 static inline void extract_metrics(Log_parser_config_t *parser_config, Log_line_parsed_t *line_parsed, Log_parser_metrics_t *metrics){
 
     /* Extract number of parsed lines */
@@ -1187,63 +2219,32 @@ static inline void extract_metrics(Log_parser_config_t *parser_config, Log_line_
     metrics->num_lines_rate++;
 
     /* Extract vhost */
-    // TODO: Reduce number of reallocs
     if((parser_config->chart_config & CHART_VHOST) && line_parsed->vhost && *line_parsed->vhost){
-        int i;
-        for(i = 0; i < metrics->vhost_arr.size; i++){
-            if(!strcmp(metrics->vhost_arr.vhosts[i].name, line_parsed->vhost)){
-                metrics->vhost_arr.vhosts[i].count++;
-                break;
-            }
-        }
-        if(metrics->vhost_arr.size == i){ // Vhost not found in array - need to append
-            metrics->vhost_arr.size++;
-            metrics->vhost_arr.vhosts = reallocz(metrics->vhost_arr.vhosts, metrics->vhost_arr.size * sizeof(struct log_parser_metrics_vhost));
-            snprintf(metrics->vhost_arr.vhosts[metrics->vhost_arr.size - 1].name, VHOST_MAX_LEN, "%s", line_parsed->vhost);
-            metrics->vhost_arr.vhosts[metrics->vhost_arr.size - 1].count = 1;
-        }
+        const int i = parser_metrics_vhost_get(&metrics->vhost_arr, line_parsed->vhost); // May realloc metrics->vhost_arr.vhosts
+        metrics->vhost_arr.vhosts[i].count++;
     }
 
     /* Extract port */
-    // TODO: Reduce number of reallocs
     if((parser_config->chart_config & CHART_PORT) && line_parsed->port){
-        int i;
-        for(i = 0; i < metrics->port_arr.size; i++){
-            if(metrics->port_arr.ports[i].port == line_parsed->port){
-                metrics->port_arr.ports[i].count++;
-                break;
-            }
-        }
-        if(metrics->port_arr.size == i){ // Port not found in array - need to append
-            metrics->port_arr.size++;
-            metrics->port_arr.ports = reallocz(metrics->port_arr.ports, metrics->port_arr.size * sizeof(struct log_parser_metrics_port));
-            metrics->port_arr.ports[metrics->port_arr.size - 1].port = line_parsed->port;
-            metrics->port_arr.ports[metrics->port_arr.size - 1].count = 1;
-        } 
+        const int i = parser_metrics_port_get(&metrics->port_arr, line_parsed->port); // May realloc metrics->port_arr.ports
+        metrics->port_arr.ports[i].count++;
     }
 
     /* Extract client metrics */
     if((parser_config->chart_config & (CHART_IP_VERSION | CHART_REQ_CLIENT_CURRENT | CHART_REQ_CLIENT_ALL_TIME)) && line_parsed->req_client && *line_parsed->req_client){
-        if(!strcmp(line_parsed->req_client, INVALID_CLIENT_IP_STR)){
+        const int ip_version = req_client_ip_version(line_parsed->req_client);
+        if(ip_version == REQ_CLIENT_IP_INVALID){
             if(parser_config->chart_config & CHART_IP_VERSION) metrics->ip_ver.invalid++;
         }
-        else if(strchr(line_parsed->req_client, ':')){
+        else if(ip_version == REQ_CLIENT_IPV6){
             /* IPv6 version */
             if(parser_config->chart_config & CHART_IP_VERSION) metrics->ip_ver.v6++;
 
             /* Unique Client IPv6 Address */
             if(parser_config->chart_config & (CHART_REQ_CLIENT_CURRENT | CHART_REQ_CLIENT_ALL_TIME)){
-                int i;
-                for(i = 0; i < metrics->req_clients_current_arr.ipv6_size; i++){
-                    if(!strcmp(metrics->req_clients_current_arr.ipv6_req_clients[i], line_parsed->req_client)) break;
-                }
-                if(metrics->req_clients_current_arr.ipv6_size == i){ // Req client not found in array - need to append
-                    metrics->req_clients_current_arr.ipv6_size++;
-                    metrics->req_clients_current_arr.ipv6_req_clients = reallocz(metrics->req_clients_current_arr.ipv6_req_clients, 
-                        metrics->req_clients_current_arr.ipv6_size * sizeof(*metrics->req_clients_current_arr.ipv6_req_clients));
-                    snprintf(metrics->req_clients_current_arr.ipv6_req_clients[metrics->req_clients_current_arr.ipv6_size - 1], 
-                        REQ_CLIENT_MAX_LEN, "%s", line_parsed->req_client);
-                }
+                struct in6_addr addr;
+                if(inet_pton(AF_INET6, line_parsed->req_client, &addr) == 1)
+                    parser_metrics_req_client_ipv6_add(&metrics->req_clients_current_arr, &addr);
             }
         }
         else{
@@ -1252,17 +2253,9 @@ static inline void extract_metrics(Log_parser_config_t *parser_config, Log_line_
 
             /* Unique Client IPv4 Address */
             if(parser_config->chart_config & (CHART_REQ_CLIENT_CURRENT | CHART_REQ_CLIENT_ALL_TIME)){
-                int i;
-                for(i = 0; i < metrics->req_clients_current_arr.ipv4_size; i++){
-                    if(!strcmp(metrics->req_clients_current_arr.ipv4_req_clients[i], line_parsed->req_client)) break;
-                }
-                if(metrics->req_clients_current_arr.ipv4_size == i){ // Req client not found in array - need to append
-                    metrics->req_clients_current_arr.ipv4_size++;
-                    metrics->req_clients_current_arr.ipv4_req_clients = reallocz(metrics->req_clients_current_arr.ipv4_req_clients, 
-                        metrics->req_clients_current_arr.ipv4_size * sizeof(*metrics->req_clients_current_arr.ipv4_req_clients));
-                    snprintf(metrics->req_clients_current_arr.ipv4_req_clients[metrics->req_clients_current_arr.ipv4_size - 1], 
-                        REQ_CLIENT_MAX_LEN, "%s", line_parsed->req_client);
-                }
+                struct in_addr addr;
+                if(inet_pton(AF_INET, line_parsed->req_client, &addr) == 1)
+                    parser_metrics_req_client_ipv4_add(&metrics->req_clients_current_arr, addr.s_addr);
             }
         }
     }
@@ -1311,10 +2304,12 @@ static inline void extract_metrics(Log_parser_config_t *parser_config, Log_line_
 
     /* Extract request protocol */
     if(parser_config->chart_config & CHART_REQ_PROTO){
-        if(!strcmp(line_parsed->req_proto, "1") || !strcmp(line_parsed->req_proto, "1.0")) metrics->req_proto.http_1++;
-        else if(!strcmp(line_parsed->req_proto, "1.1")) metrics->req_proto.http_1_1++;
-        else if(!strcmp(line_parsed->req_proto, "2") || !strcmp(line_parsed->req_proto, "2.0")) metrics->req_proto.http_2++;
-        else metrics->req_proto.other++;
+        switch(req_proto_version(line_parsed->req_proto)){
+            case REQ_PROTO_HTTP_1: metrics->req_proto.http_1++; break;
+            case REQ_PROTO_HTTP_1_1: metrics->req_proto.http_1_1++; break;
+            case REQ_PROTO_HTTP_2: metrics->req_proto.http_2++; break;
+            default: metrics->req_proto.other++; break;
+        }
     }
 
     /* Extract bytes received and sent */
@@ -1329,44 +2324,33 @@ static inline void extract_metrics(Log_parser_config_t *parser_config, Log_line_
         if(line_parsed->req_proc_time > metrics->req_proc_time.max || metrics->req_proc_time.max == 0) metrics->req_proc_time.max = line_parsed->req_proc_time;
         metrics->req_proc_time.sum += line_parsed->req_proc_time;
         metrics->req_proc_time.count++;
+        latency_hist_add(&metrics->req_proc_time.hist, (uint32_t) line_parsed->req_proc_time);
     }
 
+    /* Extract upstream response time */
+    if((parser_config->chart_config & CHART_UPS_RESP_TIME) && line_parsed->ups_resp_time)
+        latency_hist_add(&metrics->ups_resp_time_hist, (uint32_t) line_parsed->ups_resp_time);
+
     /* Extract response code family, response code & response code type */
     if(parser_config->chart_config & (CHART_RESP_CODE_FAMILY | CHART_RESP_CODE | CHART_RESP_CODE_TYPE)){
-        switch(line_parsed->resp_code / 100){
-            /* Note: 304 and 401 should be treated as resp_success */
-            case 1:
-                metrics->resp_code_family.resp_1xx++;
-                metrics->resp_code[line_parsed->resp_code - 100]++;
-                metrics->resp_code_type.resp_success++;
-                break;
-            case 2:
-                metrics->resp_code_family.resp_2xx++;
-                metrics->resp_code[line_parsed->resp_code - 100]++;
-                metrics->resp_code_type.resp_success++;
-                break;
-            case 3:
-                metrics->resp_code_family.resp_3xx++;
-                metrics->resp_code[line_parsed->resp_code - 100]++;
-                if(line_parsed->resp_code == 304) metrics->resp_code_type.resp_success++;
-                else metrics->resp_code_type.resp_redirect++;
-                break;
-            case 4:
-                metrics->resp_code_family.resp_4xx++;
-                metrics->resp_code[line_parsed->resp_code - 100]++;
-                if(line_parsed->resp_code == 401) metrics->resp_code_type.resp_success++;
-                else metrics->resp_code_type.resp_bad++;
-                break;
-            case 5:
-                metrics->resp_code_family.resp_5xx++;
-                metrics->resp_code[line_parsed->resp_code - 100]++;
-                metrics->resp_code_type.resp_error++;
-                break;
-            default:
-                metrics->resp_code_family.other++;
-                metrics->resp_code[500]++;
-                metrics->resp_code_type.other++;
-                break;
+        const int family = resp_code_family(line_parsed->resp_code);
+        switch(family){
+            case 1: metrics->resp_code_family.resp_1xx++; break;
+            case 2: metrics->resp_code_family.resp_2xx++; break;
+            case 3: metrics->resp_code_family.resp_3xx++; break;
+            case 4: metrics->resp_code_family.resp_4xx++; break;
+            case 5: metrics->resp_code_family.resp_5xx++; break;
+            default: metrics->resp_code_family.other++; break;
+        }
+
+        metrics->resp_code[family ? line_parsed->resp_code - 100 : 500]++;
+
+        switch(resp_code_type(line_parsed->resp_code)){
+            case RESP_CODE_TYPE_SUCCESS: metrics->resp_code_type.resp_success++; break;
+            case RESP_CODE_TYPE_REDIRECT: metrics->resp_code_type.resp_redirect++; break;
+            case RESP_CODE_TYPE_BAD: metrics->resp_code_type.resp_bad++; break;
+            case RESP_CODE_TYPE_ERROR: metrics->resp_code_type.resp_error++; break;
+            default: metrics->resp_code_type.other++; break;
         }
     }
 
@@ -1382,21 +2366,9 @@ static inline void extract_metrics(Log_parser_config_t *parser_config, Log_line_
     }
 
     /* Extract SSL cipher suite */
-    // TODO: Reduce number of reallocs
     if((parser_config->chart_config & CHART_SSL_CIPHER) && line_parsed->ssl_cipher && *line_parsed->ssl_cipher){
-        int i;
-        for(i = 0; i < metrics->ssl_cipher_arr.size; i++){
-            if(!strcmp(metrics->ssl_cipher_arr.ssl_ciphers[i].string, line_parsed->ssl_cipher)){
-                metrics->ssl_cipher_arr.ssl_ciphers[i].count++;
-                break;
-            }
-        }
-        if(metrics->ssl_cipher_arr.size == i){ // SSL cipher suite not found in array - need to append
-            metrics->ssl_cipher_arr.size++;
-            metrics->ssl_cipher_arr.ssl_ciphers = reallocz(metrics->ssl_cipher_arr.ssl_ciphers, metrics->ssl_cipher_arr.size * sizeof(struct log_parser_metrics_ssl_cipher));
-            snprintf(metrics->ssl_cipher_arr.ssl_ciphers[metrics->ssl_cipher_arr.size - 1].string, SSL_CIPHER_SUITE_MAX_LEN, "%s", line_parsed->ssl_cipher);
-            metrics->ssl_cipher_arr.ssl_ciphers[metrics->ssl_cipher_arr.size - 1].count = 1;
-        }
+        const int i = parser_metrics_ssl_cipher_get(&metrics->ssl_cipher_arr, line_parsed->ssl_cipher); // May realloc metrics->ssl_cipher_arr.ssl_ciphers
+        metrics->ssl_cipher_arr.ssl_ciphers[i].count++;
     }
 }
 
@@ -1406,7 +2378,8 @@ Log_parser_metrics_t parse_text_buf(Log_parser_buffs_t *parser_buffs, char *text
     if(!text_size || !text || !*text) return metrics;
 
     char *line_start = text, *line_end = text;
-    while(line_end = strchr(line_start, '\n')){
+    char *const text_end = text + text_size;
+    while(line_start < text_end && (line_end = memchr(line_start, '\n', (size_t) (text_end - line_start)))){
 
         #if MEASURE_PARSE_TEXT_TIME
         struct timespec begin, end;
@@ -1432,8 +2405,6 @@ Log_parser_metrics_t parse_text_buf(Log_parser_buffs_t *parser_buffs, char *text
         
         // TODO: Refactor the following, can be done inside parse_log_line() function to save a strcmp() call.
         extract_metrics(parser_config, line_parsed, &metrics);
-        
-        freez(line_parsed->req_URL);
 
         line_start = line_end + 1;
         
@@ -1458,21 +2429,373 @@ Log_parser_metrics_t parse_text_buf(Log_parser_buffs_t *parser_buffs, char *text
     return metrics;
 }
 
+/**
+ * @brief Condition of a log line predicate, i.e. a single dimension of a chart
+ */
+struct log_line_predicate_cond {
+    chart_type_t chart;     /**< Chart of the dimension (a single chart_type_t) */
+    int value;              /**< Numeric dimension (port, HTTP version, response code or family etc.) */
+    char *str;              /**< String dimension (vhost, method, SSL protocol or cipher suite), NULL if numeric */
+};
+
+struct Log_line_predicate {
+    struct log_line_predicate_cond *conds;
+    int conds_num;
+    unsigned long int chart_deps;   /**< Bitmask of chart_type_t of all the conditions */
+};
+
+/**
+ * @brief Chart ids (as created by the logs management plugin) that a predicate can refer to
+ */
+static const struct {
+    const char *id;
+    chart_type_t chart;
+} predicate_charts[] = {
+    { "vhost",              CHART_VHOST },
+    { "port",               CHART_PORT },
+    { "ip version",         CHART_IP_VERSION },
+    { "http methods",       CHART_REQ_METHODS },
+    { "http versions",      CHART_REQ_PROTO },
+    { "responses",          CHART_RESP_CODE_FAMILY },
+    { "detailed responses", CHART_RESP_CODE },
+    { "response types",     CHART_RESP_CODE_TYPE },
+    { "ssl protocol",       CHART_SSL_PROTO },
+    { "ssl cipher suite",   CHART_SSL_CIPHER }
+};
+
+/**
+ * @brief Parse the dimension of a predicate condition
+ * @param[in,out] cond Condition, with cond->chart already set
+ * @param[in] dimension Name of the dimension, as created by the logs management plugin
+ * @return 0 on success, -1 if the dimension is not valid for the chart of the condition
+ */
+static int log_line_predicate_cond_parse(struct log_line_predicate_cond *cond, const char *dimension){
+    switch(cond->chart){
+        case CHART_VHOST:
+            if(strlen(dimension) >= VHOST_MAX_LEN) return -1;
+            cond->str = strdupz(dimension);
+            return 0;
+        case CHART_PORT:
+            if(!strcmp(dimension, "invalid")){
+                cond->value = INVALID_PORT;
+                return 0;
+            }
+            return (str2int(&cond->value, (char *) dimension, 10) == STR2XX_SUCCESS && 
+                    cond->value > 0 && cond->value <= 65535) ? 0 : -1;
+        case CHART_IP_VERSION:
+            if(!strcmp(dimension, "ipv4")) cond->value = REQ_CLIENT_IPV4;
+            else if(!strcmp(dimension, "ipv6")) cond->value = REQ_CLIENT_IPV6;
+            else if(!strcmp(dimension, "invalid")) cond->value = REQ_CLIENT_IP_INVALID;
+            else return -1;
+            return 0;
+        case CHART_REQ_METHODS:
+            if(strlen(dimension) >= REQ_METHOD_MAX_LEN) return -1;
+            cond->str = strdupz(dimension);
+            return 0;
+        case CHART_REQ_PROTO:
+            if(!strcmp(dimension, "1.0")) cond->value = REQ_PROTO_HTTP_1;
+            else if(!strcmp(dimension, "1.1")) cond->value = REQ_PROTO_HTTP_1_1;
+            else if(!strcmp(dimension, "2.0")) cond->value = REQ_PROTO_HTTP_2;
+            else if(!strcmp(dimension, "other")) cond->value = REQ_PROTO_OTHER;
+            else return -1;
+            return 0;
+        case CHART_RESP_CODE_FAMILY:
+            if(!strcmp(dimension, "other")) cond->value = 0;
+            else if(dimension[0] >= '1' && dimension[0] <= '5' && !strcmp(&dimension[1], "xx")) cond->value = dimension[0] - '0';
+            else return -1;
+            return 0;
+        case CHART_RESP_CODE:
+            if(!strcmp(dimension, "other")){
+                cond->value = 0;
+                return 0;
+            }
+            return (str2int(&cond->value, (char *) dimension, 10) == STR2XX_SUCCESS && 
+                    cond->value >= 100 && cond->value <= 599) ? 0 : -1;
+        case CHART_RESP_CODE_TYPE:
+            if(!strcmp(dimension, "success")) cond->value = RESP_CODE_TYPE_SUCCESS;
+            else if(!strcmp(dimension, "redirect")) cond->value = RESP_CODE_TYPE_REDIRECT;
+            else if(!strcmp(dimension, "bad")) cond->value = RESP_CODE_TYPE_BAD;
+            else if(!strcmp(dimension, "error")) cond->value = RESP_CODE_TYPE_ERROR;
+            else if(!strcmp(dimension, "other")) cond->value = RESP_CODE_TYPE_OTHER;
+            else return -1;
+            return 0;
+        case CHART_SSL_PROTO:
+            /* Dimensions are in upper case (e.g. "TLSV1.2"), whereas the logs are not (e.g. "TLSv1.2"),
+             * so they are compared case insensitively. "other" is kept as NULL. */
+            if(strcmp(dimension, "other")){
+                if(strlen(dimension) >= SSL_PROTO_MAX_LEN) return -1;
+                cond->str = strdupz(dimension);
+            }
+            return 0;
+        case CHART_SSL_CIPHER:
+            if(strlen(dimension) >= SSL_CIPHER_SUITE_MAX_LEN) return -1;
+            cond->str = strdupz(dimension);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/**
+ * @brief Create a log line predicate
+ * @details A log line predicate selects the log lines that contributed to one or more 
+ * dimensions of the charts of a web log source, e.g. "responses:5xx|vhost:example.com" 
+ * selects the lines with a 5xx response code for vhost example.com. The lines are 
+ * classified exactly as when the metrics of the charts are extracted from them.
+ * @param spec List of conditions separated by '|', all of which must be true. Each 
+ * condition is "<chart id>:<dimension>", where chart id is the id of the chart (without 
+ * the chart name of the log source, e.g. "detailed responses") and dimension is the name
+ * of the dimension (e.g. "503"), as created by the logs management plugin.
+ * @return The predicate, or NULL if spec contains no conditions or any unsupported 
+ * chart or dimension. Must be released with log_line_predicate_destroy().
+ */
+Log_line_predicate_t *log_line_predicate_create(const char *spec){
+    Log_line_predicate_t *predicate = callocz(1, sizeof(Log_line_predicate_t));
+    char *spec_copy = strdupz(spec);
+    char *cursor = spec_copy;
+
+    char *cond_str;
+    while((cond_str = strsep(&cursor, "|"))){
+        if(!*cond_str) continue;
+
+        char *dimension = strchr(cond_str, ':');
+        if(!dimension) goto err;
+        *dimension++ = '\0';
+
+        predicate->conds = reallocz(predicate->conds, (predicate->conds_num + 1) * sizeof(struct log_line_predicate_cond));
+        struct log_line_predicate_cond *cond = &predicate->conds[predicate->conds_num++];
+        *cond = (struct log_line_predicate_cond) {0};
+        for(size_t i = 0; i < sizeof(predicate_charts) / sizeof(predicate_charts[0]); i++){
+            if(!strcmp(cond_str, predicate_charts[i].id)){
+                cond->chart = predicate_charts[i].chart;
+                break;
+            }
+        }
+        if(!cond->chart || log_line_predicate_cond_parse(cond, dimension)){
+            fprintf_log(LOGS_MANAG_ERROR, stderr, "Unsupported log line predicate condition: %s:%s\n", cond_str, dimension);
+            goto err;
+        }
+        predicate->chart_deps |= cond->chart;
+    }
+    if(!predicate->conds_num) goto err;
+
+    freez(spec_copy);
+    return predicate;
+
+err:
+    freez(spec_copy);
+    log_line_predicate_destroy(predicate);
+    return NULL;
+}
+
+/**
+ * @brief Release a log line predicate created with log_line_predicate_create()
+ */
+void log_line_predicate_destroy(Log_line_predicate_t *predicate){
+    if(!predicate) return;
+    for(int i = 0; i < predicate->conds_num; i++) freez(predicate->conds[i].str);
+    freez(predicate->conds);
+    freez(predicate);
+}
+
+/**
+ * @brief Test if a parsed log line contributed to a dimension
+ * @details Uses the same classification helpers as extract_metrics().
+ */
+static inline int log_line_predicate_cond_match(const struct log_line_predicate_cond *cond, const Log_line_parsed_t *line_parsed){
+    switch(cond->chart){
+        case CHART_VHOST:
+            return !strcmp(line_parsed->vhost, cond->str);
+        case CHART_PORT:
+            return line_parsed->port && line_parsed->port == cond->value;
+        case CHART_IP_VERSION:
+            if(!*line_parsed->req_client) return 0;
+            return req_client_ip_version(line_parsed->req_client) == cond->value;
+        case CHART_REQ_METHODS:
+            return !strcmp(line_parsed->req_method, cond->str);
+        case CHART_REQ_PROTO:
+            return req_proto_version(line_parsed->req_proto) == cond->value;
+        case CHART_RESP_CODE_FAMILY:
+            return resp_code_family(line_parsed->resp_code) == cond->value;
+        case CHART_RESP_CODE:
+            return (resp_code_family(line_parsed->resp_code) ? line_parsed->resp_code : 0) == cond->value;
+        case CHART_RESP_CODE_TYPE:
+            return resp_code_type(line_parsed->resp_code) == cond->value;
+        case CHART_SSL_PROTO:
+            if(cond->str) return !strcasecmp(line_parsed->ssl_proto, cond->str);
+            return  strcmp(line_parsed->ssl_proto, "TLSv1") && strcmp(line_parsed->ssl_proto, "TLSv1.1") && 
+                    strcmp(line_parsed->ssl_proto, "TLSv1.2") && strcmp(line_parsed->ssl_proto, "TLSv1.3") && 
+                    strcmp(line_parsed->ssl_proto, "SSLv2") && strcmp(line_parsed->ssl_proto, "SSLv3");
+        case CHART_SSL_CIPHER:
+            return !strcmp(line_parsed->ssl_cipher, cond->str);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Create the state needed to filter the log lines of a log source by a predicate
+ * @details Only the fields needed by the predicate will be extracted from each line, 
+ * according to a parse plan of its own (the one of the log source is not modified, 
+ * as it is used concurrently by the parser threads).
+ * @param predicate The predicate, see log_line_predicate_create(). It must outlive the result.
+ * @param parser_config Configuration of the log format of the log source.
+ * @return The predicate search state, to be released with log_line_predicate_search_destroy().
+ */
+Log_line_predicate_search_t *log_line_predicate_search_create(const Log_line_predicate_t *predicate, 
+                                                              const Log_parser_config_t *parser_config){
+    Log_line_predicate_search_t *search = callocz(1, sizeof(Log_line_predicate_search_t));
+    search->predicate = predicate;
+    search->parser_config = *parser_config;
+    search->parser_config.chart_config = predicate->chart_deps;
+    search->parser_config.plan = NULL;
+    compile_parse_plan(&search->parser_config, 0);
+    return search;
+}
+
+/**
+ * @brief Release the state created with log_line_predicate_search_create()
+ */
+void log_line_predicate_search_destroy(Log_line_predicate_search_t *search){
+    if(!search) return;
+    freez(search->parser_config.plan);
+    freez(search->parser_buffs.line);
+    freez(search->parser_buffs.fields);
+    freez(search);
+}
+
+/**
+ * @brief Keep only the lines of a buffer that match a predicate
+ * @details Each line is parsed and the lines matching all the conditions of the predicate
+ * are moved, in place and in their original order, to the beginning of text. Lines that 
+ * cannot be parsed never match. 
+ * @param[in,out] text The NUL-terminated text to be filtered
+ * @param[in] text_size Size of text, including the terminating NUL char
+ * @param[in,out] search Predicate search state, see log_line_predicate_search_create()
+ * @return Size of the kept text, including the terminating NUL char (or 0 if no lines were kept)
+ */
+size_t filter_lines_by_predicate(char *text, size_t text_size, Log_line_predicate_search_t *search){
+    if(!text_size) return 0;
+
+    Log_parser_buffs_t *parser_buffs = &search->parser_buffs;
+    const Log_line_predicate_t *predicate = search->predicate;
+
+    size_t dest_off = 0;
+    char *line_start = text;
+    char *const text_end = text + text_size - 1; // Terminating NUL char
+    while(line_start < text_end){
+        char *line_end = memchr(line_start, '\n', text_end - line_start);
+        const size_t line_len = (size_t) ((line_end ? line_end : text_end) - line_start); // Excluding newline
+        line_end = line_end ? line_end + 1 : text_end;
+
+        /* parse_log_line() modifies the line in place, so it must be parsed from a copy of it */
+        if(!parser_buffs->line || (line_len + 1) > parser_buffs->line_len_max){
+            parser_buffs->line_len_max = (line_len + 1) * LOG_PARSER_BUFFS_LINE_REALLOC_SCALE_FACTOR;
+            parser_buffs->line = reallocz(parser_buffs->line, parser_buffs->line_len_max);
+        }
+        memcpy(parser_buffs->line, line_start, line_len);
+        parser_buffs->line[line_len] = '\0';
+
+        const Log_line_parsed_t *line_parsed = parse_log_line(&search->parser_config, parser_buffs, parser_buffs->line, 1);
+        int keep = line_parsed != NULL;
+        for(int i = 0; keep && i < predicate->conds_num; i++) 
+            keep = log_line_predicate_cond_match(&predicate->conds[i], line_parsed);
+
+        if(keep){
+            const size_t kept_len = (size_t) (line_end - line_start);
+            if(text + dest_off != line_start) memmove(text + dest_off, line_start, kept_len);
+            dest_off += kept_len;
+        }
+        line_start = line_end;
+    }
+
+    if(dest_off) text[dest_off++] = '\0';
+    return dest_off;
+}
+
 Log_parser_config_t *auto_detect_parse_config(Log_parser_buffs_t *parser_buffs, const char delimiter){
+    /* parse_log_line() modifies the line in place, so each attempt must start from a copy of it */
+    const size_t line_size = strlen(parser_buffs->line) + 1;
+    char *line = mallocz(line_size);
     for(int i = 0; csv_auto_format_guess_matrix[i] != NULL; i++){
         fprintf(stderr, "Auto detection iteration: %d\n", i);
         Log_parser_config_t *parser_config = read_parse_config(csv_auto_format_guess_matrix[i], delimiter);
-        Log_line_parsed_t *line_parsed = parse_log_line(parser_config, parser_buffs, parser_buffs->line, 1);
+        memcpy(line, parser_buffs->line, line_size);
+        Log_line_parsed_t *line_parsed = parse_log_line(parser_config, parser_buffs, line, 1);
         if(line_parsed){
-            freez(line_parsed->req_URL);
             fprintf(stderr, "Auto-detection errors: %d iter:%d\n", line_parsed->parsing_errors, i);
             if(line_parsed->parsing_errors == 0){
                 fprintf(stderr, "Auto detected log format (iter:%d):%s\n", i, csv_auto_format_guess_matrix[i]);
+                freez(line);
                 return parser_config;
             }
         }
         freez(parser_config->fields);
+        freez(parser_config->plan);
         freez(parser_config);
     }
+    freez(line);
     return NULL;
-}
\ No newline at end of file
+}
+#if LOGS_MANAGEMENT_STRESS_TEST
+/**
+ * @brief Benchmark of the web log parser
+ * @details Parses PARSER_BENCHMARK_LINES lines, made up of the web log messages produced 
+ * by stress_test.c (in the log format of stress_test/log_management.conf), with 
+ * verification and all charts enabled, and logs the achieved lines/s. Half of the 
+ * lines share their time with the previous line, as it is typical for busy web servers.
+ */
+void run_parser_benchmark(void){
+    static const char *const log_msgs_arr[] = {
+        "testhost.host:80 192.168.15.14 GET 202 HTTP/1 635 - TLSv1 TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256",
+        "testhost.host:123 192.168.15.17 GET 200 HTTP/1.0 236 - TLSv1 TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256",
+        "testhost.host:123 192.168.15.14 UPDATE 202 HTTP/1 426 - TLSv1.2 TLS_PSK_WITH_AES_128_CCM_8",
+        "testhost.host:8080 192.168.2.1 DELETE 410 HTTP/1 125 - TLSv1 TLS_PSK_WITH_AES_128_CCM_8",
+        "testhost.host:80 192.137.168.4 DELETE 201 HTTP/1.1 954 - TLSv1.2 ECDHE-RSA-AES128-GCM-SHA256", 
+        "testhost12.host:8080 188.133.132.15 POST 303 HTTP/1 845 698 TLSv1.1 invalidSSLCipher", 
+        "testhost13.host:3040 2001:0db8:85a3:0000:0000:8a2e:0370:7334 OPTIONS 404 HTTP/1 - 236 TLSv1.2 invalid_SSL_cipher_suite", 
+        "testhost57.host:19999 garbageAddress PATCH 404 HTTP/2 124 541 TLSv1.3 ECDHE-RSA-AES128-GCM-SHA256", 
+        "testhost42.host:17 garbage.Address_with_dot UNBIND 1027 HTTP/3 958 2345 SSLv2 TLS_RSA_WITH_DES_CBC_SHA", 
+        "testhost0.host:77777 156.134.132.15 PUT 403 HTTP/1.0 458 1056 SSLv3 ECDHE-RSA-AES128-GCM-SHA256", 
+        "testhost111.host:42303 156.134.132.15 PUT 304 HTTP/1.0 205 288 wrong_ssl TLS_RSA_WITH_AES_256_CBC_SHA256", 
+        "testhost546.host:80 8501:0ab8:85a3:0000:0000:4a5d:0370:5213 WRONGMETHOD 504 HTTP/1.0 150 130 - TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256"
+    };
+    const int log_msgs_arr_size = (int) (sizeof(log_msgs_arr) / sizeof(log_msgs_arr[0]));
+    const int num_lines = PARSER_BENCHMARK_LINES;
+
+    char log_format[] = "%t %v:%p %h %m %>s %H %I %O $ssl_protocol $ssl_cipher";
+    Log_parser_config_t *parser_config = read_parse_config(log_format, ' ');
+
+    size_t text_size = 0;
+    char *text = mallocz((size_t) num_lines * 160);
+    for(int i = 0; i < num_lines; i++){
+        text_size += sprintf(&text[text_size], "[17/Oct/2022:10:%02d:%02d +0000] %s\n", 
+                             (i / 120) % 60, (i / 2) % 60, log_msgs_arr[i % log_msgs_arr_size]);
+    }
+
+    /* Run once with all charts enabled and once with only the vhost and response code charts */
+    const unsigned long int chart_configs[] = { ~0UL, CHART_VHOST | CHART_RESP_CODE };
+    for(int c = 0; c < (int) (sizeof(chart_configs) / sizeof(chart_configs[0])); c++){
+        parser_config->chart_config = chart_configs[c];
+        compile_parse_plan(parser_config, 0);
+
+        Log_parser_buffs_t parser_buffs = {0};
+        const uint64_t start_time = get_unix_time_ms();
+        Log_parser_metrics_t metrics = parse_text_buf(&parser_buffs, text, text_size, parser_config, 1);
+        const uint64_t runtime = get_unix_time_ms() - start_time;
+
+        fprintf_log(LOGS_MANAG_INFO, stderr, "Parser benchmark (chart config: 0x%lx): parsed %llu lines in %" PRIu64 "ms (%" PRIu64 " lines/s)\n", 
+                    chart_configs[c], metrics.num_lines_total, runtime, 
+                    runtime ? (uint64_t) metrics.num_lines_total * 1000 / runtime : 0);
+
+        parser_metrics_free(&metrics);
+        freez(parser_buffs.line);
+        freez(parser_buffs.fields);
+    }
+
+    freez(parser_config->fields);
+    freez(parser_config->plan);
+    freez(parser_config);
+    freez(text);
+}
+#endif  // LOGS_MANAGEMENT_STRESS_TEST
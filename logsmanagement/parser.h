@@ -7,6 +7,9 @@
 #ifndef PARSER_H_
 #define PARSER_H_
 
+#include <stdint.h>
+#include <netinet/in.h>
+
 /* Following max lengths include NUL terminating char */
 #define VHOST_MAX_LEN 255
 #define REQ_SCHEME_MAX_LEN 6
@@ -15,17 +18,20 @@
 #define REQ_PROTO_MAX_LEN 4 
 #define SSL_PROTO_MAX_LEN 8 
 #define SSL_CIPHER_SUITE_MAX_LEN 256 // TODO: Check max len for ssl cipher suite string is indeed 256
-#define REGEX_SIZE 100U /**< Max size of regular expression (used in keyword search) in bytes **/
 #define LOG_PARSER_BUFFS_LINE_REALLOC_SCALE_FACTOR 1.5
 #define LOG_PARSER_METRICS_VHOST_BUFFS_SCALE_FACTOR 1.5
 #define LOG_PARSER_METRICS_PORT_BUFFS_SCALE_FACTOR 8 // Unlike Vhosts, ports are stored as integers, so scale factor can be much bigger without significant waste of memory
-#define LOG_PARSER_METRICS_REQ_CLIENTS_BUFFS_SCALE_FACTOR 1.5 // Need to be careful with the scale factor here, as it can consume a lot of memory if there are many unique client IPs
 #define LOG_PARSER_METRICS_SLL_CIPHER_BUFFS_SCALE_FACTOR 1.5
+#define LOG_PARSER_METRICS_INDEX_MIN_SLOTS 16 // Initial number of slots of the hash indexes and hash sets of the metrics (must be a power of 2)
+#define LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS 5 // log2 of the number of linear sub-buckets per power of 2 of the latency histograms (relative error of percentiles < 2^-(bits+1))
+#define LOG_PARSER_METRICS_LATENCY_HIST_BUCKETS ((32 - LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS + 1) << LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS)
 
 /* Debug prints */
 #define ENABLE_PARSE_LOG_LINE_FPRINTS 0
 #define MEASURE_PARSE_TEXT_TIME 0
 
+#define PARSER_BENCHMARK_LINES 1000000 /**< Number of lines parsed by run_parser_benchmark(), when LOGS_MANAGEMENT_STRESS_TEST is enabled */
+
 #define INVALID_PORT -1
 #define INVALID_CLIENT_IP_STR "inv"
 
@@ -43,7 +49,8 @@ typedef enum{
     CHART_RESP_CODE = 1 << 10,
     CHART_RESP_CODE_TYPE = 1 << 11,
     CHART_SSL_PROTO = 1 << 12,
-    CHART_SSL_CIPHER = 1 << 13
+    CHART_SSL_CIPHER = 1 << 13,
+    CHART_UPS_RESP_TIME = 1 << 14
 } chart_type_t;
 
 typedef enum{
@@ -73,7 +80,7 @@ typedef struct log_line_parsed{
 		char req_scheme[REQ_SCHEME_MAX_LEN];
 		char req_client[REQ_CLIENT_MAX_LEN];
 		char req_method[REQ_METHOD_MAX_LEN];
-		char *req_URL;
+		char *req_URL;                  /**< Slice of the parsed line, valid only until the next line is parsed */
 		char req_proto[REQ_PROTO_MAX_LEN];
 		int req_size;
 		int req_proc_time;
@@ -90,6 +97,10 @@ typedef struct log_parser_buffs{
 	Log_line_parsed_t log_line_parsed;
 	char *line;
 	size_t line_len_max;
+	char **fields;                      /**< Fields of the line being parsed, as slices of #line. Reused for every line. */
+	int fields_max;                     /**< Size of #fields */
+	char time_cache_str[32];            /**< Last TIME field converted (without timezone) */
+	int64_t time_cache;                 /**< Result of the conversion of #time_cache_str */
 }Log_parser_buffs_t;
 
 typedef struct log_parser_config{
@@ -97,8 +108,33 @@ typedef struct log_parser_config{
     int num_fields;             		/**< Number of strings in the fields array. */
     char delimiter;       				/**< Delimiter that separates the fields in the log format. */
     unsigned long int chart_config;
+    int *plan;                          /**< Indexes of the fields to be extracted from each line, see compile_parse_plan() */
+    int plan_size;                      /**< Number of items in #plan */
+    int plan_fields_max;                /**< Number of leading fields of each line that need to be split */
 } Log_parser_config_t;
 
+/**
+ * @brief Open addressing hash index over the items of a metrics array
+ * @details Each slot holds the hash of the key of an item in its upper 32 bits and the 
+ * index of the item + 1 in its lower 32 bits, so 0 is an empty slot. The keys themselves 
+ * are only stored once, in the items of the array, which are never removed or reordered.
+ */
+struct log_parser_metrics_index{
+	uint64_t *slots;
+	uint32_t slots_mask;				/**< Number of slots - 1 (number of slots is a power of 2) **/
+};
+
+/**
+ * @brief Log-linear (HDR-style) histogram of latencies in microseconds
+ * @details Values below 2^LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS get a bucket each. 
+ * Every higher power of 2 range is split into 2^LOG_PARSER_METRICS_LATENCY_HIST_SUB_BUCKET_BITS 
+ * equally wide buckets, so the memory is fixed and histograms can be merged by adding them up.
+ */
+struct log_parser_metrics_latency_hist{
+	uint32_t buckets[LOG_PARSER_METRICS_LATENCY_HIST_BUCKETS];
+	uint64_t count;						/**< Sum of all buckets **/
+};
+
 typedef struct log_parser_metrics{
     unsigned long long num_lines_total; /**< Number of total lines parsed in log source file. */
     unsigned long long num_lines_rate;  /**< Number of new lines parsed. */
@@ -109,6 +145,7 @@ typedef struct log_parser_metrics{
 	    } *vhosts;
 	    int size;						/**< Size of vhosts array **/
 	    int size_max;
+	    struct log_parser_metrics_index index; /**< Hash index of vhosts by name **/
     } vhost_arr;
     struct log_parser_metrics_ports_array{
     	struct log_parser_metrics_port{
@@ -117,17 +154,23 @@ typedef struct log_parser_metrics{
 	    } *ports;
 	    int size;						/**< Size of ports array **/
 	    int size_max;
+	    struct log_parser_metrics_index index; /**< Hash index of ports by number **/
     } port_arr;
     struct log_parser_metrics_ip_ver{
 		int v4, v6, invalid;
 	} ip_ver;
 	struct log_parser_metrics_req_clients_array{
-		char (*ipv4_req_clients)[REQ_CLIENT_MAX_LEN];
-	    int ipv4_size;						   		 
-	    int ipv4_size_max;
-	    char (*ipv6_req_clients)[REQ_CLIENT_MAX_LEN];
-	    int ipv6_size;						   		 
-	    int ipv6_size_max;
+		uint32_t *ipv4_req_clients;			/**< Open addressing hash set of unique client IPv4 addresses (binary, network byte order). 0 is an empty slot. **/
+	    int ipv4_size;						/**< Number of unique client IPv4 addresses **/
+	    int ipv4_size_max;					/**< Number of slots of ipv4_req_clients (power of 2) **/
+	    struct in6_addr *ipv6_req_clients;	/**< Open addressing hash set of unique client IPv6 addresses (binary). :: is an empty slot. **/
+	    int ipv6_size;						/**< Number of unique client IPv6 addresses **/
+	    int ipv6_size_max;					/**< Number of slots of ipv6_req_clients (power of 2) **/
+	    size_t mem_max;						/**< Memory cap of both hash sets in bytes, or 0 for no cap. Once reached, new clients are not tracked. **/
+	    int mem_max_reached;				/**< Set once mem_max has been reached **/
+	    int hll_precision;					/**< HyperLogLog precision (log2 of the number of registers per IP version), or 0 to always count exactly **/
+	    int hll_active;						/**< Set once the hash sets grew larger than the HyperLogLog registers and were switched to them **/
+	    uint8_t *hll;						/**< HyperLogLog registers, IPv4 ones followed by IPv6 ones (1 << hll_precision each) **/
     } req_clients_current_arr, req_clients_alltime_arr; /**< req_clients_current_arr is used by parser.c to save unique client IPs extracted per circular buffer item
 														and also in p_file_info to save unique client IPs per collection (poll) iteration of plugin_logsmanagement.c.
 														req_clients_alltime_arr is used in p_file_info to save unique client IPs of all time (and so ipv4_size and 
@@ -147,7 +190,9 @@ typedef struct log_parser_metrics{
 	} bandwidth;
 	struct log_parser_metrics_req_proc_time{
 		unsigned long int min, max, sum, count;
+		struct log_parser_metrics_latency_hist hist;	/**< Histogram of request processing times, used for percentiles **/
 	} req_proc_time;
+	struct log_parser_metrics_latency_hist ups_resp_time_hist; /**< Histogram of upstream response times, used for percentiles **/
 	struct log_parser_metrics_resp_code_family{
 		int resp_1xx, resp_2xx, resp_3xx, resp_4xx, resp_5xx, other; // TODO: Can there be "other"?
 	} resp_code_family; 
@@ -165,12 +210,59 @@ typedef struct log_parser_metrics{
 	    } *ssl_ciphers;
 	    int size;									/**< Size of SSL ciphers array **/
 	    int size_max;
+	    struct log_parser_metrics_index index;		/**< Hash index of SSL ciphers by string **/
     } ssl_cipher_arr;
 } Log_parser_metrics_t;
 
-size_t search_keyword(char *src, char *dest, const char *keyword, const int ignore_case);
+typedef struct Keyword_matcher Keyword_matcher_t;
+
+Keyword_matcher_t *keyword_matcher_create(const char *keyword, const int ignore_case);
+void keyword_matcher_destroy(Keyword_matcher_t *matcher);
+size_t search_keyword(char *src, size_t src_size, char *dest, const Keyword_matcher_t *matcher);
+size_t filter_lines(char *text, size_t text_size, const Keyword_matcher_t *matcher, 
+                    const int sample_interval, const uint64_t first_line_no);
+size_t keyword_bloom_filter_size(const char *text, size_t text_size, unsigned *hashes);
+void keyword_bloom_filter_build(const char *text, size_t text_size, uint8_t *bloom, size_t bloom_size, unsigned hashes);
+int keyword_matcher_bloom_usable(const Keyword_matcher_t *matcher);
+int keyword_matcher_bloom_may_match(const Keyword_matcher_t *matcher, const uint8_t *bloom, size_t bloom_size);
 Log_parser_config_t *read_parse_config(char *log_format, const char delimiter);
+typedef struct Log_line_predicate Log_line_predicate_t;
+
+/**
+ * @brief State needed to filter the log lines of a single log source by a predicate
+ */
+typedef struct log_line_predicate_search{
+    const Log_line_predicate_t *predicate;
+    Log_parser_config_t parser_config;  /**< Copy of the configuration of the log source, with a parse plan of the fields of #predicate only */
+    Log_parser_buffs_t parser_buffs;    /**< Buffers of the parser, private to this search */
+} Log_line_predicate_search_t;
+
+Log_line_predicate_t *log_line_predicate_create(const char *spec);
+void log_line_predicate_destroy(Log_line_predicate_t *predicate);
+Log_line_predicate_search_t *log_line_predicate_search_create(const Log_line_predicate_t *predicate, 
+                                                              const Log_parser_config_t *parser_config);
+void log_line_predicate_search_destroy(Log_line_predicate_search_t *search);
+size_t filter_lines_by_predicate(char *text, size_t text_size, Log_line_predicate_search_t *search);
+void compile_parse_plan(Log_parser_config_t *parser_config, const int all_fields);
+int parser_metrics_vhost_get(struct log_parser_metrics_vhosts_array *vhost_arr, const char *name);
+int parser_metrics_port_get(struct log_parser_metrics_ports_array *port_arr, const int port);
+int parser_metrics_ssl_cipher_get(struct log_parser_metrics_ssl_cipher_array *ssl_cipher_arr, const char *string);
+int parser_metrics_req_client_ipv4_add(struct log_parser_metrics_req_clients_array *req_clients_arr, const uint32_t addr);
+int parser_metrics_req_client_ipv6_add(struct log_parser_metrics_req_clients_array *req_clients_arr, const struct in6_addr *addr);
+void parser_metrics_req_clients_merge(struct log_parser_metrics_req_clients_array *dst, 
+                                      const struct log_parser_metrics_req_clients_array *src);
+int parser_metrics_req_clients_ipv4_count(const struct log_parser_metrics_req_clients_array *req_clients_arr);
+int parser_metrics_req_clients_ipv6_count(const struct log_parser_metrics_req_clients_array *req_clients_arr);
+void parser_metrics_req_clients_reset(struct log_parser_metrics_req_clients_array *req_clients_arr);
+void parser_metrics_latency_hist_merge(struct log_parser_metrics_latency_hist *dst, 
+                                       const struct log_parser_metrics_latency_hist *src);
+unsigned int parser_metrics_latency_hist_percentile(const struct log_parser_metrics_latency_hist *hist, const double q);
+void parser_metrics_latency_hist_reset(struct log_parser_metrics_latency_hist *hist);
+void parser_metrics_free(Log_parser_metrics_t *metrics);
 Log_parser_metrics_t parse_text_buf(Log_parser_buffs_t *parser_buffs, char *text, size_t text_size, Log_parser_config_t *parser_config, const int verify);
 Log_parser_config_t *auto_detect_parse_config(Log_parser_buffs_t *parser_buffs, const char delimiter);
+#if LOGS_MANAGEMENT_STRESS_TEST
+void run_parser_benchmark(void);
+#endif  // LOGS_MANAGEMENT_STRESS_TEST
 
 #endif  // PARSER_H_
@@ -10,35 +10,31 @@
 #include "db_api.h"
 #include "file_info.h"
 #include "helper.h"
+#include "parser.h"
 
-int execute_query(logs_query_params_t *p_query_params) {
-    struct File_info *p_file_info = NULL;
-    size_t max_query_page_size = p_query_params->results_buff->size;
-    assert(max_query_page_size <= MAX_LOG_MSG_SIZE);  // Requested max size of results must be smaller than maximum size of each DB row entry.
+#define QUERY_SOURCE_RES_BUFF_INIT_SIZE 64 KiB /**< Initial size of the results buffer of each log source, when querying multiple sources */
+#define QUERY_SOURCE_RES_ENTRIES_INIT 64       /**< Initial number of results index entries of each log source, when querying multiple sources */
+#define QUERY_SOURCES_THREADS_MAX 4            /**< Maximum number of threads (including the one of the query) querying the log sources of a multi-source query */
 
-    fprintf(stderr, "Query params:%lu\n%lu\n%s\n%s\n%s\n", p_query_params->start_timestamp, p_query_params->end_timestamp, 
-         p_query_params->chart_name, p_query_params->filename, p_query_params->keyword);
+/**
+ * @brief Query a single log source
+ * @details The DB is searched first and then the circular buffer, for any 
+ * results that have not been transferred to the DB yet.
+ * @param p_file_info Log source to be queried.
+ * @param p_query_params Query parameters. Results will be appended to its results_buff.
+ * @param max_query_page_size Maximum size of results to be appended to results_buff.
+ * @return 0 on success, -1 if the logs of the DB could not be read, in which 
+ * case the results appended to results_buff are incomplete.
+ */
+static int query_source(struct File_info *p_file_info, logs_query_params_t *p_query_params, size_t max_query_page_size){
+    const size_t results_buff_len_init = p_query_params->results_buff->len;
 
-    /* Find p_file_info for this query according to chart_name or filename if the former is not valid. */
-    if(p_query_params->chart_name && p_query_params->chart_name[0] != '\0'){
-        for (int file_info_offset = 0; file_info_offset < p_file_infos_arr->count; file_info_offset++) {
-            if (!strcmp(p_file_infos_arr->data[file_info_offset]->chart_name, p_query_params->chart_name)) {
-                p_file_info = p_file_infos_arr->data[file_info_offset];
-                break;
-            }
-        }
-    } 
-    else if(p_query_params->filename && p_query_params->filename[0] != '\0'){
-        for (int file_info_offset = 0; file_info_offset < p_file_infos_arr->count; file_info_offset++) {
-            if (!strcmp(p_file_infos_arr->data[file_info_offset]->filename, p_query_params->filename)) {
-                p_file_info = p_file_infos_arr->data[file_info_offset];
-                break;
-            }
-        }
+    /* Log lines can only be matched against a predicate if they can be parsed */
+    if(p_query_params->line_predicate){
+        if(!p_file_info->parser_config) return 0;
+        p_query_params->predicate_search = log_line_predicate_search_create(p_query_params->line_predicate, 
+                                                                            p_file_info->parser_config);
     }
-    else return -1;
-
-    if(!p_file_info) return -1;
 
     /* Secure DB lock to ensure no data will be transferred from the buffers to the DB 
     * during the query execution and also no other execute_query will try to access the DB
@@ -48,39 +44,261 @@ int execute_query(logs_query_params_t *p_query_params) {
     const uint64_t start_time = get_unix_time_ms();
 
     // Search DB first
-    db_search(p_query_params, p_file_info, max_query_page_size);
+    const int rc = db_search(p_query_params, p_file_info, results_buff_len_init + max_query_page_size);
 
     const uint64_t db_search_time = get_unix_time_ms();
 
-    /* m_assert((p_query_params->results_buff->buffer && p_query_params->results_buff->len) 
-             || !(p_query_params->results_buff->buffer || p_query_params->results_buff->len),
-              "Either both buff and len true or both false"); */
-
     /* Search circular buffer ONLY IF the results len is less than the originally requested max size!
      * p_query_params->end_timestamp will be the originally requested here, as it won't have been
      * updated in db_search() due to (p_query_params->results_buff->len >= max_query_page_size) condition */
-    if (p_query_params->results_buff->len < max_query_page_size) {
+    if (!rc && !logs_query_quota_reached(p_query_params, results_buff_len_init + max_query_page_size)) {
         fprintf_log(LOGS_MANAG_INFO, stderr, "\nSearching circular buffer!\n");
-        if(!p_query_params->keyword) circ_buff_search(p_file_info->msg_buff, p_query_params, max_query_page_size); // TODO: Implement keyword search for circ buffer.
+        circ_buff_search(p_file_info->msg_buff, p_query_params, results_buff_len_init + max_query_page_size);
     }
 
     db_release_lock(p_file_info->db_mut);
 
-    // p_query_params->results_buff->len++;
-    // p_query_params->results_buff->buffer[p_query_params->results_buff->len] = '\0';
+    log_line_predicate_search_destroy(p_query_params->predicate_search);
+    p_query_params->predicate_search = NULL;
 
     const uint64_t end_time = get_unix_time_ms();
     fprintf_log(LOGS_MANAG_INFO, stderr,
                 "It took %" PRId64
-                "ms to execute query "
+                "ms to query %s "
                 "(%" PRId64 "ms DB search, %" PRId64
                 "ms circ buffer search), "
                 "retrieving %zuKB.\n",
-                (int64_t)end_time - start_time,
+                (int64_t)end_time - start_time, p_file_info->chart_name,
                 (int64_t)db_search_time - start_time, (int64_t)end_time - db_search_time,
-                p_query_params->results_buff->len / 1000);
+                (p_query_params->results_buff->len - results_buff_len_init) / 1000);
+
+    return rc;
+}
+
+/**
+ * @brief Query of a single log source, as part of a multi-source query.
+ */
+typedef struct query_source_work {
+    struct File_info *p_file_info;
+    logs_query_params_t query_params;   /**< Query parameters of this source only, with its own results_buff and res_entries */
+    size_t max_query_page_size;
+    size_t res_entry_next;              /**< Next result index entry to be merged */
+    int rc;                             /**< Return code of query_source() */
+} query_source_work_t;
+
+/**
+ * @brief Log sources of a multi-source query, shared by the threads querying them.
+ */
+typedef struct query_sources_pool {
+    query_source_work_t *works;
+    int num_of_sources;
+    int next;                           /**< Next source to be queried. Accessed atomically. */
+} query_sources_pool_t;
+
+/**
+ * @brief Query the log sources of a multi-source query, one after the other, until there are no more left.
+ */
+static void query_sources_worker(void *arg){
+    query_sources_pool_t *pool = arg;
+    int i;
+    while((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_SEQ_CST)) < pool->num_of_sources){
+        query_source_work_t *work = &pool->works[i];
+        work->rc = query_source(work->p_file_info, &work->query_params, work->max_query_page_size);
+    }
+}
+
+/**
+ * @brief Query multiple log sources concurrently and merge their results in time order.
+ * @details The sources are queried by up to QUERY_SOURCES_THREADS_MAX threads of this 
+ * query (rather than the libuv threadpool, which is busy parsing the log sources), 
+ * each source up to its share of the quota, keeping an index of its results. The 
+ * indexes are then k-way merged by timestamp into the results_buff of p_query_params, 
+ * until the quota is reached. 
+ * 
+ * The merge must stop as soon as the results of a source whose results were truncated
+ * have all been merged, as its next results (not retrieved) could be earlier than the 
+ * remaining results of the other sources. The query will be resumed from there through 
+ * the continuation token. 
+ * 
+ * Results at start_timestamp to be skipped (start_timestamp_skip) are kept by each 
+ * source without counting them towards its share of the quota, while the merge skips 
+ * that many in total. This way, each truncated source always contributes at least one 
+ * result that is not skipped, so every page makes progress.
+ * @param p_file_infos Log sources to be queried.
+ * @param num_of_sources Number of items in p_file_infos.
+ * @param p_query_params Query parameters. Merged results will be appended to its results_buff.
+ * @param max_query_page_size Maximum size of results to be appended to results_buff.
+ * @return 0 on success, -1 if the logs of the DB of any of the sources could not be 
+ * read, in which case nothing is appended to results_buff.
+ */
+static int query_sources(struct File_info **p_file_infos, int num_of_sources, 
+                          logs_query_params_t *p_query_params, size_t max_query_page_size){
+    const size_t results_buff_len_init = p_query_params->results_buff->len;
+    query_source_work_t *works = callocz(num_of_sources, sizeof(query_source_work_t));
+    
+    for(int i = 0; i < num_of_sources; i++){
+        query_source_work_t *work = &works[i];
+        work->p_file_info = p_file_infos[i];
+        work->query_params = *p_query_params;
+        work->query_params.results_buff = buffer_create(QUERY_SOURCE_RES_BUFF_INIT_SIZE);
+        work->query_params.res_entries_max = QUERY_SOURCE_RES_ENTRIES_INIT;
+        work->query_params.res_entries = mallocz(work->query_params.res_entries_max * sizeof(logs_query_res_entry_t));
+        work->query_params.res_entries_num = 0;
+        work->query_params.start_timestamp_skipped = 0;
+        work->query_params.quota_uncounted = 0;
+        work->max_query_page_size = max_query_page_size / (size_t) num_of_sources;
+        if(!work->max_query_page_size) work->max_query_page_size = 1;
+    }
+
+    /* The thread of the query queries sources too, so only spawn the rest */
+    query_sources_pool_t pool = { .works = works, .num_of_sources = num_of_sources, .next = 0 };
+    const int num_of_threads = (num_of_sources < QUERY_SOURCES_THREADS_MAX ? num_of_sources : QUERY_SOURCES_THREADS_MAX) - 1;
+    uv_thread_t threads[QUERY_SOURCES_THREADS_MAX];
+    int threads_created = 0;
+    for(; threads_created < num_of_threads; threads_created++){
+        if(uv_thread_create(&threads[threads_created], query_sources_worker, &pool)){
+            fprintf_log(LOGS_MANAG_WARNING, stderr, "uv_thread_create() failed for multi-source query\n");
+            break;
+        }
+    }
+    query_sources_worker(&pool);
+    for(int i = 0; i < threads_created; i++) uv_thread_join(&threads[i]);
+
+    /* Results with a gap in the middle of them must not be returned */
+    int rc = 0;
+    for(int i = 0; i < num_of_sources && !rc; i++) rc = works[i].rc;
+
+    /* k-way merge of results by timestamp. A linear scan of the heads is used, 
+     * as the number of sources is small. Ties are resolved by source order. */
+    while(!rc){
+        query_source_work_t *min_work = NULL;
+        for(int i = 0; i < num_of_sources; i++){
+            query_source_work_t *work = &works[i];
+            if(work->res_entry_next == work->query_params.res_entries_num) continue;
+            if(!min_work || work->query_params.res_entries[work->res_entry_next].timestamp < 
+                            min_work->query_params.res_entries[min_work->res_entry_next].timestamp)
+                min_work = work;
+        }
+        if(!min_work) break;
+
+        const logs_query_res_entry_t *res_entry = &min_work->query_params.res_entries[min_work->res_entry_next++];
+        const int min_work_exhausted = min_work->query_params.truncated && 
+                                       min_work->res_entry_next == min_work->query_params.res_entries_num;
+        if(res_entry->timestamp == p_query_params->start_timestamp && 
+           p_query_params->start_timestamp_skipped < p_query_params->start_timestamp_skip){
+            p_query_params->start_timestamp_skipped++;
+            if(min_work_exhausted) break; // Cannot happen, as the last result of a truncated source is never skipped
+            continue;
+        }
+        BUFFER *results_buff = p_query_params->results_buff;
+        buffer_need_bytes(results_buff, res_entry->size + 1);
+        const size_t res_offset = results_buff->len;
+        memcpy(&results_buff->buffer[results_buff->len], &min_work->query_params.results_buff->buffer[res_entry->offset], res_entry->size);
+        results_buff->len += res_entry->size;
+        results_buff->buffer[results_buff->len] = '\0';
+        logs_query_res_append(p_query_params, res_entry->timestamp, res_offset);
+
+        if(min_work_exhausted || results_buff->len - results_buff_len_init >= max_query_page_size){
+            p_query_params->end_timestamp = res_entry->timestamp;
+            p_query_params->truncated = 1;
+            break;
+        }
+    }
+
+    for(int i = 0; i < num_of_sources; i++){
+        buffer_free(works[i].query_params.results_buff);
+        freez(works[i].query_params.res_entries);
+    }
+    freez(works);
+    return rc;
+}
+
+int execute_query(logs_query_params_t *p_query_params) {
+    int num_of_sources = 0;
+    size_t max_query_page_size = p_query_params->quota ? p_query_params->quota : p_query_params->results_buff->size;
+    /* Requested max size of results must be smaller than maximum size of each DB row entry. */
+    if(max_query_page_size > MAX_LOG_MSG_SIZE) max_query_page_size = MAX_LOG_MSG_SIZE;
+    p_query_params->act_start_timestamp = p_query_params->act_end_timestamp = 0;
+    p_query_params->act_end_timestamp_num = 0;
+    p_query_params->start_timestamp_skipped = 0;
+    p_query_params->quota_uncounted = 0;
+    p_query_params->truncated = 0;
+    const size_t results_buff_len_init = p_query_params->results_buff->len;
+
+    fprintf_log(LOGS_MANAG_DEBUG, stderr, "Query params:%lu\n%lu\n%s\n%s\n%s\n", p_query_params->start_timestamp, p_query_params->end_timestamp, 
+         p_query_params->chart_name, p_query_params->filename, p_query_params->keyword);
+
+    if(!p_file_infos_arr || !p_file_infos_arr->count) return -1;
+    struct File_info **p_file_infos = mallocz(p_file_infos_arr->count * sizeof(struct File_info *));
+
+    /* Find the log sources for this query according to chart_name (which may be a list or 
+     * simple pattern of chart names) or filename if the former is not valid. */
+    if(p_query_params->chart_name && p_query_params->chart_name[0] != '\0'){
+        SIMPLE_PATTERN *chart_names = simple_pattern_create(p_query_params->chart_name, ",|", SIMPLE_PATTERN_EXACT);
+        for (int file_info_offset = 0; file_info_offset < p_file_infos_arr->count; file_info_offset++) {
+            if (simple_pattern_matches(chart_names, p_file_infos_arr->data[file_info_offset]->chart_name))
+                p_file_infos[num_of_sources++] = p_file_infos_arr->data[file_info_offset];
+        }
+        simple_pattern_free(chart_names);
+    } 
+    else if(p_query_params->filename && p_query_params->filename[0] != '\0'){
+        for (int file_info_offset = 0; file_info_offset < p_file_infos_arr->count; file_info_offset++) {
+            if (!strcmp(p_file_infos_arr->data[file_info_offset]->filename, p_query_params->filename)) {
+                p_file_infos[num_of_sources++] = p_file_infos_arr->data[file_info_offset];
+                break;
+            }
+        }
+    }
+
+    if(!num_of_sources){
+        freez(p_file_infos);
+        return -1;
+    }
+
+    const uint64_t start_time = get_unix_time_ms();
+
+    /* Compile predicate once for the whole query. Each log source will need its own 
+     * parse plan to match it though, see query_source(). */
+    if(p_query_params->predicate && *p_query_params->predicate){
+        p_query_params->line_predicate = log_line_predicate_create(p_query_params->predicate);
+        if(!p_query_params->line_predicate){
+            freez(p_file_infos);
+            return -3;
+        }
+    }
+
+    /* Compile keyword once for the whole query (and all the log sources of it). */
+    if(p_query_params->keyword && *p_query_params->keyword && strcmp(p_query_params->keyword, " "))
+        p_query_params->keyword_matcher = keyword_matcher_create(p_query_params->keyword, !p_query_params->case_sensitive);
+
+    const int rc = num_of_sources == 1 ? query_source(p_file_infos[0], p_query_params, max_query_page_size) : 
+                   query_sources(p_file_infos, num_of_sources, p_query_params, max_query_page_size);
+
+    freez(p_file_infos);
+    keyword_matcher_destroy(p_query_params->keyword_matcher);
+    p_query_params->keyword_matcher = NULL;
+    log_line_predicate_destroy(p_query_params->line_predicate);
+    p_query_params->line_predicate = NULL;
+
+    /* The results at start_timestamp that were skipped have been returned too, by the previous page */
+    if(p_query_params->act_end_timestamp == p_query_params->start_timestamp)
+        p_query_params->act_end_timestamp_num += p_query_params->start_timestamp_skipped;
+
+    const uint64_t end_time = get_unix_time_ms();
+    fprintf_log(LOGS_MANAG_INFO, stderr, "It took %" PRId64 "ms to execute query on %d log source(s), retrieving %zuKB.\n",
+                (int64_t)end_time - start_time, num_of_sources, 
+                (p_query_params->results_buff->len - results_buff_len_init) / 1000);
+
+    /* Incomplete results are dropped rather than returned as if they were all the results */
+    if(unlikely(rc)){
+        p_query_params->results_buff->len = results_buff_len_init;
+        p_query_params->results_buff->buffer[results_buff_len_init] = '\0';
+        p_query_params->act_start_timestamp = p_query_params->act_end_timestamp = 0;
+        p_query_params->act_end_timestamp_num = 0;
+        return -4;
+    }
 
-    if(!p_query_params->results_buff->len) return -2;
+    if(p_query_params->results_buff->len == results_buff_len_init) return -2;
 
     return 0;
 }
@@ -14,20 +14,131 @@
 /**
  * @brief Parameters of the query.
  * @param start_timestamp Start timestamp of query in milliseconds.
- * @param end_timestamp End timestamp of query in milliseconds.
+ * @param end_timestamp End timestamp of query in milliseconds. If the results 
+ * exceed the quota, it will be updated to the timestamp of the last returned result 
+ * (which may be the requested end timestamp too, see truncated).
+ * @param keyword If not NULL (or empty), only the log lines matching it will be returned. It is 
+ * searched for as a literal substring, unless it contains regex special characters, in which 
+ * case it is treated as an extended regular expression.
+ * @param case_sensitive Keyword search is case insensitive, unless this is set to 1.
+ * @param predicate If not NULL (or empty), only the log lines that contributed to the given 
+ * chart dimensions will be returned (in addition to matching keyword, if any), so that a chart 
+ * anomaly can be correlated to the log lines behind it. It is a list of "<chart id>:<dimension>"
+ * conditions separated by '|', e.g. "responses:5xx|vhost:example.com" (see 
+ * log_line_predicate_create()). Only log sources with a log format can be searched this way.
+ * @param quota Maximum size of results (in bytes). If 0, the size of results_buff is used instead.
+ * @param start_timestamp_skip Number of results at start_timestamp to skip, as they have been 
+ * returned already. Used to resume a query that reached the quota in the middle of results that 
+ * share the same timestamp (see act_end_timestamp_num).
+ * @param act_start_timestamp Timestamp of the first result actually returned (0 if no results).
+ * @param act_end_timestamp Timestamp of the last result actually returned (0 if no results).
+ * @param act_end_timestamp_num Number of results at act_end_timestamp returned so far, including 
+ * any skipped through start_timestamp_skip. To resume a query, it should be passed as 
+ * start_timestamp_skip with act_end_timestamp as start_timestamp.
+ * @param truncated Set if the quota was reached, so there may be more results, up to 
+ * end_timestamp as originally requested, to be returned by resuming the query.
+ * @param res_entries If not NULL, an index of each result appended to results_buff will be 
+ * kept here. Used internally when merging the results of multiple log sources.
+ * @param keyword_matcher Compiled keyword, set internally by execute_query() so that the 
+ * keyword is compiled only once per query.
+ * @param line_predicate Compiled predicate, set internally by execute_query().
+ * @param predicate_search Predicate search state of the log source being queried, set internally.
+ * @param start_timestamp_skipped Number of results skipped so far, out of start_timestamp_skip.
+ * @param quota_uncounted Size of the results that are kept in results_buff but must not count 
+ * towards the quota. When an index of results is kept, the results to be skipped are only 
+ * skipped while merging, as start_timestamp_skip refers to the merged results.
  */
+typedef struct logs_query_res_entry {
+    uint64_t timestamp;     /**< Timestamp of result */
+    size_t offset;          /**< Offset of result in results_buff */
+    size_t size;            /**< Size of result in results_buff (excluding any terminating NUL char) */
+} logs_query_res_entry_t;
+
 typedef struct logs_query_params {
     uint64_t start_timestamp;
     uint64_t end_timestamp;
     char *chart_name;
     char *filename;
     char *keyword;
+    int case_sensitive;
+    char *predicate;
     BUFFER *results_buff;
+    size_t quota;
+    size_t start_timestamp_skip;
+    uint64_t act_start_timestamp;
+    uint64_t act_end_timestamp;
+    size_t act_end_timestamp_num;
+    int truncated;
+    logs_query_res_entry_t *res_entries;
+    size_t res_entries_num;
+    size_t res_entries_max;
+    struct Keyword_matcher *keyword_matcher;
+    struct Log_line_predicate *line_predicate;
+    struct log_line_predicate_search *predicate_search;
+    size_t start_timestamp_skipped;
+    size_t quota_uncounted;
 } logs_query_params_t;
 
+/**
+ * @brief Check if a result must be skipped, because it has been returned already.
+ * @details To be called for each result found, before it is appended to results_buff.
+ * @param p_query_params Query parameters the result was found for.
+ * @param timestamp Timestamp of the result.
+ * @param size Size of the result (excluding any terminating NUL char).
+ * @return 1 if the result must not be appended, 0 otherwise.
+ */
+static inline int logs_query_res_skip(logs_query_params_t *p_query_params, uint64_t timestamp, size_t size){
+    if(timestamp != p_query_params->start_timestamp || 
+       p_query_params->start_timestamp_skipped == p_query_params->start_timestamp_skip) return 0;
+    p_query_params->start_timestamp_skipped++;
+    if(p_query_params->res_entries){
+        p_query_params->quota_uncounted += size;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Check if the results appended to results_buff have reached max_query_page_size.
+ */
+static inline int logs_query_quota_reached(logs_query_params_t *p_query_params, size_t max_query_page_size){
+    return p_query_params->results_buff->len - p_query_params->quota_uncounted >= max_query_page_size;
+}
+
+/**
+ * @brief Update the actual timestamps range (and index, if kept) of the results, 
+ * after a result has been appended to results_buff.
+ * @param p_query_params Query parameters the result was appended to.
+ * @param timestamp Timestamp of the appended result.
+ * @param offset Offset in results_buff where the appended result starts.
+ */
+static inline void logs_query_res_append(logs_query_params_t *p_query_params, uint64_t timestamp, size_t offset){
+    if(!p_query_params->act_start_timestamp) p_query_params->act_start_timestamp = timestamp;
+    if(p_query_params->act_end_timestamp == timestamp) p_query_params->act_end_timestamp_num++;
+    else p_query_params->act_end_timestamp_num = 1;
+    p_query_params->act_end_timestamp = timestamp;
+
+    if(p_query_params->res_entries){
+        if(p_query_params->res_entries_num == p_query_params->res_entries_max){
+            p_query_params->res_entries_max *= 2;
+            p_query_params->res_entries = reallocz(p_query_params->res_entries, 
+                p_query_params->res_entries_max * sizeof(logs_query_res_entry_t));
+        }
+        logs_query_res_entry_t *res_entry = &p_query_params->res_entries[p_query_params->res_entries_num++];
+        res_entry->timestamp = timestamp;
+        res_entry->offset = offset;
+        res_entry->size = p_query_params->results_buff->len - offset;
+    }
+}
+
 /** 
  * @brief Primary query API. 
- * @return -1 if chart name not found, -2 if query returns no results, 0 if successful. 
+ * @details chart_name can be either the chart name of a single log source, or a 
+ * list (separated by ',' or '|') and/or simple pattern of chart names, in which 
+ * case all the matching log sources will be searched concurrently and their results
+ * will be merged in time order, up to the quota.
+ * @return -1 if chart name not found, -2 if query returns no results, -3 if the 
+ * predicate is not valid, -4 if the logs could not be read from the DB, 0 if successful. 
  * @todo Implement keyword search (currently only search by timestamps is supported).
  * @todo Cornercase if filename not found in DB? Return specific message?
  */
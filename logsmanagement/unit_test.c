@@ -0,0 +1,1185 @@
+/** @file unit_test.c
+ *  @brief This is the file containing the unit tests of the log management engine
+ *
+ *  The tests are run with `netdata -W logsmanagementtest` (and as part of `-W unittest`).
+ *  They only use temporary files, so they can be run without any log management configuration.
+ */
+
+#include "unit_test.h"
+#include <dirent.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "circular_buffer.h"
+#include "compression.h"
+#include "db_api.h"
+#include "helper.h"
+#include "parser.h"
+
+#define UNIT_TEST_LOG_LINES 64
+
+/**
+ * @brief Fill a buffer with text that looks like (web server) log lines
+ * @param[out] text Buffer to fill, of size text_size_max
+ * @param[in] text_size_max Size of text
+ * @param[in] seed Varies the contents of the log lines
+ * @return Size of the text, including its terminating NUL char (the way Message_t::text_size counts it).
+ */
+static size_t unit_test_log_lines(char *text, size_t text_size_max, int seed){
+    size_t len = 0;
+    for(int i = 0; i < UNIT_TEST_LOG_LINES && len < text_size_max; i++){
+        len += (size_t) snprintf(&text[len], text_size_max - len,
+            "127.0.0.%d - - [17/Oct/2026:10:%02d:%02d +0000] \"GET /api/v1/data?chart=system.cpu&after=-%d HTTP/1.1\" %d %d\n",
+            (i + seed) % 254 + 1, (i + seed) % 60, i % 60, (i * 7 + seed) % 600, i % 9 ? 200 : 404, 1000 + (i * 37 + seed) % 9000);
+    }
+    if(len >= text_size_max) len = text_size_max - 1;
+    text[len] = '\0';
+    return len + 1;
+}
+
+/**
+ * @brief Compress text into a newly allocated buffer
+ * @param[in] text Text to compress (its terminating NUL char included in text_size)
+ * @param[in] codec One of LOGS_COMPR_CODEC_*
+ * @param[in] compr_dict Dictionary to compress with, if codec is LOGS_COMPR_CODEC_LZ4_DICT
+ * @param[out] msg Message with the compressed text, its text_compressed must be freed.
+ */
+static void unit_test_compress(char *text, size_t text_size, uint8_t codec, const struct compr_dict *compr_dict, Message_t *msg){
+    memset(msg, 0, sizeof(*msg));
+    msg->text = text;
+    msg->text_size = text_size;
+    msg->codec = codec;
+    if(compr_dict){
+        msg->dict_id = compr_dict->id;
+        msg->dict = compr_dict->data;
+        msg->dict_size = compr_dict->size;
+        msg->dict_stream = compr_dict->lz4_stream;
+    }
+    compress_text(msg);
+}
+
+/**
+ * @brief Create a log source in a temporary directory and open its DB
+ * @details The log source has its own DB directory <tmp_dir>/<name>/ and its log file 
+ * is <tmp_dir>/<name>.log, which is only read (to train a compression dictionary) 
+ * if it exists when the DB is opened.
+ * @param[in] tmp_dir Temporary directory to create the log source in
+ * @param[in] name Chart name of the log source, also used for its DB directory and log file
+ * @param[in] codec Codec to compress the log messages with, one of LOGS_COMPR_CODEC_*
+ * @param[in] db_write_batch_max_msgs Maximum number of log messages per DB writer batch
+ * @return The log source, to be destroyed with unit_test_log_source_destroy().
+ */
+static struct File_info *unit_test_log_source_create(const char *tmp_dir, const char *name, uint8_t codec, int db_write_batch_max_msgs){
+    struct File_info *p_file_info = callocz(1, sizeof(struct File_info));
+    char path[FILENAME_MAX + 1];
+    struct stat statbuf;
+
+    snprintf(path, FILENAME_MAX, "%s/%s/", tmp_dir, name);
+    fatal_assert(!mkdir(path, 0755));
+    p_file_info->db_dir = strdupz(path);
+    snprintf(path, FILENAME_MAX, "%s/%s.log", tmp_dir, name);
+    p_file_info->filename = strdupz(path);
+    p_file_info->file_basename = strrchr(p_file_info->filename, '/') + 1;
+    p_file_info->chart_name = strdupz(name);
+    if(!stat(p_file_info->filename, &statbuf)) p_file_info->filesize = (uint64_t) statbuf.st_size;
+    p_file_info->compr_codec = codec;
+    p_file_info->db_flush_interval = 1000;
+    p_file_info->db_write_batch_max_msgs = db_write_batch_max_msgs;
+    p_file_info->msg_buff = circ_buff_init(UNIT_TEST_LOG_LINES, 64 MiB, 0);
+
+    db_log_source_open(p_file_info, 2048);
+    return p_file_info;
+}
+
+/**
+ * @brief Close the DB of a log source created with unit_test_log_source_create() and free it
+ */
+static void unit_test_log_source_destroy(struct File_info *p_file_info){
+    Circ_buff_t *buff = p_file_info->msg_buff;
+
+    db_log_source_close(p_file_info);
+    for(int i = 0; i < buff->num_of_items; i++){
+        freez(buff->msgs[i].text);
+        freez(buff->msgs[i].text_compressed);
+        freez(buff->msgs[i].bloom);
+    }
+    freez(buff->msgs);
+    freez(buff);
+    freez(p_file_info->search_span_buff);
+    freez((void *) p_file_info->db_dir);
+    freez((void *) p_file_info->filename);
+    freez((void *) p_file_info->chart_name);
+    freez(p_file_info);
+}
+
+/**
+ * @brief Insert a log message in the circular buffer of a log source, ready to be written to the DB
+ * @details The log message is compressed and its bloom filter is built, as when it is parsed.
+ * @param[in] text Text of the log message (its terminating NUL char included in text_size)
+ */
+static void unit_test_buff_insert(struct File_info *p_file_info, uint64_t timestamp, const char *text, size_t text_size){
+    Circ_buff_t *buff = p_file_info->msg_buff;
+    fatal_assert(buff->head - buff->tail < (uint64_t) buff->num_of_items);
+    Message_t *p_msg = &buff->msgs[buff->head & buff->size_mask];
+
+    if(text_size > p_msg->text_size_max){
+        p_msg->text_size_max = text_size;
+        p_msg->text = reallocz(p_msg->text, p_msg->text_size_max);
+    }
+    memcpy(p_msg->text, text, text_size);
+    p_msg->text_size = text_size;
+    p_msg->timestamp = timestamp;
+    p_msg->codec = p_file_info->compr_codec;
+    if(p_msg->codec == LOGS_COMPR_CODEC_LZ4_DICT){
+        const struct compr_dict *compr_dict = &p_file_info->compr_dicts[p_file_info->compr_dicts_num - 1];
+        p_msg->dict_id = compr_dict->id;
+        p_msg->dict = compr_dict->data;
+        p_msg->dict_size = compr_dict->size;
+        p_msg->dict_stream = compr_dict->lz4_stream;
+    }
+    compress_text(p_msg);
+
+    unsigned bloom_hashes;
+    p_msg->bloom_size = keyword_bloom_filter_size(p_msg->text, p_msg->text_size, &bloom_hashes);
+    if(p_msg->bloom_size > p_msg->bloom_size_max){
+        p_msg->bloom_size_max = p_msg->bloom_size;
+        p_msg->bloom = reallocz(p_msg->bloom, p_msg->bloom_size_max);
+    }
+    keyword_bloom_filter_build(p_msg->text, p_msg->text_size, p_msg->bloom, p_msg->bloom_size, bloom_hashes);
+
+    buff->text_size_total += text_size;
+    buff->head++;
+    buff->parsed = buff->head;
+}
+
+/**
+ * @brief Search the DB of a log source for all the log messages within a time range
+ * @return The results, to be freed with buffer_free().
+ */
+static BUFFER *unit_test_db_search(struct File_info *p_file_info, uint64_t start_timestamp, uint64_t end_timestamp){
+    logs_query_params_t query_params = { .start_timestamp = start_timestamp, .end_timestamp = end_timestamp };
+    query_params.results_buff = buffer_create(1 KiB);
+    db_set_lock(p_file_info->db_mut);
+    db_search(&query_params, p_file_info, 256 MiB);
+    db_release_lock(p_file_info->db_mut);
+    return query_params.results_buff;
+}
+
+/**
+ * @brief Remove a temporary directory and all the files and directories in it
+ */
+static void unit_test_rmdir(const char *dir){
+    char path[FILENAME_MAX + 1];
+    struct stat statbuf;
+    struct dirent *entry;
+    DIR *dirp = opendir(dir);
+
+    while(dirp && (entry = readdir(dirp))){
+        if(!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+        snprintf(path, FILENAME_MAX, "%s/%s", dir, entry->d_name);
+        if(!lstat(path, &statbuf) && S_ISDIR(statbuf.st_mode)) unit_test_rmdir(path);
+        else unlink(path);
+    }
+    if(dirp) closedir(dirp);
+    rmdir(dir);
+}
+
+/**
+ * @brief Test that decompress_text() reports the log messages it cannot decompress
+ */
+static int test_decompress_text_errors(void){
+    int errors = 0;
+    char text[8 KiB], out[8 KiB];
+    const size_t text_size = unit_test_log_lines(text, sizeof(text), 0);
+    struct compr_dict compr_dict = { .id = 1, .data = mallocz(4 KiB), .size = 0 };
+    compr_dict.size = unit_test_log_lines(compr_dict.data, 4 KiB, 1) - 1;
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    Message_t msg;
+    unit_test_compress(text, text_size, LOGS_COMPR_CODEC_LZ4_DICT, &compr_dict, &msg);
+    if(msg.codec != LOGS_COMPR_CODEC_LZ4_DICT){
+        fprintf(stderr, "- FAILED: text was not compressed with the dictionary\n");
+        errors++;
+    }
+
+    /* Missing dictionary */
+    msg.text = NULL;
+    msg.dict = NULL;
+    msg.dict_size = 0;
+    if(!decompress_text(&msg, out)){
+        fprintf(stderr, "- FAILED: decompression without the dictionary did not fail\n");
+        errors++;
+    }
+    freez(msg.text_compressed);
+
+    /* Truncated LZ4 frame */
+    unit_test_compress(text, text_size, LOGS_COMPR_CODEC_LZ4F, NULL, &msg);
+    msg.text = NULL;
+    msg.text_compressed_size /= 2;
+    if(!decompress_text(&msg, out)){
+        fprintf(stderr, "- FAILED: decompression of a truncated LZ4 frame did not fail\n");
+        errors++;
+    }
+
+    /* Intact LZ4 frame */
+    freez(msg.text_compressed);
+    unit_test_compress(text, text_size, LOGS_COMPR_CODEC_LZ4F, NULL, &msg);
+    msg.text = NULL;
+    if(decompress_text(&msg, out) || memcmp(out, text, text_size)){
+        fprintf(stderr, "- FAILED: decompression of an intact LZ4 frame failed\n");
+        errors++;
+    }
+    freez(msg.text_compressed);
+    freez(compr_dict.data);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test compression with a dictionary loaded once in an LZ4 stream
+ * @details The stream is shared by all the log messages compressed with the dictionary, 
+ * so compressing a log message must not depend on the ones compressed before it.
+ */
+static int test_compress_text_dict_stream(void){
+    int errors = 0;
+    char text[2][8 KiB], out[8 KiB];
+    size_t text_size[2];
+    for(int i = 0; i < 2; i++) text_size[i] = unit_test_log_lines(text[i], sizeof(text[i]), i + 2);
+    struct compr_dict compr_dict = { .id = 1, .data = mallocz(4 KiB), .size = 0 };
+    compr_dict.size = unit_test_log_lines(compr_dict.data, 4 KiB, 1) - 1;
+    compr_dict.lz4_stream = compr_dict_stream_create(compr_dict.data, compr_dict.size);
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    /* text[0] is compressed again after text[1], the results must be the same */
+    Message_t msg[3];
+    for(int i = 0; i < 3; i++){
+        unit_test_compress(text[i % 2], text_size[i % 2], LOGS_COMPR_CODEC_LZ4_DICT, &compr_dict, &msg[i]);
+        msg[i].text = NULL;
+        if(msg[i].codec != LOGS_COMPR_CODEC_LZ4_DICT || decompress_text(&msg[i], out) || 
+           memcmp(out, text[i % 2], text_size[i % 2])){
+            fprintf(stderr, "- FAILED: log message %d was not compressed with the dictionary stream\n", i);
+            errors++;
+        }
+    }
+    if(msg[2].text_compressed_size != msg[0].text_compressed_size || 
+       memcmp(msg[2].text_compressed, msg[0].text_compressed, msg[0].text_compressed_size)){
+        fprintf(stderr, "- FAILED: compression depends on the previous log message\n");
+        errors++;
+    }
+
+    for(int i = 0; i < 3; i++) freez(msg[i].text_compressed);
+    LZ4_freeStream(compr_dict.lz4_stream);
+    freez(compr_dict.data);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test that the DB compactor never loses the log messages it cannot decompress
+ * @details A BLOB with two log messages is recompressed: one compressed with a dictionary
+ * of the log source and one whose dictionary is missing. The latter must be copied as it
+ * is, with its codec and dictionary id unchanged.
+ */
+static int test_db_blob_recompress_missing_dict(void){
+    int errors = 0, rc;
+    char tmp_dir[] = "/tmp/netdata-logsmanagement-unittest-XXXXXX";
+    char blob_path[FILENAME_MAX + 1], compact_path[FILENAME_MAX + 1];
+    char text[2][8 KiB];
+    size_t text_size[2];
+    uv_fs_t req;
+    uv_loop_t loop;
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    if(!mkdtemp(tmp_dir)){
+        fprintf(stderr, "- FAILED: cannot create %s\n", tmp_dir);
+        return 1;
+    }
+    fatal_assert(!uv_loop_init(&loop));
+    snprintf(blob_path, FILENAME_MAX, "%s/logs.bin.1", tmp_dir);
+    snprintf(compact_path, FILENAME_MAX, "%s/logs.bin.compact.1", tmp_dir);
+
+    struct compr_dict compr_dicts[2] = {
+        { .id = 1, .data = mallocz(4 KiB), .size = 0 },
+        { .id = 2, .data = mallocz(4 KiB), .size = 0 }  // Not known to the log source
+    };
+    for(int i = 0; i < 2; i++) compr_dicts[i].size = unit_test_log_lines(compr_dicts[i].data, 4 KiB, i + 1) - 1;
+
+    struct File_info *p_file_info = callocz(1, sizeof(struct File_info));
+    p_file_info->filename = "unittest.log";
+    p_file_info->compr_dicts = &compr_dicts[0];
+    p_file_info->compr_dicts_num = 1;
+
+    /* Write the BLOB */
+    Message_t msg[2];
+    db_compact_msg_t msgs[2];
+    rc = uv_fs_open(&loop, &req, blob_path, UV_FS_O_RDWR | UV_FS_O_CREAT, 0644, NULL);
+    uv_fs_req_cleanup(&req);
+    fatal_assert(rc >= 0);
+    const uv_file blob_handle = rc;
+    int64_t offset = 0;
+    for(int i = 0; i < 2; i++){
+        text_size[i] = unit_test_log_lines(text[i], sizeof(text[i]), i);
+        unit_test_compress(text[i], text_size[i], LOGS_COMPR_CODEC_LZ4_DICT, &compr_dicts[i], &msg[i]);
+        msgs[i] = (db_compact_msg_t) { .id = i + 1, .offset = offset, .text_compressed_size = msg[i].text_compressed_size,
+                                       .text_size = text_size[i], .codec = msg[i].codec, .dict_id = msg[i].dict_id };
+        uv_buf_t uv_buf = uv_buf_init(msg[i].text_compressed, (unsigned int) msg[i].text_compressed_size);
+        rc = uv_fs_write(&loop, &req, blob_handle, &uv_buf, 1, offset, NULL);
+        uv_fs_req_cleanup(&req);
+        fatal_assert(rc == (int) msg[i].text_compressed_size);
+        offset += rc;
+    }
+
+    /* Recompress it */
+    rc = uv_fs_open(&loop, &req, compact_path, UV_FS_O_RDWR | UV_FS_O_CREAT | UV_FS_O_TRUNC, 0644, NULL);
+    uv_fs_req_cleanup(&req);
+    fatal_assert(rc >= 0);
+    const uv_file compact_handle = rc;
+    int64_t compact_filesize = 0;
+    if(db_blob_recompress(p_file_info, blob_handle, compact_handle, msgs, 2, &loop, &compact_filesize)){
+        fprintf(stderr, "- FAILED: db_blob_recompress() failed\n");
+        errors++;
+    }
+
+    /* The log message with the missing dictionary must be intact */
+    char *compressed = mallocz(msg[1].text_compressed_size);
+    uv_buf_t uv_buf = uv_buf_init(compressed, (unsigned int) msg[1].text_compressed_size);
+    rc = uv_fs_read(&loop, &req, compact_handle, &uv_buf, 1, msgs[1].offset, NULL);
+    uv_fs_req_cleanup(&req);
+    if(msgs[1].codec != LOGS_COMPR_CODEC_LZ4_DICT || msgs[1].dict_id != 2 ||
+       msgs[1].text_compressed_size != msg[1].text_compressed_size || rc != (int) msg[1].text_compressed_size ||
+       memcmp(compressed, msg[1].text_compressed, msg[1].text_compressed_size)){
+        fprintf(stderr, "- FAILED: log message with missing dictionary was not kept as it is\n");
+        errors++;
+    }
+    freez(compressed);
+
+    /* The other log message must still decompress to the same text */
+    Message_t temp_msg = { .text_compressed = mallocz(msgs[0].text_compressed_size), .text_compressed_size = msgs[0].text_compressed_size,
+                           .text_size = msgs[0].text_size, .codec = (uint8_t) msgs[0].codec, .dict_id = msgs[0].dict_id };
+    if(temp_msg.codec == LOGS_COMPR_CODEC_LZ4_DICT){
+        temp_msg.dict = compr_dicts[0].data;
+        temp_msg.dict_size = compr_dicts[0].size;
+    }
+    uv_buf = uv_buf_init(temp_msg.text_compressed, (unsigned int) temp_msg.text_compressed_size);
+    rc = uv_fs_read(&loop, &req, compact_handle, &uv_buf, 1, msgs[0].offset, NULL);
+    uv_fs_req_cleanup(&req);
+    if(rc != (int) temp_msg.text_compressed_size || decompress_text(&temp_msg, NULL) ||
+       memcmp(temp_msg.text, text[0], text_size[0])){
+        fprintf(stderr, "- FAILED: recompressed log message does not match the original\n");
+        errors++;
+    }
+    if(compact_filesize != (int64_t) (msgs[0].text_compressed_size + msgs[1].text_compressed_size)){
+        fprintf(stderr, "- FAILED: wrong size of recompressed BLOB: %" PRId64 "\n", compact_filesize);
+        errors++;
+    }
+    freez(temp_msg.text);
+    freez(temp_msg.text_compressed);
+
+    for(int i = 0; i < 2; i++){
+        freez(msg[i].text_compressed);
+        freez(compr_dicts[i].data);
+    }
+    freez(p_file_info);
+    uv_fs_close(&loop, &req, blob_handle, NULL);
+    uv_fs_req_cleanup(&req);
+    uv_fs_close(&loop, &req, compact_handle, NULL);
+    uv_fs_req_cleanup(&req);
+    uv_fs_unlink(&loop, &req, blob_path, NULL);
+    uv_fs_req_cleanup(&req);
+    uv_fs_unlink(&loop, &req, compact_path, NULL);
+    uv_fs_req_cleanup(&req);
+    uv_fs_rmdir(&loop, &req, tmp_dir, NULL);
+    uv_fs_req_cleanup(&req);
+    uv_loop_close(&loop);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test that paging through results that share the same timestamp with continuation 
+ * tokens returns each of them exactly once
+ * @details The circular buffer is searched with a quota that is reached in the middle of 
+ * the results of each timestamp, resuming from the last returned timestamp (inclusive), 
+ * skipping the results at that timestamp returned already, as execute_query() does. The 
+ * query is resumed for as long as it is truncated, including when the quota is reached in 
+ * the middle of the results at the requested end timestamp.
+ */
+static int test_query_continuation_same_timestamp(void){
+    int errors = 0;
+    const int msgs_num = 13, msgs_per_timestamp = 5;
+    const uint64_t end_timestamps[] = { 2000, 1000 + (uint64_t) ((msgs_num - 1) / msgs_per_timestamp) };
+    char expected[1 KiB], returned[1 KiB];
+    size_t expected_len = 0;
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    Circ_buff_t *buff = circ_buff_init(msgs_num, 1 MiB, 0);
+    for(int i = 0; i < msgs_num; i++){
+        Message_t *p_msg = &buff->msgs[i];
+        p_msg->timestamp = 1000 + (uint64_t) (i / msgs_per_timestamp);
+        p_msg->text = mallocz(32);
+        p_msg->text_size = (size_t) snprintf(p_msg->text, 32, "line %02d\n", i) + 1;
+        expected_len += (size_t) snprintf(&expected[expected_len], sizeof(expected) - expected_len, "%s", p_msg->text);
+    }
+    buff->head = buff->parsed = (uint64_t) msgs_num;
+
+    for(size_t e = 0; e < sizeof(end_timestamps) / sizeof(end_timestamps[0]); e++){
+        logs_query_params_t query_params = { .start_timestamp = 0, .end_timestamp = end_timestamps[e] };
+        size_t returned_len = 0;
+        int pages = 0;
+        do {
+            query_params.results_buff = buffer_create(64);
+            query_params.act_start_timestamp = query_params.act_end_timestamp = 0;
+            query_params.act_end_timestamp_num = query_params.start_timestamp_skipped = 0;
+            query_params.truncated = 0;
+            query_params.end_timestamp = end_timestamps[e];
+            circ_buff_search(buff, &query_params, 2 * sizeof("line 00\n"));
+            if(query_params.act_end_timestamp == query_params.start_timestamp)
+                query_params.act_end_timestamp_num += query_params.start_timestamp_skipped;
+
+            if(returned_len + query_params.results_buff->len < sizeof(returned)){
+                memcpy(&returned[returned_len], query_params.results_buff->buffer, query_params.results_buff->len);
+                returned_len += query_params.results_buff->len;
+            }
+            buffer_free(query_params.results_buff);
+
+            /* Resume from the continuation token, if the quota was reached */
+            query_params.start_timestamp = query_params.act_end_timestamp;
+            query_params.start_timestamp_skip = query_params.act_end_timestamp_num;
+        } while(query_params.truncated && ++pages < msgs_num);
+
+        if(returned_len != expected_len || memcmp(returned, expected, expected_len)){
+            fprintf(stderr, "- FAILED: results up to %" PRIu64 " returned through continuation tokens:\n%.*s", 
+                    end_timestamps[e], (int) returned_len, returned);
+            errors++;
+        }
+    }
+
+    for(int i = 0; i < msgs_num; i++) freez(buff->msgs[i].text);
+    freez(buff->msgs);
+    freez(buff);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test the trigram bloom filters of log messages
+ * @details Keyword searches must never skip a log message that contains the keyword 
+ * (no false negatives) and the false positive rate of trigrams that are not in a log 
+ * message must be close to DB_BLOOM_FILTER_FALSE_POSITIVE_RATE, whatever its size.
+ */
+static int test_keyword_bloom_filter(void){
+    int errors = 0;
+    /* Literal keywords only, as bloom filters cannot be used with regular expressions */
+    const char *keywords[] = { "chart=system", "404", "GET /api", "POST", "chart=disk", "after=-999", "HTTP/2", "Mozilla" };
+    const int keywords_num = (int) (sizeof(keywords) / sizeof(keywords[0]));
+    const size_t text_size_max = 256 KiB;
+    char *text = mallocz(text_size_max);
+    size_t trigrams_tested = 0, trigrams_false_positive = 0;
+    unsigned int seed = 1;
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    /* Log messages of 2 KiB up to 256 KiB, with a random request id per line */
+    for(size_t msg_size = 2 KiB; msg_size <= text_size_max; msg_size *= 4){
+        for(int i = 0; i < 16; i++){
+            size_t len = 0;
+            while(len + 256 < msg_size){
+                len += (size_t) snprintf(&text[len], msg_size - len, 
+                    "10.0.%d.%d - - [17/Oct/2026:10:%02d:%02d +0000] \"GET /api/v1/data?chart=system.cpu&after=-%d HTTP/1.1\" %d %d req=%c%c%d%c%c%d\n",
+                    rand_r(&seed) % 256, rand_r(&seed) % 256, rand_r(&seed) % 60, rand_r(&seed) % 60, rand_r(&seed) % 600, 
+                    rand_r(&seed) % 9 ? 200 : 404, rand_r(&seed) % 50000, 'a' + rand_r(&seed) % 26, 'a' + rand_r(&seed) % 26, 
+                    rand_r(&seed) % 10, 'a' + rand_r(&seed) % 26, 'a' + rand_r(&seed) % 26, rand_r(&seed) % 10);
+            }
+            const size_t text_size = len + 1;
+            unsigned hashes = 0;
+            const size_t bloom_size = keyword_bloom_filter_size(text, text_size, &hashes);
+            uint8_t *bloom = mallocz(bloom_size);
+            keyword_bloom_filter_build(text, text_size, bloom, bloom_size, hashes);
+
+            for(int k = 0; k < keywords_num; k++){
+                Keyword_matcher_t *matcher = keyword_matcher_create(keywords[k], 1);
+                if(strcasestr(text, keywords[k]) && !keyword_matcher_bloom_may_match(matcher, bloom, bloom_size)){
+                    fprintf(stderr, "- FAILED: log message containing \"%s\" was skipped\n", keywords[k]);
+                    errors++;
+                }
+                keyword_matcher_destroy(matcher);
+            }
+
+            for(int t = 0; t < 256; t++){
+                const char trigram[4] = { 'a' + rand_r(&seed) % 26, 'a' + rand_r(&seed) % 26, "0123456789=/- "[rand_r(&seed) % 14], '\0' };
+                if(strcasestr(text, trigram)) continue;
+                Keyword_matcher_t *matcher = keyword_matcher_create(trigram, 1);
+                trigrams_tested++;
+                trigrams_false_positive += keyword_matcher_bloom_may_match(matcher, bloom, bloom_size);
+                keyword_matcher_destroy(matcher);
+            }
+            freez(bloom);
+        }
+    }
+    const double false_positive_rate = (double) trigrams_false_positive / (double) trigrams_tested;
+    fprintf(stderr, "- %zu out of %zu trigrams not in the log messages were false positives (%.2f%%)\n", 
+            trigrams_false_positive, trigrams_tested, false_positive_rate * 100);
+    if(false_positive_rate > 2 * DB_BLOOM_FILTER_FALSE_POSITIVE_RATE){
+        fprintf(stderr, "- FAILED: false positive rate is too high\n");
+        errors++;
+    }
+
+    freez(text);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test that the DB writer persists every log message of the circular buffer exactly once
+ * @details The log messages are written in batches limited both in messages and in bytes, 
+ * so a log message that does not fit in the bytes of a batch is carried over to the next one. 
+ * A flush that fails to write the BLOB, before or after part of its batch has landed in it, 
+ * must leave its log messages in the circular buffer and the BLOB at its size before the 
+ * flush, so that the next flush persists them without any duplicates or gaps. Log messages 
+ * that cannot be read back from the BLOB must fail the search.
+ */
+static int test_db_writer_batches(void){
+    int errors = 0;
+    char tmp_dir[] = "/tmp/netdata-logsmanagement-unittest-XXXXXX";
+    const size_t large_text_size = 3 MiB;
+    char *text = mallocz(large_text_size);
+    BUFFER *expected = buffer_create(1 KiB);
+    uint64_t timestamp = 1000;
+    unsigned int seed = 1;
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    if(!mkdtemp(tmp_dir)){
+        fprintf(stderr, "- FAILED: cannot create %s\n", tmp_dir);
+        freez(text);
+        buffer_free(expected);
+        return 1;
+    }
+    struct File_info *p_file_info = unit_test_log_source_create(tmp_dir, "batches", LOGS_COMPR_CODEC_LZ4F, 4);
+    struct db_writer_stats *stats = &p_file_info->db_writer_stats;
+
+    /* 10 log messages, 2 per timestamp, in batches of up to 4 of them */
+    for(int i = 0; i < 10; i++){
+        const size_t text_size = unit_test_log_lines(text, 2 KiB, i);
+        unit_test_buff_insert(p_file_info, timestamp + (uint64_t) (i / 2), text, text_size);
+        buffer_increase(expected, text_size);
+        memcpy(&expected->buffer[expected->len], text, text_size - 1);
+        expected->len += text_size - 1;
+    }
+    timestamp += 5;
+    db_log_source_flush(p_file_info);
+    if(stats->num_of_msgs != 10 || stats->num_of_batches != 3){
+        fprintf(stderr, "- FAILED: %" PRIu64 " log messages written in %" PRIu64 " batches instead of 10 in 3\n", 
+                stats->num_of_msgs, stats->num_of_batches);
+        errors++;
+    }
+
+    /* 3 incompressible log messages, only 2 of which fit in DB_WRITER_BATCH_MAX_BYTES */
+    for(int i = 0; i < 3; i++){
+        for(size_t j = 0; j + 1 < large_text_size; j++) text[j] = (char) (' ' + rand_r(&seed) % 94);
+        text[large_text_size - 1] = '\0';
+        unit_test_buff_insert(p_file_info, timestamp++, text, large_text_size);
+        buffer_increase(expected, large_text_size);
+        memcpy(&expected->buffer[expected->len], text, large_text_size - 1);
+        expected->len += large_text_size - 1;
+    }
+    db_log_source_flush(p_file_info);
+    if(stats->num_of_msgs != 13 || stats->num_of_batches != 5){
+        fprintf(stderr, "- FAILED: %" PRIu64 " log messages written in %" PRIu64 " batches instead of 13 in 5\n", 
+                stats->num_of_msgs, stats->num_of_batches);
+        errors++;
+    }
+
+    /* Failure to write the BLOB, then retry */
+    for(int i = 0; i < 5; i++){
+        const size_t text_size = unit_test_log_lines(text, 2 KiB, 10 + i);
+        unit_test_buff_insert(p_file_info, timestamp++, text, text_size);
+        buffer_increase(expected, text_size);
+        memcpy(&expected->buffer[expected->len], text, text_size - 1);
+        expected->len += text_size - 1;
+    }
+    const uv_file blob_handle = p_file_info->blob_handles[p_file_info->blob_write_handle_offset];
+    p_file_info->blob_handles[p_file_info->blob_write_handle_offset] = -1;
+    db_log_source_flush(p_file_info);
+    p_file_info->blob_handles[p_file_info->blob_write_handle_offset] = blob_handle;
+    if(stats->num_of_msgs != 13 || circ_buff_read_pending(p_file_info->msg_buff) != 5 || 
+       p_file_info->msg_buff->tail == p_file_info->msg_buff->head){
+        fprintf(stderr, "- FAILED: log messages of failed flush were not kept in the circular buffer\n");
+        errors++;
+    }
+    db_log_source_flush(p_file_info);
+    if(stats->num_of_msgs != 18 || p_file_info->msg_buff->tail != p_file_info->msg_buff->head){
+        fprintf(stderr, "- FAILED: log messages of failed flush were not written when retried\n");
+        errors++;
+    }
+
+    /* Failure after part of the batch has been written to the BLOB, then retry. The file size 
+     * limit lets the first incompressible message land whole and the second one only in part. */
+    struct stat statbuf;
+    struct rlimit fsize_limit_orig, fsize_limit;
+    fatal_assert(!fstat(blob_handle, &statbuf));
+    const off_t blob_filesize = statbuf.st_size;
+    for(int i = 0; i < 2; i++){
+        for(size_t j = 0; j + 1 < large_text_size; j++) text[j] = (char) (' ' + rand_r(&seed) % 94);
+        text[large_text_size - 1] = '\0';
+        unit_test_buff_insert(p_file_info, timestamp++, text, large_text_size);
+        buffer_increase(expected, large_text_size);
+        memcpy(&expected->buffer[expected->len], text, large_text_size - 1);
+        expected->len += large_text_size - 1;
+    }
+    void (*sigxfsz_handler_orig)(int) = signal(SIGXFSZ, SIG_IGN);
+    fatal_assert(!getrlimit(RLIMIT_FSIZE, &fsize_limit_orig));
+    fsize_limit = fsize_limit_orig;
+    fsize_limit.rlim_cur = (rlim_t) blob_filesize + large_text_size + large_text_size / 2;
+    if(setrlimit(RLIMIT_FSIZE, &fsize_limit)){
+        fprintf(stderr, "- FAILED: cannot limit the file size to %" PRIu64 " bytes\n", (uint64_t) fsize_limit.rlim_cur);
+        errors++;
+    }
+    db_log_source_flush(p_file_info);
+    fatal_assert(!setrlimit(RLIMIT_FSIZE, &fsize_limit_orig));
+    signal(SIGXFSZ, sigxfsz_handler_orig);
+    fatal_assert(!fstat(blob_handle, &statbuf));
+    if(stats->num_of_msgs != 18 || circ_buff_read_pending(p_file_info->msg_buff) != 2){
+        fprintf(stderr, "- FAILED: log messages of partially written flush were not kept in the circular buffer\n");
+        errors++;
+    }
+    if(statbuf.st_size != blob_filesize){
+        fprintf(stderr, "- FAILED: BLOB of partially written flush is %" PRId64 " bytes instead of %" PRId64 "\n", 
+                (int64_t) statbuf.st_size, (int64_t) blob_filesize);
+        errors++;
+    }
+    db_log_source_flush(p_file_info);
+    if(stats->num_of_msgs != 20 || p_file_info->msg_buff->tail != p_file_info->msg_buff->head){
+        fprintf(stderr, "- FAILED: log messages of partially written flush were not written when retried\n");
+        errors++;
+    }
+
+    BUFFER *results = unit_test_db_search(p_file_info, 0, timestamp);
+    if(results->len != expected->len || memcmp(results->buffer, expected->buffer, expected->len)){
+        fprintf(stderr, "- FAILED: DB search returned %zu bytes instead of the %zu bytes written\n", results->len, expected->len);
+        errors++;
+    }
+    buffer_free(results);
+
+    /* Log messages missing from the BLOB must fail the search rather than be left out of the results */
+    fatal_assert(!ftruncate(blob_handle, blob_filesize / 2));
+    logs_query_params_t query_params = { .start_timestamp = 0, .end_timestamp = timestamp };
+    query_params.results_buff = buffer_create(1 KiB);
+    db_set_lock(p_file_info->db_mut);
+    const int rc = db_search(&query_params, p_file_info, 256 MiB);
+    db_release_lock(p_file_info->db_mut);
+    if(rc != -1){
+        fprintf(stderr, "- FAILED: DB search of truncated BLOB returned %d instead of -1\n", rc);
+        errors++;
+    }
+    buffer_free(query_params.results_buff);
+
+    unit_test_log_source_destroy(p_file_info);
+    unit_test_rmdir(tmp_dir);
+    buffer_free(expected);
+    freez(text);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test that the log messages of each codec can be read back from the DB
+ * @details A log source is created for each codec and its DB is closed and opened 
+ * again before it is searched, so that its compression dictionary (trained from the 
+ * log file) is loaded from the DB rather than trained again. Short log messages must 
+ * compress better with the dictionary than without it. A log source that is too small 
+ * to train a dictionary must fall back to LOGS_COMPR_CODEC_LZ4F.
+ */
+static int test_db_compr_codecs(void){
+    int errors = 0;
+    char tmp_dir[] = "/tmp/netdata-logsmanagement-unittest-XXXXXX";
+    char path[FILENAME_MAX + 1], text[8 KiB];
+    const uint8_t codecs[] = { LOGS_COMPR_CODEC_LZ4F, LOGS_COMPR_CODEC_LZ4F_HC, LOGS_COMPR_CODEC_LZ4_DICT };
+    const char *names[] = { "lz4f", "lz4f_hc", "lz4_dict" };
+    const int msgs_num = 16;
+    size_t compressed_size[3] = {0};
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    if(!mkdtemp(tmp_dir)){
+        fprintf(stderr, "- FAILED: cannot create %s\n", tmp_dir);
+        return 1;
+    }
+
+    /* Log file to train the dictionary from */
+    snprintf(path, FILENAME_MAX, "%s/%s.log", tmp_dir, names[2]);
+    FILE *fp = fopen(path, "w");
+    fatal_assert(fp);
+    for(int i = 0; i < 8; i++){
+        const size_t text_size = unit_test_log_lines(text, sizeof(text), 100 + i);
+        fwrite(text, 1, text_size - 1, fp);
+    }
+    fclose(fp);
+
+    for(int c = 0; c < 3; c++){
+        BUFFER *expected = buffer_create(1 KiB);
+        struct File_info *p_file_info = unit_test_log_source_create(tmp_dir, names[c], codecs[c], 4);
+        if(p_file_info->compr_codec != codecs[c]){
+            fprintf(stderr, "- FAILED: %s log source falls back to codec %d\n", names[c], p_file_info->compr_codec);
+            errors++;
+        }
+        const int dict_id = p_file_info->compr_dicts_num ? p_file_info->compr_dicts[0].id : 0;
+        if((codecs[c] == LOGS_COMPR_CODEC_LZ4_DICT) != (p_file_info->compr_dicts_num == 1)){
+            fprintf(stderr, "- FAILED: %s log source has %d dictionaries\n", names[c], p_file_info->compr_dicts_num);
+            errors++;
+        }
+
+        for(int i = 0; i < msgs_num; i++){
+            const size_t text_size = unit_test_log_lines(text, 512, i);
+            unit_test_buff_insert(p_file_info, 1000 + (uint64_t) i, text, text_size);
+            const Message_t *p_msg = &p_file_info->msg_buff->msgs[i];
+            if(p_msg->codec != codecs[c] || p_msg->dict_id != dict_id){
+                fprintf(stderr, "- FAILED: %s log message compressed with codec %d and dictionary %d\n", 
+                        names[c], p_msg->codec, p_msg->dict_id);
+                errors++;
+            }
+            compressed_size[c] += p_msg->text_compressed_size;
+            buffer_increase(expected, text_size);
+            memcpy(&expected->buffer[expected->len], text, text_size - 1);
+            expected->len += text_size - 1;
+        }
+        db_log_source_flush(p_file_info);
+
+        db_log_source_close(p_file_info);
+        db_log_source_open(p_file_info, 2048);
+        if(p_file_info->compr_codec != codecs[c] || 
+           (p_file_info->compr_dicts_num ? p_file_info->compr_dicts[0].id : 0) != dict_id){
+            fprintf(stderr, "- FAILED: %s log source did not load its dictionary from the DB\n", names[c]);
+            errors++;
+        }
+
+        BUFFER *results = unit_test_db_search(p_file_info, 0, 2000);
+        if(results->len != expected->len || memcmp(results->buffer, expected->buffer, expected->len)){
+            fprintf(stderr, "- FAILED: %s log messages read from the DB do not match the ones written\n", names[c]);
+            errors++;
+        }
+        buffer_free(results);
+        buffer_free(expected);
+        unit_test_log_source_destroy(p_file_info);
+    }
+    fprintf(stderr, "- %d log messages compressed to %zu bytes with lz4f, %zu with lz4f_hc and %zu with lz4_dict\n", 
+            msgs_num, compressed_size[0], compressed_size[1], compressed_size[2]);
+    if(compressed_size[2] >= compressed_size[0]){
+        fprintf(stderr, "- FAILED: log messages did not compress better with the dictionary\n");
+        errors++;
+    }
+
+    /* No log file to train a dictionary from */
+    struct File_info *p_file_info = unit_test_log_source_create(tmp_dir, "no_dict", LOGS_COMPR_CODEC_LZ4_DICT, 4);
+    if(p_file_info->compr_codec != LOGS_COMPR_CODEC_LZ4F || p_file_info->compr_dicts_num){
+        fprintf(stderr, "- FAILED: log source without a dictionary did not fall back to lz4f\n");
+        errors++;
+    }
+    unit_test_log_source_destroy(p_file_info);
+
+    unit_test_rmdir(tmp_dir);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Check that the DB of a log source returns exactly the given log messages of test_db_startup_recovery()
+ * @param[in] alive Boolean per log message, set if it must be returned
+ * @return 1 if it does not, 0 otherwise
+ */
+static int unit_test_db_recovery_check(struct File_info *p_file_info, const int *alive, int msgs_num, const char *step){
+    char text[1 KiB];
+    BUFFER *expected = buffer_create(1 KiB);
+
+    for(int i = 0; i < msgs_num; i++){
+        if(!alive[i]) continue;
+        const size_t text_size = unit_test_log_lines(text, sizeof(text), i);
+        buffer_increase(expected, text_size);
+        memcpy(&expected->buffer[expected->len], text, text_size - 1);
+        expected->len += text_size - 1;
+    }
+    BUFFER *results = unit_test_db_search(p_file_info, 0, 2000);
+    const int failed = results->len != expected->len || memcmp(results->buffer, expected->buffer, expected->len);
+    if(failed) fprintf(stderr, "- FAILED: wrong log messages in the DB after %s\n", step);
+    buffer_free(results);
+    buffer_free(expected);
+    return failed;
+}
+
+/**
+ * @brief Test that opening the DB of a log source heals it after a crash
+ * @details The DB is closed, left the way a crash at different points would leave it and 
+ * opened again: with a BLOB that is longer or shorter than its metadata, in the middle of 
+ * a rotation of the BLOBs (before and after the metadata were rotated) and with the 
+ * temporary file of a discarded compaction. Only the log messages that are wholly in 
+ * their BLOB must be kept, and new log messages must be written after them. BLOBs beyond 
+ * BLOB_MAX_FILES must be removed and the rest renumbered, whatever the gaps in their Ids.
+ */
+static int test_db_startup_recovery(void){
+    int errors = 0;
+    char tmp_dir[] = "/tmp/netdata-logsmanagement-unittest-XXXXXX";
+    char path[FILENAME_MAX + 1], new_path[FILENAME_MAX + 1], text[1 KiB];
+    enum { MSGS_NUM = 16 };
+    int alive[MSGS_NUM] = {0}, msgs_num = 0;
+    size_t compressed_size[MSGS_NUM] = {0};
+    int64_t blob_size = 0;
+    struct stat statbuf;
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    if(!mkdtemp(tmp_dir)){
+        fprintf(stderr, "- FAILED: cannot create %s\n", tmp_dir);
+        return 1;
+    }
+    struct File_info *p_file_info = unit_test_log_source_create(tmp_dir, "recovery", LOGS_COMPR_CODEC_LZ4F, 4);
+    char blob_path[FILENAME_MAX + 1];
+    snprintf(blob_path, FILENAME_MAX, "%slogs.bin.0", p_file_info->db_dir);
+
+#define UNIT_TEST_WRITE_MSGS(n) do { \
+        for(int m = 0; m < (n); m++, msgs_num++){ \
+            const size_t text_size = unit_test_log_lines(text, sizeof(text), msgs_num); \
+            unit_test_buff_insert(p_file_info, 1000 + (uint64_t) msgs_num, text, text_size); \
+            compressed_size[msgs_num] = p_file_info->msg_buff->msgs[(p_file_info->msg_buff->head - 1) & p_file_info->msg_buff->size_mask].text_compressed_size; \
+            blob_size += (int64_t) compressed_size[msgs_num]; \
+            alive[msgs_num] = 1; \
+        } \
+        db_log_source_flush(p_file_info); \
+    } while(0)
+
+    UNIT_TEST_WRITE_MSGS(8);
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "writing");
+
+    /* BLOB longer than its metadata: it is truncated */
+    db_log_source_close(p_file_info);
+    FILE *fp = fopen(blob_path, "a");
+    fatal_assert(fp);
+    fwrite(text, 1, 100, fp);
+    fclose(fp);
+    db_log_source_open(p_file_info, 2048);
+    if(stat(blob_path, &statbuf) || statbuf.st_size != blob_size){
+        fprintf(stderr, "- FAILED: BLOB longer than its metadata was not truncated\n");
+        errors++;
+    }
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "truncating a longer BLOB");
+    UNIT_TEST_WRITE_MSGS(2);
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "writing to a truncated BLOB");
+
+    /* BLOB shorter than its metadata, in the middle of the last log message: it is dropped */
+    db_log_source_close(p_file_info);
+    fatal_assert(!truncate(blob_path, blob_size - (int64_t) compressed_size[msgs_num - 1] / 2));
+    db_log_source_open(p_file_info, 2048);
+    blob_size -= (int64_t) compressed_size[msgs_num - 1];
+    alive[msgs_num - 1] = 0;
+    if(stat(blob_path, &statbuf) || statbuf.st_size != blob_size){
+        fprintf(stderr, "- FAILED: BLOB shorter than its metadata was not truncated to its last whole log message\n");
+        errors++;
+    }
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "rebuilding the metadata of a shorter BLOB");
+    UNIT_TEST_WRITE_MSGS(1);
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "writing to a BLOB with rebuilt metadata");
+
+    /* Rotation interrupted while renaming the BLOB files: it is undone */
+    db_log_source_close(p_file_info);
+    for(int i = BLOB_MAX_FILES - 1; i >= BLOB_MAX_FILES / 2; i--){
+        snprintf(path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, i);
+        snprintf(new_path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, i + 1);
+        fatal_assert(!rename(path, new_path));
+    }
+    db_log_source_open(p_file_info, 2048);
+    for(int i = 0; i <= BLOB_MAX_FILES; i++){
+        snprintf(path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, i);
+        if(!stat(path, &statbuf) != (i < BLOB_MAX_FILES)){
+            fprintf(stderr, "- FAILED: rotation of BLOB files was not undone (logs.bin.%d)\n", i);
+            errors++;
+        }
+    }
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "undoing an interrupted rotation");
+
+    /* Rotation interrupted after renaming the BLOB files and their metadata: it is completed */
+    const int blob_write_handle_offset = p_file_info->blob_write_handle_offset;
+    db_log_source_close(p_file_info);
+    sqlite3 *db;
+    snprintf(path, FILENAME_MAX, "%smetadata.db", p_file_info->db_dir);
+    fatal_assert(sqlite3_open(path, &db) == SQLITE_OK);
+    for(int i = BLOB_MAX_FILES - 1; i >= 0; i--){
+        snprintf(path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, i);
+        snprintf(new_path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, i + 1);
+        fatal_assert(!rename(path, new_path));
+        char *sql = sqlite3_mprintf("UPDATE Blobs SET Filename = 'logs.bin.%d' WHERE Filename = 'logs.bin.%d';", i + 1, i);
+        fatal_assert(sqlite3_exec(db, sql, NULL, NULL, NULL) == SQLITE_OK);
+        sqlite3_free(sql);
+    }
+    fatal_assert(sqlite3_close(db) == SQLITE_OK);
+    db_log_source_open(p_file_info, 2048);
+    snprintf(path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, BLOB_MAX_FILES);
+    if(!stat(path, &statbuf) || stat(blob_path, &statbuf) || statbuf.st_size || 
+       p_file_info->blob_write_handle_offset == blob_write_handle_offset){
+        fprintf(stderr, "- FAILED: rotation of BLOBs was not completed\n");
+        errors++;
+    }
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "completing an interrupted rotation");
+    UNIT_TEST_WRITE_MSGS(1);
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "writing to a rotated BLOB");
+
+    /* Compaction interrupted before its metadata were committed: it is discarded */
+    snprintf(path, FILENAME_MAX, "%slogs.bin.compact.%d", p_file_info->db_dir, blob_write_handle_offset);
+    db_log_source_close(p_file_info);
+    fp = fopen(path, "w");
+    fatal_assert(fp);
+    fwrite(text, 1, 100, fp);
+    fclose(fp);
+    db_log_source_open(p_file_info, 2048);
+    if(!stat(path, &statbuf)){
+        fprintf(stderr, "- FAILED: temporary file of an interrupted compaction was not removed\n");
+        errors++;
+    }
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "discarding an interrupted compaction");
+
+    /* More BLOBs than BLOB_MAX_FILES (left by a build with more of them) and gaps in their Ids: 
+     * the excess BLOBs are removed and the rest are renumbered from 1, in their order. The 
+     * excess BLOBs start from logs.bin.<BLOB_MAX_FILES + 1>, as logs.bin.<BLOB_MAX_FILES> is 
+     * taken for an interrupted rotation. */
+    const int blob_write_handle_offset_renumbered = p_file_info->blob_write_handle_offset;
+    db_log_source_close(p_file_info);
+    snprintf(path, FILENAME_MAX, "%smetadata.db", p_file_info->db_dir);
+    fatal_assert(sqlite3_open(path, &db) == SQLITE_OK);
+    fatal_assert(sqlite3_exec(db, 
+        "PRAGMA foreign_keys = ON;"
+        "INSERT INTO Blobs (Id, Filename, Filesize) VALUES (101, 'logs.bin.11', 0), (102, 'logs.bin.12', 0);"
+        "UPDATE Blobs SET Id = Id * 2 + 200;"
+        "UPDATE Blobs SET Id = CASE Filename WHEN 'logs.bin.11' THEN 1 WHEN 'logs.bin.12' THEN 7 ELSE Id END;", 
+        NULL, NULL, NULL) == SQLITE_OK);
+    fatal_assert(sqlite3_close(db) == SQLITE_OK);
+    for(int i = BLOB_MAX_FILES + 1; i <= BLOB_MAX_FILES + 2; i++){
+        snprintf(path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, i);
+        fp = fopen(path, "w");
+        fatal_assert(fp);
+        fclose(fp);
+    }
+    db_log_source_open(p_file_info, 2048);
+    for(int i = BLOB_MAX_FILES + 1; i <= BLOB_MAX_FILES + 2; i++){
+        snprintf(path, FILENAME_MAX, "%slogs.bin.%d", p_file_info->db_dir, i);
+        if(!stat(path, &statbuf)){
+            fprintf(stderr, "- FAILED: BLOB beyond BLOB_MAX_FILES (logs.bin.%d) was not removed\n", i);
+            errors++;
+        }
+    }
+    if(p_file_info->blob_write_handle_offset != blob_write_handle_offset_renumbered){
+        fprintf(stderr, "- FAILED: BLOB written to is %d instead of %d after renumbering the BLOBs\n", 
+                p_file_info->blob_write_handle_offset, blob_write_handle_offset_renumbered);
+        errors++;
+    }
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "renumbering the BLOBs");
+    UNIT_TEST_WRITE_MSGS(1);
+    errors += unit_test_db_recovery_check(p_file_info, alive, msgs_num, "writing to a renumbered BLOB");
+#undef UNIT_TEST_WRITE_MSGS
+
+    unit_test_log_source_destroy(p_file_info);
+    unit_test_rmdir(tmp_dir);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test that log lines are filtered by a predicate on chart dimensions
+ * @details Each predicate must keep exactly the log lines that contributed to all of its
+ * dimensions, in their original order. Lines that cannot be parsed never match and 
+ * predicates with unsupported charts or dimensions must be rejected.
+ */
+static int test_log_line_predicate(void){
+    int errors = 0;
+    const char *lines[] = {
+        "example.com:80 192.168.1.1 - - [17/Oct/2026:10:00:00 +0000] \"GET /index.html HTTP/1.1\" 200 1234\n",
+        "example.com:443 192.168.1.2 - - [17/Oct/2026:10:00:01 +0000] \"POST /login HTTP/1.1\" 503 12\n",
+        "other.org:8080 2001:db8::1 - - [17/Oct/2026:10:00:02 +0000] \"GET /missing HTTP/2.0\" 404 0\n",
+        "this line cannot be parsed\n",
+        "other.org:80 10.0.0.1 - - [17/Oct/2026:10:00:03 +0000] \"POST /api HTTP/1.0\" 304 0\n",
+        "example.com:8080 2001:db8::2 - - [17/Oct/2026:10:00:04 +0000] \"PUT /upload HTTP/1.1\" 401 0\n",
+        "example.com:80 10.0.0.2 - - [17/Oct/2026:10:00:05 +0000] \"POST /api HTTP/1.1\" 500 77"
+    };
+    const int lines_num = (int) (sizeof(lines) / sizeof(lines[0]));
+    const struct {
+        const char *spec;
+        int expected;   /**< Bitmap of lines[] that match, -1 if the predicate is not valid */
+    } predicates[] = {
+        { "responses:5xx",                              0x42 },
+        { "response types:success",                     0x31 },
+        { "detailed responses:404",                     0x04 },
+        { "vhost:example.com|http methods:POST",        0x42 },
+        { "ip version:ipv6",                            0x24 },
+        { "port:8080|ip version:ipv6",                  0x24 },
+        { "http versions:1.0",                          0x10 },
+        { "http versions:2.0|responses:4xx",            0x04 },
+        { "vhost:example.org",                          0x00 },
+        { "responses:6xx",                              -1 },
+        { "detailed responses:abc",                     -1 },
+        { "no such chart:1",                            -1 },
+        { "responses",                                  -1 },
+        { "",                                           -1 }
+    };
+    char text[2 KiB], expected[2 KiB];
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    Log_parser_config_t *parser_config = read_parse_config(
+        "$host:$server_port $remote_addr - - [$time_local] \"$request\" $status $body_bytes_sent", ' ');
+    fatal_assert(parser_config);
+
+    for(size_t p = 0; p < sizeof(predicates) / sizeof(predicates[0]); p++){
+        Log_line_predicate_t *predicate = log_line_predicate_create(predicates[p].spec);
+        if(!predicate != (predicates[p].expected < 0)){
+            fprintf(stderr, "- FAILED: predicate \"%s\" was %s\n", predicates[p].spec, predicate ? "accepted" : "rejected");
+            errors++;
+        }
+        if(!predicate) continue;
+
+        size_t text_len = 0, expected_len = 0;
+        for(int i = 0; i < lines_num; i++){
+            text_len += (size_t) snprintf(&text[text_len], sizeof(text) - text_len, "%s", lines[i]);
+            if(predicates[p].expected & (1 << i))
+                expected_len += (size_t) snprintf(&expected[expected_len], sizeof(expected) - expected_len, "%s", lines[i]);
+        }
+
+        Log_line_predicate_search_t *search = log_line_predicate_search_create(predicate, parser_config);
+        const size_t kept_size = filter_lines_by_predicate(text, text_len + 1, search);
+        if(kept_size != (expected_len ? expected_len + 1 : 0) || (kept_size && memcmp(text, expected, kept_size))){
+            fprintf(stderr, "- FAILED: predicate \"%s\" kept:\n%.*s\n", predicates[p].spec, (int) kept_size, text);
+            errors++;
+        }
+        log_line_predicate_search_destroy(search);
+        log_line_predicate_destroy(predicate);
+    }
+
+    freez(parser_config->fields);
+    freez(parser_config->plan);
+    freez(parser_config);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Test that a query of multiple log sources merges their results in time order
+ * @details Two out of three log sources are queried through a list of chart names, with 
+ * some of their log messages in the DB and the rest in the circular buffer. Their 
+ * timestamps are interleaved and shared by log messages of both sources and of the same 
+ * source. Paging through the results with continuation tokens and a quota of a few results 
+ * must return each log message of the queried sources exactly once, in time order, with 
+ * ties resolved by the order of the log sources.
+ */
+static int test_query_merge_sources(void){
+    int errors = 0;
+    char tmp_dir[] = "/tmp/netdata-logsmanagement-unittest-XXXXXX";
+    const char *names[] = { "merge_a", "merge_b", "merge_c" };
+    enum { SOURCES_NUM = 3, MSGS_NUM = 10 };
+    struct File_info *p_file_infos[SOURCES_NUM];
+    char text[SOURCES_NUM][MSGS_NUM][32];
+    uint64_t timestamps[SOURCES_NUM][MSGS_NUM];
+
+    fprintf(stderr, "%s() running...\n", __FUNCTION__ );
+
+    if(!mkdtemp(tmp_dir)){
+        fprintf(stderr, "- FAILED: cannot create %s\n", tmp_dir);
+        return 1;
+    }
+    for(int s = 0; s < SOURCES_NUM; s++){
+        p_file_infos[s] = unit_test_log_source_create(tmp_dir, names[s], LOGS_COMPR_CODEC_LZ4F, 4);
+        for(int i = 0; i < MSGS_NUM; i++){
+            timestamps[s][i] = s == 2 ? 1000 + (uint64_t) ((i + 5) * 2 / 3) : 1000 + (uint64_t) i;
+            const size_t text_size = (size_t) snprintf(text[s][i], sizeof(text[s][i]), "%s %" PRIu64 " %d\n", 
+                                                       names[s], timestamps[s][i], i) + 1;
+            unit_test_buff_insert(p_file_infos[s], timestamps[s][i], text[s][i], text_size);
+            if(i == MSGS_NUM / 2) db_log_source_flush(p_file_infos[s]);
+        }
+    }
+
+    /* Results of merge_a and merge_c, in time order (ties in the order of the log sources) */
+    char expected[2 * MSGS_NUM * 32];
+    size_t expected_len = 0;
+    for(int a = 0, c = 0; a < MSGS_NUM || c < MSGS_NUM; ){
+        const int s = c == MSGS_NUM || (a < MSGS_NUM && timestamps[0][a] <= timestamps[2][c]) ? 0 : 2;
+        expected_len += (size_t) snprintf(&expected[expected_len], sizeof(expected) - expected_len, "%s", 
+                                          text[s][s ? c++ : a++]);
+    }
+
+    struct File_infos_arr *p_file_infos_arr_saved = p_file_infos_arr;
+    struct File_infos_arr file_infos_arr = { .data = p_file_infos, .count = SOURCES_NUM };
+    p_file_infos_arr = &file_infos_arr;
+
+    char returned[2 * MSGS_NUM * 32];
+    size_t returned_len = 0;
+    /* The query ends at the last timestamp of the log sources, so it is truncated there too */
+    const uint64_t end_timestamp = timestamps[0][MSGS_NUM - 1];
+    logs_query_params_t query_params = { .start_timestamp = 0, .chart_name = "merge_a,merge_c", .quota = 3 * 16 };
+    int pages = 0, rc;
+    do {
+        query_params.results_buff = buffer_create(1 KiB);
+        query_params.end_timestamp = end_timestamp;
+        rc = execute_query(&query_params);
+        if(rc && rc != -2){
+            fprintf(stderr, "- FAILED: execute_query() returned %d\n", rc);
+            errors++;
+        }
+        if(returned_len + query_params.results_buff->len <= sizeof(returned)){
+            memcpy(&returned[returned_len], query_params.results_buff->buffer, query_params.results_buff->len);
+            returned_len += query_params.results_buff->len;
+        }
+        buffer_free(query_params.results_buff);
+
+        /* Resume from the continuation token, if the quota was reached */
+        query_params.start_timestamp = query_params.act_end_timestamp;
+        query_params.start_timestamp_skip = query_params.act_end_timestamp_num;
+    } while(!rc && query_params.truncated && ++pages < 2 * MSGS_NUM);
+
+    if(returned_len != expected_len || memcmp(returned, expected, expected_len)){
+        fprintf(stderr, "- FAILED: merged results returned through continuation tokens:\n%.*s", (int) returned_len, returned);
+        errors++;
+    }
+    if(pages < 2){
+        fprintf(stderr, "- FAILED: the results were not paged\n");
+        errors++;
+    }
+
+    p_file_infos_arr = p_file_infos_arr_saved;
+    for(int s = 0; s < SOURCES_NUM; s++) unit_test_log_source_destroy(p_file_infos[s]);
+    unit_test_rmdir(tmp_dir);
+
+    fprintf(stderr, "%s\n", errors ? "FAILED" : "OK");
+    return errors;
+}
+
+/**
+ * @brief Run all the unit tests of the log management engine
+ * @return 0 if all the tests passed, non-zero otherwise
+ */
+int logs_management_unittest(void){
+    int errors = 0;
+
+    errors += test_decompress_text_errors();
+    errors += test_compress_text_dict_stream();
+    errors += test_db_blob_recompress_missing_dict();
+    errors += test_query_continuation_same_timestamp();
+    errors += test_keyword_bloom_filter();
+    errors += test_db_writer_batches();
+    errors += test_db_compr_codecs();
+    errors += test_db_startup_recovery();
+    errors += test_log_line_predicate();
+    errors += test_query_merge_sources();
+
+    fprintf(stderr, "\nLogs management unit tests %s (%d errors)\n\n", errors ? "FAILED" : "PASSED", errors);
+    return errors;
+}
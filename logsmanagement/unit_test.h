@@ -0,0 +1,10 @@
+/** @file unit_test.h
+ *  @brief Header of unit_test.c
+ */
+
+#ifndef LOGSMANAGEMENT_UNIT_TEST_H_
+#define LOGSMANAGEMENT_UNIT_TEST_H_
+
+int logs_management_unittest(void);
+
+#endif  // LOGSMANAGEMENT_UNIT_TEST_H_
@@ -549,7 +549,14 @@ static inline void do_dimension_fixedstep(
     size_t db_points_read = 0;
     time_t db_now = now;
 
-    for(rd->state->query_ops.init(rd, &handle, now, before_wanted) ; points_added < points_wanted ; now += dt) {
+#ifdef ENABLE_DBENGINE
+    if(unlikely(r->internal.tier))
+        rrdeng_load_metric_init_tier(rd, &handle, now, before_wanted, r->internal.tier, r->internal.tier_query_fetch);
+    else
+#endif
+        rd->state->query_ops.init(rd, &handle, now, before_wanted);
+
+    for( ; points_added < points_wanted ; now += dt) {
         // make sure we return data in the proper time range
         if(unlikely(now > before_wanted)) {
 #ifdef NETDATA_INTERNAL_CHECKS
@@ -822,6 +829,7 @@ static RRDR *rrd2rrdr_fixedstep(
         , time_t last_entry_t
         , int absolute_period_requested
         , struct context_param *context_param_list
+        , int tier
 ) {
     int aligned = !(options & RRDR_OPTION_NOT_ALIGNED);
 
@@ -1023,6 +1031,13 @@ static RRDR *rrd2rrdr_fixedstep(
     r->internal.points_wanted = points_wanted;
     r->internal.resampling_group = resampling_group;
     r->internal.resampling_divisor = resampling_divisor;
+    r->internal.tier = tier;
+    switch(group_method) {
+        case RRDR_GROUPING_MIN: r->internal.tier_query_fetch = TIER_QUERY_FETCH_MIN; break;
+        case RRDR_GROUPING_MAX: r->internal.tier_query_fetch = TIER_QUERY_FETCH_MAX; break;
+        case RRDR_GROUPING_SUM: r->internal.tier_query_fetch = TIER_QUERY_FETCH_SUM; break;
+        default:                r->internal.tier_query_fetch = TIER_QUERY_FETCH_AVERAGE; break;
+    }
 
 
     // -------------------------------------------------------------------------
@@ -1599,6 +1614,20 @@ RRDR *rrd2rrdr(
         struct rrdeng_region_info *region_info_array;
         unsigned regions, max_interval;
 
+        int tier_update_every;
+        int tier = rrdeng_query_tier(st, after_requested, before_requested, points_requested, &tier_update_every);
+        if (tier > 0) {
+            /* the tiers above 0 have a fixed step, aligned to their update every */
+            rrd_update_every = tier_update_every;
+            absolute_period_requested = rrdr_convert_before_after_to_absolute(&after_requested, &before_requested,
+                                                                              rrd_update_every, first_entry_t,
+                                                                              last_entry_t, options);
+            return rrd2rrdr_fixedstep(st, points_requested, after_requested, before_requested, group_method,
+                                      resampling_time_requested, options, dimensions, rrd_update_every,
+                                      first_entry_t, last_entry_t, absolute_period_requested, context_param_list,
+                                      tier);
+        }
+
         /* This call takes the chart read-lock */
         regions = rrdeng_variable_step_boundaries(st, after_requested, before_requested,
                                                   &region_info_array, &max_interval, context_param_list);
@@ -1615,7 +1644,7 @@ RRDR *rrd2rrdr(
             }
             return rrd2rrdr_fixedstep(st, points_requested, after_requested, before_requested, group_method,
                                       resampling_time_requested, options, dimensions, rrd_update_every,
-                                      first_entry_t, last_entry_t, absolute_period_requested, context_param_list);
+                                      first_entry_t, last_entry_t, absolute_period_requested, context_param_list, 0);
         } else {
             if (rrd_update_every != (uint16_t)max_interval) {
                 rrd_update_every = (uint16_t) max_interval;
@@ -1632,5 +1661,6 @@ RRDR *rrd2rrdr(
 #endif
     return rrd2rrdr_fixedstep(st, points_requested, after_requested, before_requested, group_method,
                               resampling_time_requested, options, dimensions,
-                              rrd_update_every, first_entry_t, last_entry_t, absolute_period_requested, context_param_list);
+                              rrd_update_every, first_entry_t, last_entry_t, absolute_period_requested, context_param_list,
+                              0);
 }
\ No newline at end of file
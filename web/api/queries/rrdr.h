@@ -87,6 +87,9 @@ typedef struct rrdresult {
         calculated_number (*grouping_flush)(struct rrdresult *r, RRDR_VALUE_FLAGS *rrdr_value_options_ptr);
         void *grouping_data;
 
+        int tier;               // the dbengine storage tier the dimensions are read from
+        int tier_query_fetch;   // the TIER_QUERY_FETCH rollup read from tiers above 0
+
         #ifdef NETDATA_INTERNAL_CHECKS
         const char *log;
         #endif
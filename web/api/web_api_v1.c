@@ -996,13 +996,40 @@ inline int web_client_api_request_v1_info(RRDHOST *host, struct web_client *w, c
 }
 
 #ifdef ENABLE_LOGSMANAGEMENT
+/**
+ * Logs management query.
+ *
+ * The results are decompressed directly into the response buffer (so they are
+ * sent as they are, chunked when the response is compressed) up to "quota" bytes.
+ * The actual timestamps range of the returned results is sent back in the
+ * X-Logs-From and X-Logs-End headers. If the quota was reached before the end
+ * of the requested range, a X-Logs-Continuation-Token header is also sent back,
+ * which can be passed as the "continuation_token" parameter to get the next page,
+ * without re-scanning the already returned range. The token is made of the timestamp
+ * of the last returned result (inclusive, as more results may share it), the end of
+ * the requested range and the number of results at that timestamp returned already.
+ *
+ * "chart_name" may also be a list (separated by ',' or '|') or simple pattern of
+ * chart names, in which case the results of all matching log sources are merged
+ * in time order.
+ *
+ * "keyword" is matched case insensitively, unless "case_sensitive=1" is given.
+ *
+ * To jump from a chart anomaly to the log lines behind it, "chart" (the full id of a
+ * chart of a web log source, e.g. "apache.responses") and "dimension" (e.g. "5xx") can
+ * be given, along with the time window of the anomaly as "from" and "end". Only the log
+ * lines that contributed to that dimension will be returned. "filter" can narrow them
+ * down further, as a list of "<chart id>:<dimension>" separated by '|' (e.g.
+ * "vhost:example.com|port:443"), and may also be used on its own.
+ */
 inline int web_client_api_request_v1_logsmanagement(RRDHOST *host, struct web_client *w, char *url) {
 
     BUFFER *wb = w->response.data;
     buffer_flush(wb);
 
     logs_query_params_t query_params = {0};
-    size_t buf_size = 1048576; // Default query quota size 1 MiB
+    query_params.quota = 1048576; // Default query quota size 1 MiB
+    char *chart = NULL, *dimension = NULL, *filter = NULL;
     
     while(url) {
         char *value = mystrsep(&url, "&");
@@ -1013,13 +1040,13 @@ inline int web_client_api_request_v1_logsmanagement(RRDHOST *host, struct web_cl
         if(!value || !*value) continue;
 
         if(!strcmp(name, "from")) {
-            query_params.start_timestamp = strtol(value, NULL, 10);
+            query_params.start_timestamp = strtoull(value, NULL, 10);
         }
         else if(!strcmp(name, "end")) {
-            query_params.end_timestamp = strtol(value, NULL, 10);
+            query_params.end_timestamp = strtoull(value, NULL, 10);
         }
         else if(!strcmp(name, "quota")) {
-            buf_size = (size_t) strtol(value, NULL, 10);
+            query_params.quota = (size_t) strtoull(value, NULL, 10);
         }
         else if(!strcmp(name, "chart_name")) {
             query_params.chart_name = value;
@@ -1027,31 +1054,82 @@ inline int web_client_api_request_v1_logsmanagement(RRDHOST *host, struct web_cl
         else if(!strcmp(name, "keyword")) {
             query_params.keyword = value;
         }
+        else if(!strcmp(name, "case_sensitive")) {
+            query_params.case_sensitive = str2i(value) ? 1 : 0;
+        }
+        else if(!strcmp(name, "chart")) {
+            chart = value;
+        }
+        else if(!strcmp(name, "dimension")) {
+            dimension = value;
+        }
+        else if(!strcmp(name, "filter")) {
+            filter = value;
+        }
+        else if(!strcmp(name, "continuation_token")) {
+            // Token format is "<from>,<end>,<skip>" - it overrides any from / end parameters
+            char *end_str = NULL, *skip_str = NULL;
+            uint64_t token_from = strtoull(value, &end_str, 10);
+            if(end_str && *end_str == ',') {
+                query_params.start_timestamp = token_from;
+                query_params.end_timestamp = strtoull(end_str + 1, &skip_str, 10);
+                if(skip_str && *skip_str == ',')
+                    query_params.start_timestamp_skip = (size_t) strtoull(skip_str + 1, NULL, 10);
+            }
+        }
     }
 
-    BUFFER *buf = buffer_create(buf_size);
-    buf->len = 0; // Remove?
-    query_params.results_buff = buf;
+    /* Chart ids are "<chart name of log source>.<chart id>", the former selecting the 
+     * log source (unless chart_name is given) and the latter the predicate */
+    BUFFER *predicate = NULL;
+    if(chart && dimension) {
+        char *chart_id = strrchr(chart, '.');
+        if(chart_id) {
+            *chart_id++ = '\0';
+            if(!query_params.chart_name) query_params.chart_name = chart;
+        }
+        else chart_id = chart;
+
+        predicate = buffer_create(100);
+        buffer_sprintf(predicate, "%s:%s", chart_id, dimension);
+        if(filter) buffer_sprintf(predicate, "|%s", filter);
+        query_params.predicate = (char *) buffer_tostring(predicate);
+    }
+    else query_params.predicate = filter;
+
+    const uint64_t req_end_timestamp = query_params.end_timestamp;
+    query_params.results_buff = wb;
 
     wb->contenttype = CT_TEXT_PLAIN;
 
+    int ret = HTTP_RESP_OK;
     switch(execute_query(&query_params)){
         case -1:
-            buffer_sprintf(wb, "Chart name not found!");
+            buffer_strcat(wb, "Chart name not found!");
             break;
         case -2:
-            buffer_sprintf(wb, "Query returned no results!");
+            buffer_strcat(wb, "Query returned no results!");
+            break;
+        case -3:
+            buffer_strcat(wb, "Unsupported chart or dimension to filter log lines by!");
+            ret = HTTP_RESP_BAD_REQUEST;
+            break;
+        case -4:
+            buffer_strcat(wb, "Failed to read the logs from the database!");
+            ret = HTTP_RESP_INTERNAL_SERVER_ERROR;
+            break;
         default:
-            buffer_sprintf(wb, "%s", buf->buffer);
+            buffer_sprintf(w->response.header, "X-Logs-From: %" PRIu64 "\r\nX-Logs-End: %" PRIu64 "\r\n",
+                           query_params.act_start_timestamp, query_params.act_end_timestamp);
+            if(query_params.truncated)
+                buffer_sprintf(w->response.header, "X-Logs-Continuation-Token: %" PRIu64 ",%" PRIu64 ",%zu\r\n",
+                               query_params.act_end_timestamp, req_end_timestamp, query_params.act_end_timestamp_num);
             break;
     } 
-    
-    buffer_free(buf);
-
-    // TODO: Requested from, end and size..... Actual returned from, end and size.....
 
+    buffer_free(predicate);
     buffer_no_cacheable(wb);
-    return HTTP_RESP_OK;
+    return ret;
 }
 #endif
 